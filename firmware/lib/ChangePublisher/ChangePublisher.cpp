@@ -0,0 +1,72 @@
+#include "ChangePublisher.h"
+
+#include <stdlib.h>
+
+// Default deadbands, in TelemetryCodec units
+static const int32_t DEFAULT_DEADBANDS[TF_FIELD_COUNT] = {
+  0,     // TF_TIME
+  300,   // TF_LAT, about 3 m
+  300,   // TF_LON, 3 m or less
+  10,    // TF_SOG, 0.1 kt
+  200,   // TF_COG, 2°
+  20,    // TF_AWS, 0.2 kt
+  200,   // TF_AWA, 2°
+  20,    // TF_TWS, 0.2 kt
+  200,   // TF_TWA, 2°
+  50,    // TF_HEEL, 0.5°
+  100,   // TF_HDM, 1°
+  1,     // TF_SATS, any change
+  5,     // TF_HDOP, 0.5
+  100,   // TF_ACCEL_X, 1 m/s²
+  100,   // TF_ACCEL_Y
+  100,   // TF_ACCEL_Z
+  0,     // TF_RSSI
+  0,     // TF_SEQ
+  200,   // TF_TWD, 2°
+};
+static_assert(sizeof(DEFAULT_DEADBANDS) / sizeof(DEFAULT_DEADBANDS[0]) == TF_FIELD_COUNT,
+              "one deadband per telemetry channel");
+
+static const int32_t ANGLE_TURN = 36000;
+
+static bool isAngle(int field) {
+  return field == TF_COG || field == TF_AWA || field == TF_TWA || field == TF_HDM || field == TF_TWD;
+}
+
+ChangePublisher::ChangePublisher(const PublishConfig &config) : config(config) {
+  for (int f = 0; f < TF_FIELD_COUNT; f++) deadbands[f] = DEFAULT_DEADBANDS[f];
+}
+
+bool ChangePublisher::changed(const TelemetryFrame &frame) const {
+  if (frame.valid != reference.valid) return true;
+  for (int f = 0; f < TF_FIELD_COUNT; f++) {
+    if (deadbands[f] <= 0 || !frame.has((TelemetryField)f)) continue;
+    int64_t delta = llabs((int64_t)frame.value[f] - reference.value[f]);
+    if (isAngle(f) && delta > ANGLE_TURN / 2) delta = ANGLE_TURN - delta % ANGLE_TURN;
+    if (delta >= deadbands[f]) return true;
+  }
+  return false;
+}
+
+PublishReason ChangePublisher::update(uint32_t now, const TelemetryFrame &frame, bool force) {
+  PublishReason reason = PUBLISH_NONE;
+  uint32_t sincePublish = now - lastPublish;
+  if (!hasReference) {
+    reason = PUBLISH_FIRST;
+  } else if (sincePublish >= config.heartbeatMs) {
+    reason = PUBLISH_HEARTBEAT;
+  } else if (sincePublish >= config.minIntervalMs) {
+    if (force) reason = PUBLISH_FORCED;
+    else if (changed(frame)) reason = PUBLISH_CHANGE;
+  }
+
+  if (reason == PUBLISH_NONE) {
+    suppressed++;
+    return reason;
+  }
+  reference = frame;
+  hasReference = true;
+  lastPublish = now;
+  published++;
+  return reason;
+}
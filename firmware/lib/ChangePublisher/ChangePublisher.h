@@ -0,0 +1,60 @@
+#pragma once
+
+#include <TelemetryCodec.h>
+#include <stdint.h>
+
+// Decides which snapshots are worth notifying: those of every refresh tick
+// and of every fast update between them (IMU report, wind reading).
+//
+// A snapshot is published when any channel moved by at least its deadband
+// since the last published snapshot (or a channel appeared/disappeared),
+// but never sooner than minIntervalMs after the previous one. Otherwise it
+// is published once heartbeatMs have passed, so clients still see the link
+// alive and slow drifts below the deadbands. A steady boat therefore costs
+// one notify per heartbeat instead of one per refresh tick, and a change
+// goes out with the update that sees it.
+//
+// Deadbands are in the frame's fixed-point units; 0 ignores the channel
+// (time, sequence, RSSI). Angle channels are compared modulo one turn.
+
+enum PublishReason : uint8_t {
+  PUBLISH_NONE = 0,   // Suppressed
+  PUBLISH_FIRST,      // First frame or after reset()
+  PUBLISH_CHANGE,     // A deadband was crossed
+  PUBLISH_HEARTBEAT,  // Nothing changed for heartbeatMs
+  PUBLISH_FORCED,     // Caller asked for it
+};
+
+struct PublishConfig {
+  uint32_t minIntervalMs = 250;   // Rate limit for change-triggered notifies
+  uint32_t heartbeatMs = 5000;    // Longest gap between notifies
+};
+
+class ChangePublisher {
+public:
+  explicit ChangePublisher(const PublishConfig &config = PublishConfig());
+
+  void setDeadband(TelemetryField field, int32_t deadband) { deadbands[field] = deadband; }
+  int32_t deadband(TelemetryField field) const { return deadbands[field]; }
+
+  // Decide for the snapshot taken at `now`; a published frame becomes the
+  // new reference. `force` publishes regardless of change (still rate limited).
+  PublishReason update(uint32_t now, const TelemetryFrame &frame, bool force = false);
+
+  // Publish the next snapshot unconditionally (new subscriber)
+  void reset() { hasReference = false; }
+
+  uint32_t publishedCount() const { return published; }
+  uint32_t suppressedCount() const { return suppressed; }
+
+private:
+  bool changed(const TelemetryFrame &frame) const;
+
+  PublishConfig config;
+  int32_t deadbands[TF_FIELD_COUNT];
+  TelemetryFrame reference = {};
+  bool hasReference = false;
+  uint32_t lastPublish = 0;
+  uint32_t published = 0;
+  uint32_t suppressed = 0;
+};
@@ -0,0 +1,57 @@
+#include "ConnParams.h"
+
+#define BULK_MIN_INTERVAL_MS 15
+#define BULK_MAX_INTERVAL_MS 30
+#define DASHBOARD_MIN_INTERVAL_MS 45   // Lower bound of the long interval
+#define DASHBOARD_MAX_INTERVAL_MS 150  // Upper bound, keeps the link responsive
+#define INTERVAL_SPREAD_MS 15          // max - min, as iOS requires
+#define MAX_SLAVE_LATENCY 4
+#define MIN_TIMEOUT_MS 2000
+#define MAX_TIMEOUT_MS 6000
+
+const char* connProfileName(ConnProfile profile) {
+  switch (profile) {
+    case CONN_PROFILE_NONE: return "default";
+    case CONN_PROFILE_DASHBOARD: return "dashboard";
+    case CONN_PROFILE_BULK: return "bulk";
+  }
+  return "unknown";
+}
+
+static uint16_t intervalUnits(uint32_t ms) {
+  return (uint16_t)(ms * 1000 / CONN_INTERVAL_UNIT_US);
+}
+
+// Supervision timeout: three full latency cycles, within the allowed range
+static uint16_t timeoutUnits(uint32_t maxIntervalMs, uint16_t latency) {
+  uint32_t ms = maxIntervalMs * (latency + 1) * 3 + CONN_TIMEOUT_UNIT_MS;
+  if (ms < MIN_TIMEOUT_MS) ms = MIN_TIMEOUT_MS;
+  if (ms > MAX_TIMEOUT_MS) ms = MAX_TIMEOUT_MS;
+  return (uint16_t)(ms / CONN_TIMEOUT_UNIT_MS);
+}
+
+ConnParams connParamsFor(ConnProfile profile, uint32_t refreshMs) {
+  ConnParams params;
+  if (profile == CONN_PROFILE_BULK) {
+    params.minInterval = intervalUnits(BULK_MIN_INTERVAL_MS);
+    params.maxInterval = intervalUnits(BULK_MAX_INTERVAL_MS);
+    params.latency = 0;
+    params.timeout = timeoutUnits(BULK_MAX_INTERVAL_MS, 0);
+    return params;
+  }
+
+  // About eight connection events per refresh, of which the peripheral
+  // attends every (latency + 1)-th: a command waits at most refresh / 2
+  uint32_t maxMs = refreshMs / 8;
+  if (maxMs < DASHBOARD_MIN_INTERVAL_MS) maxMs = DASHBOARD_MIN_INTERVAL_MS;
+  if (maxMs > DASHBOARD_MAX_INTERVAL_MS) maxMs = DASHBOARD_MAX_INTERVAL_MS;
+  uint32_t cycles = refreshMs / (2 * maxMs);
+  uint16_t latency = cycles > 1 ? (uint16_t)(cycles - 1) : 0;
+  if (latency > MAX_SLAVE_LATENCY) latency = MAX_SLAVE_LATENCY;
+
+  params.minInterval = intervalUnits(maxMs - INTERVAL_SPREAD_MS);
+  params.maxInterval = intervalUnits(maxMs);
+  params.latency = latency;
+  params.timeout = timeoutUnits(maxMs, latency);
+  return params;
+}
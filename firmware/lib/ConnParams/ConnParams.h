@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+// BLE connection parameters per connection profile.
+//
+// The advertised preferred interval is only a hint; once a central has
+// connected, the peripheral has to ask for the parameters it wants. Two
+// profiles cover what the firmware does:
+//
+//   BULK       OTA, session log or trace transfer: the shortest interval
+//              phones accept and no slave latency, so every connection event
+//              can carry notifies and acknowledgements.
+//   DASHBOARD  Periodic telemetry: a long interval with slave latency sized
+//              to the publish rate. The radio wakes a few times per update,
+//              and a command written by the client still waits at most half
+//              a refresh period.
+//
+// The values respect the Apple accessory guidelines (interval >= 15 ms,
+// max >= min + 15 ms, latency <= 30, timeout 2..6 s and
+// max * (latency + 1) * 3 < timeout), which Android centrals accept as well.
+
+// Units as in the HCI spec
+#define CONN_INTERVAL_UNIT_US 1250  // Connection interval
+#define CONN_TIMEOUT_UNIT_MS 10     // Supervision timeout
+
+enum ConnProfile : uint8_t {
+  CONN_PROFILE_NONE = 0,  // Nothing requested yet (central's choice)
+  CONN_PROFILE_DASHBOARD = 1,
+  CONN_PROFILE_BULK = 2,
+};
+
+struct ConnParams {
+  uint16_t minInterval;  // 1.25 ms units
+  uint16_t maxInterval;  // 1.25 ms units
+  uint16_t latency;      // Connection events the peripheral may skip
+  uint16_t timeout;      // 10 ms units
+};
+
+const char* connProfileName(ConnProfile profile);
+
+// Parameters to request for a profile at the given publish interval
+ConnParams connParamsFor(ConnProfile profile, uint32_t refreshMs);
@@ -0,0 +1,158 @@
+#include "DeltaPatch.h"
+
+#include <string.h>
+
+static uint32_t readLE32(const uint8_t* p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+void DeltaPatch::begin() {
+  currentState = DELTA_HEADER;
+  failure = nullptr;
+  headerFill = 0;
+  stage = STAGE_OP;
+  varint = 0;
+  varintShift = 0;
+  opLength = 0;
+  sourceCursor = 0;
+  targetWritten = 0;
+  targetHash.reset();
+}
+
+bool DeltaPatch::fail(const char* message) {
+  failure = message;
+  currentState = DELTA_FAILED;
+  return false;
+}
+
+size_t DeltaPatch::feed(const uint8_t* data, size_t length) {
+  size_t used = 0;
+  while (used < length) {
+    if (currentState == DELTA_HEADER) {
+      size_t take = DELTA_HEADER_SIZE - headerFill;
+      if (take > length - used) take = length - used;
+      memcpy(headerBytes + headerFill, data + used, take);
+      headerFill += take;
+      used += take;
+      if (headerFill < DELTA_HEADER_SIZE) continue;
+
+      if (memcmp(headerBytes, DELTA_MAGIC, 4) != 0) {
+        fail("Not a firmware patch");
+        return used;
+      }
+      patchHeader.sourceSize = readLE32(headerBytes + 4);
+      patchHeader.targetSize = readLE32(headerBytes + 8);
+      memcpy(patchHeader.sourceHash, headerBytes + 12, SHA256_SIZE);
+      memcpy(patchHeader.targetHash, headerBytes + 44, SHA256_SIZE);
+      if (patchHeader.targetSize == 0) {
+        fail("Patch has an empty target");
+        return used;
+      }
+      currentState = DELTA_READY;
+      return used;
+    }
+
+    if (currentState == DELTA_COMPLETE) {
+      fail("Data after the end of the patch");
+      return used;
+    }
+    if (currentState != DELTA_APPLYING) return used;
+
+    if (stage == STAGE_INSERT) {
+      // Literal bytes go straight from the patch to the sink
+      size_t take = opLength < length - used ? opLength : length - used;
+      if (!emit(data + used, take)) return used;
+      used += take;
+      opLength -= take;
+      if (opLength == 0) stage = STAGE_OP;
+    } else if (!decode(data[used++])) {
+      return used;
+    }
+    if (stage == STAGE_OP && targetWritten == patchHeader.targetSize) currentState = DELTA_COMPLETE;
+  }
+  return used;
+}
+
+// One byte of an operation's varints; runs the COPY once its offset is read
+bool DeltaPatch::decode(uint8_t byte) {
+  varint |= (uint32_t)(byte & 0x7f) << varintShift;
+  if (byte & 0x80) {
+    varintShift += 7;
+    return varintShift <= 28 || fail("Malformed patch operation");
+  }
+  uint32_t value = varint;
+  varint = 0;
+  varintShift = 0;
+
+  if (stage == STAGE_OP) {
+    opLength = value >> 1;
+    if (opLength == 0 || opLength > patchHeader.targetSize - targetWritten) {
+      return fail("Patch operation past the end of the image");
+    }
+    stage = (value & 1) ? STAGE_INSERT : STAGE_OFFSET;
+    return true;
+  }
+
+  // Zigzag: distance from the end of the previous COPY
+  int32_t distance = (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+  uint32_t from = sourceCursor + (uint32_t)distance;
+  if (from > patchHeader.sourceSize || opLength > patchHeader.sourceSize - from) {
+    return fail("Patch copies from outside the running image");
+  }
+  if (!copy(from, opLength)) return false;
+  sourceCursor = from + opLength;
+  opLength = 0;
+  stage = STAGE_OP;
+  return true;
+}
+
+bool DeltaPatch::copy(uint32_t offset, uint32_t length) {
+  while (length > 0) {
+    size_t take = length < DELTA_COPY_BUFFER ? length : DELTA_COPY_BUFFER;
+    if (!source.read(offset, copyBuffer, take)) return fail("Running image read failed");
+    if (!emit(copyBuffer, take)) return false;
+    offset += take;
+    length -= take;
+  }
+  return true;
+}
+
+bool DeltaPatch::emit(const uint8_t* data, size_t length) {
+  if (!sink.write(data, length)) return fail("Image write failed");
+  targetHash.update(data, length);
+  targetWritten += length;
+  return true;
+}
+
+bool DeltaPatch::verifySource() {
+  if (currentState != DELTA_READY) return false;
+  if (patchHeader.sourceSize > source.size()) return fail("Patch is for a different firmware");
+
+  Sha256 hash;
+  for (uint32_t offset = 0; offset < patchHeader.sourceSize; offset += DELTA_COPY_BUFFER) {
+    size_t take = patchHeader.sourceSize - offset < DELTA_COPY_BUFFER ? patchHeader.sourceSize - offset
+                                                                       : DELTA_COPY_BUFFER;
+    if (!source.read(offset, copyBuffer, take)) return fail("Running image read failed");
+    hash.update(copyBuffer, take);
+  }
+  uint8_t digest[SHA256_SIZE];
+  hash.finish(digest);
+  if (memcmp(digest, patchHeader.sourceHash, SHA256_SIZE) != 0) return fail("Patch is for a different firmware");
+  return true;
+}
+
+void DeltaPatch::start() {
+  if (currentState == DELTA_READY) currentState = DELTA_APPLYING;
+}
+
+bool DeltaPatch::finish() {
+  if (currentState == DELTA_FAILED) return false;
+  if (currentState != DELTA_COMPLETE) return fail("Patch incomplete");
+  uint8_t digest[SHA256_SIZE];
+  targetHash.finish(digest);
+  targetHash.reset();
+  if (memcmp(digest, patchHeader.targetHash, SHA256_SIZE) != 0) {
+    return fail("Patched image does not match its expected hash");
+  }
+  return true;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Sha256.h"
+
+// Firmware update as a patch against the running image.
+//
+// A patch is a header and a list of operations that rebuild the new image
+// front to back: COPY a run of bytes from the old image (the running
+// partition) or INSERT bytes carried in the patch. DeltaPatch applies one as
+// it arrives, in pieces of any size, writing the new image straight to the
+// sink (the inactive OTA slot); RAM is a fixed copy buffer and the header,
+// never an image. The result is hashed on the way out and only accepted
+// when it matches the hash in the header, and a patch is only started on
+// the source image it was made from.
+//
+// Layout (little-endian):
+//   0   4   magic "VDP1"
+//   4   4   source image size
+//   8   4   target image size
+//   12  32  SHA-256 of the source image
+//   44  32  SHA-256 of the target image
+//   76  ... operations until the target is complete
+//
+// An operation starts with a varint v: length = v >> 1, and bit 0 set is an
+// INSERT followed by its `length` bytes. Bit 0 clear is a COPY followed by a
+// zigzag varint: the distance from the end of the previous COPY (the start of
+// the source for the first) to where this one reads, so runs that continue
+// in place cost a byte. Patches are made on the host with
+// examples/patch_tool.
+
+#define DELTA_MAGIC "VDP1"
+#define DELTA_HEADER_SIZE 76
+#define DELTA_COPY_BUFFER 256        // Bytes read from the source at a time
+
+// The running image, read at any offset
+class PatchSource {
+public:
+  virtual ~PatchSource() {}
+  virtual uint32_t size() = 0;    // Bytes readable (the partition)
+  virtual bool read(uint32_t offset, uint8_t* out, size_t length) = 0;
+};
+
+// Where the new image goes, front to back
+class PatchSink {
+public:
+  virtual ~PatchSink() {}
+  virtual bool write(const uint8_t* data, size_t length) = 0;
+};
+
+struct DeltaHeader {
+  uint32_t sourceSize;
+  uint32_t targetSize;
+  uint8_t sourceHash[SHA256_SIZE];
+  uint8_t targetHash[SHA256_SIZE];
+};
+
+enum DeltaState : uint8_t {
+  DELTA_HEADER = 0,   // Reading the header
+  DELTA_READY,        // Header read: check the source, prepare the sink, then start()
+  DELTA_APPLYING,     // Rebuilding the target
+  DELTA_COMPLETE,     // Target complete; finish() checks its hash
+  DELTA_FAILED,       // See error()
+};
+
+class DeltaPatch {
+public:
+  DeltaPatch(PatchSource &source, PatchSink &sink) : source(source), sink(sink) { begin(); }
+
+  // Expect a new patch
+  void begin();
+
+  // Take patch bytes; returns how many were used. Stops early once the
+  // header is complete (DELTA_READY) or on a failure, so call again with the
+  // rest after start()
+  size_t feed(const uint8_t* data, size_t length);
+
+  DeltaState state() const { return currentState; }
+  const char* error() const { return failure; }
+  const DeltaHeader &header() const { return patchHeader; }
+
+  // In DELTA_READY: hash the source and compare it with the header (reads
+  // the whole source image once)
+  bool verifySource();
+  // In DELTA_READY: apply the operations that follow
+  void start();
+
+  // After the last byte: true when the target is complete and its hash
+  // matches the header
+  bool finish();
+
+  uint32_t written() const { return targetWritten; }
+
+private:
+  bool fail(const char* message);
+  bool emit(const uint8_t* data, size_t length);
+  bool copy(uint32_t offset, uint32_t length);
+  bool decode(uint8_t byte);
+
+  PatchSource &source;
+  PatchSink &sink;
+  DeltaHeader patchHeader;
+  DeltaState currentState = DELTA_HEADER;
+  const char* failure = nullptr;
+
+  uint8_t headerBytes[DELTA_HEADER_SIZE];
+  uint8_t headerFill = 0;
+
+  // Operation decoding
+  enum Stage : uint8_t { STAGE_OP, STAGE_OFFSET, STAGE_INSERT };
+  Stage stage = STAGE_OP;
+  uint32_t varint = 0;
+  uint8_t varintShift = 0;
+  uint32_t opLength = 0;         // Bytes of the current operation still to do
+  uint32_t sourceCursor = 0;     // End of the previous COPY
+
+  uint32_t targetWritten = 0;
+  Sha256 targetHash;
+  uint8_t copyBuffer[DELTA_COPY_BUFFER];
+};
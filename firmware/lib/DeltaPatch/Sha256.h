@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(ESP_PLATFORM)
+#include <mbedtls/sha256.h>
+#endif
+
+// SHA-256 (FIPS 180-4), incremental, for checking firmware images on the
+// device and building patches on the host with the same interface. On the
+// ESP32 it is mbedtls, which uses the SHA accelerator; the portable
+// implementation is for host builds.
+
+#define SHA256_SIZE 32
+
+class Sha256 {
+public:
+  Sha256();
+  ~Sha256();
+  Sha256(const Sha256 &) = delete;
+  Sha256 &operator=(const Sha256 &) = delete;
+
+  void reset();
+  void update(const uint8_t* data, size_t length);
+  // Digest of everything since reset(); the state must be reset() before reuse
+  void finish(uint8_t digest[SHA256_SIZE]);
+
+private:
+#if defined(ESP_PLATFORM)
+  mbedtls_sha256_context context;
+#else
+  void compress(const uint8_t block[64]);
+
+  uint32_t state[8];
+  uint64_t total = 0;        // Bytes hashed
+  uint8_t buffer[64];
+  uint8_t buffered = 0;
+#endif
+};
@@ -0,0 +1,430 @@
+// Host tool for DeltaPatch: makes a firmware patch from the image the device
+// runs and the new one, and checks it by applying it the way the device does.
+//
+// Build and run on the development machine (no Arduino dependencies):
+//   cd firmware/lib/DeltaPatch
+//   g++ -O2 -I . DeltaPatch.cpp Sha256.cpp examples/patch_tool/patch_tool.cpp -o patch_tool
+//   ./patch_tool old.bin new.bin --out update.patch
+//
+// old.bin is the firmware.bin the device is running (the patch is refused by
+// any other), new.bin the one to install. Without files the tool runs its
+// checks: SHA-256 test vectors, then synthetic images (identical, a version
+// bump, a release with inserted, deleted and relocated code, unrelated
+// data) patched and applied in pieces of random size, and patches that must
+// be refused (wrong source, corrupted, truncated, trailing data). Exits 1 on
+// failure.
+
+#include <DeltaPatch.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define MIN_MATCH 8          // Shortest COPY found through the index
+#define MIN_NEAR_MATCH 4     // Shortest COPY that continues near the previous one
+#define GOOD_NEAR_MATCH 64   // Near matches this long skip the index search
+#define MAX_CHAIN 64         // Index candidates tried per position
+#define HASH_BITS 20
+
+typedef std::vector<uint8_t> Bytes;
+
+// ---- Patch generation ----
+
+static void putVarint(Bytes &out, uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back((uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back((uint8_t)value);
+}
+
+static size_t varintSize(uint32_t value) {
+  size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+static uint32_t zigzag(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static void putLE32(Bytes &out, uint32_t value) {
+  for (int i = 0; i < 4; i++) out.push_back((uint8_t)(value >> (8 * i)));
+}
+
+static void sha256(const Bytes &data, uint8_t digest[SHA256_SIZE]) {
+  Sha256 hash;
+  hash.update(data.data(), data.size());
+  hash.finish(digest);
+}
+
+class Matcher {
+public:
+  explicit Matcher(const Bytes &source) : source(source), head(1u << HASH_BITS, -1), previous(source.size(), -1) {
+    for (size_t p = 0; p + MIN_MATCH <= source.size(); p++) {
+      uint32_t h = hash(&source[p]);
+      previous[p] = head[h];
+      head[h] = (int32_t)p;
+    }
+  }
+
+  static uint32_t hash(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return (uint32_t)((v * 0x9E3779B97F4A7C15ull) >> (64 - HASH_BITS));
+  }
+
+  size_t length(size_t from, const Bytes &target, size_t at) const {
+    size_t n = 0;
+    while (from + n < source.size() && at + n < target.size() && source[from + n] == target[at + n]) n++;
+    return n;
+  }
+
+  const Bytes &source;
+  std::vector<int32_t> head;
+  std::vector<int32_t> previous;
+};
+
+static void flushInsert(Bytes &patch, const Bytes &target, size_t from, size_t to) {
+  if (to == from) return;
+  putVarint(patch, (uint32_t)(to - from) << 1 | 1);
+  patch.insert(patch.end(), target.begin() + from, target.begin() + to);
+}
+
+// Greedy: at each position the COPY that saves the most bytes, trying the
+// places next to the previous COPY first (edits in place and insertions
+// leave the rest of the image where it was, or shifted by a little)
+static Bytes makePatch(const Bytes &source, const Bytes &target) {
+  Bytes patch(DELTA_MAGIC, DELTA_MAGIC + 4);
+  putLE32(patch, (uint32_t)source.size());
+  putLE32(patch, (uint32_t)target.size());
+  uint8_t digest[SHA256_SIZE];
+  sha256(source, digest);
+  patch.insert(patch.end(), digest, digest + SHA256_SIZE);
+  sha256(target, digest);
+  patch.insert(patch.end(), digest, digest + SHA256_SIZE);
+
+  Matcher matcher(source);
+  size_t at = 0, literalStart = 0;
+  uint32_t cursor = 0;
+  while (at < target.size()) {
+    size_t bestLength = 0;
+    uint32_t bestFrom = 0;
+    long bestScore = 0;
+    auto consider = [&](uint32_t from, size_t minimum) {
+      size_t length = matcher.length(from, target, at);
+      if (length < minimum) return;
+      long score = (long)length - (long)varintSize(zigzag((int32_t)(from - cursor)));
+      if (score > bestScore) {
+        bestScore = score;
+        bestLength = length;
+        bestFrom = from;
+      }
+    };
+    uint32_t pending = (uint32_t)(at - literalStart);
+    if (cursor + pending < source.size()) consider(cursor + pending, MIN_NEAR_MATCH);
+    if (pending && cursor < source.size()) consider(cursor, MIN_NEAR_MATCH);
+    if (bestLength < GOOD_NEAR_MATCH && at + MIN_MATCH <= target.size()) {
+      int chain = 0;
+      for (int32_t p = matcher.head[Matcher::hash(&target[at])]; p >= 0 && chain < MAX_CHAIN;
+           p = matcher.previous[p], chain++) {
+        consider((uint32_t)p, MIN_MATCH);
+      }
+    }
+
+    if (bestLength == 0) {
+      at++;
+      continue;
+    }
+    flushInsert(patch, target, literalStart, at);
+    putVarint(patch, (uint32_t)bestLength << 1);
+    putVarint(patch, zigzag((int32_t)(bestFrom - cursor)));
+    cursor = bestFrom + (uint32_t)bestLength;
+    at += bestLength;
+    literalStart = at;
+  }
+  flushInsert(patch, target, literalStart, at);
+  return patch;
+}
+
+// ---- Applying, as on the device ----
+
+class MemorySource : public PatchSource {
+public:
+  explicit MemorySource(const Bytes &image) : image(image) {}
+  uint32_t size() override { return (uint32_t)image.size() + 4096; }   // The partition is larger
+  bool read(uint32_t offset, uint8_t* out, size_t length) override {
+    for (size_t i = 0; i < length; i++) out[i] = offset + i < image.size() ? image[offset + i] : 0xFF;
+    return true;
+  }
+  const Bytes &image;
+};
+
+class MemorySink : public PatchSink {
+public:
+  bool write(const uint8_t* data, size_t length) override {
+    image.insert(image.end(), data, data + length);
+    return true;
+  }
+  Bytes image;
+};
+
+struct Applied {
+  bool ok;
+  const char* error;
+  Bytes image;
+};
+
+// Feed the patch in pieces of 1..maxPiece bytes (0 = all at once)
+static Applied apply(const Bytes &source, const Bytes &patch, size_t maxPiece) {
+  MemorySource memory(source);
+  MemorySink sink;
+  DeltaPatch delta(memory, sink);
+  size_t offset = 0;
+  while (offset < patch.size() && delta.state() != DELTA_FAILED) {
+    size_t piece = maxPiece ? 1 + rand() % maxPiece : patch.size();
+    if (piece > patch.size() - offset) piece = patch.size() - offset;
+    size_t used = 0;
+    while (used < piece && delta.state() != DELTA_FAILED) {
+      used += delta.feed(patch.data() + offset + used, piece - used);
+      if (delta.state() == DELTA_READY && delta.verifySource()) delta.start();
+    }
+    offset += piece;
+  }
+  bool ok = delta.finish();
+  return {ok, delta.error(), sink.image};
+}
+
+// ---- Checks ----
+
+static std::string hex(const uint8_t* data, size_t length) {
+  std::string text;
+  char digits[3];
+  for (size_t i = 0; i < length; i++) {
+    snprintf(digits, sizeof(digits), "%02x", data[i]);
+    text += digits;
+  }
+  return text;
+}
+
+static int checkSha256() {
+  struct Vector {
+    std::string input;
+    const char* digest;
+  } vectors[] = {
+    {"", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+    {"abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+    {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+     "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+    {std::string(1000000, 'a'), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
+  };
+  int failures = 0;
+  for (const Vector &v : vectors) {
+    // In uneven pieces, across block boundaries
+    Sha256 hash;
+    for (size_t offset = 0; offset < v.input.size();) {
+      size_t piece = std::min<size_t>(1 + rand() % 150, v.input.size() - offset);
+      hash.update((const uint8_t*)v.input.data() + offset, piece);
+      offset += piece;
+    }
+    uint8_t digest[SHA256_SIZE];
+    hash.finish(digest);
+    if (hex(digest, SHA256_SIZE) != v.digest) failures++;
+  }
+  printf("SHA-256 test vectors:                %s\n", failures ? "FAILED" : "ok");
+  return failures;
+}
+
+// Something like an application image: code, pointer tables, strings, padding
+static Bytes makeImage(size_t size) {
+  static const char* const strings[] = {"BLE OTA", "Firmware Version: 0.0.25", "Wind sensor read failed",
+                                        "Loaded level reference from NVS", "settings"};
+  Bytes image;
+  while (image.size() < size) {
+    switch (rand() % 8) {
+      case 0:   // Pointer table into flash
+        for (int i = 0; i < 16 + rand() % 64; i++) putLE32(image, 0x400D0000u + (uint32_t)(rand() % 0x80000) * 4);
+        break;
+      case 1: {
+        const char* s = strings[rand() % 5];
+        image.insert(image.end(), s, s + strlen(s) + 1);
+        break;
+      }
+      case 2:
+        image.insert(image.end(), rand() % 64, 0);
+        break;
+      default: {   // Code: a few hundred short instruction patterns
+        int n = 64 + rand() % 512;
+        for (int i = 0; i < n; i++) {
+          int op = rand() % 300;
+          image.push_back((uint8_t)(op * 37));
+          image.push_back((uint8_t)(op * 11 + 3));
+          if (op % 3) image.push_back((uint8_t)(rand() % 16));
+        }
+      }
+    }
+  }
+  image.resize(size);
+  return image;
+}
+
+static Bytes versionBump(Bytes image) {
+  const char* from = "0.0.25";
+  for (size_t i = 0; i + 6 <= image.size(); i++) {
+    if (memcmp(&image[i], from, 6) == 0) image[i + 5] = '6';
+  }
+  return image;
+}
+
+// New code in the middle, some removed further on, everything after the
+// insertion relocated in the pointer tables, scattered small edits
+static Bytes release(const Bytes &image) {
+  Bytes out = versionBump(image);
+  size_t insertAt = out.size() * 2 / 5, removeAt = out.size() * 7 / 10;
+  const uint32_t shift = 2048;
+  for (size_t i = 0; i + 4 <= out.size(); i += 4) {
+    uint32_t v = out[i] | out[i + 1] << 8 | out[i + 2] << 16 | (uint32_t)out[i + 3] << 24;
+    if (v >= 0x400D0000u + insertAt && v < 0x40200000u) {
+      v += shift;
+      for (int b = 0; b < 4; b++) out[i + b] = (uint8_t)(v >> (8 * b));
+    }
+  }
+  for (int i = 0; i < 300; i++) {
+    size_t at = rand() % (out.size() - 3);
+    for (int b = 0; b < 3; b++) out[at + b] ^= (uint8_t)(1 + rand() % 255);
+  }
+  out.erase(out.begin() + removeAt, out.begin() + removeAt + 700);
+  Bytes code = makeImage(shift);
+  out.insert(out.begin() + insertAt, code.begin(), code.end());
+  return out;
+}
+
+static Bytes randomBytes(size_t size) {
+  Bytes out(size);
+  for (uint8_t &b : out) b = (uint8_t)rand();
+  return out;
+}
+
+static int checkCase(const char* name, const Bytes &source, const Bytes &target) {
+  auto start = std::chrono::steady_clock::now();
+  Bytes patch = makePatch(source, target);
+  double makeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  int failures = 0;
+  start = std::chrono::steady_clock::now();
+  Applied whole = apply(source, patch, 0);
+  double applyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  if (!whole.ok || whole.image != target) failures++;
+  for (size_t maxPiece : {1, 7, 180, 4096}) {
+    Applied pieces = apply(source, patch, maxPiece);
+    if (!pieces.ok || pieces.image != target) failures++;
+  }
+  printf("%-13s %8zu -> %8zu bytes: patch %7zu (%5.1f%%), made in %4.0f ms, applied in %3.0f ms %s\n", name,
+         source.size(), target.size(), patch.size(), 100.0 * patch.size() / target.size(), makeMs, applyMs,
+         failures ? "FAILED" : "ok");
+  if (failures && !whole.ok) printf("  %s\n", whole.error);
+  return failures;
+}
+
+static int expectRefused(const char* name, const Bytes &source, const Bytes &patch, size_t maxPiece = 0) {
+  Applied result = apply(source, patch, maxPiece);
+  printf("refused, %-26s %s (%s)\n", name, result.ok ? "FAILED" : "ok", result.error ? result.error : "-");
+  return result.ok ? 1 : 0;
+}
+
+static int runChecks() {
+  srand(5);
+  int failures = checkSha256();
+
+  Bytes image = makeImage(1300000);
+  Bytes next = release(image);
+  failures += checkCase("identical", image, image);
+  failures += checkCase("version bump", image, versionBump(image));
+  failures += checkCase("release", image, next);
+  failures += checkCase("unrelated", image, randomBytes(200000));
+  failures += checkCase("from nothing", Bytes(), randomBytes(5000));
+
+  Bytes patch = makePatch(image, next);
+  Bytes otherSource = image;
+  otherSource[123456] ^= 1;
+  failures += expectRefused("other source image:", otherSource, patch);
+  Bytes corrupted = patch;
+  corrupted[corrupted.size() / 2] ^= 0x40;
+  failures += expectRefused("corrupted patch:", image, corrupted, 333);
+  Bytes inserted = makePatch(image, randomBytes(20000));   // One INSERT: the hash has to catch it
+  inserted[inserted.size() / 2] ^= 0x40;
+  failures += expectRefused("corrupted image data:", image, inserted, 333);
+  failures += expectRefused("truncated patch:", image, Bytes(patch.begin(), patch.end() - 10), 333);
+  Bytes trailing = patch;
+  trailing.push_back(0);
+  failures += expectRefused("trailing data:", image, trailing);
+  Bytes wrongMagic = patch;
+  wrongMagic[0] = 'X';
+  failures += expectRefused("not a patch:", image, wrongMagic);
+
+  printf("applier state: %zu bytes\n", sizeof(DeltaPatch));
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
+
+// ---- Files ----
+
+static bool readFile(const char* path, Bytes &out) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  uint8_t buffer[65536];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) out.insert(out.end(), buffer, buffer + n);
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  const char* files[2] = {nullptr, nullptr};
+  const char* outPath = nullptr;
+  int fileCount = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+      outPath = argv[++i];
+    } else if (fileCount < 2) {
+      files[fileCount++] = argv[i];
+    }
+  }
+  if (fileCount == 0) return runChecks();
+  if (fileCount != 2) {
+    fprintf(stderr, "usage: patch_tool old.bin new.bin [--out update.patch]\n");
+    return 1;
+  }
+
+  Bytes source, target;
+  if (!readFile(files[0], source) || !readFile(files[1], target)) {
+    fprintf(stderr, "cannot read %s or %s\n", files[0], files[1]);
+    return 1;
+  }
+  Bytes patch = makePatch(source, target);
+  Applied check = apply(source, patch, 509);
+  if (!check.ok || check.image != target) {
+    fprintf(stderr, "patch does not reproduce %s: %s\n", files[1], check.error ? check.error : "image differs");
+    return 1;
+  }
+  uint8_t digest[SHA256_SIZE];
+  sha256(target, digest);
+  printf("%zu -> %zu bytes, patch %zu bytes (%.1f%%), target SHA-256 %s\n", source.size(), target.size(),
+         patch.size(), 100.0 * patch.size() / target.size(), hex(digest, SHA256_SIZE).c_str());
+  if (outPath) {
+    FILE* f = fopen(outPath, "wb");
+    if (!f || fwrite(patch.data(), 1, patch.size(), f) != patch.size()) {
+      fprintf(stderr, "cannot write %s\n", outPath);
+      return 1;
+    }
+    fclose(f);
+  }
+  return 0;
+}
@@ -0,0 +1,105 @@
+#include "Geodesy.h"
+
+#include <math.h>
+
+static const float DEGREES_TO_RADIANS = (float)M_PI / 180.0f;
+
+// Longitude difference in 1e-7 degrees, the short way round the antimeridian
+static int32_t lonDifference(int32_t to, int32_t from) {
+  int64_t difference = (int64_t)to - from;
+  if (difference > 180 * (int64_t)GEO_E7) difference -= 360 * (int64_t)GEO_E7;
+  if (difference < -180 * (int64_t)GEO_E7) difference += 360 * (int64_t)GEO_E7;
+  return (int32_t)difference;
+}
+
+GeoPoint geoFromDegrees(double lat, double lon) {
+  GeoPoint p;
+  p.lat = (int32_t)lround(lat * GEO_E7);
+  p.lon = (int32_t)lround(lon * GEO_E7);
+  return p;
+}
+
+void LocalPlane::anchor(const GeoPoint &origin) {
+  originPoint = origin;
+  anchored = true;
+
+  // WGS84 metres per degree and the east scale's derivative, at the anchor
+  float phi = origin.lat / (float)GEO_E7 * DEGREES_TO_RADIANS;
+  float perDegreeLat = 111132.92f - 559.82f * cosf(2 * phi) + 1.175f * cosf(4 * phi);
+  float perDegreeLon = 111412.84f * cosf(phi) - 93.5f * cosf(3 * phi);
+  float perDegreeLonSlope = (-111412.84f * sinf(phi) + 280.5f * sinf(3 * phi)) * DEGREES_TO_RADIANS;
+  northScale = perDegreeLat / GEO_E7;
+  eastScale = perDegreeLon / GEO_E7;
+  eastScaleSlope = perDegreeLonSlope / GEO_E7 / GEO_E7;
+
+  // Prime vertical radius of curvature
+  float sinPhi = sinf(phi);
+  float primeVertical = 6378137.0f / sqrtf(1.0f - 0.00669438f * sinPhi * sinPhi);
+  convergence = tanf(phi) / (2.0f * primeVertical);
+}
+
+bool LocalPlane::follow(const GeoPoint &p) {
+  if (anchored) {
+    float east, north;
+    project(p, east, north);
+    if (east * east + north * north <= GEO_PLANE_RADIUS * GEO_PLANE_RADIUS) return false;
+  }
+  anchor(p);
+  return true;
+}
+
+void LocalPlane::offset(const GeoPoint &from, const GeoPoint &to, float &east, float &north) const {
+  int32_t dLat = to.lat - from.lat;
+  int32_t dLon = lonDifference(to.lon, from.lon);
+  float midLat = (float)(from.lat - originPoint.lat) + dLat * 0.5f;
+  east = dLon * (eastScale + eastScaleSlope * midLat);
+  north = dLat * northScale;
+}
+
+void LocalPlane::project(const GeoPoint &p, float &east, float &north) const {
+  int32_t dLat = p.lat - originPoint.lat;
+  int32_t dLon = lonDifference(p.lon, originPoint.lon);
+  east = dLon * (eastScale + eastScaleSlope * dLat);
+  north = dLat * northScale + east * east * convergence;
+}
+
+float LocalPlane::distance(const GeoPoint &a, const GeoPoint &b) const {
+  float east, north;
+  offset(a, b, east, north);
+  return sqrtf(east * east + north * north);
+}
+
+float LocalPlane::bearing(const GeoPoint &a, const GeoPoint &b) const {
+  float east, north;
+  offset(a, b, east, north);
+  float degrees = atan2f(east, north) / DEGREES_TO_RADIANS;
+  return degrees < 0 ? degrees + 360.0f : degrees;
+}
+
+float LocalPlane::crossTrack(const GeoPoint &a, const GeoPoint &b, const GeoPoint &p) const {
+  float aEast, aNorth, trackEast, trackNorth, east, north;
+  project(a, aEast, aNorth);
+  project(b, trackEast, trackNorth);
+  project(p, east, north);
+  trackEast -= aEast;
+  trackNorth -= aNorth;
+  east -= aEast;
+  north -= aNorth;
+  float length = sqrtf(trackEast * trackEast + trackNorth * trackNorth);
+  if (length <= 0) return sqrtf(east * east + north * north);
+  return (east * trackNorth - north * trackEast) / length;
+}
+
+float LocalPlane::alongTrack(const GeoPoint &a, const GeoPoint &b, const GeoPoint &p) const {
+  float aEast, aNorth, trackEast, trackNorth, east, north;
+  project(a, aEast, aNorth);
+  project(b, trackEast, trackNorth);
+  project(p, east, north);
+  trackEast -= aEast;
+  trackNorth -= aNorth;
+  east -= aEast;
+  north -= aNorth;
+  float length = sqrtf(trackEast * trackEast + trackNorth * trackNorth);
+  if (length <= 0) return 0;
+  return (east * trackEast + north * trackNorth) / length;
+}
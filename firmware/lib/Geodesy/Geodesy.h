@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+
+// Positions in integer 1e-7 degrees, geometry in single-precision float.
+//
+// The ESP32 FPU only handles float; every double operation (and double
+// sin/cos/atan2 in particular) is emulated in software. A GeoPoint keeps
+// latitude and longitude as int32 in 1e-7 degrees (about 1 cm, the
+// resolution of NMEA positions), so the difference between two nearby
+// points is an exact integer and fits a float's mantissa without loss.
+//
+// LocalPlane turns those differences into metres east and north with WGS84
+// scale factors taken at an anchor point: one multiplication per axis, plus
+// a first-order correction of the east scale for latitude so points north
+// or south of the anchor do not pick up tan(lat) errors.
+//  - distance() and bearing() scale a pair's difference at its mid latitude.
+//    Within GEO_PLANE_RADIUS of the anchor they agree with the ellipsoidal
+//    geodesic to about 1e-5 (a centimetre per kilometre). The anchor only
+//    supplies the scales, so follow() can move it with the boat.
+//  - project() places points on the tangent plane at the anchor, including
+//    the meridian convergence term (east^2 * tan(lat) / 2N), so straight
+//    lines through several points (crossTrack(), the start line) stay
+//    straight to a few centimetres within GEO_PLANE_RADIUS.
+
+#define GEO_E7 10000000L                 // GeoPoint units per degree
+#define GEO_PLANE_RADIUS 2000.0f         // Metres from the anchor before follow() moves it
+
+struct GeoPoint {
+  int32_t lat;   // 1e-7 degrees, + = north
+  int32_t lon;   // 1e-7 degrees, + = east
+};
+
+// Degrees to 1e-7 degrees; for positions from commands and settings, not per fix
+GeoPoint geoFromDegrees(double lat, double lon);
+
+class LocalPlane {
+public:
+  // Place the plane's origin at `origin`
+  void anchor(const GeoPoint &origin);
+  bool isAnchored() const { return anchored; }
+  const GeoPoint &origin() const { return originPoint; }
+
+  // Anchor at `p` if not anchored yet or `p` is more than GEO_PLANE_RADIUS
+  // from the anchor; true when the anchor moved (projected points are stale)
+  bool follow(const GeoPoint &p);
+
+  // Metres east and north of the anchor on its tangent plane
+  void project(const GeoPoint &p, float &east, float &north) const;
+
+  // Metres east and north from `from` to `to`, scaled at their mid latitude
+  void offset(const GeoPoint &from, const GeoPoint &to, float &east, float &north) const;
+
+  float distance(const GeoPoint &a, const GeoPoint &b) const;   // Metres
+  float bearing(const GeoPoint &a, const GeoPoint &b) const;    // Degrees true 0-360, a to b
+
+  // Signed distance of `p` from the line through a and b (+ = right of a->b)
+  // and its position along it (metres from a towards b), on the tangent
+  // plane; all three points should be within GEO_PLANE_RADIUS of the anchor
+  float crossTrack(const GeoPoint &a, const GeoPoint &b, const GeoPoint &p) const;
+  float alongTrack(const GeoPoint &a, const GeoPoint &b, const GeoPoint &p) const;
+
+private:
+  bool anchored = false;
+  GeoPoint originPoint = {0, 0};
+  float northScale = 0;       // Metres per 1e-7 degree of latitude
+  float eastScale = 0;        // Metres per 1e-7 degree of longitude at the anchor
+  float eastScaleSlope = 0;   // Change of eastScale per 1e-7 degree of latitude
+  float convergence = 0;      // tan(lat) / 2N: northward drift of the parallel per square metre east
+};
@@ -0,0 +1,229 @@
+// Host check for Geodesy: compares LocalPlane distances and bearings with
+// the WGS84 geodesic (Vincenty's inverse formula in double) and cross-track
+// with an exact tangent plane (ECEF to east/north/up in double), and times
+// them against the double-precision haversine the firmware used before.
+//
+// Build and run on the development machine (no Arduino dependencies):
+//   cd firmware/lib/Geodesy
+//   g++ -O2 -I . Geodesy.cpp examples/geodesy_check/geodesy_check.cpp -o geodesy_check
+//   ./geodesy_check
+//
+// Point pairs are drawn within GEO_PLANE_RADIUS of a plane anchor between
+// 70S and 70N, including pairs across the antimeridian. Exits 1 when an
+// error exceeds its tolerance.
+//
+// The timings are host nanoseconds, where double is as fast as float. On
+// the ESP32 double maths is emulated in software and the gap is far larger;
+// the on-device profiler (PROF_FUSION) shows it in cycles.
+
+#include <Geodesy.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define DISTANCE_TOLERANCE 2e-5     // Relative, plus 1 cm for the 1e-7 degree positions
+#define BEARING_TOLERANCE 0.002     // Degrees, plus 1 cm of position across the pair
+#define CROSS_TRACK_TOLERANCE 0.05  // Metres
+
+static const double WGS84_A = 6378137.0;
+static const double WGS84_F = 1 / 298.257223563;
+static const double RADIANS = M_PI / 180.0;
+
+// Vincenty's inverse formula on WGS84: distance (m) and the bearing (degrees)
+// halfway along, the mean of the initial and final azimuths
+static void geodesic(double lat1, double lon1, double lat2, double lon2, double &distance, double &bearing) {
+  double b = WGS84_A * (1 - WGS84_F);
+  double L = (lon2 - lon1) * RADIANS;
+  if (L > M_PI) L -= 2 * M_PI;
+  if (L < -M_PI) L += 2 * M_PI;
+  double U1 = atan((1 - WGS84_F) * tan(lat1 * RADIANS));
+  double U2 = atan((1 - WGS84_F) * tan(lat2 * RADIANS));
+  double sinU1 = sin(U1), cosU1 = cos(U1), sinU2 = sin(U2), cosU2 = cos(U2);
+  double lambda = L, sinSigma = 0, cosSigma = 1, sigma = 0, cos2Alpha = 1, cos2SigmaM = 0;
+  for (int i = 0; i < 100; i++) {
+    double sinLambda = sin(lambda), cosLambda = cos(lambda);
+    sinSigma = sqrt(pow(cosU2 * sinLambda, 2) + pow(cosU1 * sinU2 - sinU1 * cosU2 * cosLambda, 2));
+    if (sinSigma == 0) {
+      distance = 0;
+      bearing = 0;
+      return;
+    }
+    cosSigma = sinU1 * sinU2 + cosU1 * cosU2 * cosLambda;
+    sigma = atan2(sinSigma, cosSigma);
+    double sinAlpha = cosU1 * cosU2 * sinLambda / sinSigma;
+    cos2Alpha = 1 - sinAlpha * sinAlpha;
+    cos2SigmaM = cos2Alpha != 0 ? cosSigma - 2 * sinU1 * sinU2 / cos2Alpha : 0;
+    double C = WGS84_F / 16 * cos2Alpha * (4 + WGS84_F * (4 - 3 * cos2Alpha));
+    double previous = lambda;
+    lambda = L + (1 - C) * WGS84_F * sinAlpha *
+             (sigma + C * sinSigma * (cos2SigmaM + C * cosSigma * (-1 + 2 * cos2SigmaM * cos2SigmaM)));
+    if (fabs(lambda - previous) < 1e-13) break;
+  }
+  double u2 = cos2Alpha * (WGS84_A * WGS84_A - b * b) / (b * b);
+  double A = 1 + u2 / 16384 * (4096 + u2 * (-768 + u2 * (320 - 175 * u2)));
+  double B = u2 / 1024 * (256 + u2 * (-128 + u2 * (74 - 47 * u2)));
+  double deltaSigma = B * sinSigma * (cos2SigmaM + B / 4 * (cosSigma * (-1 + 2 * cos2SigmaM * cos2SigmaM) -
+                      B / 6 * cos2SigmaM * (-3 + 4 * sinSigma * sinSigma) * (-3 + 4 * cos2SigmaM * cos2SigmaM)));
+  distance = b * A * (sigma - deltaSigma);
+  double sinLambda = sin(lambda), cosLambda = cos(lambda);
+  double initial = atan2(cosU2 * sinLambda, cosU1 * sinU2 - sinU1 * cosU2 * cosLambda);
+  double final = atan2(cosU1 * sinLambda, -sinU1 * cosU2 + cosU1 * sinU2 * cosLambda);
+  bearing = atan2(sin(initial) + sin(final), cos(initial) + cos(final)) / RADIANS;
+  if (bearing < 0) bearing += 360;
+}
+
+// East and north of `p` on the tangent plane at `origin` (degrees), through ECEF
+static void tangentPlane(double originLat, double originLon, double lat, double lon, double &east, double &north) {
+  double e2 = WGS84_F * (2 - WGS84_F);
+  double xyz[2][3];
+  double points[2][2] = {{originLat, originLon}, {lat, lon}};
+  for (int i = 0; i < 2; i++) {
+    double phi = points[i][0] * RADIANS, lambda = points[i][1] * RADIANS;
+    double n = WGS84_A / sqrt(1 - e2 * sin(phi) * sin(phi));
+    xyz[i][0] = n * cos(phi) * cos(lambda);
+    xyz[i][1] = n * cos(phi) * sin(lambda);
+    xyz[i][2] = n * (1 - e2) * sin(phi);
+  }
+  double dx = xyz[1][0] - xyz[0][0], dy = xyz[1][1] - xyz[0][1], dz = xyz[1][2] - xyz[0][2];
+  double phi = originLat * RADIANS, lambda = originLon * RADIANS;
+  east = -sin(lambda) * dx + cos(lambda) * dy;
+  north = -sin(phi) * cos(lambda) * dx - sin(phi) * sin(lambda) * dy + cos(phi) * dz;
+}
+
+// The firmware's previous track maths: haversine and great-circle bearing in double
+static float haversineDistance(double lat1, double lon1, double lat2, double lon2) {
+  double dLat = (lat2 - lat1) * RADIANS;
+  double dLon = (lon2 - lon1) * RADIANS;
+  double a = sin(dLat / 2) * sin(dLat / 2) + cos(lat1 * RADIANS) * cos(lat2 * RADIANS) * sin(dLon / 2) * sin(dLon / 2);
+  return (float)(6371000 * 2 * atan2(sqrt(a), sqrt(1 - a)));
+}
+
+static float greatCircleBearing(double lat1, double lon1, double lat2, double lon2) {
+  double dLon = (lon2 - lon1) * RADIANS;
+  double y = sin(dLon) * cos(lat2 * RADIANS);
+  double x = cos(lat1 * RADIANS) * sin(lat2 * RADIANS) - sin(lat1 * RADIANS) * cos(lat2 * RADIANS) * cos(dLon);
+  return (float)fmod(atan2(y, x) / RADIANS + 360.0, 360.0);
+}
+
+static double uniform(double low, double high) {
+  return low + (high - low) * rand() / RAND_MAX;
+}
+
+static double angleError(double a, double b) {
+  double error = fabs(fmod(a - b + 540.0, 360.0) - 180.0);
+  return error;
+}
+
+// A point about `metres` from `origin` in a random direction
+static GeoPoint near(const GeoPoint &origin, double metres) {
+  double direction = uniform(0, 2 * M_PI);
+  double range = metres * sqrt(uniform(0, 1));
+  double lat = origin.lat / 1e7 + range * cos(direction) / 111000.0;
+  double lon = origin.lon / 1e7 + range * sin(direction) / (111000.0 * cos(lat * RADIANS));
+  if (lon > 180) lon -= 360;
+  if (lon < -180) lon += 360;
+  return geoFromDegrees(lat, lon);
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  printf("%-34s %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok) failures++;
+}
+
+int main() {
+  srand(11);
+  const int samples = 200000;
+  double distanceMax = 0, distanceSum = 0, bearingMax = 0, crossMax = 0;
+  double legacyDistanceMax = 0, legacyBearingMax = 0;
+  bool distanceOk = true, bearingOk = true;
+
+  for (int i = 0; i < samples; i++) {
+    GeoPoint anchor = geoFromDegrees(uniform(-70, 70), i % 10 == 0 ? uniform(179.98, 180) : uniform(-180, 180));
+    LocalPlane plane;
+    plane.anchor(anchor);
+    GeoPoint a = near(anchor, GEO_PLANE_RADIUS * 0.7);
+    GeoPoint b = near(a, i % 2 ? 50.0 : GEO_PLANE_RADIUS * 0.6);
+    double lat1 = a.lat / 1e7, lon1 = a.lon / 1e7, lat2 = b.lat / 1e7, lon2 = b.lon / 1e7;
+
+    double reference, referenceBearing;
+    geodesic(lat1, lon1, lat2, lon2, reference, referenceBearing);
+    double error = fabs(plane.distance(a, b) - reference);
+    if (error > reference * DISTANCE_TOLERANCE + 0.01) distanceOk = false;
+    double relative = reference > 1 ? error / reference : 0;
+    distanceSum += relative;
+    if (relative > distanceMax) distanceMax = relative;
+    if (reference > 1) {
+      double legacy = fabs(haversineDistance(lat1, lon1, lat2, lon2) - reference) / reference;
+      if (legacy > legacyDistanceMax) legacyDistanceMax = legacy;
+    }
+    if (reference > 10) {
+      double bearingError = angleError(plane.bearing(a, b), referenceBearing);
+      if (bearingError > bearingMax) bearingMax = bearingError;
+      if (bearingError > BEARING_TOLERANCE + 0.01 / reference / RADIANS) bearingOk = false;
+      double legacy = angleError(greatCircleBearing(lat1, lon1, lat2, lon2), referenceBearing);
+      if (legacy > legacyBearingMax) legacyBearingMax = legacy;
+
+      // Cross-track of a third point, on the tangent plane at a
+      GeoPoint p = near(a, reference);
+      double bEast, bNorth, pEast, pNorth;
+      tangentPlane(lat1, lon1, lat2, lon2, bEast, bNorth);
+      tangentPlane(lat1, lon1, p.lat / 1e7, p.lon / 1e7, pEast, pNorth);
+      double referenceCross = (pEast * bNorth - pNorth * bEast) / sqrt(bEast * bEast + bNorth * bNorth);
+      double crossError = fabs(plane.crossTrack(a, b, p) - referenceCross);
+      if (crossError > crossMax) crossMax = crossError;
+    }
+  }
+
+  printf("distance error:    %.2e max, %.2e mean (relative)\n", distanceMax, distanceSum / samples);
+  printf("  haversine:       %.2e max (relative)\n", legacyDistanceMax);
+  printf("bearing error:     %.4f deg max\n", bearingMax);
+  printf("  great circle:    %.4f deg max\n", legacyBearingMax);
+  printf("cross-track error: %.3f m max\n", crossMax);
+  check(distanceOk, "distance within tolerance");
+  check(bearingOk, "bearing within tolerance");
+  check(crossMax <= CROSS_TRACK_TOLERANCE, "cross-track within tolerance");
+
+  // The anchor follows the boat once it leaves the plane
+  LocalPlane follower;
+  GeoPoint start = geoFromDegrees(52.0, 4.0);
+  bool anchoredFirst = follower.follow(start);
+  bool stays = !follower.follow(geoFromDegrees(52.01, 4.0));
+  bool moves = follower.follow(geoFromDegrees(52.03, 4.0));
+  check(anchoredFirst && stays && moves && follower.origin().lat == 520300000, "anchor follows the boat");
+
+  // Cost per distance + bearing, float plane against double haversine
+  const int iterations = 2000000;
+  std::vector<GeoPoint> points(1024);
+  std::vector<double> lats(1024), lons(1024);
+  LocalPlane plane;
+  plane.anchor(geoFromDegrees(45.0, 7.0));
+  for (size_t i = 0; i < points.size(); i++) {
+    points[i] = near(plane.origin(), 1000);
+    lats[i] = points[i].lat / 1e7;
+    lons[i] = points[i].lon / 1e7;
+  }
+  float sink = 0;
+  auto start1 = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    size_t j = i & 1023, k = (i + 1) & 1023;
+    sink += plane.distance(points[j], points[k]) + plane.bearing(points[j], points[k]);
+  }
+  auto end1 = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    size_t j = i & 1023, k = (i + 1) & 1023;
+    sink += haversineDistance(lats[j], lons[j], lats[k], lons[k]) + greatCircleBearing(lats[j], lons[j], lats[k], lons[k]);
+  }
+  auto end2 = std::chrono::steady_clock::now();
+  double planeNs = std::chrono::duration<double, std::nano>(end1 - start1).count() / iterations;
+  double haversineNs = std::chrono::duration<double, std::nano>(end2 - end1).count() / iterations;
+  printf("plane:             %.1f ns per distance + bearing\n", planeNs);
+  printf("haversine:         %.1f ns per distance + bearing (%.1fx, checksum %.0f)\n", haversineNs,
+         haversineNs / planeNs, sink);
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,129 @@
+#include "HampelFilter.h"
+
+#include <math.h>
+#include <string.h>
+
+void MedianWindow::setWindow(uint8_t window) {
+  if (window < 1) window = 1;
+  if (window > HAMPEL_MAX_WINDOW) window = HAMPEL_MAX_WINDOW;
+  size = window;
+  clear();
+}
+
+void MedianWindow::clear() {
+  filled = 0;
+  next = 0;
+}
+
+// First sorted index whose sample is not below `value`
+uint8_t MedianWindow::lowerBound(float value) const {
+  uint8_t low = 0, high = filled;
+  while (low < high) {
+    uint8_t middle = (low + high) / 2;
+    if (sorted[middle] < value) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+void MedianWindow::add(float value) {
+  if (filled == size) {
+    // Full: the oldest sample is in the next slot; take it out of the sorted copy
+    uint8_t at = lowerBound(samples[next]);
+    memmove(&sorted[at], &sorted[at + 1], (filled - at - 1) * sizeof(float));
+    filled--;
+  }
+  uint8_t at = lowerBound(value);
+  memmove(&sorted[at + 1], &sorted[at], (filled - at) * sizeof(float));
+  sorted[at] = value;
+  filled++;
+  samples[next] = value;
+  next = (uint8_t)((next + 1) % size);
+}
+
+void MedianWindow::shift(float delta) {
+  for (uint8_t i = 0; i < filled; i++) {
+    samples[i] += delta;
+    sorted[i] += delta;
+  }
+}
+
+float MedianWindow::median() const {
+  if (!filled) return NAN;
+  if (filled % 2) return sorted[filled / 2];
+  return (sorted[filled / 2 - 1] + sorted[filled / 2]) / 2;
+}
+
+float MedianWindow::mad() const {
+  if (!filled) return NAN;
+  float center = median();
+  // Deviations grow outwards from the median on both sides: merge the two
+  // runs up to the middle rank
+  int left = (int)lowerBound(center) - 1;
+  int right = left + 1;
+  float previous = 0, current = 0;
+  for (uint8_t rank = 0; rank <= filled / 2; rank++) {
+    float below = left >= 0 ? center - sorted[left] : INFINITY;
+    float above = right < filled ? sorted[right] - center : INFINITY;
+    previous = current;
+    if (below <= above) {
+      current = below;
+      left--;
+    } else {
+      current = above;
+      right++;
+    }
+  }
+  return filled % 2 ? current : (previous + current) / 2;
+}
+
+void HampelFilter::setWindow(uint8_t window) {
+  enabled = window > 0;
+  samples.setWindow(enabled ? window : 1);
+  clear();
+}
+
+void HampelFilter::clear() {
+  samples.clear();
+  hasOutput = false;
+  rejectedLast = false;
+}
+
+float HampelFilter::filter(float value) {
+  rejectedLast = false;
+  if (isnan(value)) return value;
+  sampleCount++;
+  if (!enabled) return value;
+
+  // Angles: the turn closest to the last output
+  if (period > 0 && hasOutput) value += period * roundf((lastOutput - value) / period);
+
+  float output = value;
+  if (samples.count() >= HAMPEL_MIN_SAMPLES) {
+    float median = samples.median();
+    float scale = fmaxf(HAMPEL_MAD_SCALE * samples.mad(), minDeviation);
+    if (fabsf(value - median) > threshold * scale) {
+      output = median;
+      rejectedLast = true;
+      rejectedCount++;
+    }
+  }
+  samples.add(value);
+
+  if (period > 0) {
+    lastOutput = output;
+    hasOutput = true;
+    // Back to the first turns now and then, so the floats keep their precision
+    if (fabsf(lastOutput) >= 4 * period) {
+      float turns = period * truncf(lastOutput / period);
+      samples.shift(-turns);
+      lastOutput -= turns;
+    }
+    output = fmodf(output, period);
+    if (output < 0) output += period;
+  }
+  return output;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+
+// Streaming outlier rejection (Hampel identifier) for single sensor spikes:
+// rain and spray on the ultrasonic anemometer, multipath jumps in GPS speed.
+//
+// MedianWindow keeps the last `window` samples twice: in arrival order and
+// sorted. A new sample replaces the oldest with one binary search and one
+// short move in the sorted copy, so the median is a lookup and the median
+// absolute deviation (MAD) a merge of the two sorted halves around it. With
+// windows of at most HAMPEL_MAX_WINDOW samples every step is bounded by a
+// few dozen float moves, whatever the data.
+//
+// HampelFilter tests each sample against the window of the samples before
+// it: one further than `threshold` x 1.4826 x MAD from the median (the MAD
+// scaled to a standard deviation for Gaussian noise) is replaced by the
+// median and counted. `minDeviation` is a floor on that scale, so a
+// perfectly steady signal does not reject its first real change. The raw
+// sample still enters the window, so a genuine step passes once it makes
+// up half the window. Angle channels are unwrapped against the last output
+// so the window never straddles 0/360.
+
+#define HAMPEL_MAX_WINDOW 31
+#define HAMPEL_MIN_SAMPLES 3      // Samples in the window before anything is tested
+#define HAMPEL_MAD_SCALE 1.4826f  // MAD to standard deviation for Gaussian noise
+
+class MedianWindow {
+public:
+  explicit MedianWindow(uint8_t window = 7) { setWindow(window); }
+
+  // Window length in samples (1..HAMPEL_MAX_WINDOW); clears the window
+  void setWindow(uint8_t window);
+  uint8_t window() const { return size; }
+  void clear();
+
+  void add(float value);
+  // Add `delta` to every sample (order is unchanged)
+  void shift(float delta);
+
+  uint8_t count() const { return filled; }
+  float median() const;
+  float mad() const;   // Median of |sample - median()|
+
+private:
+  uint8_t lowerBound(float value) const;
+
+  float samples[HAMPEL_MAX_WINDOW];   // Arrival order, slot = sequence % size
+  float sorted[HAMPEL_MAX_WINDOW];
+  uint8_t size = 0;
+  uint8_t filled = 0;
+  uint8_t next = 0;                   // Slot of the next sample
+};
+
+class HampelFilter {
+public:
+  // window 0 passes every sample through; `period` 360 for angles in degrees
+  explicit HampelFilter(uint8_t window = 7, float threshold = 3.0f, float minDeviation = 0.0f, float period = 0.0f)
+    : threshold(threshold), minDeviation(minDeviation), period(period) { setWindow(window); }
+
+  void setWindow(uint8_t window);
+  uint8_t window() const { return enabled ? samples.window() : 0; }
+  void setThreshold(float value) { threshold = value; }
+  float getThreshold() const { return threshold; }
+  void clear();
+
+  // Sample in, filtered sample out (the window median for an outlier)
+  float filter(float value);
+
+  bool lastRejected() const { return rejectedLast; }
+  uint32_t rejected() const { return rejectedCount; }
+  uint32_t total() const { return sampleCount; }
+  void resetCounters() { rejectedCount = sampleCount = 0; }
+
+private:
+  MedianWindow samples;
+  bool enabled = true;
+  float threshold;
+  float minDeviation;
+  float period;             // 0 = linear channel
+  float lastOutput = 0;     // Unwrapped, for angle channels
+  bool hasOutput = false;
+  bool rejectedLast = false;
+  uint32_t rejectedCount = 0;
+  uint32_t sampleCount = 0;
+};
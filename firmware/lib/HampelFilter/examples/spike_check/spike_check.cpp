@@ -0,0 +1,163 @@
+// Host check for HampelFilter: the sliding median and MAD against a sort of
+// the same window after every sample, synthetic wind and GPS speed with
+// injected spikes (how many are caught, how many clean samples are lost),
+// a genuine step, and the cost per sample.
+//
+// Build and run on the development machine (no Arduino dependencies):
+//   cd firmware/lib
+//   g++ -O2 -I HampelFilter HampelFilter/HampelFilter.cpp
+//       HampelFilter/examples/spike_check/spike_check.cpp -o spike_check
+//   ./spike_check
+//
+// Channel settings are the firmware defaults (see SensorPipeline.h). Exits 1
+// on a mismatch or when a channel misses its targets.
+
+#include <HampelFilter.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define SPIKE_RATE 0.02f          // Fraction of samples replaced by a spike
+#define MIN_CAUGHT 0.95f          // Spikes that must be rejected
+#define MAX_FALSE 0.01f           // Clean samples that may be rejected
+
+static float uniform(float low, float high) {
+  return low + (high - low) * rand() / (float)RAND_MAX;
+}
+
+static float gaussian(float sigma) {
+  float u = uniform(1e-6f, 1.0f), v = uniform(0.0f, 1.0f);
+  return sigma * sqrtf(-2.0f * logf(u)) * cosf(2.0f * (float)M_PI * v);
+}
+
+static float angleDiff(float a, float b) {
+  float d = fmodf(a - b, 360.0f);
+  if (d >= 180.0f) d -= 360.0f;
+  if (d < -180.0f) d += 360.0f;
+  return d;
+}
+
+// Sliding median and MAD against a full sort, for every window length
+static int checkWindow() {
+  int failures = 0;
+  for (uint8_t window = 1; window <= HAMPEL_MAX_WINDOW; window++) {
+    MedianWindow sliding(window);
+    std::vector<float> history;
+    for (int i = 0; i < 2000; i++) {
+      // Coarse values so ties are common
+      float value = (float)(rand() % 40) * 0.5f;
+      if (i == 1000) {
+        sliding.shift(360.0f);
+        for (float &h : history) h += 360.0f;
+      }
+      sliding.add(value);
+      history.push_back(value);
+
+      std::vector<float> kept(history.end() - std::min<size_t>(history.size(), window), history.end());
+      std::sort(kept.begin(), kept.end());
+      size_t n = kept.size();
+      float median = n % 2 ? kept[n / 2] : (kept[n / 2 - 1] + kept[n / 2]) / 2;
+      std::vector<float> deviations;
+      for (float v : kept) deviations.push_back(fabsf(v - median));
+      std::sort(deviations.begin(), deviations.end());
+      float mad = n % 2 ? deviations[n / 2] : (deviations[n / 2 - 1] + deviations[n / 2]) / 2;
+      if ((sliding.median() != median || sliding.mad() != mad) && failures++ < 5) {
+        printf("window %u sample %d: median %.2f mad %.2f, sorted %.2f %.2f\n", window, i, sliding.median(),
+               sliding.mad(), median, mad);
+      }
+    }
+  }
+  printf("median/MAD against a sort, windows 1-%d:   %s\n", HAMPEL_MAX_WINDOW, failures ? "FAILED" : "ok");
+  return failures;
+}
+
+struct Channel {
+  const char* name;
+  HampelFilter filter;
+  bool angle;
+  float (*truth)(int i);
+  float noise;
+  float (*spike)(float truth);
+};
+
+static float windSpeed(int i) { return 12.0f + 4.0f * sinf(i / 120.0f) + 2.0f * sinf(i / 17.0f); }
+static float windAngle(int i) { return fmodf(360.0f + 25.0f * sinf(i / 90.0f), 360.0f); }   // Around 0/360
+static float groundSpeed(int i) { return 5.0f + 1.5f * sinf(i / 300.0f); }
+static float speedSpike(float) { return uniform(0, 1) < 0.3f ? 0.0f : uniform(40.0f, 97.0f); }   // Dropouts and spray
+static float angleSpike(float truth) { return fmodf(truth + uniform(60.0f, 300.0f), 360.0f); }
+static float gpsSpike(float truth) { return truth + uniform(4.0f, 20.0f) * (uniform(0, 1) < 0.5f ? -1.0f : 1.0f); }
+
+static int checkSpikes(Channel &channel) {
+  const int samples = 200000;
+  int spikes = 0, caught = 0, falseRejects = 0;
+  double rawError = 0, filteredError = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < samples; i++) {
+    float truth = channel.truth(i);
+    float value = truth + gaussian(channel.noise);
+    if (channel.angle) value = fmodf(value + 360.0f, 360.0f);
+    bool spike = uniform(0, 1) < SPIKE_RATE;
+    if (spike) {
+      value = fmaxf(0.0f, channel.spike(truth));
+      spikes++;
+    }
+    float output = channel.filter.filter(value);
+    if (channel.filter.lastRejected()) {
+      if (spike) {
+        caught++;
+      } else {
+        falseRejects++;
+      }
+    }
+    float rawDiff = channel.angle ? angleDiff(value, truth) : value - truth;
+    float filteredDiff = channel.angle ? angleDiff(output, truth) : output - truth;
+    rawError += rawDiff * rawDiff;
+    filteredError += filteredDiff * filteredDiff;
+  }
+  double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / samples;
+
+  float caughtRate = (float)caught / spikes, falseRate = (float)falseRejects / (samples - spikes);
+  bool ok = caughtRate >= MIN_CAUGHT && falseRate <= MAX_FALSE && channel.filter.rejected() == (uint32_t)(caught + falseRejects);
+  printf("%-4s window %2u: %5.1f%% of %d spikes caught, %.2f%% clean lost, RMS error %6.2f -> %.2f, %.3f us/sample %s\n",
+         channel.name, channel.filter.window(), caughtRate * 100, spikes, falseRate * 100, sqrt(rawError / samples),
+         sqrt(filteredError / samples), us, ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
+
+// A real step is held back until it fills half the window, then passes
+static int checkStep(uint8_t window) {
+  HampelFilter filter(window, 3.0f, 2.0f);
+  for (int i = 0; i < 50; i++) filter.filter(10.0f + (i % 3) * 0.1f);
+  int delay = -1;
+  for (int i = 0; i < 50 && delay < 0; i++) {
+    if (fabsf(filter.filter(20.0f) - 20.0f) < 0.5f) delay = i;
+  }
+  bool ok = delay >= 0 && delay <= window / 2 + 1;
+  printf("step 10 -> 20 kn, window %2u: held for %d samples %s\n", window, delay, ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
+
+int main() {
+  srand(11);
+  int failures = checkWindow();
+
+  Channel channels[] = {
+    {"AWS", HampelFilter(7, 3.0f, 2.0f), false, windSpeed, 0.8f, speedSpike},
+    {"AWA", HampelFilter(7, 3.0f, 15.0f, 360.0f), true, windAngle, 4.0f, angleSpike},
+    {"SOG", HampelFilter(5, 3.0f, 0.5f), false, groundSpeed, 0.1f, gpsSpike},
+  };
+  for (Channel &channel : channels) failures += checkSpikes(channel);
+  Channel wide = {"AWS", HampelFilter(HAMPEL_MAX_WINDOW, 3.0f, 2.0f), false, windSpeed, 0.8f, speedSpike};
+  failures += checkSpikes(wide);
+
+  failures += checkStep(5);
+  failures += checkStep(7);
+  failures += checkStep(15);
+
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
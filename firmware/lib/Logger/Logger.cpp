@@ -0,0 +1,114 @@
+#include "Logger.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(ESP_PLATFORM)
+#include <freertos/FreeRTOS.h>
+static portMUX_TYPE ringLock = portMUX_INITIALIZER_UNLOCKED;
+#define RING_LOCK() portENTER_CRITICAL(&ringLock)
+#define RING_UNLOCK() portEXIT_CRITICAL(&ringLock)
+#else
+#include <mutex>
+static std::mutex ringLock;
+#define RING_LOCK() ringLock.lock()
+#define RING_UNLOCK() ringLock.unlock()
+#endif
+
+Logger logger;
+
+static const char LEVEL_LETTERS[] = "-EWIDV";
+
+void Logger::begin(LogSink sink, bool buffered) {
+  this->sink = sink;
+  this->buffered = buffered;
+}
+
+void Logger::write(uint8_t level, const char* tag, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  vwrite(level, tag, format, args);
+  va_end(args);
+}
+
+void Logger::vwrite(uint8_t level, const char* tag, const char* format, va_list args) {
+  char line[LOGGER_LINE_MAX];
+  char letter = level <= VEETR_LOG_VERBOSE ? LEVEL_LETTERS[level] : '?';
+  int prefix = snprintf(line, sizeof(line), "%c [%s] ", letter, tag);
+  if (prefix < 0 || (size_t)prefix >= sizeof(line) - 1) return;
+
+  int body = vsnprintf(line + prefix, sizeof(line) - prefix, format, args);
+  if (body < 0) return;
+  size_t length = prefix + (size_t)body;
+  if (length > sizeof(line) - 2) length = sizeof(line) - 2;  // Truncated
+  line[length++] = '\n';
+
+  if (!buffered) {
+    if (sink) sink(line, length);
+    return;
+  }
+  push(line, length);
+}
+
+bool Logger::push(const char* text, size_t length) {
+  RING_LOCK();
+  size_t used = (head - tail + LOGGER_RING_SIZE) % LOGGER_RING_SIZE;
+  // One byte stays free so a full ring is distinguishable from an empty one
+  if (length > LOGGER_RING_SIZE - 1 - used) {
+    droppedCount++;
+    RING_UNLOCK();
+    return false;
+  }
+  size_t first = LOGGER_RING_SIZE - head;
+  if (first > length) first = length;
+  memcpy(ring + head, text, first);
+  memcpy(ring, text + first, length - first);
+  head = (head + length) % LOGGER_RING_SIZE;
+  RING_UNLOCK();
+  return true;
+}
+
+size_t Logger::drain(size_t maxBytes) {
+  if (!sink) return 0;
+  size_t written = 0;
+
+  if (droppedCount != reportedDrops) {
+    char notice[48];
+    uint32_t drops = droppedCount;
+    int length = snprintf(notice, sizeof(notice), "W [Log] %lu messages dropped\n",
+                          (unsigned long)(drops - reportedDrops));
+    reportedDrops = drops;
+    if (length > 0) {
+      sink(notice, length);
+      written += length;
+    }
+  }
+
+  // Copy out in small chunks so the lock is never held while the sink blocks
+  char chunk[128];
+  while (written < maxBytes) {
+    RING_LOCK();
+    size_t available = (head - tail + LOGGER_RING_SIZE) % LOGGER_RING_SIZE;
+    size_t count = available;
+    if (count > sizeof(chunk)) count = sizeof(chunk);
+    if (count > maxBytes - written) count = maxBytes - written;
+    size_t first = LOGGER_RING_SIZE - tail;
+    if (first > count) first = count;
+    memcpy(chunk, ring + tail, first);
+    memcpy(chunk + first, ring, count - first);
+    tail = (tail + count) % LOGGER_RING_SIZE;
+    RING_UNLOCK();
+
+    if (count == 0) break;
+    sink(chunk, count);
+    written += count;
+  }
+  return written;
+}
+
+size_t Logger::pending() const {
+  RING_LOCK();
+  size_t used = (head - tail + LOGGER_RING_SIZE) % LOGGER_RING_SIZE;
+  RING_UNLOCK();
+  return used;
+}
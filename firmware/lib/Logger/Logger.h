@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Levelled diagnostic logger with a non-blocking sink.
+//
+// LOGE/LOGW/LOGI/LOGD/LOGV compile to nothing when their level is above
+// VEETR_LOG_LEVEL, so disabled messages cost neither flash nor time (their
+// arguments are not evaluated). Enabled messages are formatted as
+// "[tag] message\n" into a ring buffer and handed to the sink by drain(),
+// which the firmware calls from a low-priority task: the caller never waits
+// for the UART. When the ring is full the message is dropped and counted.
+//
+// write() may be called from any task; drain() from one task only.
+
+// Levels, numbered like CORE_DEBUG_LEVEL
+#define VEETR_LOG_NONE    0
+#define VEETR_LOG_ERROR   1
+#define VEETR_LOG_WARN    2
+#define VEETR_LOG_INFO    3
+#define VEETR_LOG_DEBUG   4
+#define VEETR_LOG_VERBOSE 5
+
+#ifndef VEETR_LOG_LEVEL
+#define VEETR_LOG_LEVEL VEETR_LOG_INFO
+#endif
+
+#ifndef LOGGER_RING_SIZE
+#define LOGGER_RING_SIZE 4096
+#endif
+#define LOGGER_LINE_MAX 192  // Longer messages are truncated
+
+// Receives formatted text; may block (it runs on the drain task)
+typedef void (*LogSink)(const char* text, size_t length);
+
+class Logger {
+public:
+  // buffered=false writes each message straight to the sink from the caller
+  // (or discards it when sink is null), for host tools without a drain task.
+  // Messages logged before begin() are kept in the ring.
+  void begin(LogSink sink, bool buffered = true);
+
+  void write(uint8_t level, const char* tag, const char* format, ...) __attribute__((format(printf, 4, 5)));
+  void vwrite(uint8_t level, const char* tag, const char* format, va_list args);
+
+  // Hand up to maxBytes of buffered text to the sink; returns the bytes written
+  size_t drain(size_t maxBytes);
+
+  size_t pending() const;
+  uint32_t dropped() const { return droppedCount; }
+
+private:
+  bool push(const char* text, size_t length);
+
+  LogSink sink = nullptr;
+  bool buffered = true;
+
+  char ring[LOGGER_RING_SIZE];
+  size_t head = 0;  // Next byte to write
+  size_t tail = 0;  // Next byte to drain
+  uint32_t droppedCount = 0;
+  uint32_t reportedDrops = 0;
+};
+
+extern Logger logger;
+
+#define LOG_AT_(level, tag, ...) logger.write(level, tag, __VA_ARGS__)
+
+#if VEETR_LOG_LEVEL >= VEETR_LOG_ERROR
+#define LOGE(tag, ...) LOG_AT_(VEETR_LOG_ERROR, tag, __VA_ARGS__)
+#else
+#define LOGE(tag, ...) do {} while (0)
+#endif
+
+#if VEETR_LOG_LEVEL >= VEETR_LOG_WARN
+#define LOGW(tag, ...) LOG_AT_(VEETR_LOG_WARN, tag, __VA_ARGS__)
+#else
+#define LOGW(tag, ...) do {} while (0)
+#endif
+
+#if VEETR_LOG_LEVEL >= VEETR_LOG_INFO
+#define LOGI(tag, ...) LOG_AT_(VEETR_LOG_INFO, tag, __VA_ARGS__)
+#else
+#define LOGI(tag, ...) do {} while (0)
+#endif
+
+#if VEETR_LOG_LEVEL >= VEETR_LOG_DEBUG
+#define LOGD(tag, ...) LOG_AT_(VEETR_LOG_DEBUG, tag, __VA_ARGS__)
+#else
+#define LOGD(tag, ...) do {} while (0)
+#endif
+
+#if VEETR_LOG_LEVEL >= VEETR_LOG_VERBOSE
+#define LOGV(tag, ...) LOG_AT_(VEETR_LOG_VERBOSE, tag, __VA_ARGS__)
+#else
+#define LOGV(tag, ...) do {} while (0)
+#endif
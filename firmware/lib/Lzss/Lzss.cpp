@@ -0,0 +1,95 @@
+#include "Lzss.h"
+
+#include <string.h>
+
+#define WINDOW_MASK (LZSS_WINDOW_SIZE - 1)
+
+void LzssDecoder::begin() {
+  failure = nullptr;
+  field = FIELD_TAG;
+  needed = 1;
+  opBits = 0;
+  opOnes = false;
+  value = 0;
+  distance = 0;
+  head = 0;
+  flushed = 0;
+  total = 0;
+  // Back-references before the start read zeros, as in heatshrink
+  memset(window, 0, sizeof(window));
+}
+
+bool LzssDecoder::fail(const char* message) {
+  if (!failure) failure = message;
+  return false;
+}
+
+bool LzssDecoder::feed(const uint8_t* data, size_t length) {
+  if (failure) return false;
+  for (size_t i = 0; i < length; i++) {
+    uint8_t byte = data[i];
+    for (uint8_t mask = 0x80; mask; mask >>= 1) {
+      bool bit = byte & mask;
+      value = (uint16_t)(value << 1 | bit);
+      opOnes |= bit;
+      opBits++;
+      if (--needed) continue;
+
+      switch (field) {
+        case FIELD_TAG:
+          field = value ? FIELD_LITERAL : FIELD_INDEX;
+          needed = value ? 8 : LZSS_WINDOW_BITS;
+          break;
+        case FIELD_LITERAL:
+          if (!put((uint8_t)value)) return false;
+          field = FIELD_TAG;
+          needed = 1;
+          opBits = 0;
+          opOnes = false;
+          break;
+        case FIELD_INDEX:
+          distance = value + 1;
+          field = FIELD_COUNT;
+          needed = LZSS_LOOKAHEAD_BITS;
+          break;
+        case FIELD_COUNT:
+          // Byte by byte: a run may overlap the bytes it produces
+          for (uint16_t count = value + 1; count; count--) {
+            if (!put(window[(head - distance) & WINDOW_MASK])) return false;
+          }
+          field = FIELD_TAG;
+          needed = 1;
+          opBits = 0;
+          opOnes = false;
+          break;
+      }
+      value = 0;
+    }
+  }
+  // Hand on what this piece produced rather than holding it to the next
+  return flush();
+}
+
+bool LzssDecoder::put(uint8_t byte) {
+  window[head++] = byte;
+  total++;
+  if (head < LZSS_WINDOW_SIZE) return true;
+  bool ok = flush();
+  head = 0;
+  flushed = 0;
+  return ok;
+}
+
+bool LzssDecoder::flush() {
+  if (head == flushed) return true;
+  if (!output.write(window + flushed, head - flushed)) return fail("Image write failed");
+  flushed = head;
+  return true;
+}
+
+bool LzssDecoder::finish() {
+  if (failure) return false;
+  // Up to 7 zero bits pad the last byte; a literal or back-reference takes more
+  if (opBits > 7 || opOnes) return fail("Compressed image incomplete");
+  return flush();
+}
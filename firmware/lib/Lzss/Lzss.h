@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming LZSS decompression for compressed firmware images.
+//
+// The stream is heatshrink's bit stream, most significant bit first: a 1 bit
+// and 8 bits is a literal byte, a 0 bit is a back-reference of
+// LZSS_WINDOW_BITS bits (distance - 1) and LZSS_LOOKAHEAD_BITS bits
+// (length - 1) into the bytes already produced. The last byte is padded with
+// zero bits. `heatshrink -e -w 11 -l 4` makes the same stream;
+// examples/lzss_tool compresses somewhat better.
+//
+// The window is the only buffer: output is handed on from it in runs as it
+// fills, so RAM is fixed at the window size, whatever the image size. Input
+// may be split anywhere, down to single bytes.
+
+#ifndef LZSS_WINDOW_BITS
+#define LZSS_WINDOW_BITS 11       // 2 KB window
+#endif
+#ifndef LZSS_LOOKAHEAD_BITS
+#define LZSS_LOOKAHEAD_BITS 4     // Back-references of up to 16 bytes
+#endif
+#define LZSS_WINDOW_SIZE (1u << LZSS_WINDOW_BITS)
+
+// Where the decompressed bytes go, front to back
+class LzssOutput {
+public:
+  virtual ~LzssOutput() {}
+  virtual bool write(const uint8_t* data, size_t length) = 0;
+};
+
+class LzssDecoder {
+public:
+  explicit LzssDecoder(LzssOutput &output) : output(output) { begin(); }
+
+  // Expect a new stream
+  void begin();
+
+  // Decompress compressed bytes; false once the output refused a write
+  bool feed(const uint8_t* data, size_t length);
+
+  // After the last byte: hands on what is left and checks that the stream
+  // did not stop inside a literal or back-reference
+  bool finish();
+
+  const char* error() const { return failure; }
+  uint32_t written() const { return total; }
+
+private:
+  enum Field : uint8_t { FIELD_TAG, FIELD_LITERAL, FIELD_INDEX, FIELD_COUNT };
+
+  bool put(uint8_t byte);
+  bool flush();
+  bool fail(const char* message);
+
+  LzssOutput &output;
+  const char* failure = nullptr;
+
+  Field field = FIELD_TAG;
+  uint8_t needed = 1;          // Bits still to read for the field
+  uint8_t opBits = 0;          // Bits read since the last complete literal or back-reference
+  bool opOnes = false;         // Any of them set (padding is zeros)
+  uint16_t value = 0;          // The field so far
+  uint16_t distance = 0;       // Of the back-reference being read
+
+  uint16_t head = 0;           // Next window position to fill
+  uint16_t flushed = 0;        // Window bytes before this were handed on
+  uint32_t total = 0;          // Bytes produced
+  uint8_t window[LZSS_WINDOW_SIZE];
+};
@@ -0,0 +1,271 @@
+// Host tool for Lzss: compresses a firmware image (or a DeltaPatch patch) for
+// the OTA update and checks the decoder against it.
+//
+// Build and run on the development machine (no Arduino dependencies):
+//   cd firmware/lib/Lzss
+//   g++ -O2 -I . Lzss.cpp examples/lzss_tool/lzss_tool.cpp -o lzss_tool
+//   ./lzss_tool firmware.bin --out firmware.lzss
+//
+// The compressed file is decompressed again in pieces of random size and
+// compared before it is written. Without files the tool runs its checks: a
+// hand-made stream that fixes the bit layout, round trips of empty, tiny,
+// zero, text, random and machine code data (its own executable) fed whole
+// and in pieces down to single bytes, and streams that must be refused.
+// Exits 1 on failure.
+
+#include <Lzss.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define MAX_LENGTH (1u << LZSS_LOOKAHEAD_BITS)
+#define LITERAL_BITS 9
+#define REFERENCE_BITS (1 + LZSS_WINDOW_BITS + LZSS_LOOKAHEAD_BITS)
+
+typedef std::vector<uint8_t> Bytes;
+
+// ---- Compression ----
+
+class BitWriter {
+public:
+  void put(uint32_t value, uint8_t bits) {
+    while (bits--) {
+      if (used == 0) out.push_back(0);
+      if (value >> bits & 1) out.back() |= (uint8_t)(0x80 >> used);
+      used = (used + 1) & 7;
+    }
+  }
+  Bytes out;
+
+private:
+  uint8_t used = 0;   // Bits of the last byte filled
+};
+
+// Optimal parse: the longest match in the window at every position, then
+// the cheapest mix of literals and back-references (or shorter ones) from
+// the end, so a literal that lets a longer reference start is taken
+static Bytes compress(const Bytes &data) {
+  size_t n = data.size();
+  std::vector<uint16_t> matchLength(n, 0), matchDistance(n, 0);
+  std::vector<int32_t> head(65536, -1), previous(n, -1);
+  for (size_t i = 0; i + 1 < n; i++) {
+    uint16_t key = (uint16_t)(data[i] | data[i + 1] << 8);
+    for (int32_t p = head[key]; p >= 0 && i - (size_t)p <= LZSS_WINDOW_SIZE; p = previous[p]) {
+      size_t length = 0;
+      while (length < MAX_LENGTH && i + length < n && data[p + length] == data[i + length]) length++;
+      if (length > matchLength[i]) {
+        matchLength[i] = (uint16_t)length;
+        matchDistance[i] = (uint16_t)(i - p);
+        if (length == MAX_LENGTH) break;
+      }
+    }
+    previous[i] = head[key];
+    head[key] = (int32_t)i;
+  }
+
+  std::vector<uint32_t> cost(n + 1, 0);
+  std::vector<uint16_t> choice(n + 1, 0);   // Reference length, 0 for a literal
+  for (size_t i = n; i-- > 0;) {
+    cost[i] = LITERAL_BITS + cost[i + 1];
+    for (uint16_t length = 2; length <= matchLength[i]; length++) {
+      uint32_t c = REFERENCE_BITS + cost[i + length];
+      if (c < cost[i]) {
+        cost[i] = c;
+        choice[i] = length;
+      }
+    }
+  }
+
+  BitWriter bits;
+  for (size_t i = 0; i < n;) {
+    if (choice[i]) {
+      bits.put(0, 1);
+      bits.put(matchDistance[i] - 1u, LZSS_WINDOW_BITS);
+      bits.put(choice[i] - 1u, LZSS_LOOKAHEAD_BITS);
+      i += choice[i];
+    } else {
+      bits.put(1, 1);
+      bits.put(data[i], 8);
+      i++;
+    }
+  }
+  return bits.out;
+}
+
+// ---- Decompressing, as on the device ----
+
+class MemoryOutput : public LzssOutput {
+public:
+  bool write(const uint8_t* data, size_t length) override {
+    if (image.size() + length > limit) return false;
+    image.insert(image.end(), data, data + length);
+    writes++;
+    return true;
+  }
+  Bytes image;
+  size_t limit = (size_t)-1;   // Refuse writes past this many bytes
+  size_t writes = 0;
+};
+
+struct Decoded {
+  bool ok;
+  const char* error;
+  Bytes image;
+};
+
+// Feed the stream in pieces of 1..maxPiece bytes (0 = all at once)
+static Decoded decompress(const Bytes &stream, size_t maxPiece, size_t limit = (size_t)-1) {
+  MemoryOutput output;
+  output.limit = limit;
+  LzssDecoder decoder(output);
+  bool ok = true;
+  for (size_t offset = 0; offset < stream.size() && ok;) {
+    size_t piece = maxPiece ? 1 + rand() % maxPiece : stream.size();
+    piece = std::min(piece, stream.size() - offset);
+    ok = decoder.feed(stream.data() + offset, piece);
+    offset += piece;
+  }
+  ok = decoder.finish() && ok;
+  if (ok && decoder.written() != output.image.size()) ok = false;
+  return {ok, decoder.error(), output.image};
+}
+
+// ---- Checks ----
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int checkCase(const char* name, const Bytes &data) {
+  auto start = std::chrono::steady_clock::now();
+  Bytes stream = compress(data);
+  double compressMs = elapsedMs(start);
+
+  int failures = 0;
+  start = std::chrono::steady_clock::now();
+  Decoded whole = decompress(stream, 0);
+  double decodeMs = elapsedMs(start);
+  if (!whole.ok || whole.image != data) failures++;
+  for (size_t maxPiece : {1, 7, 180, 4096}) {
+    Decoded pieces = decompress(stream, maxPiece);
+    if (!pieces.ok || pieces.image != data) failures++;
+  }
+  printf("%-14s %8zu -> %8zu bytes (%5.1f%%), compressed in %4.0f ms, decompressed at %5.0f MB/s %s\n", name,
+         data.size(), stream.size(), data.empty() ? 0.0 : 100.0 * stream.size() / data.size(), compressMs,
+         decodeMs > 0 ? data.size() / decodeMs / 1000.0 : 0.0, failures ? "FAILED" : "ok");
+  if (failures && whole.error) printf("  %s\n", whole.error);
+  return failures;
+}
+
+// "abcabcabc": three literals and a reference 3 back for 6 bytes, which
+// overlaps what it produces
+static int checkLayout() {
+#if LZSS_WINDOW_BITS == 11 && LZSS_LOOKAHEAD_BITS == 4
+  const Bytes stream = {0xb0, 0xd8, 0xac, 0x60, 0x04, 0xa0};
+  const char* expected = "abcabcabc";
+  Decoded decoded = decompress(stream, 1);
+  bool ok = decoded.ok && decoded.image == Bytes(expected, expected + 9) && compress(decoded.image) == stream;
+  printf("bit layout:                          %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+#else
+  return 0;
+#endif
+}
+
+static int expectRefused(const char* name, const Bytes &stream, size_t limit = (size_t)-1) {
+  Decoded result = decompress(stream, 5, limit);
+  printf("refused, %-27s %s (%s)\n", name, result.ok ? "FAILED" : "ok", result.error ? result.error : "-");
+  return result.ok ? 1 : 0;
+}
+
+static Bytes randomBytes(size_t size) {
+  Bytes out(size);
+  for (uint8_t &b : out) b = (uint8_t)rand();
+  return out;
+}
+
+static Bytes text(size_t size) {
+  static const char* const words[] = {"wind", "heel", "speed", "over", "ground", "true", "apparent", "angle",
+                                      "\"type\":", "\"data\",", "{", "}", "1", "12.4", "-0.3", "\n"};
+  std::string s;
+  while (s.size() < size) {
+    s += words[rand() % 16];
+    s += ' ';
+  }
+  return Bytes(s.begin(), s.begin() + size);
+}
+
+static bool readFile(const char* path, Bytes &out) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  uint8_t buffer[65536];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) out.insert(out.end(), buffer, buffer + n);
+  fclose(f);
+  return true;
+}
+
+static int runChecks() {
+  srand(7);
+  int failures = checkLayout();
+
+  failures += checkCase("empty", Bytes());
+  failures += checkCase("one byte", Bytes(1, 0xE9));
+  failures += checkCase("zeros", Bytes(100000, 0));
+  failures += checkCase("0xFF padding", Bytes(65536, 0xFF));
+  failures += checkCase("text", text(300000));
+  failures += checkCase("random", randomBytes(200000));
+  Bytes code;
+  if (readFile("/proc/self/exe", code)) failures += checkCase("machine code", code);
+
+  // A literal cut short, and the output refusing a write
+  Bytes stream = compress(text(5000));
+  failures += expectRefused("truncated stream:", Bytes{0xb0, 0xd8});
+  failures += expectRefused("output full:", stream, 3000);
+
+  printf("decoder state: %zu bytes\n", sizeof(LzssDecoder));
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+  const char* inPath = nullptr;
+  const char* outPath = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+      outPath = argv[++i];
+    } else {
+      inPath = argv[i];
+    }
+  }
+  if (!inPath) return runChecks();
+
+  Bytes image;
+  if (!readFile(inPath, image)) {
+    fprintf(stderr, "cannot read %s\n", inPath);
+    return 1;
+  }
+  Bytes stream = compress(image);
+  Decoded check = decompress(stream, 4096);
+  if (!check.ok || check.image != image) {
+    fprintf(stderr, "round trip failed: %s\n", check.error ? check.error : "image differs");
+    return 1;
+  }
+  printf("%zu -> %zu bytes (%.1f%%)\n", image.size(), stream.size(), 100.0 * stream.size() / image.size());
+
+  if (outPath) {
+    FILE* f = fopen(outPath, "wb");
+    if (!f || fwrite(stream.data(), 1, stream.size(), f) != stream.size()) {
+      fprintf(stderr, "cannot write %s\n", outPath);
+      if (f) fclose(f);
+      return 1;
+    }
+    fclose(f);
+  }
+  return 0;
+}
@@ -0,0 +1,285 @@
+#include "NmeaOutput.h"
+
+#include <math.h>
+#include <string.h>
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+// `value` / `divisor`, rounded half away from zero
+static int32_t scaleDown(int32_t value, int32_t divisor) {
+  return (value + (value >= 0 ? divisor / 2 : -divisor / 2)) / divisor;
+}
+
+// Float to units of 10^-decimals; false when unknown
+static bool toFixed(float value, uint8_t decimals, int32_t &out) {
+  if (isnan(value) || isinf(value)) return false;
+  float scale = 1.0f;
+  for (uint8_t i = 0; i < decimals; i++) scale *= 10.0f;
+  out = (int32_t)lroundf(value * scale);
+  return true;
+}
+
+// A float field, empty when unknown
+static void addOptional(NmeaSentence &sentence, float value, uint8_t decimals) {
+  int32_t fixed;
+  if (toFixed(value, decimals, fixed)) {
+    sentence.addFixed(fixed, decimals);
+  } else {
+    sentence.addEmpty();
+  }
+}
+
+uint8_t nmeaOutputBit(const char* name) {
+  static const struct {
+    const char* name;
+    uint8_t bit;
+  } names[] = {
+    {"MWV", NMEA_OUT_MWV_APPARENT | NMEA_OUT_MWV_TRUE},
+    {"MWVR", NMEA_OUT_MWV_APPARENT},
+    {"MWVT", NMEA_OUT_MWV_TRUE},
+    {"HDM", NMEA_OUT_HDM},
+    {"XDR", NMEA_OUT_XDR},
+    {"RMC", NMEA_OUT_RMC},
+    {"VTG", NMEA_OUT_VTG},
+    {"LINE", NMEA_OUT_LINE},
+  };
+  for (const auto &entry : names) {
+    if (strcmp(name, entry.name) == 0) return entry.bit;
+  }
+  return 0;
+}
+
+void NmeaSentence::put(char c) {
+  if (length < capacity) {
+    out[length++] = c;
+  } else {
+    overflow = true;
+  }
+  checksum ^= (uint8_t)c;
+}
+
+void NmeaSentence::begin(const char* address) {
+  length = 0;
+  checksum = 0;
+  overflow = false;
+  if (capacity) {
+    out[length++] = '$';   // Not part of the checksum
+  } else {
+    overflow = true;
+  }
+  while (*address) put(*address++);
+}
+
+void NmeaSentence::addEmpty() {
+  separator();
+}
+
+void NmeaSentence::addChar(char c) {
+  separator();
+  put(c);
+}
+
+void NmeaSentence::addText(const char* text) {
+  separator();
+  while (*text) put(*text++);
+}
+
+void NmeaSentence::addUnsigned(uint32_t value, uint8_t minDigits) {
+  separator();
+  char digits[10];
+  uint8_t count = 0;
+  do {
+    digits[count++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+  while (count < minDigits && count < sizeof(digits)) digits[count++] = '0';
+  while (count) put(digits[--count]);
+}
+
+void NmeaSentence::addFixed(int32_t value, uint8_t decimals, uint8_t minWholeDigits) {
+  separator();
+  uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+  if (value < 0) put('-');
+  char digits[11];
+  uint8_t count = 0;
+  // Fraction digits first (they are written in reverse), then the whole digits
+  for (uint8_t i = 0; i < decimals; i++) {
+    digits[count++] = (char)('0' + magnitude % 10);
+    magnitude /= 10;
+  }
+  do {
+    digits[count++] = (char)('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude);
+  while (count < decimals + minWholeDigits && count < sizeof(digits)) digits[count++] = '0';
+  while (count) {
+    if (count == decimals) put('.');
+    put(digits[--count]);
+  }
+}
+
+void NmeaSentence::addCoordinate(int32_t e7, uint8_t degreeDigits, char positive, char negative) {
+  uint32_t magnitude = e7 < 0 ? 0u - (uint32_t)e7 : (uint32_t)e7;
+  uint32_t degrees = magnitude / 10000000;
+  // Remainder of a degree in 1e-5 minutes (x 60 / 100); rounds to 59.99999 at most
+  uint32_t minutes = ((magnitude % 10000000) * 6 + 5) / 10;
+  addFixed((int32_t)(degrees * 10000000 + minutes), 5, (uint8_t)(degreeDigits + 2));   // (d)ddmm.mmmmm
+  addChar(e7 < 0 ? negative : positive);
+}
+
+size_t NmeaSentence::end() {
+  if (overflow || length + 5 > capacity || length + 5 > NMEA_SENTENCE_MAX) return 0;
+  out[length++] = '*';
+  out[length++] = HEX_DIGITS[checksum >> 4];
+  out[length++] = HEX_DIGITS[checksum & 0x0F];
+  out[length++] = '\r';
+  out[length++] = '\n';
+  return length;
+}
+
+void NmeaOutput::finish(NmeaSentence &sentence) {
+  size_t length = sentence.end();
+  if (length) {
+    used += length;
+    built++;
+  } else {
+    dropped++;
+  }
+}
+
+size_t NmeaOutput::build(uint32_t now, const TelemetryFrame &frame, const NmeaFix &fix, float pitch,
+                         const StartLineState &line, float timeToStart) {
+  used = 0;
+  if (enabled & NMEA_OUT_MWV_APPARENT) addWind(frame, TF_AWA, TF_AWS, 'R');
+  if (enabled & NMEA_OUT_MWV_TRUE) addWind(frame, TF_TWA, TF_TWS, 'T');
+  if (enabled & NMEA_OUT_HDM) addHeading(frame);
+  if (enabled & NMEA_OUT_XDR) addAttitude(frame, pitch);
+
+  bool fresh = fix.has(NMEA_POSITION) && now - fix.positionAt <= NMEA_OUTPUT_FIX_MAX_AGE;
+  if (enabled & NMEA_OUT_RMC) addRmc(fix, fresh);
+  if ((enabled & NMEA_OUT_VTG) && fresh) addVtg(fix);
+  if ((enabled & NMEA_OUT_LINE) && line.valid) addLine(line, timeToStart);
+
+  buffer[used] = '\0';
+  return used;
+}
+
+// $IIMWV,<angle>,<R|T>,<speed>,N,A
+void NmeaOutput::addWind(const TelemetryFrame &frame, TelemetryField angle, TelemetryField speed, char reference) {
+  if (!frame.has(angle) || !frame.has(speed)) return;
+  NmeaSentence sentence = next();
+  sentence.begin("IIMWV");
+  sentence.addFixed(scaleDown(frame.value[angle], 10) % 3600, 1);
+  sentence.addChar(reference);
+  sentence.addFixed(scaleDown(frame.value[speed], 10), 1);
+  sentence.addChar('N');
+  sentence.addChar('A');
+  finish(sentence);
+}
+
+// $IIHDM,<heading>,M
+void NmeaOutput::addHeading(const TelemetryFrame &frame) {
+  if (!frame.has(TF_HDM)) return;
+  NmeaSentence sentence = next();
+  sentence.begin("IIHDM");
+  sentence.addFixed(scaleDown(frame.value[TF_HDM], 10) % 3600, 1);
+  sentence.addChar('M');
+  finish(sentence);
+}
+
+// $IIXDR,A,<heel>,D,ROLL,A,<pitch>,D,PITCH (either quadruple alone when the other is unknown)
+void NmeaOutput::addAttitude(const TelemetryFrame &frame, float pitch) {
+  int32_t pitchTenths;
+  bool hasPitch = toFixed(pitch, 1, pitchTenths);
+  if (!frame.has(TF_HEEL) && !hasPitch) return;
+  NmeaSentence sentence = next();
+  sentence.begin("IIXDR");
+  if (frame.has(TF_HEEL)) {
+    sentence.addChar('A');
+    sentence.addFixed(scaleDown(frame.value[TF_HEEL], 10), 1);
+    sentence.addChar('D');
+    sentence.addText("ROLL");
+  }
+  if (hasPitch) {
+    sentence.addChar('A');
+    sentence.addFixed(pitchTenths, 1);
+    sentence.addChar('D');
+    sentence.addText("PITCH");
+  }
+  finish(sentence);
+}
+
+// $GPRMC,hhmmss.ss,<A|V>,ddmm.mmmmm,N,dddmm.mmmmm,E,<knots>,<course>,ddmmyy,,,<A|N>
+void NmeaOutput::addRmc(const NmeaFix &fix, bool fresh) {
+  if (!fix.has(NMEA_TIME)) return;
+  NmeaSentence sentence = next();
+  sentence.begin("GPRMC");
+  uint32_t hhmmss = (uint32_t)fix.hour * 10000 + fix.minute * 100 + fix.second;
+  sentence.addFixed((int32_t)(hhmmss * 100 + fix.centisecond), 2, 6);
+  sentence.addChar(fresh ? 'A' : 'V');
+  if (fresh) {
+    sentence.addCoordinate(fix.position.lat, 2, 'N', 'S');
+    sentence.addCoordinate(fix.position.lon, 3, 'E', 'W');
+  } else {
+    for (uint8_t i = 0; i < 4; i++) sentence.addEmpty();
+  }
+  if (fresh && fix.has(NMEA_SPEED)) {
+    sentence.addFixed(scaleDown(fix.speed * 360, 1852), 2);   // mm/s to 0.01 kn
+  } else {
+    sentence.addEmpty();
+  }
+  if (fresh && fix.has(NMEA_COURSE)) {
+    sentence.addFixed(fix.course, 2);
+  } else {
+    sentence.addEmpty();
+  }
+  if (fix.has(NMEA_DATE)) {
+    sentence.addUnsigned((uint32_t)fix.day * 10000 + fix.month * 100 + fix.year % 100, 6);
+  } else {
+    sentence.addEmpty();
+  }
+  sentence.addEmpty();   // Magnetic variation and its direction
+  sentence.addEmpty();
+  sentence.addChar(fresh ? 'A' : 'N');
+  finish(sentence);
+}
+
+// $GPVTG,<course>,T,,M,<knots>,N,<km/h>,K,A
+void NmeaOutput::addVtg(const NmeaFix &fix) {
+  NmeaSentence sentence = next();
+  sentence.begin("GPVTG");
+  if (fix.has(NMEA_COURSE)) {
+    sentence.addFixed(fix.course, 2);
+  } else {
+    sentence.addEmpty();
+  }
+  sentence.addChar('T');
+  sentence.addEmpty();
+  sentence.addChar('M');
+  if (fix.has(NMEA_SPEED)) {
+    sentence.addFixed(scaleDown(fix.speed * 360, 1852), 2);   // mm/s to 0.01 kn
+    sentence.addChar('N');
+    sentence.addFixed(scaleDown(fix.speed * 36, 100), 2);     // mm/s to 0.01 km/h
+    sentence.addChar('K');
+  } else {
+    sentence.addEmpty();
+    sentence.addChar('N');
+    sentence.addEmpty();
+    sentence.addChar('K');
+  }
+  sentence.addChar('A');
+  finish(sentence);
+}
+
+// $PVTR,LINE,<distance>,<time to line>,<time to burn>,<time to start>,<bias>
+void NmeaOutput::addLine(const StartLineState &line, float timeToStart) {
+  NmeaSentence sentence = next();
+  sentence.begin("PVTR");
+  sentence.addText("LINE");
+  addOptional(sentence, line.distance, 1);
+  addOptional(sentence, line.timeToLine, 0);
+  addOptional(sentence, line.timeToBurn, 0);
+  addOptional(sentence, timeToStart, 0);
+  addOptional(sentence, line.bias, 1);
+  finish(sentence);
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <NmeaParser.h>
+#include <StartLine.h>
+#include <TelemetryCodec.h>
+
+// NMEA 0183 sentences for chart plotters and OpenCPN, from the telemetry
+// snapshot.
+//
+// NmeaSentence writes one sentence into a caller buffer: fields are
+// appended as integers and fixed-point values (no printf, no floating
+// point) and the checksum is XORed in as each character is written, so
+// ending the sentence only appends "*hh\r\n". A sentence that would not fit
+// the buffer or the NMEA limit of 82 characters is dropped whole.
+//
+// NmeaOutput builds the enabled sentences of one snapshot back to back into
+// its own preallocated buffer:
+//   $IIMWV  apparent (R) and true (T) wind angle and speed, knots
+//   $IIHDM  magnetic heading
+//   $IIXDR  heel (ROLL, signed as TF_HEEL) and pitch (PITCH, + = bow up), degrees
+//   $GPRMC  position, SOG, COG, date and time of the last GPS fix
+//   $GPVTG  COG and SOG
+//   $PVTR   start line: LINE, distance (m, - = pre-start side), time to
+//           line, time to burn and time to start (s), bias (degrees,
+//           + = committee boat end favoured)
+// A sentence is skipped when its values are unknown. RMC and VTG are
+// regenerated from the parsed fix rather than copied from the GPS UART, so
+// the parser keeps consuming characters without buffering sentences; a fix
+// older than NMEA_OUTPUT_FIX_MAX_AGE is sent as void (RMC status V, no VTG).
+
+#define NMEA_SENTENCE_MAX 82            // Characters from '$' to "\r\n" (NMEA 0183)
+#define NMEA_OUTPUT_BUFFER 512          // One snapshot, all sentences
+#define NMEA_OUTPUT_FIX_MAX_AGE 3000    // ms; older GPS fixes are void
+
+// NmeaOutput::setSentences() bits
+enum NmeaOutputSentence : uint8_t {
+  NMEA_OUT_MWV_APPARENT = 1 << 0,
+  NMEA_OUT_MWV_TRUE     = 1 << 1,
+  NMEA_OUT_HDM          = 1 << 2,
+  NMEA_OUT_XDR          = 1 << 3,
+  NMEA_OUT_RMC          = 1 << 4,
+  NMEA_OUT_VTG          = 1 << 5,
+  NMEA_OUT_LINE         = 1 << 6,
+  NMEA_OUT_ALL          = 0x7F,
+};
+
+// Bit for a sentence name ("MWV" is both wind sentences, "MWVR"/"MWVT" one
+// of them, "LINE" the start line), 0 when unknown
+uint8_t nmeaOutputBit(const char* name);
+
+class NmeaSentence {
+public:
+  NmeaSentence(char* buffer, size_t capacity) : out(buffer), capacity(capacity) {}
+
+  // Start a sentence with its address field ("IIMWV", "PVTR")
+  void begin(const char* address);
+
+  void addEmpty();
+  void addChar(char c);
+  void addText(const char* text);
+  // Unsigned integer, zero-padded to `minDigits`
+  void addUnsigned(uint32_t value, uint8_t minDigits = 1);
+  // `value` in units of 10^-decimals, e.g. (1234, 1) is "123.4", with the
+  // whole part zero-padded to `minWholeDigits`
+  void addFixed(int32_t value, uint8_t decimals, uint8_t minWholeDigits = 1);
+  // A 1e-7 degree coordinate as two fields: (d)ddmm.mmmmm and hemisphere
+  void addCoordinate(int32_t e7, uint8_t degreeDigits, char positive, char negative);
+
+  // Append the checksum and CRLF; returns the sentence length, 0 when it
+  // did not fit (nothing written then counts)
+  size_t end();
+
+private:
+  void put(char c);
+  void separator() { put(','); }
+
+  char* out;
+  size_t capacity;
+  size_t length = 0;
+  uint8_t checksum = 0;
+  bool overflow = false;
+};
+
+class NmeaOutput {
+public:
+  void setSentences(uint8_t mask) { enabled = mask & NMEA_OUT_ALL; }
+  uint8_t sentences() const { return enabled; }
+
+  // Build the enabled sentences for one snapshot: the telemetry frame (wind,
+  // heel, heading), the GPS fix (RMC, VTG), pitch in degrees (NAN when
+  // unknown), the start line and the seconds to the start (NAN without a
+  // countdown). Returns the length of text()
+  size_t build(uint32_t now, const TelemetryFrame &frame, const NmeaFix &fix, float pitch,
+               const StartLineState &line, float timeToStart);
+
+  const char* text() const { return buffer; }   // NUL-terminated
+  size_t length() const { return used; }
+
+  uint32_t sentencesBuilt() const { return built; }
+  uint32_t sentencesDropped() const { return dropped; }   // Did not fit (a bug if ever non-zero)
+
+private:
+  NmeaSentence next() { return NmeaSentence(buffer + used, sizeof(buffer) - 1 - used); }
+  void finish(NmeaSentence &sentence);
+
+  void addWind(const TelemetryFrame &frame, TelemetryField angle, TelemetryField speed, char reference);
+  void addHeading(const TelemetryFrame &frame);
+  void addAttitude(const TelemetryFrame &frame, float pitch);
+  void addRmc(const NmeaFix &fix, bool fresh);
+  void addVtg(const NmeaFix &fix);
+  void addLine(const StartLineState &line, float timeToStart);
+
+  uint8_t enabled = NMEA_OUT_ALL;
+  char buffer[NMEA_OUTPUT_BUFFER];
+  size_t used = 0;
+  uint32_t built = 0;
+  uint32_t dropped = 0;
+};
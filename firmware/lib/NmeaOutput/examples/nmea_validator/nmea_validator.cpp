@@ -0,0 +1,299 @@
+// Host check for NmeaOutput: every sentence through an NMEA 0183 validator,
+// the values read back against the snapshot, RMC/VTG round-tripped through
+// NmeaParser, and the cost of building one snapshot.
+//
+// Build and run on the development machine (no Arduino dependencies):
+//   cd firmware/lib
+//   g++ -O2 -I NmeaOutput -I NmeaParser -I StartLine -I TelemetryCodec -I Geodesy
+//       NmeaOutput/NmeaOutput.cpp NmeaParser/NmeaParser.cpp
+//       NmeaOutput/examples/nmea_validator/nmea_validator.cpp -o nmea_validator
+//   ./nmea_validator [-v]
+//
+// The validator checks framing ('$' ... "*hh\r\n"), length (82 at most),
+// characters (printable, none of the reserved $ * ! \ ^ ~ in the body), the
+// checksum and the field count of each sentence type. -v prints the
+// sentences of a few snapshots. Exits 1 on any failure.
+
+#include <NmeaOutput.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+static size_t checked = 0;
+
+static void fail(const char* what, const std::string &sentence) {
+  if (failures < 20) printf("FAILED %s: %s", what, sentence.c_str());
+  failures++;
+}
+
+static std::vector<std::string> splitSentences(const char* text) {
+  std::vector<std::string> sentences;
+  const char* start = text;
+  while (*start) {
+    const char* end = strstr(start, "\r\n");
+    if (!end) {
+      sentences.push_back(start);
+      break;
+    }
+    sentences.push_back(std::string(start, end + 2));
+    start = end + 2;
+  }
+  return sentences;
+}
+
+static std::vector<std::string> splitFields(const std::string &body) {
+  std::vector<std::string> fields;
+  size_t start = 0;
+  for (;;) {
+    size_t comma = body.find(',', start);
+    fields.push_back(body.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+    if (comma == std::string::npos) break;
+    start = comma + 1;
+  }
+  return fields;
+}
+
+static int expectedFields(const std::string &address, size_t fields) {
+  if (address == "IIMWV") return 6;
+  if (address == "IIHDM") return 3;
+  if (address == "IIXDR") return (fields == 5 || fields == 9) ? (int)fields : 9;
+  if (address == "GPRMC") return 13;
+  if (address == "GPVTG") return 10;
+  if (address == "PVTR") return 7;
+  return -1;
+}
+
+// Framing, characters, checksum and field count; the fields on success
+static bool validate(const std::string &sentence, std::vector<std::string> &fields) {
+  checked++;
+  size_t n = sentence.size();
+  if (n > NMEA_SENTENCE_MAX) return fail("longer than 82 characters", sentence), false;
+  if (n < 9 || sentence[0] != '$' || sentence.compare(n - 2, 2, "\r\n") != 0 || sentence[n - 5] != '*') {
+    return fail("framing", sentence), false;
+  }
+  std::string body = sentence.substr(1, n - 6);
+  uint8_t checksum = 0;
+  for (char c : body) {
+    if (c < 0x20 || c > 0x7E || strchr("$*!\\^~", c)) return fail("reserved or control character", sentence), false;
+    checksum ^= (uint8_t)c;
+  }
+  char hex[3];
+  snprintf(hex, sizeof(hex), "%02X", checksum);
+  if (sentence.compare(n - 4, 2, hex) != 0) return fail("checksum", sentence), false;
+
+  fields = splitFields(body);
+  int expected = expectedFields(fields[0], fields.size());
+  if (expected < 0) return fail("unknown address", sentence), false;
+  if ((int)fields.size() != expected) return fail("field count", sentence), false;
+  return true;
+}
+
+static bool near(const std::string &field, double expected, double tolerance) {
+  if (field.empty()) return false;
+  char* end;
+  double value = strtod(field.c_str(), &end);
+  return *end == 0 && fabs(value - expected) <= tolerance;
+}
+
+struct Snapshot {
+  TelemetryFrame frame;
+  NmeaFix fix;
+  float pitch;
+  StartLineState line;
+  float timeToStart;
+  uint32_t now;
+};
+
+static float uniform(float low, float high) {
+  return low + (high - low) * rand() / (float)RAND_MAX;
+}
+
+static Snapshot randomSnapshot(int i) {
+  Snapshot s = {};
+  s.now = 100000 + i * 1000;
+  int32_t aws = rand() % 4000, awa = rand() % 36000;
+  if (i % 7 != 0) {
+    s.frame.set(TF_AWS, aws);
+    s.frame.set(TF_AWA, awa);
+  }
+  if (i % 5 != 0) {
+    s.frame.set(TF_TWS, rand() % 3500);
+    s.frame.set(TF_TWA, rand() % 36000);
+  }
+  if (i % 11 != 0) s.frame.set(TF_HDM, (rand() % 360) * 100);
+  if (i % 13 != 0) s.frame.set(TF_HEEL, rand() % 9000 - 4500);
+  s.pitch = i % 17 == 0 ? NAN : uniform(-20, 20);
+
+  // Positions all over the globe, now and then a hair below a whole degree
+  int32_t lat = (int32_t)(uniform(-89.9f, 89.9f) * GEO_E7);
+  int32_t lon = (int32_t)(uniform(-179.9f, 179.9f) * GEO_E7);
+  if (i % 9 == 0) lat = (lat / GEO_E7) * GEO_E7 + (lat >= 0 ? GEO_E7 - 1 : -(GEO_E7 - 1));
+  s.fix.position = {lat, lon};
+  s.fix.speed = rand() % 15000;
+  s.fix.course = (uint16_t)(rand() % 36000);
+  s.fix.hour = (uint8_t)(rand() % 24);
+  s.fix.minute = (uint8_t)(rand() % 60);
+  s.fix.second = (uint8_t)(rand() % 60);
+  s.fix.centisecond = (uint8_t)(rand() % 100);
+  s.fix.day = (uint8_t)(1 + rand() % 28);
+  s.fix.month = (uint8_t)(1 + rand() % 12);
+  s.fix.year = (uint16_t)(2000 + rand() % 100);
+  s.fix.valid = NMEA_POSITION | NMEA_SPEED | NMEA_COURSE | NMEA_TIME | NMEA_DATE;
+  s.fix.positionAt = s.now - (i % 19 == 0 ? NMEA_OUTPUT_FIX_MAX_AGE + 1 : rand() % 1000);
+  s.fix.timeAt = s.fix.positionAt;
+
+  if (i % 3 != 0) {
+    s.line.valid = true;
+    s.line.distance = uniform(-500, 50);
+    s.line.timeToLine = i % 4 == 0 ? NAN : uniform(0, 300);
+    s.line.timeToBurn = i % 4 == 0 ? NAN : uniform(-60, 120);
+    s.line.bias = i % 6 == 0 ? NAN : uniform(-30, 30);
+    s.timeToStart = i % 8 == 0 ? NAN : uniform(-30, 600);
+  } else {
+    s.timeToStart = NAN;
+  }
+  return s;
+}
+
+// Each sentence read back against the snapshot it was built from
+static void checkValues(const Snapshot &s, const std::vector<std::string> &f, const std::string &sentence) {
+  const std::string &address = f[0];
+  bool fresh = s.now - s.fix.positionAt <= NMEA_OUTPUT_FIX_MAX_AGE;
+  bool ok = true;
+  if (address == "IIMWV") {
+    bool apparent = f[2] == "R";
+    TelemetryField angle = apparent ? TF_AWA : TF_TWA, speed = apparent ? TF_AWS : TF_TWS;
+    double expectedAngle = s.frame.value[angle] / 100.0;
+    if (expectedAngle >= 359.95) expectedAngle -= 360.0;
+    ok = (apparent || f[2] == "T") && near(f[1], expectedAngle, 0.051) &&
+         near(f[3], s.frame.value[speed] / 100.0, 0.051) && f[4] == "N" && f[5] == "A";
+  } else if (address == "IIHDM") {
+    ok = near(f[1], s.frame.value[TF_HDM] / 100.0, 0.051) && f[2] == "M";
+  } else if (address == "IIXDR") {
+    size_t at = 1;
+    if (s.frame.has(TF_HEEL)) {
+      ok = f[at] == "A" && near(f[at + 1], s.frame.value[TF_HEEL] / 100.0, 0.051) && f[at + 2] == "D" &&
+           f[at + 3] == "ROLL";
+      at += 4;
+    }
+    if (!std::isnan(s.pitch)) {
+      ok = ok && at < f.size() && f[at] == "A" && near(f[at + 1], s.pitch, 0.051) && f[at + 3] == "PITCH";
+    }
+  } else if (address == "GPRMC") {
+    ok = f[2] == (fresh ? "A" : "V") && f[12] == (fresh ? "A" : "N");
+    if (fresh) {
+      double knots = s.fix.speed * 3.6 / 1852.0;
+      ok = ok && f[3].size() == 10 && f[5].size() == 11 && near(f[7], knots, 0.0051) &&
+           near(f[8], s.fix.course / 100.0, 0.001);
+    } else {
+      ok = ok && f[3].empty() && f[5].empty() && f[7].empty();
+    }
+  } else if (address == "GPVTG") {
+    ok = fresh && near(f[1], s.fix.course / 100.0, 0.001) && near(f[5], s.fix.speed * 3.6 / 1852.0, 0.0051) &&
+         near(f[7], s.fix.speed * 0.0036, 0.0051);
+  } else if (address == "PVTR") {
+    ok = f[1] == "LINE" && s.line.valid && near(f[2], s.line.distance, 0.051) &&
+         (std::isnan(s.line.timeToLine) ? f[3].empty() : near(f[3], s.line.timeToLine, 0.51)) &&
+         (std::isnan(s.line.timeToBurn) ? f[4].empty() : near(f[4], s.line.timeToBurn, 0.51)) &&
+         (std::isnan(s.timeToStart) ? f[5].empty() : near(f[5], s.timeToStart, 0.51)) &&
+         (std::isnan(s.line.bias) ? f[6].empty() : near(f[6], s.line.bias, 0.051));
+  }
+  if (!ok) fail("values", sentence);
+}
+
+// Feed the sentences to the GPS parser and compare its fix with the source
+static void checkRoundTrip(const Snapshot &s, const std::vector<std::string> &sentences) {
+  NmeaParser parser;
+  bool sawRmc = false;
+  for (const std::string &sentence : sentences) {
+    if (sentence.compare(1, 5, "GPRMC") == 0) sawRmc = true;
+    for (char c : sentence) parser.encode(s.now, c);
+  }
+  if (!sawRmc || s.now - s.fix.positionAt > NMEA_OUTPUT_FIX_MAX_AGE) return;
+  const NmeaFix &fix = parser.fix();
+  // ddmm.mmmmm is 1.7e-7 degrees: one unit each way
+  bool ok = fix.has(NMEA_POSITION | NMEA_SPEED | NMEA_COURSE | NMEA_TIME | NMEA_DATE) &&
+            abs(fix.position.lat - s.fix.position.lat) <= 1 && abs(fix.position.lon - s.fix.position.lon) <= 1 &&
+            abs(fix.speed - s.fix.speed) <= 3 && fix.course == s.fix.course && fix.hour == s.fix.hour &&
+            fix.minute == s.fix.minute && fix.second == s.fix.second && fix.centisecond == s.fix.centisecond &&
+            fix.day == s.fix.day && fix.month == s.fix.month && fix.year == s.fix.year;
+  if (!ok) {
+    std::string all;
+    for (const std::string &sentence : sentences) all += sentence;
+    fail("NmeaParser round trip", all);
+  }
+}
+
+int main(int argc, char** argv) {
+  bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+  srand(3);
+
+  // Fixed-point formatting at the edges
+  {
+    char buffer[NMEA_SENTENCE_MAX];
+    NmeaSentence sentence(buffer, sizeof(buffer));
+    sentence.begin("IIXXX");
+    sentence.addFixed(-3, 1);
+    sentence.addFixed(0, 2);
+    sentence.addFixed(5, 3, 2);
+    sentence.addCoordinate(-339999999, 2, 'N', 'S');
+    sentence.addCoordinate(1512500000, 3, 'E', 'W');
+    size_t length = sentence.end();
+    std::string text(buffer, length);
+    const char* expected = "$IIXXX,-0.3,0.00,00.005,3359.99999,S,15115.00000,E*";
+    if (text.compare(0, strlen(expected), expected) != 0) fail("formatting", text + "\r\n");
+
+    NmeaSentence tooLong(buffer, sizeof(buffer));
+    tooLong.begin("IIXXX");
+    for (int i = 0; i < 20; i++) tooLong.addText("ABCD");
+    if (tooLong.end() != 0) fail("sentence over 82 characters accepted", "\r\n");
+  }
+
+  const int snapshots = 20000;
+  NmeaOutput output;
+  size_t sentences = 0, bytes = 0;
+  for (int i = 0; i < snapshots; i++) {
+    Snapshot s = randomSnapshot(i);
+    output.setSentences(i % 23 == 0 ? (uint8_t)(rand() & NMEA_OUT_ALL) : (uint8_t)NMEA_OUT_ALL);
+    size_t length = output.build(s.now, s.frame, s.fix, s.pitch, s.line, s.timeToStart);
+    if (length != strlen(output.text())) fail("length", output.text());
+    if (verbose && i < 4) printf("%s\n", output.text());
+    std::vector<std::string> built = splitSentences(output.text());
+    for (const std::string &sentence : built) {
+      std::vector<std::string> fields;
+      if (validate(sentence, fields)) checkValues(s, fields, sentence);
+    }
+    if (output.sentences() & NMEA_OUT_RMC) checkRoundTrip(s, built);
+    sentences += built.size();
+    bytes += length;
+  }
+  printf("snapshots:         %d, %zu sentences, %.1f bytes per snapshot\n", snapshots, sentences,
+         (double)bytes / snapshots);
+  printf("validated:         %zu sentences, %d failures, %u dropped\n", checked, failures,
+         (unsigned)output.sentencesDropped());
+  if (output.sentencesDropped()) failures++;
+
+  // Cost of one full snapshot (all seven sentences)
+  Snapshot s = randomSnapshot(1);
+  s.line.timeToLine = 42;
+  output.setSentences(NMEA_OUT_ALL);
+  const int rounds = 200000;
+  size_t sink = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) {
+    s.frame.value[TF_AWA] = (r * 7) % 36000;
+    sink += output.build(s.now, s.frame, s.fix, s.pitch, s.line, s.timeToStart);
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  printf("build:             %.0f ns per snapshot (%zu bytes)\n",
+         std::chrono::duration<double, std::nano>(t1 - t0).count() / rounds, sink / rounds);
+
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,353 @@
+#include "NmeaParser.h"
+
+static const uint32_t POWERS_OF_TEN[10] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+};
+
+// The three characters after the talker, as packed in NmeaParser::address
+#define NMEA_ADDRESS(a, b, c) (((uint32_t)(a) << 16) | ((uint32_t)(b) << 8) | (uint32_t)(c))
+
+// Values that are only used together
+#define NMEA_PART_LAT      0x01
+#define NMEA_PART_NS       0x02
+#define NMEA_PART_LON      0x04
+#define NMEA_PART_EW       0x08
+#define NMEA_PART_QUALITY  0x10
+#define NMEA_PART_MODE     0x20
+#define NMEA_PART_PDOP     0x40
+#define NMEA_PART_VDOP     0x80
+#define NMEA_PART_POSITION (NMEA_PART_LAT | NMEA_PART_NS | NMEA_PART_LON | NMEA_PART_EW)
+#define NMEA_PART_DOP      (NMEA_PART_MODE | NMEA_PART_PDOP | NMEA_PART_VDOP)
+
+// Fields decoded per Sentence (bit n = field n), the others are only checksummed
+static const uint32_t DECODED_FIELDS[] = {
+  0,                                                // Other
+  0x3FE,                                            // RMC: 1-9
+  0x1FE,                                            // GGA: 1-8
+  (1 << 1) | (1 << 5) | (1 << 9),                   // VTG
+  (1 << 2) | (1 << 15) | (1 << 17),                 // GSA
+};
+
+static int8_t hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+bool NmeaParser::encode(uint32_t now, char c) {
+  chars++;
+  if (c == '$') {
+    beginSentence();
+    return false;
+  }
+
+  switch (state) {
+    case NMEA_BODY:
+      if ((uint8_t)(c - 0x20) > 0x7e - 0x20 || ++length > NMEA_MAX_SENTENCE) {
+        state = NMEA_IDLE;   // Line noise, or the end of the sentence was lost
+      } else if (c == ',') {
+        checksum ^= (uint8_t)c;
+        if (decoded) endField();
+        field++;
+        beginField();
+      } else if (c == '*') {
+        if (decoded) endField();
+        state = NMEA_CHECKSUM_HIGH;
+      } else {
+        checksum ^= (uint8_t)c;
+        if (field == 0) {
+          address = ((address << 8) | (uint8_t)c) & 0xFFFFFF;
+          fieldLength++;
+        } else if (decoded) {
+          addToField(c);
+        }
+      }
+      return false;
+
+    case NMEA_CHECKSUM_HIGH:
+    case NMEA_CHECKSUM_LOW: {
+      int8_t digit = hexValue(c);
+      if (digit < 0) {
+        failed++;
+        state = NMEA_IDLE;
+        return false;
+      }
+      if (state == NMEA_CHECKSUM_HIGH) {
+        received = (uint8_t)(digit << 4);
+        state = NMEA_CHECKSUM_LOW;
+        return false;
+      }
+      state = NMEA_IDLE;
+      if ((received | digit) != checksum) {
+        failed++;
+        return false;
+      }
+      passed++;
+      return commit(now);
+    }
+
+    default:
+      return false;
+  }
+}
+
+void NmeaParser::beginSentence() {
+  state = NMEA_BODY;
+  sentence = NMEA_OTHER;
+  address = 0;
+  length = 0;
+  checksum = 0;
+  pendingFields = 0;
+  parts = 0;
+  sentenceHasFix = false;
+  field = 0;
+  fieldLength = 0;
+  decoded = true;
+}
+
+void NmeaParser::beginField() {
+  decoded = field < 32 && (DECODED_FIELDS[sentence] >> field & 1);
+  if (!decoded) return;
+  fieldLength = 0;
+  whole = 0;
+  fraction = 0;
+  wholeDigits = 0;
+  fractionDigits = 0;
+  afterPoint = false;
+  fieldError = false;
+  letter = 0;
+}
+
+void NmeaParser::addToField(char c) {
+  uint8_t digit = (uint8_t)(c - '0');
+  if (digit <= 9) {
+    if (afterPoint) {
+      // Digits beyond the ninth decimal are below any resolution used here
+      if (fractionDigits < 9) {
+        fraction = fraction * 10 + digit;
+        fractionDigits++;
+      }
+    } else if (wholeDigits < 9) {
+      whole = whole * 10 + digit;
+      wholeDigits++;
+    } else {
+      fieldError = true;
+    }
+  } else if (c == '.' && !afterPoint) {
+    afterPoint = true;
+  } else if (fieldLength == 0) {
+    letter = c;
+  } else {
+    fieldError = true;
+  }
+  fieldLength++;
+}
+
+// The fractional digits as a number of `decimals` digits, rounded
+uint32_t NmeaParser::fractionScaled(uint8_t decimals) const {
+  if (fractionDigits > decimals) {
+    uint32_t divisor = POWERS_OF_TEN[fractionDigits - decimals];
+    return (fraction + divisor / 2) / divisor;
+  }
+  return fraction * POWERS_OF_TEN[decimals - fractionDigits];
+}
+
+// The field as an unsigned number with `decimals` implied decimals
+bool NmeaParser::fieldFixed(uint8_t decimals, uint32_t &value) const {
+  if (fieldError || letter || wholeDigits + fractionDigits == 0 || wholeDigits + decimals > 9) return false;
+  value = whole * POWERS_OF_TEN[decimals] + fractionScaled(decimals);
+  return true;
+}
+
+// (d)ddmm.mmmm to unsigned 1e-7 degrees
+bool NmeaParser::fieldCoordinate(uint8_t maxDegrees, int32_t &value) const {
+  if (fieldError || letter || wholeDigits < 3) return false;
+  uint32_t degrees = whole / 100;
+  uint32_t minutes = whole % 100;
+  if (degrees > maxDegrees || minutes >= 60) return false;
+  uint32_t minutesE7 = minutes * GEO_E7 + fractionScaled(7);
+  value = (int32_t)(degrees * GEO_E7 + (minutesE7 + 30) / 60);
+  return true;
+}
+
+// hhmmss.ss
+bool NmeaParser::fieldTime() {
+  if (fieldError || letter || wholeDigits != 6) return false;
+  uint8_t hour = (uint8_t)(whole / 10000);
+  uint8_t minute = (uint8_t)(whole / 100 % 100);
+  uint8_t second = (uint8_t)(whole % 100);
+  if (hour > 23 || minute > 59 || second > 60) return false;
+  uint32_t centisecond = fractionScaled(2);
+  pending.hour = hour;
+  pending.minute = minute;
+  pending.second = second;
+  pending.centisecond = (uint8_t)(centisecond > 99 ? 99 : centisecond);
+  return true;
+}
+
+// ddmmyy
+bool NmeaParser::fieldDate() {
+  if (fieldError || letter || wholeDigits != 6 || fractionDigits) return false;
+  uint8_t day = (uint8_t)(whole / 10000);
+  uint8_t month = (uint8_t)(whole / 100 % 100);
+  if (day < 1 || day > 31 || month < 1 || month > 12) return false;
+  pending.day = day;
+  pending.month = month;
+  pending.year = (uint16_t)(2000 + whole % 100);
+  return true;
+}
+
+void NmeaParser::endField() {
+  if (field == 0) {
+    if (fieldLength == 5) {
+      switch (address) {
+        case NMEA_ADDRESS('R', 'M', 'C'): sentence = NMEA_RMC; break;
+        case NMEA_ADDRESS('G', 'G', 'A'): sentence = NMEA_GGA; break;
+        case NMEA_ADDRESS('V', 'T', 'G'): sentence = NMEA_VTG; sentenceHasFix = true; break;
+        case NMEA_ADDRESS('G', 'S', 'A'): sentence = NMEA_GSA; break;
+        default: break;
+      }
+    }
+    return;
+  }
+
+  uint32_t value;
+  int32_t coordinate;
+
+  // Field numbers per sentence; the position fields of RMC are one further than GGA's
+  uint8_t positionField = sentence == NMEA_RMC ? field - 1 : field;
+  if ((sentence == NMEA_RMC || sentence == NMEA_GGA) && positionField >= 2 && positionField <= 5) {
+    switch (positionField) {
+      case 2:
+        if (fieldCoordinate(90, coordinate)) {
+          pending.position.lat = coordinate;
+          parts |= NMEA_PART_LAT;
+        }
+        break;
+      case 3:
+        if (letter == 'N' || letter == 'S') {
+          if (letter == 'S') pending.position.lat = -pending.position.lat;
+          parts |= NMEA_PART_NS;
+        }
+        break;
+      case 4:
+        if (fieldCoordinate(180, coordinate)) {
+          pending.position.lon = coordinate;
+          parts |= NMEA_PART_LON;
+        }
+        break;
+      case 5:
+        if (letter == 'E' || letter == 'W') {
+          if (letter == 'W') pending.position.lon = -pending.position.lon;
+          parts |= NMEA_PART_EW;
+        }
+        break;
+    }
+    return;
+  }
+
+  switch (sentence) {
+    case NMEA_RMC:
+      // 1 time, 2 status, 3-6 position, 7 speed (kn), 8 course, 9 date
+      if (field == 1 && fieldTime()) pendingFields |= NMEA_TIME;
+      else if (field == 2) sentenceHasFix = letter == 'A';
+      else if (field == 7 && fieldFixed(3, value)) {
+        pending.speed = (int32_t)(((uint64_t)value * 1852 + 1800) / 3600);
+        pendingFields |= NMEA_SPEED;
+      } else if (field == 8 && fieldFixed(2, value)) {
+        pending.course = (uint16_t)(value % 36000);
+        pendingFields |= NMEA_COURSE;
+      } else if (field == 9 && fieldDate()) {
+        pendingFields |= NMEA_DATE;
+      }
+      break;
+
+    case NMEA_GGA:
+      // 1 time, 2-5 position, 6 quality, 7 satellites, 8 HDOP
+      if (field == 1 && fieldTime()) pendingFields |= NMEA_TIME;
+      else if (field == 6 && fieldFixed(0, value)) {
+        pending.quality = (uint8_t)value;
+        sentenceHasFix = value > 0;
+        parts |= NMEA_PART_QUALITY;
+      } else if (field == 7 && fieldFixed(0, value)) {
+        pending.satellites = (uint8_t)(value > 255 ? 255 : value);
+        pendingFields |= NMEA_SATELLITES;
+      } else if (field == 8 && fieldFixed(2, value)) {
+        pending.hdop = (uint16_t)(value > 9999 ? 9999 : value);
+        pendingFields |= NMEA_HDOP;
+      }
+      break;
+
+    case NMEA_VTG:
+      // 1 course true, 3 course magnetic, 5 speed (kn), 7 speed (km/h), 9 mode (NMEA 2.3)
+      if (field == 1 && fieldFixed(2, value)) {
+        pending.course = (uint16_t)(value % 36000);
+        pendingFields |= NMEA_COURSE;
+      } else if (field == 5 && fieldFixed(3, value)) {
+        pending.speed = (int32_t)(((uint64_t)value * 1852 + 1800) / 3600);
+        pendingFields |= NMEA_SPEED;
+      } else if (field == 9 && letter == 'N') {
+        sentenceHasFix = false;
+      }
+      break;
+
+    case NMEA_GSA:
+      // 2 mode, 3-14 satellites, 15 PDOP, 16 HDOP, 17 VDOP
+      if (field == 2 && fieldFixed(0, value) && value >= 1 && value <= 3) {
+        pending.mode = (uint8_t)value;
+        parts |= NMEA_PART_MODE;
+      } else if (field == 15 && fieldFixed(2, value)) {
+        pending.pdop = (uint16_t)(value > 9999 ? 9999 : value);
+        parts |= NMEA_PART_PDOP;
+      } else if (field == 17 && fieldFixed(2, value)) {
+        pending.vdop = (uint16_t)(value > 9999 ? 9999 : value);
+        parts |= NMEA_PART_VDOP;
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+bool NmeaParser::commit(uint32_t now) {
+  if (sentence == NMEA_OTHER) return false;
+
+  uint16_t fields = pendingFields;
+  if ((parts & NMEA_PART_POSITION) == NMEA_PART_POSITION) fields |= NMEA_POSITION;
+  if ((parts & NMEA_PART_DOP) == NMEA_PART_DOP) fields |= NMEA_DOP;
+  if (parts & NMEA_PART_QUALITY) current.quality = pending.quality;
+
+  // Position and motion only count with a fix; time, satellites and DOP always do
+  if (!sentenceHasFix) fields &= (uint16_t)~(NMEA_POSITION | NMEA_SPEED | NMEA_COURSE);
+  else if (sentence == NMEA_RMC || sentence == NMEA_GGA) withFix++;
+
+  if (fields & NMEA_POSITION) {
+    current.position = pending.position;
+    current.positionAt = now;
+  }
+  if (fields & NMEA_SPEED) current.speed = pending.speed;
+  if (fields & NMEA_COURSE) current.course = pending.course;
+  if (fields & NMEA_DATE) {
+    current.day = pending.day;
+    current.month = pending.month;
+    current.year = pending.year;
+  }
+  if (fields & NMEA_TIME) {
+    current.hour = pending.hour;
+    current.minute = pending.minute;
+    current.second = pending.second;
+    current.centisecond = pending.centisecond;
+    current.timeAt = now;
+  }
+  if (fields & NMEA_SATELLITES) current.satellites = pending.satellites;
+  if (fields & NMEA_HDOP) current.hdop = pending.hdop;
+  if (fields & NMEA_DOP) {
+    current.mode = pending.mode;
+    current.pdop = pending.pdop;
+    current.vdop = pending.vdop;
+  }
+  current.valid |= fields;
+  return true;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdint.h>
+#include <Geodesy.h>
+
+// NMEA 0183 parser for the GPS UART, straight into fixed point.
+//
+// Only RMC, GGA, VTG and GSA are decoded (from any talker: GP, GN, GL...);
+// other sentences are checksummed and skipped. Characters are consumed as
+// they arrive: the checksum is accumulated on the way, and each field is
+// accumulated as integer whole and fractional digits and converted when its
+// comma arrives, so nothing is buffered and there is no floating point. The
+// values of a sentence are staged and only copied into the fix once its
+// checksum has matched.
+//
+// Like TinyGPS++, a value stays valid once received (a sentence without a
+// fix does not clear the last position); use the *At stamps for its age.
+
+#define NMEA_MAX_SENTENCE 120   // Characters between '$' and '*'; longer ones are dropped
+
+// NmeaFix::valid bits
+enum NmeaField : uint16_t {
+  NMEA_POSITION   = 1 << 0,   // RMC with status A, GGA with a fix quality
+  NMEA_SPEED      = 1 << 1,   // RMC with status A, VTG unless mode N
+  NMEA_COURSE     = 1 << 2,
+  NMEA_DATE       = 1 << 3,   // RMC
+  NMEA_TIME       = 1 << 4,   // RMC, GGA
+  NMEA_SATELLITES = 1 << 5,   // GGA
+  NMEA_HDOP       = 1 << 6,   // GGA
+  NMEA_DOP        = 1 << 7,   // GSA: pdop, vdop and mode
+};
+
+struct NmeaFix {
+  uint16_t valid;          // NmeaField bits received at least once
+  GeoPoint position;       // 1e-7 degrees
+  int32_t speed;           // Speed over ground in mm/s
+  uint16_t course;         // Course over ground, 1e-2 degrees true (0-35999)
+  uint8_t satellites;      // In use (GGA)
+  uint8_t quality;         // GGA fix quality: 0 none, 1 GPS, 2 DGPS, 4/5 RTK...
+  uint16_t hdop;           // 1e-2
+  uint16_t pdop;           // 1e-2 (GSA)
+  uint16_t vdop;           // 1e-2 (GSA)
+  uint8_t mode;            // GSA fix mode: 1 none, 2 2D, 3 3D
+  uint8_t day, month;      // UTC date
+  uint16_t year;
+  uint8_t hour, minute, second, centisecond;   // UTC time of the last RMC or GGA
+  uint32_t positionAt;     // `now` of the sentence that last set the position
+  uint32_t timeAt;         // `now` of the sentence that last set the time
+
+  bool has(uint16_t fields) const { return (valid & fields) == fields; }
+
+  // Conversions for display and filtering, outside the parser
+  float knots() const { return speed * (3.6f / 1852.0f); }
+  float courseDegrees() const { return course * 0.01f; }
+  float hdopValue() const { return hdop * 0.01f; }
+};
+
+class NmeaParser {
+public:
+  // One character from the UART; `now` (ms) stamps the values of the
+  // sentence it completes. True when it completed an RMC, GGA, VTG or GSA
+  // with a valid checksum
+  bool encode(uint32_t now, char c);
+
+  const NmeaFix &fix() const { return current; }
+
+  uint32_t charsProcessed() const { return chars; }
+  uint32_t passedChecksum() const { return passed; }
+  uint32_t failedChecksum() const { return failed; }
+  uint32_t sentencesWithFix() const { return withFix; }
+
+private:
+  enum State : uint8_t { NMEA_IDLE, NMEA_BODY, NMEA_CHECKSUM_HIGH, NMEA_CHECKSUM_LOW };
+  enum Sentence : uint8_t { NMEA_OTHER, NMEA_RMC, NMEA_GGA, NMEA_VTG, NMEA_GSA };
+
+  void beginSentence();
+  void beginField();
+  void addToField(char c);
+  void endField();
+  bool commit(uint32_t now);
+
+  uint32_t fractionScaled(uint8_t decimals) const;
+  bool fieldFixed(uint8_t decimals, uint32_t &value) const;
+  bool fieldCoordinate(uint8_t maxDegrees, int32_t &value) const;
+  bool fieldTime();
+  bool fieldDate();
+
+  NmeaFix current = {};
+  NmeaFix pending = {};       // Values of the sentence being received
+  uint16_t pendingFields = 0; // NmeaField bits set in `pending`
+  uint8_t parts = 0;          // Values that only count together (NMEA_PART_*)
+  bool sentenceHasFix = false;
+
+  State state = NMEA_IDLE;
+  Sentence sentence = NMEA_OTHER;
+  uint32_t address = 0;       // Last three characters of the address field
+  uint8_t length = 0;
+  uint8_t checksum = 0;
+  uint8_t received = 0;
+
+  // Field being received
+  uint8_t field = 0;
+  bool decoded = false;       // Field 0 (address) or one of DECODED_FIELDS
+  uint8_t fieldLength = 0;
+  uint32_t whole = 0;
+  uint32_t fraction = 0;
+  uint8_t wholeDigits = 0;
+  uint8_t fractionDigits = 0;
+  bool afterPoint = false;
+  bool fieldError = false;
+  char letter = 0;            // First character when it is not numeric
+
+  uint32_t chars = 0;
+  uint32_t passed = 0;
+  uint32_t failed = 0;
+  uint32_t withFix = 0;
+};
@@ -0,0 +1,226 @@
+// Host benchmark for NmeaParser against TinyGPS++: same fixes, and the cost
+// of parsing a stream and reading each fix.
+//
+// Build and run on the development machine, with TinyGPS++ as installed for
+// the native environment (`pio run -e native` from the repository root):
+//   cd firmware/lib
+//   g++ -O2 -DARDUINO=100 -I NmeaParser -I Geodesy -I ../src/native/shim -I ../../.pio/libdeps/native/TinyGPSPlus/src
+//       NmeaParser/NmeaParser.cpp ../../.pio/libdeps/native/TinyGPSPlus/src/TinyGPS++.cpp
+//       NmeaParser/examples/nmea_benchmark/nmea_benchmark.cpp -o nmea_benchmark
+//   ./nmea_benchmark [session.nmea]
+//
+// The file is a GPS UART capture as taken by the replay harness (--nmea):
+// one sentence per line, optionally after "<ms><TAB or comma>". Without a
+// file a synthetic 1 Hz RMC/GGA/VTG/GSA/GSV session with a few corrupted
+// sentences is generated. Exits 1 when a fix differs.
+
+#include <NmeaParser.h>
+#include <TinyGPS++.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// TinyGPS++ truncates speed, course and HDOP to 2 decimals and positions to
+// 1e-9 degrees; NmeaParser rounds to its units
+#define POSITION_TOLERANCE 1     // 1e-7 degrees
+#define SPEED_TOLERANCE 6        // mm/s (0.01 kn)
+#define HUNDREDTHS_TOLERANCE 1   // Course and HDOP
+
+static uint32_t benchmarkNow = 0;
+unsigned long millis() { return benchmarkNow; }
+unsigned long micros() { return benchmarkNow * 1000; }
+
+static std::vector<std::string> loadNmea(const char* path) {
+  std::vector<std::string> sentences;
+  FILE* file = fopen(path, "r");
+  if (!file) return sentences;
+  char line[512];
+  while (fgets(line, sizeof(line), file)) {
+    line[strcspn(line, "\r\n")] = 0;
+    const char* sentence = strchr(line, '$');
+    if (sentence) sentences.push_back(std::string(sentence) + "\r\n");
+  }
+  fclose(file);
+  return sentences;
+}
+
+static void addSentence(std::vector<std::string> &sentences, const char* body) {
+  uint8_t checksum = 0;
+  for (const char* c = body; *c; c++) checksum ^= (uint8_t)*c;
+  char sentence[160];
+  snprintf(sentence, sizeof(sentence), "$%s*%02X\r\n", body, checksum);
+  sentences.push_back(sentence);
+}
+
+// Degrees to NMEA (d)ddmm.mmmmm and hemisphere
+static void formatCoordinate(char* out, size_t size, double value, int degreeDigits, char positive, char negative) {
+  double magnitude = fabs(value);
+  int degrees = (int)magnitude;
+  double minutes = (magnitude - degrees) * 60.0;
+  snprintf(out, size, "%0*d%08.5f,%c", degreeDigits, degrees, minutes, value < 0 ? negative : positive);
+}
+
+static std::vector<std::string> synthesize(int seconds) {
+  std::vector<std::string> sentences;
+  double lat = -33.85, lon = 151.25, course = 40;
+  char body[160], latText[32], lonText[32];
+  srand(7);
+  for (int t = 0; t < seconds; t++) {
+    if (t % 90 == 0) course = fmod(course + 95, 360);
+    double knots = 5.5 + 0.5 * sin(t / 30.0) + (rand() % 100) / 1000.0;
+    double metres = knots * 1852 / 3600;
+    lat += metres * cos(course * M_PI / 180) / 111000.0;
+    lon -= metres * sin(course * M_PI / 180) / 92500.0;
+    bool fix = t % 600 > 5;   // A short loss of fix every 10 minutes
+    formatCoordinate(latText, sizeof(latText), lat, 2, 'N', 'S');
+    formatCoordinate(lonText, sizeof(lonText), lon, 3, 'E', 'W');
+    int hh = 10 + t / 3600, mm = t / 60 % 60, ss = t % 60;
+    int satellites = 7 + rand() % 5;
+    double hdop = 0.7 + (rand() % 80) / 100.0;
+
+    snprintf(body, sizeof(body), "GPRMC,%02d%02d%02d.00,%c,%s,%s,%.3f,%.2f,150326,,,%c", hh, mm, ss, fix ? 'A' : 'V',
+             latText, lonText, knots, course, fix ? 'A' : 'N');
+    addSentence(sentences, body);
+    snprintf(body, sizeof(body), "GPVTG,%.2f,T,,M,%.3f,N,%.3f,K,%c", course, knots, knots * 1.852, fix ? 'A' : 'N');
+    addSentence(sentences, body);
+    snprintf(body, sizeof(body), "GPGGA,%02d%02d%02d.00,%s,%s,%d,%02d,%.2f,42.1,M,20.3,M,,", hh, mm, ss, latText, lonText,
+             fix ? 1 : 0, satellites, hdop);
+    addSentence(sentences, body);
+    snprintf(body, sizeof(body), "GNGSA,A,%d,02,05,07,13,15,18,20,24,,,,,%.2f,%.2f,%.2f", fix ? 3 : 1, hdop * 1.6, hdop,
+             hdop * 1.3);
+    addSentence(sentences, body);
+    for (int page = 1; page <= 3; page++) {
+      snprintf(body, sizeof(body), "GPGSV,3,%d,11,%02d,61,214,42,%02d,45,061,38,%02d,22,301,33,%02d,09,145,21", page,
+               page * 4, page * 4 + 1, page * 4 + 2, page * 4 + 3);
+      addSentence(sentences, body);
+    }
+    // Line noise: one sentence in 200 loses a character
+    if (rand() % 200 == 0) sentences.back().erase(10, 1);
+  }
+  return sentences;
+}
+
+struct Mismatches {
+  size_t position = 0, speed = 0, course = 0, satellites = 0, hdop = 0, time = 0, date = 0;
+  size_t total() const { return position + speed + course + satellites + hdop + time + date; }
+};
+
+static int32_t toE7(const RawDegrees &raw) {
+  int32_t value = (int32_t)raw.deg * GEO_E7 + (int32_t)((raw.billionths + 50) / 100);
+  return raw.negative ? -value : value;
+}
+
+// Feed both parsers sentence by sentence and compare what TinyGPS++ updated
+static Mismatches compare(const std::vector<std::string> &sentences, NmeaParser &parser, TinyGPSPlus &gps) {
+  Mismatches m;
+  for (size_t i = 0; i < sentences.size(); i++) {
+    benchmarkNow = (uint32_t)i;
+    for (char c : sentences[i]) {
+      parser.encode(benchmarkNow, c);
+      gps.encode(c);
+    }
+    const NmeaFix &fix = parser.fix();
+    if (gps.location.isUpdated()) {
+      GeoPoint expected = {toE7(gps.location.rawLat()), toE7(gps.location.rawLng())};
+      if (!fix.has(NMEA_POSITION) || abs(fix.position.lat - expected.lat) > POSITION_TOLERANCE ||
+          abs(fix.position.lon - expected.lon) > POSITION_TOLERANCE) {
+        m.position++;
+      }
+    }
+    if (gps.speed.isUpdated()) {
+      int32_t expected = (int32_t)lround(gps.speed.knots() * 1852000.0 / 3600.0);
+      if (!fix.has(NMEA_SPEED) || abs(fix.speed - expected) > SPEED_TOLERANCE) m.speed++;
+    }
+    if (gps.course.isUpdated()) {
+      int32_t expected = gps.course.value() % 36000;
+      if (!fix.has(NMEA_COURSE) || abs((int32_t)fix.course - expected) > HUNDREDTHS_TOLERANCE) m.course++;
+    }
+    if (gps.satellites.isUpdated() && (!fix.has(NMEA_SATELLITES) || fix.satellites != gps.satellites.value())) {
+      m.satellites++;
+    }
+    if (gps.hdop.isUpdated() && (!fix.has(NMEA_HDOP) || abs((int32_t)fix.hdop - gps.hdop.value()) > HUNDREDTHS_TOLERANCE)) {
+      m.hdop++;
+    }
+    if (gps.time.isUpdated()) {
+      if (!fix.has(NMEA_TIME) || fix.hour != gps.time.hour() || fix.minute != gps.time.minute() ||
+          fix.second != gps.time.second() || fix.centisecond != gps.time.centisecond()) {
+        m.time++;
+      }
+    }
+    if (gps.date.isUpdated()) {
+      if (!fix.has(NMEA_DATE) || fix.day != gps.date.day() || fix.month != gps.date.month() ||
+          fix.year != gps.date.year()) {
+        m.date++;
+      }
+    }
+  }
+  return m;
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  printf("%-34s %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok) failures++;
+}
+
+int main(int argc, char** argv) {
+  std::vector<std::string> sentences = argc > 1 ? loadNmea(argv[1]) : synthesize(3600);
+  if (sentences.empty()) {
+    fprintf(stderr, "No sentences in %s\n", argv[1]);
+    return 1;
+  }
+  std::string stream;
+  for (const std::string &sentence : sentences) stream += sentence;
+  printf("stream:            %zu sentences, %zu bytes%s\n", sentences.size(), stream.size(),
+         argc > 1 ? "" : " (synthetic)");
+
+  NmeaParser parser;
+  TinyGPSPlus gps;
+  Mismatches m = compare(sentences, parser, gps);
+  printf("checksums:         %u ok, %u bad (TinyGPS++: %u ok, %u bad)\n", (unsigned)parser.passedChecksum(),
+         (unsigned)parser.failedChecksum(), (unsigned)gps.passedChecksum(), (unsigned)gps.failedChecksum());
+  printf("mismatches:        position %zu, speed %zu, course %zu, satellites %zu, hdop %zu, time %zu, date %zu\n",
+         m.position, m.speed, m.course, m.satellites, m.hdop, m.time, m.date);
+  check(m.total() == 0, "fixes match TinyGPS++");
+  check(parser.failedChecksum() == gps.failedChecksum(), "same sentences rejected");
+
+  // Parse the whole stream and read each new fix the way the pipeline does:
+  // position, speed and course
+  const int rounds = 20;
+  double sink = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) {
+    NmeaParser p;
+    for (char c : stream) {
+      if (p.encode(0, c)) {
+        const NmeaFix &fix = p.fix();
+        sink += fix.position.lat + fix.position.lon + fix.knots() + fix.course;
+      }
+    }
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) {
+    TinyGPSPlus g;
+    for (char c : stream) {
+      if (g.encode(c)) {
+        sink += g.location.lat() + g.location.lng() + g.speed.knots() + g.course.deg();
+      }
+    }
+  }
+  auto t2 = std::chrono::steady_clock::now();
+  double bytes = (double)stream.size() * rounds;
+  printf("NmeaParser:        %.2f ns per byte, %.0f ns per sentence\n",
+         std::chrono::duration<double, std::nano>(t1 - t0).count() / bytes,
+         std::chrono::duration<double, std::nano>(t1 - t0).count() / (sentences.size() * rounds));
+  printf("TinyGPS++:         %.2f ns per byte, %.0f ns per sentence (checksum %.0f)\n",
+         std::chrono::duration<double, std::nano>(t2 - t1).count() / bytes,
+         std::chrono::duration<double, std::nano>(t2 - t1).count() / (sentences.size() * rounds), sink);
+
+  return failures ? 1 : 0;
+}
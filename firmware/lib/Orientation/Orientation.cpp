@@ -0,0 +1,150 @@
+#include "Orientation.h"
+
+#include <math.h>
+
+static const float DEGREES_TO_RADIANS = (float)M_PI / 180.0f;
+
+// Signed difference a - b of two angles in degrees, -180..180
+static float angleDiff(float a, float b) {
+  float d = a - b;
+  if (d > 180.0f) d -= 360.0f;
+  if (d < -180.0f) d += 360.0f;
+  return d;
+}
+
+Quaternion Quaternion::operator*(const Quaternion &q) const {
+  return Quaternion(w * q.w - x * q.x - y * q.y - z * q.z,
+                    w * q.x + x * q.w + y * q.z - z * q.y,
+                    w * q.y - x * q.z + y * q.w + z * q.x,
+                    w * q.z + x * q.y - y * q.x + z * q.w);
+}
+
+Quaternion Quaternion::normalized() const {
+  float norm = sqrtf(w * w + x * x + y * y + z * z);
+  if (!(norm > 0)) return Quaternion();
+  return Quaternion(w / norm, x / norm, y / norm, z / norm);
+}
+
+void Quaternion::rotate(float &vx, float &vy, float &vz) const {
+  // v + 2w (u x v) + 2 u x (u x v), u = (x, y, z)
+  float tx = 2.0f * (y * vz - z * vy);
+  float ty = 2.0f * (z * vx - x * vz);
+  float tz = 2.0f * (x * vy - y * vx);
+  float rx = vx + w * tx + (y * tz - z * ty);
+  float ry = vy + w * ty + (z * tx - x * tz);
+  float rz = vz + w * tz + (x * ty - y * tx);
+  vx = rx;
+  vy = ry;
+  vz = rz;
+}
+
+Quaternion Quaternion::tilt() const {
+  // Heading of the x axis (the Euler yaw) as cos/sin, then as a half-angle
+  // turn about the vertical, with square roots only
+  float c = 1.0f - 2.0f * (y * y + z * z);
+  float s = 2.0f * (w * z + x * y);
+  float norm = sqrtf(c * c + s * s);
+  if (!(norm > 0)) return *this;   // x axis vertical: no heading to take out
+  c /= norm;
+  s /= norm;
+  float halfCos = sqrtf((1.0f + c) / 2.0f);
+  float halfSin = halfCos > 1e-6f ? s / (2.0f * halfCos) : 1.0f;
+  return Quaternion(halfCos, 0, 0, -halfSin) * *this;
+}
+
+Quaternion Quaternion::aboutX(float degrees) {
+  float half = degrees * DEGREES_TO_RADIANS / 2.0f;
+  return Quaternion(cosf(half), sinf(half), 0, 0);
+}
+
+void Orientation::setPeakWindow(uint8_t seconds) {
+  if (seconds < 1) seconds = 1;
+  if (seconds > ORIENTATION_PEAK_SLOTS) seconds = ORIENTATION_PEAK_SLOTS;
+  window = seconds;
+}
+
+void Orientation::clear() {
+  hasSample = false;
+  slotsStarted = false;
+  current = Attitude();
+  sensorQuat = Quaternion();
+  sensorTilt = Quaternion();
+}
+
+void Orientation::update(uint32_t now, const Quaternion &sensor) {
+  sensorQuat = sensor.normalized();
+  sensorTilt = sensorQuat.tilt();
+  Quaternion q = sensorQuat * levelReference.conjugate();
+
+  // The only trig per report
+  float heel = atan2f(2.0f * (q.w * q.x + q.y * q.z), 1.0f - 2.0f * (q.x * q.x + q.y * q.y)) / DEGREES_TO_RADIANS;
+  float sinPitch = 2.0f * (q.w * q.y - q.z * q.x);
+  if (sinPitch > 1.0f) sinPitch = 1.0f;
+  if (sinPitch < -1.0f) sinPitch = -1.0f;
+  float pitch = asinf(sinPitch) / DEGREES_TO_RADIANS;
+  float yaw = atan2f(2.0f * (q.w * q.z + q.x * q.y), 1.0f - 2.0f * (q.y * q.y + q.z * q.z)) / DEGREES_TO_RADIANS;
+  if (yaw < 0) yaw += 360.0f;
+
+  uint32_t gap = now - lastTime;
+  if (hasSample && gap > 0 && gap <= ORIENTATION_MAX_GAP_MS) {
+    float perSecond = 1000.0f / gap;
+    current.heelRate = angleDiff(heel, current.heel) * perSecond;
+    current.pitchRate = (pitch - current.pitch) * perSecond;
+    current.yawRate = angleDiff(yaw, current.yaw) * perSecond;
+  } else {
+    current.heelRate = 0;
+    current.pitchRate = 0;
+    current.yawRate = 0;
+  }
+  current.heel = heel;
+  current.pitch = pitch;
+  current.yaw = yaw;
+  lastTime = now;
+  hasSample = true;
+  sampleCount++;
+
+  uint32_t second = now / 1000;
+  advanceSlots(second);
+  uint8_t slot = second % ORIENTATION_PEAK_SLOTS;
+  if (isnan(slotMax[slot]) || heel > slotMax[slot]) slotMax[slot] = heel;
+  if (isnan(slotMin[slot]) || heel < slotMin[slot]) slotMin[slot] = heel;
+}
+
+void Orientation::advanceSlots(uint32_t second) {
+  // Empty the slots of the seconds passed since the newest; all of them on
+  // the first report, after a long gap or when the clock went back (a wrap)
+  uint32_t steps = slotsStarted ? second - slotSecond : ORIENTATION_PEAK_SLOTS;
+  if (steps >= ORIENTATION_PEAK_SLOTS) {
+    for (uint8_t slot = 0; slot < ORIENTATION_PEAK_SLOTS; slot++) {
+      slotMax[slot] = NAN;
+      slotMin[slot] = NAN;
+    }
+  } else {
+    for (uint32_t i = 1; i <= steps; i++) {
+      uint8_t slot = (slotSecond + i) % ORIENTATION_PEAK_SLOTS;
+      slotMax[slot] = NAN;
+      slotMin[slot] = NAN;
+    }
+  }
+  slotSecond = second;
+  slotsStarted = true;
+}
+
+float Orientation::peak(uint32_t now, bool highest) const {
+  if (!slotsStarted) return NAN;
+  uint32_t age = now / 1000 - slotSecond;
+  float result = NAN;
+  for (uint32_t i = 0; age + i < window; i++) {
+    uint8_t slot = (slotSecond + ORIENTATION_PEAK_SLOTS - i) % ORIENTATION_PEAK_SLOTS;
+    result = highest ? fmaxf(result, slotMax[slot]) : fminf(result, slotMin[slot]);
+  }
+  return result;
+}
+
+float Orientation::heelMax(uint32_t now) const {
+  return peak(now, true);
+}
+
+float Orientation::heelMin(uint32_t now) const {
+  return peak(now, false);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdint.h>
+
+// Vessel attitude from the IMU's rotation vector.
+//
+// Every report goes through update() once: the sensor quaternion is turned
+// into the vessel's by the stored level reference (the sensor orientation
+// recorded with the boat level, so a tilted mount reads zero), then heel,
+// pitch and yaw are taken from it with one atan2/asin/atan2 each. Rates come
+// from consecutive reports and the heel extremes from one-second slots, so
+// everything downstream (true wind, compass, the app) reads the same numbers
+// without any further trig.
+//
+// Conventions: heel is the rotation about the fore-aft (x) axis, pitch + =
+// bow up, yaw 0..360 in the sensor's own reference (not a heading: the
+// compass is SensorPipeline's).
+
+#define ORIENTATION_MAX_GAP_MS 1000    // Longer between reports is not a rate
+#define ORIENTATION_PEAK_SLOTS 60      // Peak heel window of up to 60 s, in 1 s slots
+#define ORIENTATION_PEAK_WINDOW 10     // Default peak heel window, seconds
+
+struct Quaternion {
+  float w = 1, x = 0, y = 0, z = 0;
+
+  Quaternion() {}
+  Quaternion(float w, float x, float y, float z) : w(w), x(x), y(y), z(z) {}
+
+  Quaternion operator*(const Quaternion &q) const;
+  Quaternion conjugate() const { return Quaternion(w, -x, -y, -z); }
+  // Unit length; identity for a zero quaternion
+  Quaternion normalized() const;
+  // Rotate a vector by this (unit) quaternion, in place
+  void rotate(float &vx, float &vy, float &vz) const;
+  // The tilt part: this rotation with the heading of its x axis taken out
+  // (pitch and roll of a yaw-pitch-roll decomposition)
+  Quaternion tilt() const;
+
+  // Rotation of `degrees` about the fore-aft axis (a heel)
+  static Quaternion aboutX(float degrees);
+};
+
+struct Attitude {
+  float heel = 0;        // Degrees about the fore-aft axis
+  float pitch = 0;       // Degrees, + = bow up
+  float yaw = 0;         // Degrees 0..360
+  float heelRate = 0;    // Degrees per second between the last two reports
+  float pitchRate = 0;
+  float yawRate = 0;
+};
+
+class Orientation {
+public:
+  Orientation() { clear(); }
+
+  // Sensor orientation that counts as level; applied from the next report
+  void setReference(const Quaternion &level) { levelReference = level.normalized(); }
+  const Quaternion &reference() const { return levelReference; }
+
+  // Peak heel window in seconds (1..ORIENTATION_PEAK_SLOTS)
+  void setPeakWindow(uint8_t seconds);
+  uint8_t peakWindow() const { return window; }
+
+  // One rotation vector report taken at `now` (ms)
+  void update(uint32_t now, const Quaternion &sensor);
+  // Forget the reports so far (sensor lost); keeps the reference and window
+  void clear();
+
+  bool valid() const { return hasSample; }
+  uint32_t sampleTime() const { return lastTime; }
+  uint32_t samples() const { return sampleCount; }
+  const Attitude &attitude() const { return current; }
+  // Last report as the sensor gave it (normalized)
+  const Quaternion &sensor() const { return sensorQuat; }
+
+  // A reference that makes the last report level (its tilt only, so the
+  // mount's yaw stays in yaw)
+  Quaternion levelHere() const { return sensorQuat.tilt(); }
+
+  // Rotate a vector in sensor axes (the magnetometer) into the horizontal
+  // plane of the sensor's own reference
+  void toHorizontal(float &x, float &y, float &z) const { sensorTilt.rotate(x, y, z); }
+
+  // Extremes of heel over the peak window, NAN without reports in it
+  float heelMax(uint32_t now) const;
+  float heelMin(uint32_t now) const;
+
+private:
+  void advanceSlots(uint32_t second);
+  float peak(uint32_t now, bool highest) const;
+
+  Quaternion levelReference;
+  Quaternion sensorQuat;
+  Quaternion sensorTilt;
+  Attitude current;
+  uint32_t lastTime = 0;
+  uint32_t sampleCount = 0;
+  bool hasSample = false;
+
+  // Per-second heel extremes, slot = second % ORIENTATION_PEAK_SLOTS
+  float slotMax[ORIENTATION_PEAK_SLOTS];
+  float slotMin[ORIENTATION_PEAK_SLOTS];
+  uint32_t slotSecond = 0;   // Second (now / 1000) of the newest slot
+  bool slotsStarted = false;
+  uint8_t window = ORIENTATION_PEAK_WINDOW;
+};
@@ -0,0 +1,218 @@
+// Host check for Orientation: heel, pitch and yaw against the yaw-pitch-roll
+// rotations they were built from, the tilt part against the compass field,
+// a tilted mount levelled by its reference, rates across north, peak heel
+// against the raw samples of the window, and the cost per report.
+//
+// Build and run on the development machine (no Arduino dependencies):
+//   cd firmware/lib
+//   g++ -O2 -I Orientation Orientation/Orientation.cpp
+//       Orientation/examples/orientation_check/orientation_check.cpp -o orientation_check
+//   ./orientation_check
+//
+// Exits 1 on a mismatch.
+
+#include <Orientation.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#define ANGLE_TOLERANCE 0.02f   // Degrees
+#define RATE_TOLERANCE 0.05f    // Degrees per second
+
+static float angleDiff(float a, float b) {
+  float d = fmodf(a - b, 360.0f);
+  if (d >= 180.0f) d -= 360.0f;
+  if (d < -180.0f) d += 360.0f;
+  return d;
+}
+
+static Quaternion about(double degrees, double ax, double ay, double az) {
+  double half = degrees * M_PI / 360.0;
+  return Quaternion((float)cos(half), (float)(ax * sin(half)), (float)(ay * sin(half)), (float)(az * sin(half)));
+}
+
+// Yaw about z, then pitch about y, then roll (heel) about x
+static Quaternion fromEuler(double yaw, double pitch, double heel) {
+  return about(yaw, 0, 0, 1) * about(pitch, 0, 1, 0) * about(heel, 1, 0, 0);
+}
+
+static bool close(const Attitude &a, float heel, float pitch, float yaw, float &worst) {
+  float error = fmaxf(fabsf(angleDiff(a.heel, heel)), fmaxf(fabsf(a.pitch - pitch), fabsf(angleDiff(a.yaw, yaw))));
+  worst = fmaxf(worst, error);
+  return error <= ANGLE_TOLERANCE;
+}
+
+// Every 10 degrees of yaw and heel, pitch short of straight up
+static int checkEuler() {
+  int failures = 0;
+  float worst = 0;
+  Orientation orientation;
+  for (int yaw = 0; yaw < 360; yaw += 10) {
+    for (int pitch = -80; pitch <= 80; pitch += 10) {
+      for (int heel = -170; heel <= 170; heel += 10) {
+        orientation.update(0, fromEuler(yaw, pitch, heel));
+        if (!close(orientation.attitude(), heel, pitch, yaw, worst) && failures++ < 5) {
+          const Attitude &a = orientation.attitude();
+          printf("yaw %d pitch %d heel %d: %.2f %.2f %.2f\n", yaw, pitch, heel, a.yaw, a.pitch, a.heel);
+        }
+      }
+    }
+  }
+  printf("heel/pitch/yaw from the quaternion:  worst %.4f deg %s\n", worst, failures ? "FAILED" : "ok");
+  return failures;
+}
+
+// The tilt part keeps pitch and heel and levels the field for the compass
+static int checkTilt() {
+  int failures = 0;
+  float worstTilt = 0, worstHeading = 0;
+  const float north = 20.0f, down = -40.0f;   // World field, uT
+  for (int yaw = 0; yaw < 360; yaw += 15) {
+    for (int pitch = -60; pitch <= 60; pitch += 15) {
+      for (int heel = -60; heel <= 60; heel += 15) {
+        Quaternion q = fromEuler(yaw, pitch, heel);
+        Orientation orientation;
+        orientation.update(0, q);
+        Orientation tilt;
+        tilt.update(0, q.tilt());
+        worstTilt = fmaxf(worstTilt, fabsf(tilt.attitude().heel - heel));
+        worstTilt = fmaxf(worstTilt, fabsf(tilt.attitude().pitch - pitch));
+        worstTilt = fmaxf(worstTilt, fabsf(angleDiff(tilt.attitude().yaw, 0)));
+
+        // The field as the sensor sees it, then back to the horizontal
+        float mx = north, my = 0, mz = down;
+        q.conjugate().rotate(mx, my, mz);
+        orientation.toHorizontal(mx, my, mz);
+        float heading = atan2f(my, mx) * 180.0f / (float)M_PI;
+        worstHeading = fmaxf(worstHeading, fabsf(angleDiff(heading, -(float)yaw)));
+      }
+    }
+  }
+  if (worstTilt > ANGLE_TOLERANCE || worstHeading > ANGLE_TOLERANCE) failures++;
+  printf("tilt part: pitch/heel kept within %.4f deg, compass within %.4f deg %s\n", worstTilt, worstHeading,
+         failures ? "FAILED" : "ok");
+  return failures;
+}
+
+// A sensor mounted 6 deg nose up and 4 deg to port, levelled at the dock
+static int checkMount() {
+  int failures = 0;
+  float worst = 0;
+  Quaternion mount = about(6, 0, 1, 0) * about(-4, 1, 0, 0);
+  Orientation orientation;
+  orientation.update(0, about(123, 0, 0, 1) * mount);
+  orientation.setReference(orientation.levelHere());
+  for (int yaw = 0; yaw < 360; yaw += 30) {
+    for (int pitch = -15; pitch <= 15; pitch += 5) {
+      for (int heel = -45; heel <= 45; heel += 5) {
+        orientation.update(0, fromEuler(yaw, pitch, heel) * mount);
+        if (!close(orientation.attitude(), heel, pitch, yaw, worst) && failures++ < 5) {
+          const Attitude &a = orientation.attitude();
+          printf("mount, yaw %d pitch %d heel %d: %.2f %.2f %.2f\n", yaw, pitch, heel, a.yaw, a.pitch, a.heel);
+        }
+      }
+    }
+  }
+
+  // A heel offset from before the reference: heel minus the offset
+  Orientation legacy;
+  legacy.setReference(Quaternion::aboutX(5.0f));
+  legacy.update(0, Quaternion::aboutX(20.0f));
+  if (fabsf(legacy.attitude().heel - 15.0f) > ANGLE_TOLERANCE) failures++;
+  printf("tilted mount levelled:               worst %.4f deg, heel offset %.3f %s\n", worst,
+         legacy.attitude().heel, failures ? "FAILED" : "ok");
+  return failures;
+}
+
+// Rates between 20 Hz reports, through north, and none across a gap
+static int checkRates() {
+  int failures = 0;
+  float worst = 0;
+  Orientation orientation;
+  const double amplitude = 15, omega = 2 * M_PI * 0.2;   // 15 deg of roll every 5 s
+  for (uint32_t t = 0; t <= 20000; t += 50) {
+    double s = t / 1000.0;
+    double yaw = fmod(350 + 10 * s, 360);   // 10 deg/s through north
+    orientation.update(t, fromEuler(yaw, 3 * sin(omega * s), amplitude * sin(omega * s)));
+    if (t == 0) continue;
+    // A difference is the derivative half a report back
+    double middle = s - 0.025;
+    const Attitude &a = orientation.attitude();
+    float heelError = fabsf(a.heelRate - (float)(amplitude * omega * cos(omega * middle)));
+    float pitchError = fabsf(a.pitchRate - (float)(3 * omega * cos(omega * middle)));
+    float yawError = fabsf(a.yawRate - 10.0f);
+    worst = fmaxf(worst, fmaxf(heelError, fmaxf(pitchError, yawError)));
+  }
+  if (worst > RATE_TOLERANCE) failures++;
+  orientation.update(20000 + ORIENTATION_MAX_GAP_MS + 50, fromEuler(0, 0, 30));
+  if (orientation.attitude().heelRate != 0) failures++;
+  printf("rates at 20 Hz, yaw through north:   worst %.4f deg/s, %s after a gap %s\n", worst,
+         orientation.attitude().heelRate == 0 ? "none" : "some", failures ? "FAILED" : "ok");
+  return failures;
+}
+
+struct Report {
+  uint32_t time;
+  float heel;
+};
+
+// Peak heel against the samples of the last `window` whole seconds
+static int checkPeaks() {
+  int failures = 0;
+  Orientation orientation;
+  std::vector<Report> reports;
+  uint32_t checked = 0;
+  for (uint32_t t = 0; t <= 300000; t += 50) {
+    if (t >= 100000 && t < 170000) continue;   // IMU lost for 70 s
+    if (t == 200000) orientation.setPeakWindow(30);
+    if (t == 250000) orientation.setPeakWindow(1);
+    double s = t / 1000.0;
+    float heel = (float)(20 * sin(s / 7) + 8 * sin(s * 1.3));
+    orientation.update(t, Quaternion::aboutX(heel));
+    reports.push_back({t, orientation.attitude().heel});
+
+    for (uint32_t now = t; now < t + 50; now += 25) {
+      uint32_t second = now / 1000, window = orientation.peakWindow();
+      float high = NAN, low = NAN;
+      for (auto r = reports.rbegin(); r != reports.rend() && second - r->time / 1000 < window; ++r) {
+        high = fmaxf(high, r->heel);
+        low = fminf(low, r->heel);
+      }
+      float gotHigh = orientation.heelMax(now), gotLow = orientation.heelMin(now);
+      bool match = (std::isnan(high) ? std::isnan(gotHigh) : gotHigh == high) && (std::isnan(low) ? std::isnan(gotLow) : gotLow == low);
+      if (!match && failures++ < 5) {
+        printf("peaks at %u ms (window %u s): %.2f/%.2f, expected %.2f/%.2f\n", now, window, gotHigh, gotLow, high,
+               low);
+      }
+      checked++;
+    }
+  }
+  // Nothing in the window once the reports stop
+  if (!std::isnan(orientation.heelMax(300000 + 2000))) failures++;
+  printf("peak heel over 10, 30 and 1 s:       %u checks %s\n", checked, failures ? "FAILED" : "ok");
+  return failures;
+}
+
+int main() {
+  int failures = checkEuler();
+  failures += checkTilt();
+  failures += checkMount();
+  failures += checkRates();
+  failures += checkPeaks();
+
+  Orientation orientation;
+  const int reports = 1000000;
+  volatile float sink = 0;   // Keeps the loop from being optimized out
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < reports; i++) {
+    orientation.update((uint32_t)i * 50, fromEuler(i % 360, 10 * sin(i / 40.0), 25 * sin(i / 60.0)));
+    sink += orientation.attitude().heel;
+  }
+  double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / reports;
+  printf("update: %.3f us per report (building the quaternion included)\n", us);
+
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,198 @@
+#include "PolarTable.h"
+
+#include <math.h>
+#include <string.h>
+
+static const float DEGREES_TO_RADIANS = (float)M_PI / 180.0f;
+
+uint32_t polarCrc32(const uint8_t* data, size_t length, uint32_t crc) {
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+static uint16_t read16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+// 0-360 (or any turn) to degrees off the wind, 0-180
+static float foldAngle(float angle) {
+  angle = fmodf(angle, 360.0f);
+  if (angle < 0) angle += 360.0f;
+  return angle > 180.0f ? 360.0f - angle : angle;
+}
+
+// Position of `value` on an uploaded axis with an implicit 0 in front of
+// it: index -1 is that zero, t the fraction from `index` to `index + 1`
+static void axisPosition(const uint16_t* axis, uint8_t count, float value, int &index, float &t) {
+  if (!(value > 0)) value = 0;
+  if (value < axis[0]) {
+    index = -1;
+    t = value / axis[0];
+    return;
+  }
+  if (value >= axis[count - 1]) {
+    index = count - 2;
+    t = 1.0f;
+    return;
+  }
+  int i = 0;
+  while (value >= axis[i + 1]) i++;
+  index = i;
+  t = (value - axis[i]) / (float)(axis[i + 1] - axis[i]);
+}
+
+// Position on a uniform grid axis, clamped to its ends
+static void gridPosition(float value, float step, int count, int &index, float &t) {
+  float x = value / step;
+  if (!(x > 0)) {
+    index = 0;
+    t = 0;
+    return;
+  }
+  if (x >= count - 1) {
+    index = count - 2;
+    t = 1.0f;
+    return;
+  }
+  index = (int)x;
+  t = x - index;
+}
+
+static PolarTarget lerpTarget(const PolarTarget &a, const PolarTarget &b, float t) {
+  PolarTarget out;
+  out.twa = a.twa + (b.twa - a.twa) * t;
+  out.speed = a.speed + (b.speed - a.speed) * t;
+  out.vmg = a.vmg + (b.vmg - a.vmg) * t;
+  return out;
+}
+
+bool PolarTable::load(const uint8_t* blob, size_t length) {
+  if (length < sizeof(PolarHeader)) return false;
+  PolarHeader header;
+  memcpy(&header, blob, sizeof(header));
+  if (header.magic != POLAR_MAGIC || header.version != POLAR_VERSION) return false;
+  if (header.twsCount < 2 || header.twsCount > POLAR_MAX_TWS) return false;
+  if (header.twaCount < 2 || header.twaCount > POLAR_MAX_TWA) return false;
+  size_t expected = sizeof(PolarHeader) +
+                    ((size_t)header.twsCount + header.twaCount + header.twsCount * header.twaCount) * 2;
+  if (length != expected) return false;
+
+  const uint8_t* p = blob + sizeof(PolarHeader);
+  uint16_t newTws[POLAR_MAX_TWS];
+  uint16_t newTwa[POLAR_MAX_TWA];
+  for (int i = 0; i < header.twsCount; i++, p += 2) {
+    newTws[i] = read16(p);
+    if (i > 0 && newTws[i] <= newTws[i - 1]) return false;
+  }
+  for (int i = 0; i < header.twaCount; i++, p += 2) {
+    newTwa[i] = read16(p);
+    if (i > 0 && newTwa[i] <= newTwa[i - 1]) return false;
+  }
+  if (newTwa[header.twaCount - 1] > 1800) return false;
+
+  twsColumns = header.twsCount;
+  twaRows = header.twaCount;
+  memcpy(tws, newTws, twsColumns * sizeof(uint16_t));
+  memcpy(twa, newTwa, twaRows * sizeof(uint16_t));
+  for (int row = 0; row < twaRows; row++) {
+    for (int column = 0; column < twsColumns; column++, p += 2) {
+      speed[row][column] = read16(p);
+    }
+  }
+  buildGrid();
+  loaded = true;
+  return true;
+}
+
+float PolarTable::interpolate(float trueWindSpeed, float trueWindAngle) const {
+  if (!twsColumns) return 0;
+  int column, row;
+  float tc, tr;
+  axisPosition(tws, twsColumns, trueWindSpeed * 10.0f, column, tc);
+  axisPosition(twa, twaRows, foldAngle(trueWindAngle) * 10.0f, row, tr);
+
+  auto at = [&](int r, int c) -> float {
+    return (r < 0 || c < 0) ? 0.0f : (float)speed[r][c];
+  };
+  float low = at(row, column) + (at(row, column + 1) - at(row, column)) * tc;
+  float high = at(row + 1, column) + (at(row + 1, column + 1) - at(row + 1, column)) * tc;
+  return (low + (high - low) * tr) / 100.0f;
+}
+
+void PolarTable::buildGrid() {
+  for (int row = 0; row < POLAR_GRID_TWA_COUNT; row++) {
+    for (int column = 0; column < POLAR_GRID_TWS_COUNT; column++) {
+      float value = interpolate(column * POLAR_GRID_TWS_STEP, row * POLAR_GRID_TWA_STEP);
+      grid[row][column] = (uint16_t)lroundf(value * 100.0f);
+    }
+  }
+
+  // Best VMG per column from the uploaded surface; the downwind scan starts
+  // at 180 so a flat (zero) column reports dead downwind
+  int steps = (int)lroundf(180.0f / POLAR_TARGET_SCAN_STEP);
+  for (int column = 0; column < POLAR_GRID_TWS_COUNT; column++) {
+    float windSpeed = column * POLAR_GRID_TWS_STEP;
+    PolarTarget up = {0, 0, 0};
+    PolarTarget down = {180.0f, 0, 0};
+    for (int i = 0; i <= steps; i++) {
+      float upAngle = i * POLAR_TARGET_SCAN_STEP;
+      float upSpeed = interpolate(windSpeed, upAngle);
+      float upVmg = upSpeed * cosf(upAngle * DEGREES_TO_RADIANS);
+      if (upVmg > up.vmg) up = {upAngle, upSpeed, upVmg};
+
+      float downAngle = 180.0f - upAngle;
+      float downSpeed = interpolate(windSpeed, downAngle);
+      float downVmg = -downSpeed * cosf(downAngle * DEGREES_TO_RADIANS);
+      if (downVmg > down.vmg) down = {downAngle, downSpeed, downVmg};
+    }
+    upwind[column] = up;
+    downwind[column] = down;
+  }
+}
+
+float PolarTable::targetSpeed(float trueWindSpeed, float trueWindAngle) const {
+  if (!loaded) return 0;
+  int column, row;
+  float tc, tr;
+  gridPosition(trueWindSpeed, POLAR_GRID_TWS_STEP, POLAR_GRID_TWS_COUNT, column, tc);
+  gridPosition(foldAngle(trueWindAngle), POLAR_GRID_TWA_STEP, POLAR_GRID_TWA_COUNT, row, tr);
+
+  const uint16_t* low = grid[row];
+  const uint16_t* high = grid[row + 1];
+  float a = low[column] + (low[column + 1] - low[column]) * tc;
+  float b = high[column] + (high[column + 1] - high[column]) * tc;
+  return (a + (b - a) * tr) / 100.0f;
+}
+
+PolarTarget PolarTable::upwindTarget(float trueWindSpeed) const {
+  if (!loaded) return {0, 0, 0};
+  int column;
+  float t;
+  gridPosition(trueWindSpeed, POLAR_GRID_TWS_STEP, POLAR_GRID_TWS_COUNT, column, t);
+  return lerpTarget(upwind[column], upwind[column + 1], t);
+}
+
+PolarTarget PolarTable::downwindTarget(float trueWindSpeed) const {
+  if (!loaded) return {180.0f, 0, 0};
+  int column;
+  float t;
+  gridPosition(trueWindSpeed, POLAR_GRID_TWS_STEP, POLAR_GRID_TWS_COUNT, column, t);
+  return lerpTarget(downwind[column], downwind[column + 1], t);
+}
+
+void PolarTable::evaluate(float trueWindSpeed, float trueWindAngle, float speedOverGround,
+                          PolarPerformance &out) const {
+  float angle = foldAngle(trueWindAngle);
+  out.vmg = speedOverGround * cosf(angle * DEGREES_TO_RADIANS);
+  out.targetSpeed = targetSpeed(trueWindSpeed, angle);
+  out.percent = out.targetSpeed > 0.1f ? speedOverGround / out.targetSpeed * 100.0f : NAN;
+  out.upwind = upwindTarget(trueWindSpeed);
+  out.downwind = downwindTarget(trueWindSpeed);
+  out.targetVmg = angle < 90.0f ? out.upwind.vmg : -out.downwind.vmg;
+}
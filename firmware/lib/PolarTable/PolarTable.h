@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Boat polar: target boat speed by true wind speed and angle.
+//
+// The table is uploaded as a compact little-endian blob (kept as-is in NVS):
+//
+//   PolarHeader                       8 bytes
+//   uint16 tws[twsCount]              True wind speed columns, 0.1 knots, increasing
+//   uint16 twa[twaCount]              True wind angle rows, 0.1 degrees, increasing, <= 180
+//   uint16 speed[twaCount][twsCount]  Boat speed, 0.01 knots, row by row
+//
+// Between the uploaded points the speed is bilinear in TWS and TWA. Below
+// the first column or row it falls linearly to zero at 0 knots / 0 degrees,
+// above the last one it is held. load() resamples that surface onto a
+// uniform grid and finds the best upwind and downwind VMG for every grid
+// column, so a lookup per sample is a few multiplies without any search.
+
+#define POLAR_MAGIC 0x4C4F5056  // "VPOL"
+#define POLAR_VERSION 1
+#define POLAR_MAX_TWS 16
+#define POLAR_MAX_TWA 32
+#define POLAR_MAX_BLOB_SIZE (sizeof(PolarHeader) + (POLAR_MAX_TWS + POLAR_MAX_TWA + POLAR_MAX_TWS * POLAR_MAX_TWA) * 2)
+
+// Lookup grid: 0-40 knots in 1 knot steps, 0-180 degrees in 2 degree steps
+#define POLAR_GRID_TWS_STEP 1.0f
+#define POLAR_GRID_TWS_COUNT 41
+#define POLAR_GRID_TWA_STEP 2.0f
+#define POLAR_GRID_TWA_COUNT 91
+#define POLAR_TARGET_SCAN_STEP 0.5f  // TWA resolution of the VMG search at load()
+
+struct __attribute__((packed)) PolarHeader {
+  uint32_t magic;      // POLAR_MAGIC
+  uint8_t version;     // POLAR_VERSION
+  uint8_t twsCount;    // 2..POLAR_MAX_TWS
+  uint8_t twaCount;    // 2..POLAR_MAX_TWA
+  uint8_t reserved;
+};
+
+// Best VMG point at a given wind speed
+struct PolarTarget {
+  float twa;     // Degrees off the wind, 0-180
+  float speed;   // Boat speed in knots
+  float vmg;     // Speed towards (upwind) or away from (downwind) the wind, knots
+};
+
+// Per-sample performance against the polar
+struct PolarPerformance {
+  float vmg;           // SOG * cos(TWA), positive upwind, negative downwind
+  float targetSpeed;   // Polar speed at the current TWS and TWA
+  float percent;       // SOG as a percentage of targetSpeed, NAN when the target is ~0
+  float targetVmg;     // Best VMG on the current side (upwind below 90 degrees TWA), signed like vmg
+  PolarTarget upwind;
+  PolarTarget downwind;
+};
+
+// CRC-32 (IEEE 802.3) of an upload, checked before the blob is accepted
+uint32_t polarCrc32(const uint8_t* data, size_t length, uint32_t crc = 0);
+
+class PolarTable {
+public:
+  // Validate a blob and rebuild the grid; an invalid blob leaves the table unchanged
+  bool load(const uint8_t* blob, size_t length);
+  void clear() { loaded = false; }
+
+  bool isLoaded() const { return loaded; }
+  uint8_t twsCount() const { return twsColumns; }
+  uint8_t twaCount() const { return twaRows; }
+  float maxTws() const { return tws[twsColumns - 1] / 10.0f; }
+
+  // Speed from the uploaded points (reference for the grid, not for every sample)
+  float interpolate(float trueWindSpeed, float trueWindAngle) const;
+
+  // Grid lookups; TWA may be 0-360 (folded to 0-180)
+  float targetSpeed(float trueWindSpeed, float trueWindAngle) const;
+  PolarTarget upwindTarget(float trueWindSpeed) const;
+  PolarTarget downwindTarget(float trueWindSpeed) const;
+
+  void evaluate(float trueWindSpeed, float trueWindAngle, float speedOverGround, PolarPerformance &out) const;
+
+private:
+  void buildGrid();
+
+  bool loaded = false;
+  uint8_t twsColumns = 0;
+  uint8_t twaRows = 0;
+  uint16_t tws[POLAR_MAX_TWS];
+  uint16_t twa[POLAR_MAX_TWA];
+  uint16_t speed[POLAR_MAX_TWA][POLAR_MAX_TWS];
+
+  uint16_t grid[POLAR_GRID_TWA_COUNT][POLAR_GRID_TWS_COUNT];  // 0.01 knots
+  PolarTarget upwind[POLAR_GRID_TWS_COUNT];
+  PolarTarget downwind[POLAR_GRID_TWS_COUNT];
+};
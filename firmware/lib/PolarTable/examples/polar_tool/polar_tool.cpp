@@ -0,0 +1,258 @@
+// Host tool for PolarTable: converts a polar to the upload blob and checks
+// the on-device interpolation against the uploaded points.
+//
+// Build and run on the development machine (no Arduino dependencies):
+//   cd firmware/lib/PolarTable
+//   g++ -O2 -I . PolarTable.cpp examples/polar_tool/polar_tool.cpp -o polar_tool
+//   ./polar_tool [polar.csv] [--out polar.bin]
+//
+// The polar is the usual table: a header row "twa/tws;6;8;10;..." with the
+// true wind speeds in knots, then one row per true wind angle in degrees
+// with the boat speeds in knots (separated by ';', ',', tabs or spaces).
+// Without a file a built-in 20 ft keelboat polar is used.
+//
+// Checks: node values are reproduced, grid lookups stay within
+// GRID_TOLERANCE_KN of the bilinear surface, VMG targets match a fine
+// brute-force search, and malformed blobs are rejected. Exits 1 on failure.
+
+#include <PolarTable.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define GRID_TOLERANCE_KN 0.05f   // Grid resampling and 0.01 kn quantisation
+#define TARGET_TOLERANCE_KN 0.01f
+
+struct Polar {
+  std::vector<double> tws;
+  std::vector<double> twa;
+  std::vector<std::vector<double>> speed;  // [twa][tws]
+};
+
+static const char* SAMPLE_POLAR =
+  "twa/tws;6;8;10;12;14;16;20\n"
+  "38;3.9;4.7;5.3;5.6;5.8;5.9;6.0\n"
+  "45;4.5;5.3;5.8;6.1;6.2;6.3;6.4\n"
+  "52;4.9;5.7;6.1;6.3;6.5;6.6;6.7\n"
+  "60;5.2;5.9;6.3;6.6;6.7;6.8;6.9\n"
+  "75;5.4;6.1;6.5;6.8;7.0;7.1;7.3\n"
+  "90;5.4;6.2;6.7;7.0;7.3;7.5;7.8\n"
+  "110;5.3;6.1;6.7;7.2;7.6;8.0;8.7\n"
+  "120;5.0;5.9;6.6;7.1;7.6;8.1;9.2\n"
+  "135;4.4;5.4;6.2;6.8;7.3;7.8;9.0\n"
+  "150;3.7;4.7;5.6;6.3;6.9;7.4;8.4\n"
+  "165;3.3;4.3;5.2;5.9;6.5;7.0;7.9\n"
+  "180;3.1;4.1;4.9;5.6;6.2;6.7;7.6\n";
+
+static bool parseRow(const char* line, std::vector<double> &values, bool skipLabel) {
+  values.clear();
+  const char* p = line;
+  bool first = true;
+  while (*p) {
+    while (*p == ';' || *p == ',' || *p == '\t' || *p == ' ') p++;
+    if (!*p || *p == '\r' || *p == '\n') break;
+    char* end;
+    double value = strtod(p, &end);
+    if (end == p) {
+      if (!(first && skipLabel)) return false;
+      while (*p && *p != ';' && *p != ',' && *p != '\t' && *p != ' ') p++;  // Label cell
+    } else {
+      values.push_back(value);
+      p = end;
+    }
+    first = false;
+  }
+  return !values.empty();
+}
+
+static bool parsePolar(const char* text, Polar &polar) {
+  std::vector<double> values;
+  bool header = true;
+  const char* line = text;
+  while (*line) {
+    const char* next = strchr(line, '\n');
+    std::string row(line, next ? next - line : strlen(line));
+    line = next ? next + 1 : line + row.size();
+    if (row.empty() || row[0] == '#' || row[0] == '\r') continue;
+    if (!parseRow(row.c_str(), values, header)) return false;
+    if (header) {
+      polar.tws = values;
+      header = false;
+      continue;
+    }
+    if (values.size() != polar.tws.size() + 1) return false;
+    polar.twa.push_back(values[0]);
+    polar.speed.push_back(std::vector<double>(values.begin() + 1, values.end()));
+  }
+  return !polar.tws.empty() && !polar.twa.empty();
+}
+
+static void put16(std::vector<uint8_t> &blob, double value, double scale) {
+  long scaled = lround(value * scale);
+  if (scaled < 0) scaled = 0;
+  if (scaled > 65535) scaled = 65535;
+  blob.push_back((uint8_t)(scaled & 0xFF));
+  blob.push_back((uint8_t)(scaled >> 8));
+}
+
+static std::vector<uint8_t> buildBlob(const Polar &polar) {
+  PolarHeader header = {POLAR_MAGIC, POLAR_VERSION, (uint8_t)polar.tws.size(), (uint8_t)polar.twa.size(), 0};
+  std::vector<uint8_t> blob((const uint8_t*)&header, (const uint8_t*)&header + sizeof(header));
+  for (double tws : polar.tws) put16(blob, tws, 10);
+  for (double twa : polar.twa) put16(blob, twa, 10);
+  for (const std::vector<double> &row : polar.speed) {
+    for (double speed : row) put16(blob, speed, 100);
+  }
+  return blob;
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  printf("%-34s %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok) failures++;
+}
+
+int main(int argc, char** argv) {
+  const char* input = nullptr;
+  const char* output = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+      output = argv[++i];
+    } else {
+      input = argv[i];
+    }
+  }
+
+  std::string text = SAMPLE_POLAR;
+  if (input) {
+    FILE* file = fopen(input, "rb");
+    if (!file) {
+      fprintf(stderr, "Cannot open %s\n", input);
+      return 1;
+    }
+    text.clear();
+    char buffer[512];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) text.append(buffer, n);
+    fclose(file);
+  }
+
+  Polar polar;
+  if (!parsePolar(text.c_str(), polar)) {
+    fprintf(stderr, "Cannot parse polar (header row of TWS, then TWA and one speed per TWS)\n");
+    return 1;
+  }
+  std::vector<uint8_t> blob = buildBlob(polar);
+  static PolarTable table;  // ~9 KB, keep it off the stack
+  if (!table.load(blob.data(), blob.size())) {
+    fprintf(stderr, "Polar rejected: %zu TWS x %zu TWA (max %d x %d, axes increasing, TWA <= 180)\n",
+            polar.tws.size(), polar.twa.size(), POLAR_MAX_TWS, POLAR_MAX_TWA);
+    return 1;
+  }
+
+  printf("table:             %zu TWS x %zu TWA\n", polar.tws.size(), polar.twa.size());
+  printf("blob:              %zu bytes, crc 0x%08lx\n", blob.size(),
+         (unsigned long)polarCrc32(blob.data(), blob.size()));
+  if (output) {
+    FILE* file = fopen(output, "wb");
+    if (!file || fwrite(blob.data(), 1, blob.size(), file) != blob.size()) {
+      fprintf(stderr, "Cannot write %s\n", output);
+      return 1;
+    }
+    fclose(file);
+    printf("written:           %s\n", output);
+  }
+
+  // Uploaded points come back exactly (up to the 0.01 kn storage unit)
+  double nodeError = 0;
+  for (size_t r = 0; r < polar.twa.size(); r++) {
+    for (size_t c = 0; c < polar.tws.size(); c++) {
+      double error = fabs(table.interpolate(polar.tws[c], polar.twa[r]) - polar.speed[r][c]);
+      if (error > nodeError) nodeError = error;
+    }
+  }
+  printf("node error:        %.4f kn\n", nodeError);
+  check(nodeError <= 0.0051, "nodes reproduced");
+
+  // Grid lookup against the bilinear surface over the table's range
+  srand(7);
+  double gridMax = 0, gridSum = 0;
+  const int samples = 200000;
+  double maxTws = polar.tws.back() * 1.1;
+  for (int i = 0; i < samples; i++) {
+    float tws = (float)(maxTws * rand() / RAND_MAX);
+    float twa = (float)(360.0 * rand() / RAND_MAX);
+    double error = fabs(table.targetSpeed(tws, twa) - table.interpolate(tws, twa));
+    gridSum += error;
+    if (error > gridMax) gridMax = error;
+  }
+  printf("grid error:        %.4f kn max, %.4f kn mean\n", gridMax, gridSum / samples);
+  check(gridMax <= GRID_TOLERANCE_KN, "grid within tolerance");
+
+  // VMG targets at the grid columns against a 0.1 degree search
+  bool targetsOk = true;
+  for (int knots = 0; knots < POLAR_GRID_TWS_COUNT; knots++) {
+    double bestUp = 0, bestDown = 0;
+    for (int tenth = 0; tenth <= 1800; tenth++) {
+      double angle = tenth / 10.0;
+      double vmg = table.interpolate((float)knots, (float)angle) * cos(angle * M_PI / 180.0);
+      if (vmg > bestUp) bestUp = vmg;
+      if (-vmg > bestDown) bestDown = -vmg;
+    }
+    PolarTarget up = table.upwindTarget((float)knots);
+    PolarTarget down = table.downwindTarget((float)knots);
+    if (fabs(up.vmg - bestUp) > TARGET_TOLERANCE_KN || fabs(down.vmg - bestDown) > TARGET_TOLERANCE_KN) {
+      targetsOk = false;
+    }
+  }
+  check(targetsOk, "VMG targets match search");
+
+  printf("\n  TWS   up TWA  speed   VMG   down TWA  speed   VMG\n");
+  for (double tws : polar.tws) {
+    PolarTarget up = table.upwindTarget((float)tws);
+    PolarTarget down = table.downwindTarget((float)tws);
+    printf("%5.1f   %6.1f  %5.2f  %4.2f   %8.1f  %5.2f  %4.2f\n", tws, up.twa, up.speed, up.vmg, down.twa,
+           down.speed, down.vmg);
+  }
+  printf("\n");
+
+  // Malformed uploads are refused and keep the loaded table
+  PolarTable scratch;
+  std::vector<uint8_t> bad = blob;
+  bad[0] ^= 0xFF;
+  bool rejected = !scratch.load(bad.data(), bad.size());
+  rejected &= !scratch.load(blob.data(), blob.size() - 1);
+  bad = blob;
+  bad[sizeof(PolarHeader) + 2] = bad[sizeof(PolarHeader)];  // Second TWS equal to the first
+  bad[sizeof(PolarHeader) + 3] = bad[sizeof(PolarHeader) + 1];
+  rejected &= !scratch.load(bad.data(), bad.size());
+  check(rejected && !scratch.isLoaded(), "malformed blobs rejected");
+
+  // Cost of the per-sample evaluation
+  const int iterations = 1000000;
+  std::vector<float> winds(1024), angles(1024), speeds(1024);
+  for (size_t i = 0; i < winds.size(); i++) {
+    winds[i] = (float)(maxTws * rand() / RAND_MAX);
+    angles[i] = (float)(360.0 * rand() / RAND_MAX);
+    speeds[i] = (float)(8.0 * rand() / RAND_MAX);
+  }
+  PolarPerformance performance;
+  double sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    size_t k = i & 1023;
+    table.evaluate(winds[k], angles[k], speeds[k], performance);
+    sink += performance.targetVmg;
+  }
+  auto end = std::chrono::steady_clock::now();
+  printf("evaluate:          %.0f ns/sample (checksum %.0f)\n",
+         std::chrono::duration<double, std::nano>(end - start).count() / iterations, sink);
+
+  return failures ? 1 : 0;
+}
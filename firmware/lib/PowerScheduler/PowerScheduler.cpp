@@ -0,0 +1,60 @@
+#include "PowerScheduler.h"
+
+const char* powerModeName(PowerMode mode) {
+  switch (mode) {
+    case POWER_ACTIVE: return "active";
+    case POWER_MOORED: return "moored";
+  }
+  return "unknown";
+}
+
+bool PowerScheduler::update(uint32_t now, bool moving, size_t clients, bool busy) {
+  PowerMode next = currentMode;
+  if (moving || clients > 0 || busy) {
+    lastActivity = now;
+    next = POWER_ACTIVE;
+  } else if (now - lastActivity >= config.mooredAfterMs) {
+    next = POWER_MOORED;
+  }
+
+  if (next == currentMode) return false;
+  currentMode = next;
+  changes++;
+  return true;
+}
+
+uint32_t PowerScheduler::refreshInterval(uint32_t activeIntervalMs) const {
+  if (currentMode == POWER_MOORED && config.mooredRefreshMs > activeIntervalMs) {
+    return config.mooredRefreshMs;
+  }
+  return activeIntervalMs;
+}
+
+uint32_t PowerScheduler::waitBudget(uint32_t now, uint32_t deadline) const {
+  int32_t remaining = (int32_t)(deadline - now);
+  if (remaining <= 0) return 0;
+  uint32_t cap = currentMode == POWER_MOORED ? config.mooredPollMs : config.activePollMs;
+  return (uint32_t)remaining < cap ? (uint32_t)remaining : cap;
+}
+
+void PowerScheduler::recordAwake(uint32_t us) {
+  awakeUs += us;
+  decay();
+}
+
+void PowerScheduler::recordWait(uint32_t us) {
+  waitUs += us;
+  decay();
+}
+
+float PowerScheduler::dutyCycle() const {
+  uint64_t total = awakeUs + waitUs;
+  return total ? (float)((double)awakeUs / total) : 1.0f;
+}
+
+// Halve both totals once they span the window, so old passes fade out
+void PowerScheduler::decay() {
+  if (awakeUs + waitUs < POWER_DUTY_WINDOW_US) return;
+  awakeUs /= 2;
+  waitUs /= 2;
+}
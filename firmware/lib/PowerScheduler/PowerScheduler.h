@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Power policy for the refresh loop.
+//
+// ACTIVE runs the full sensor refresh at the configured rate and keeps the
+// chip out of light sleep, because the GPS UART loses bytes while asleep.
+// After mooredAfterMs with no movement, no connected client and nothing else
+// going on, the scheduler switches to MOORED: the full refresh (wind, IMU,
+// notify, session log) slows to mooredRefreshMs, the GPS UART is only
+// drained every mooredPollMs and light sleep is allowed in between. Any
+// client, movement or activity returns to ACTIVE on the next update().
+//
+// The loop reports how long it worked and how long it waited, which gives
+// the duty cycle over roughly the last POWER_DUTY_WINDOW_US.
+
+#define POWER_DUTY_WINDOW_US 10000000UL
+
+enum PowerMode : uint8_t {
+  POWER_ACTIVE = 0,
+  POWER_MOORED = 1,
+};
+
+struct PowerConfig {
+  uint32_t mooredAfterMs = 120000;   // Quiet time before slowing down
+  uint32_t mooredRefreshMs = 10000;  // Full refresh interval while moored
+  uint32_t activePollMs = 50;        // Longest wait while active (button debounce, LED)
+  uint32_t mooredPollMs = 1000;      // Longest wait while moored (GPS UART drain)
+};
+
+const char* powerModeName(PowerMode mode);
+
+class PowerScheduler {
+public:
+  explicit PowerScheduler(const PowerConfig &config = PowerConfig()) : config(config) {}
+
+  // Call once per loop pass; returns true when the mode changed
+  bool update(uint32_t now, bool moving, size_t clients, bool busy);
+
+  PowerMode mode() const { return currentMode; }
+  uint32_t modeChanges() const { return changes; }
+
+  // Full refresh interval for the current mode
+  uint32_t refreshInterval(uint32_t activeIntervalMs) const;
+
+  // How long the loop may wait for `deadline`, capped at the mode's poll interval
+  uint32_t waitBudget(uint32_t now, uint32_t deadline) const;
+
+  // Duty cycle bookkeeping, in microseconds
+  void recordAwake(uint32_t us);
+  void recordWait(uint32_t us);
+  float dutyCycle() const;  // Fraction of time awake, 0..1
+
+private:
+  void decay();
+
+  PowerConfig config;
+  PowerMode currentMode = POWER_ACTIVE;
+  uint32_t lastActivity = 0;
+  uint32_t changes = 0;
+  uint64_t awakeUs = 0;
+  uint64_t waitUs = 0;
+};
@@ -0,0 +1,129 @@
+#include "Profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+Profiler profiler;
+
+static const char* const SECTION_NAMES[PROF_SECTION_COUNT] = {
+  "refresh", "gps_parse", "modbus", "imu_read", "fusion", "serialize", "ble_notify", "log",
+};
+
+const char* profileSectionName(int section) {
+  return section >= 0 && section < PROF_SECTION_COUNT ? SECTION_NAMES[section] : "unknown";
+}
+
+void Profiler::begin(uint32_t cyclesPerUs) {
+  this->cyclesPerUs = cyclesPerUs ? cyclesPerUs : 1;
+  lastCycles = profileCycles();
+  cycleBase = 0;
+  startCycles = 0;
+  reset();
+}
+
+void Profiler::reset() {
+  memset(stats, 0, sizeof(stats));
+  for (int i = 0; i < PROF_SECTION_COUNT; i++) stats[i].minCycles = UINT32_MAX;
+  traceHead = 0;
+  traceFull = false;
+  startCycles = extendedCycles(profileCycles());
+}
+
+uint32_t Profiler::enter() {
+  if (depth < PROF_MAX_DEPTH) childCycles[depth] = 0;
+  depth++;
+  return profileCycles();
+}
+
+void Profiler::exit(ProfileSection section, uint32_t start) {
+  uint32_t now = profileCycles();
+  uint32_t elapsed = now - start;
+  depth--;
+
+  uint32_t self = elapsed;
+  if (depth < PROF_MAX_DEPTH) {
+    uint32_t nested = childCycles[depth];
+    self = nested < elapsed ? elapsed - nested : 0;
+  }
+  if (depth > 0 && depth <= PROF_MAX_DEPTH) childCycles[depth - 1] += elapsed;
+
+  Stats &s = stats[section];
+  s.count++;
+  s.totalCycles += self;
+  if (self < s.minCycles) s.minCycles = self;
+  if (self > s.maxCycles) s.maxCycles = self;
+  s.histogram[bucketIndex(self)]++;
+
+  if (traceEnabled) {
+    uint64_t end = extendedCycles(now);
+    ProfileEvent &event = trace[traceHead];
+    event.startUs = (uint32_t)((end - elapsed - startCycles) / cyclesPerUs);
+    event.durationUs = elapsed / cyclesPerUs;
+    event.section = section;
+    event.depth = depth;
+    traceHead = (traceHead + 1) % PROF_TRACE_EVENTS;
+    if (traceHead == 0) traceFull = true;
+  }
+}
+
+bool Profiler::summary(int section, ProfileSummary &out) const {
+  if (section < 0 || section >= PROF_SECTION_COUNT) return false;
+  const Stats &s = stats[section];
+  memset(&out, 0, sizeof(out));
+  out.count = s.count;
+  if (s.count == 0) return true;
+
+  float scale = 1.0f / cyclesPerUs;
+  out.minUs = s.minCycles * scale;
+  out.maxUs = s.maxCycles * scale;
+  out.avgUs = (float)((double)s.totalCycles / s.count) * scale;
+
+  // Upper edge of the bucket holding the 99th percentile sample, capped at the max
+  uint32_t rank = s.count - s.count / 100;
+  uint32_t seen = 0;
+  for (int i = 0; i < PROF_HISTOGRAM_BUCKETS; i++) {
+    seen += s.histogram[i];
+    if (seen >= rank) {
+      uint32_t bound = bucketUpperBound(i);
+      out.p99Us = (bound < s.maxCycles ? bound : s.maxCycles) * scale;
+      break;
+    }
+  }
+  return true;
+}
+
+bool Profiler::traceEvent(size_t index, ProfileEvent &out) const {
+  if (index >= traceCount()) return false;
+  size_t first = traceFull ? traceHead : 0;
+  out = trace[(first + index) % PROF_TRACE_EVENTS];
+  return true;
+}
+
+size_t Profiler::formatTraceEvent(const ProfileEvent &event, char* buffer, size_t size) const {
+  int length = snprintf(buffer, size, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lu,\"dur\":%lu,\"pid\":1,\"tid\":1}",
+                        profileSectionName(event.section), (unsigned long)event.startUs,
+                        (unsigned long)event.durationUs);
+  return length > 0 && (size_t)length < size ? (size_t)length : 0;
+}
+
+int Profiler::bucketIndex(uint32_t cycles) {
+  if (cycles < (1u << PROF_HISTOGRAM_MIN_SHIFT)) return 0;
+  int msb = 31 - __builtin_clz(cycles);
+  int sub = (cycles >> (msb - 2)) & (PROF_HISTOGRAM_SUB_BUCKETS - 1);
+  return (msb - PROF_HISTOGRAM_MIN_SHIFT) * PROF_HISTOGRAM_SUB_BUCKETS + sub + 1;
+}
+
+uint32_t Profiler::bucketUpperBound(int index) {
+  if (index == 0) return (1u << PROF_HISTOGRAM_MIN_SHIFT) - 1;
+  int msb = (index - 1) / PROF_HISTOGRAM_SUB_BUCKETS + PROF_HISTOGRAM_MIN_SHIFT;
+  int sub = (index - 1) % PROF_HISTOGRAM_SUB_BUCKETS;
+  uint64_t low = (uint64_t)(PROF_HISTOGRAM_SUB_BUCKETS + sub) << (msb - 2);
+  uint64_t high = low + (1ull << (msb - 2)) - 1;
+  return high > UINT32_MAX ? UINT32_MAX : (uint32_t)high;
+}
+
+uint64_t Profiler::extendedCycles(uint32_t cycles) {
+  cycleBase += (uint32_t)(cycles - lastCycles);
+  lastCycles = cycles;
+  return cycleBase;
+}
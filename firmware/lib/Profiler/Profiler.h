@@ -0,0 +1,148 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(ESP_PLATFORM)
+#include <xtensa/hal.h>
+#else
+#include <chrono>
+#endif
+
+// Cycle-count profiler for the refresh hot path.
+//
+// Sections are timed with PROFILE_SCOPE(). Each section keeps count, min,
+// max, total and a log-linear histogram (four sub-buckets per power of two)
+// in static memory, so percentiles cost nothing to record. Scopes may nest;
+// a section's samples are its self time, with nested sections subtracted, so
+// the per-section averages add up to the time spent in a refresh tick.
+// The last PROF_TRACE_EVENTS scopes are also kept with their start time and
+// inclusive duration for export as a Chrome trace (chrome://tracing,
+// ui.perfetto.dev).
+//
+// Scopes must only be used from one task (the Arduino loop on the device).
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+enum ProfileSection {
+  PROF_REFRESH,      // Refresh tick work not covered by another section
+  PROF_GPS_PARSE,    // Draining the GPS UART into the NMEA parser
+  PROF_MODBUS,       // Wind sensor Modbus round trip
+  PROF_IMU_READ,     // Fetching a BNO080 report over I2C
+  PROF_FUSION,       // Speed filter, true wind, orientation, polar and start line maths
+  PROF_SERIALIZE,    // JSON document and telemetry frame encoding
+  PROF_BLE_NOTIFY,   // Notifies to connected clients
+  PROF_LOG,          // Session log append and flash writes
+  PROF_SECTION_COUNT
+};
+
+#define PROF_HISTOGRAM_MIN_SHIFT 6    // Samples below 64 cycles share bucket 0
+#define PROF_HISTOGRAM_SUB_BUCKETS 4
+#define PROF_HISTOGRAM_BUCKETS ((32 - PROF_HISTOGRAM_MIN_SHIFT) * PROF_HISTOGRAM_SUB_BUCKETS + 1)
+#ifndef PROF_TRACE_EVENTS
+#define PROF_TRACE_EVENTS 256
+#endif
+#define PROF_MAX_DEPTH 8
+
+// Current cycle counter (CPU cycles on the ESP32, nanoseconds on the host)
+inline uint32_t profileCycles() {
+#if defined(ESP_PLATFORM)
+  return xthal_get_ccount();
+#else
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Summary of one section in microseconds
+struct ProfileSummary {
+  uint32_t count;
+  float minUs;
+  float avgUs;
+  float maxUs;
+  float p99Us;
+};
+
+// One completed scope for the trace export
+struct ProfileEvent {
+  uint32_t startUs;     // Start time since Profiler::begin()
+  uint32_t durationUs;  // Inclusive duration
+  uint8_t section;
+  uint8_t depth;
+};
+
+const char* profileSectionName(int section);
+
+class Profiler {
+public:
+  // cyclesPerUs converts the cycle counter to time (CPU MHz on the device)
+  void begin(uint32_t cyclesPerUs);
+  void reset();
+
+  // Scope bookkeeping, use PROFILE_SCOPE() instead of calling these directly
+  uint32_t enter();
+  void exit(ProfileSection section, uint32_t startCycles);
+
+  bool summary(int section, ProfileSummary &out) const;
+  uint32_t cyclesPerMicrosecond() const { return cyclesPerUs; }
+
+  // Trace ring, oldest event first; recording can be paused while exporting
+  size_t traceCount() const { return traceFull ? PROF_TRACE_EVENTS : traceHead; }
+  bool traceEvent(size_t index, ProfileEvent &out) const;
+  void setTraceEnabled(bool enabled) { traceEnabled = enabled; }
+
+  // Format an event as a Chrome trace "complete" event; returns the length
+  size_t formatTraceEvent(const ProfileEvent &event, char* buffer, size_t size) const;
+
+private:
+  struct Stats {
+    uint32_t count;
+    uint32_t minCycles;
+    uint32_t maxCycles;
+    uint64_t totalCycles;
+    uint32_t histogram[PROF_HISTOGRAM_BUCKETS];
+  };
+
+  static int bucketIndex(uint32_t cycles);
+  static uint32_t bucketUpperBound(int index);
+  uint64_t extendedCycles(uint32_t cycles);
+
+  Stats stats[PROF_SECTION_COUNT];
+  uint32_t cyclesPerUs = 1;
+
+  // Per-depth time spent in nested scopes, subtracted from the parent
+  uint32_t childCycles[PROF_MAX_DEPTH];
+  int depth = 0;
+
+  // 32-bit counter extended to 64 bits for trace timestamps (wraps every 17 s at 240 MHz)
+  uint32_t lastCycles = 0;
+  uint64_t cycleBase = 0;
+  uint64_t startCycles = 0;
+
+  ProfileEvent trace[PROF_TRACE_EVENTS];
+  size_t traceHead = 0;
+  bool traceFull = false;
+  bool traceEnabled = true;
+};
+
+extern Profiler profiler;
+
+class ProfileScope {
+public:
+  explicit ProfileScope(ProfileSection section) : section(section), start(profiler.enter()) {}
+  ~ProfileScope() { profiler.exit(section, start); }
+
+private:
+  ProfileSection section;
+  uint32_t start;
+};
+
+#if PROFILER_ENABLED
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(section) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(section)
+#else
+#define PROFILE_SCOPE(section) do {} while (0)
+#endif
@@ -0,0 +1,651 @@
+#include "SensorPipeline.h"
+
+#include <Logger.h>
+#include <Profiler.h>
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+
+// Snapshot sensor data as a codec frame (fixed-point units)
+void buildTelemetryFrame(const SensorData &data, const NmeaFix &fix, bool imuAvailable, int rssi,
+                         uint32_t time, TelemetryFrame &frame) {
+  memset(&frame, 0, sizeof(frame));
+  frame.set(TF_TIME, (int32_t)time);
+
+  if (fix.has(NMEA_POSITION)) {
+    frame.set(TF_LAT, fix.position.lat);
+    frame.set(TF_LON, fix.position.lon);
+  }
+  frame.set(TF_SOG, (int32_t)lround((isnan(data.speed) ? 0.0f : data.speed) * 100.0f));
+  if (fix.has(NMEA_COURSE)) frame.set(TF_COG, fix.course);
+  if (fix.has(NMEA_SATELLITES)) frame.set(TF_SATS, fix.satellites);
+  if (fix.has(NMEA_HDOP)) frame.set(TF_HDOP, (fix.hdop + 5) / 10);
+
+  if (!isnan(data.windSpeed)) frame.set(TF_AWS, (int32_t)lround(data.windSpeed * 100.0f));
+  if (data.windAngle >= 0 && data.windAngle <= 359) frame.set(TF_AWA, data.windAngle * 100);
+  if (!isnan(data.trueWindSpeed)) frame.set(TF_TWS, (int32_t)lround(data.trueWindSpeed * 100.0f));
+  if (!isnan(data.trueWindAngle)) frame.set(TF_TWA, (int32_t)lround(data.trueWindAngle * 100.0f) % 36000);
+  if (!isnan(data.trueWindDirection)) frame.set(TF_TWD, (int32_t)lround(data.trueWindDirection * 100.0f) % 36000);
+
+  if (imuAvailable && !isnan(data.tilt)) frame.set(TF_HEEL, (int32_t)lround(data.tilt * 100.0f));
+  if (imuAvailable && data.HDM >= 0 && data.HDM <= 359) frame.set(TF_HDM, data.HDM * 100);
+  if (imuAvailable && !isnan(data.accelX)) {
+    frame.set(TF_ACCEL_X, (int32_t)lround(data.accelX * 100.0f));
+    frame.set(TF_ACCEL_Y, (int32_t)lround(data.accelY * 100.0f));
+    frame.set(TF_ACCEL_Z, (int32_t)lround(data.accelZ * 100.0f));
+  }
+  frame.set(TF_RSSI, rssi);
+}
+
+// Convert two Modbus registers (32 bits) to float
+static float regsToFloat(uint16_t lowReg, uint16_t highReg) {
+  uint32_t combined = ((uint32_t)highReg << 16) | lowReg;
+  float value;
+  memcpy(&value, &combined, sizeof(value));
+  return value;
+}
+
+// Decode common Modbus error codes (only referenced by debug logging)
+__attribute__((unused)) static const char* modbusErrorName(uint8_t result) {
+  switch (result) {
+    case 0xE0: return "Invalid slave ID";
+    case 0xE1: return "Invalid function";
+    case 0xE2: return "Response timeout";
+    case 0xE3: return "Invalid CRC";
+    default:   return "Unknown error code";
+  }
+}
+
+void SensorPipeline::setMovementWindows(uint8_t trackPoints, uint8_t accelSamples) {
+  gpsTrack.setWindow(trackPoints);
+  accelMagnitudes.setWindow(accelSamples);
+  lastMovementResult = false;
+  lastAccelResult = false;
+}
+
+void SensorPipeline::setOutlierThreshold(float threshold) {
+  for (HampelFilter &filter : outlierFilters) filter.setThreshold(threshold);
+}
+
+void SensorPipeline::resetOutlierCounters() {
+  for (HampelFilter &filter : outlierFilters) filter.resetCounters();
+}
+
+// Store accelerometer reading for movement analysis
+void SensorPipeline::storeAccelReading(float accelX, float accelY, float accelZ) {
+  if (!imu.isAvailable()) return;
+
+  accelMagnitudes.add(sqrtf(accelX * accelX + accelY * accelY + accelZ * accelZ));
+  updateAccelMovement();
+}
+
+// Analyze accelerometer data to detect movement
+void SensorPipeline::updateAccelMovement() {
+  if (accelMagnitudes.count() < 3) {
+    lastAccelResult = false;
+    return; // Not enough data
+  }
+
+  float avgMagnitude = accelMagnitudes.mean();
+  float magnitudeRange = accelMagnitudes.max() - accelMagnitudes.min();
+  float stdDev = accelMagnitudes.stdDev();
+
+  // Movement detection thresholds
+  const float MOVEMENT_STD_DEV_THRESHOLD = 0.5;  // m/s² - acceleration variation indicating movement
+  const float MOVEMENT_RANGE_THRESHOLD = 1.0;    // m/s² - total acceleration range indicating movement
+  const float MIN_AVERAGE_ACCEL = 8.0;           // m/s² - minimum for valid readings (gravity ~9.81)
+  const float MAX_AVERAGE_ACCEL = 12.0;          // m/s² - maximum for valid readings
+
+  // Check if accelerometer readings are reasonable (detecting presence of gravity)
+  bool validAccelData = (avgMagnitude >= MIN_AVERAGE_ACCEL && avgMagnitude <= MAX_AVERAGE_ACCEL);
+
+  // Movement detected if significant variation in acceleration
+  lastAccelResult = validAccelData &&
+                    (stdDev > MOVEMENT_STD_DEV_THRESHOLD || magnitudeRange > MOVEMENT_RANGE_THRESHOLD);
+
+  LOGV("Accel Movement", "Avg: %.2f m/s², StdDev: %.2f, Range: %.2f, Movement: %s",
+       avgMagnitude, stdDev, magnitudeRange, lastAccelResult ? "YES" : "NO");
+}
+
+// Analyze GPS track to determine if movement is real
+void SensorPipeline::updateTrackMovement() {
+  lastMovementResult = false;
+
+  // Need at least 3 points and 2 legs between fixes
+  int legs = gpsTrack.legCount();
+  if (gpsTrack.points() < 3 || legs < 2) return;
+
+  // Calculate average distance per sample
+  float avgDistance = gpsTrack.totalDistance() / legs;
+
+  // If we're moving very little, check for GPS noise pattern
+  if (avgDistance < 3.0) { // Less than 3 meters per sample = likely stationary
+    return;
+  }
+
+  // If we're moving significantly, check for consistent track
+  if (avgDistance > 5.0) { // More than 5 meters per sample = likely real movement
+    // Check if bearing changes are reasonable (not jumping around randomly)
+    float avgBearingChange = gpsTrack.totalBearingChange() / std::max(1, legs - 1);
+
+    // Allow for reasonable course changes in sailing
+    if (avgBearingChange < 45.0) { // Less than 45° average change = consistent track
+      lastMovementResult = true;
+    }
+  }
+}
+
+// Enhanced GPS speed filtering with accelerometer data
+float SensorPipeline::filterGPSSpeed(float rawSpeed, int satellites, float hdop) {
+  // Basic GPS quality check - less strict than before
+  bool goodGPSQuality = (satellites >= 4 && hdop <= 3.0);
+
+  // If GPS quality is very poor, don't trust readings
+  if (!goodGPSQuality) {
+    return lastValidSpeed * 0.95; // Gradually decay speed if no GPS
+  }
+
+  // Add the current GPS point to the track window and re-evaluate it
+  GeoPoint position = gpsPosition();
+  bool positionValid = gps.fix().has(NMEA_POSITION);
+  if (positionValid) {
+    trackPlane.follow(position);
+    gpsSpeeds.add(outlierFilters[OUTLIER_SOG].filter(rawSpeed));
+    if (outlierFilters[OUTLIER_SOG].lastRejected()) {
+      LOGD("GPS Filter", "Speed spike rejected: %.2f kt", rawSpeed);
+    }
+  }
+  gpsTrack.add(position, positionValid, trackPlane);
+  updateTrackMovement();
+
+  // Basic speed smoothing over the last fixes with a position
+  float smoothedSpeed = gpsSpeeds.count() > 0 ? gpsSpeeds.mean() : rawSpeed;
+
+  // Enhanced movement detection combining GPS track and accelerometer
+  bool gpsMovementDetected = isMovementConsistent();
+  bool accelMovementDetected = isAccelerometerMovementDetected();
+  bool imuAvailable = imu.isAvailable();
+
+  // Combined movement detection logic
+  bool realMovementDetected = false;
+
+  if (imuAvailable) {
+    // When IMU is available, use both GPS and accelerometer
+    // Movement confirmed if EITHER sensor detects movement (OR logic for sensitivity)
+    // But both must agree for stationary state (AND logic for stability)
+    if (gpsMovementDetected || accelMovementDetected) {
+      realMovementDetected = true;
+    } else {
+      // Both sensors agree: no movement
+      realMovementDetected = false;
+    }
+  } else {
+    // Fall back to GPS-only detection when no IMU
+    realMovementDetected = gpsMovementDetected;
+  }
+
+  // Adaptive noise threshold based on movement detection confidence
+  float noiseThreshold = 0.08; // Base threshold: 0.08 knots
+
+  if (imuAvailable && accelMovementDetected && gpsMovementDetected) {
+    // Both sensors confirm movement - lower threshold for better sensitivity
+    noiseThreshold = 0.05; // More sensitive when movement is confirmed
+  } else if (imuAvailable && !accelMovementDetected && !gpsMovementDetected) {
+    // Both sensors confirm stationary - higher threshold to filter noise
+    noiseThreshold = 0.12; // Less sensitive when stationary is confirmed
+  }
+
+  if (smoothedSpeed < noiseThreshold) {
+    if (realMovementDetected) {
+      // Movement detected by sensors, trust the GPS speed even if low
+      lastValidSpeed = smoothedSpeed;
+      return smoothedSpeed;
+    } else {
+      // No movement detected, likely stationary or GPS noise
+      lastValidSpeed = 0.0;
+      return 0.0;
+    }
+  }
+
+  // For higher speeds, use lighter filtering with hysteresis
+  const float HYSTERESIS_FACTOR = 0.1; // 10% hysteresis
+
+  if (lastValidSpeed < noiseThreshold) {
+    // Was stationary, need slightly higher speed to register movement
+    if (smoothedSpeed > (noiseThreshold + HYSTERESIS_FACTOR)) {
+      lastValidSpeed = smoothedSpeed;
+      return smoothedSpeed;
+    } else {
+      return 0.0;
+    }
+  } else {
+    // Was moving, use current speed with minimal filtering
+    lastValidSpeed = smoothedSpeed;
+    return smoothedSpeed;
+  }
+}
+
+// Read sensor data
+void SensorPipeline::readSensors() {
+  // I/O below has its own sections, so this one measures the processing only
+  PROFILE_SCOPE(PROF_FUSION);
+  data.sampleTime = clock.millis();
+
+  // Read GPS data first
+  bool gpsDataValid = readGPS();
+
+  // Apply track-based GPS speed filtering
+  updateSpeed(gpsDataValid);
+
+  // Read wind sensor using ModbusMaster, unless updateFast() just did
+  pollWind();
+
+  // Enhanced GPS debug output (only when needed)
+  LOGV("GPS Debug", "NMEA chars processed: %lu, Sentences with fix: %lu, Satellites: %u, HDOP: %u, Age: %lu ms",
+       (unsigned long)gps.charsProcessed(), (unsigned long)gps.sentencesWithFix(),
+       (unsigned)gps.fix().satellites, (unsigned)gps.fix().hdop,
+       (unsigned long)(clock.millis() - gps.fix().positionAt));
+
+  // Read tilt from BNO080 (only if available)
+  updateImu();
+
+  // True wind from this pass's wind, speed, heading and heel
+  updateTrueWind();
+}
+
+void SensorPipeline::updateSpeed(bool gpsDataValid) {
+  const NmeaFix &fix = gps.fix();
+  if (gpsDataValid && fix.has(NMEA_SPEED)) {
+    float rawSpeed = fix.knots();
+    int satellites = fix.has(NMEA_SATELLITES) ? fix.satellites : 0;
+    float hdop = fix.has(NMEA_HDOP) ? fix.hdopValue() : 99.9;
+
+    // Use enhanced GPS filtering with accelerometer data
+    data.speed = filterGPSSpeed(rawSpeed, satellites, hdop);
+
+    LOGD("GPS Filter", "Raw: %.3f kt, Filtered: %.3f kt, Sats: %d, HDOP: %.1f, GPS Track: %s, Accel: %s",
+         rawSpeed, data.speed, satellites, hdop,
+         isMovementConsistent() ? "MOVING" : "STATIONARY",
+         imu.isAvailable() ? (isAccelerometerMovementDetected() ? "MOVING" : "STATIONARY") : "N/A");
+  } else {
+    data.speed = 0.0;
+  }
+}
+
+void SensorPipeline::updateWind() {
+  float sensorWindSpeed;
+  int sensorWindAngle;
+  if (readWindSensor(sensorWindSpeed, sensorWindAngle)) {
+    // Speed is already in m/s from the sensor, convert to knots (1 m/s = 1.944 knots)
+    float knots = sensorWindSpeed * 1.944;
+    data.windSpeed = outlierFilters[OUTLIER_AWS].filter(knots);
+
+    // Wind angle 0-359°, spikes replaced by the recent median
+    data.windAngle = (int)lroundf(outlierFilters[OUTLIER_AWA].filter((float)sensorWindAngle)) % 360;
+    if (outlierFilters[OUTLIER_AWS].lastRejected() || outlierFilters[OUTLIER_AWA].lastRejected()) {
+      LOGD("Wind", "Spike rejected: %.1f kt @ %d°", knots, sensorWindAngle);
+    }
+
+    LOGD("Wind", "%.1f kt @ %d°", data.windSpeed, data.windAngle);
+  } else {
+    data.windSpeed = NAN;
+    data.windAngle = -999; // Use clearly invalid value (not -1 which could be valid)
+    // Only show error once every 10 seconds to avoid spam
+    if (clock.millis() - lastWindError > 10000) {
+      LOGW("Wind", "Wind sensor read failed");
+      lastWindError = clock.millis();
+    }
+  }
+}
+
+void SensorPipeline::updateTrueWind() {
+  if (isnan(data.windSpeed) || data.windAngle < 0 || data.windAngle > 359) {
+    data.trueWindSpeed = NAN;
+    data.trueWindAngle = NAN;
+    data.trueWindDirection = NAN;
+    trueWind.reset();
+    return;
+  }
+
+  bool imuValid = imu.isAvailable() && orientation.valid();
+  TrueWindInput in;
+  in.aws = data.windSpeed;
+  in.awa = data.windAngle;
+  in.sog = data.speed;
+  in.cog = gps.fix().has(NMEA_COURSE) ? gps.fix().courseDegrees() : NAN;
+  in.heading = imu.isAvailable() ? heading : NAN;
+  in.heel = imuValid ? data.tilt : NAN;
+  in.pitch = imuValid ? orientation.attitude().pitch : NAN;
+  in.rollRate = imuValid ? orientation.attitude().heelRate : NAN;
+  in.pitchRate = imuValid ? orientation.attitude().pitchRate : NAN;
+
+  TrueWindOutput out;
+  trueWind.update(data.sampleTime, in, out);
+  data.trueWindSpeed = out.tws;
+  data.trueWindAngle = out.twa;
+  data.trueWindDirection = out.twd;
+
+  LOGD("True Wind", "TWS %.1f kt TWA %.1f° TWD %.1f° (AWS %.1f kt AWA %.1f° corrected, leeway %.1f°)",
+       out.tws, out.twa, out.twd, out.aws, out.awa, out.leeway);
+}
+
+bool SensorPipeline::pollWind() {
+  if (clock.millis() - lastWindAttempt < WIND_POLL_INTERVAL_MS) return false;
+  updateWind();
+  return true;
+}
+
+bool SensorPipeline::updateFast() {
+  bool changed = false;
+  if (pollImu()) {
+    data.tilt = orientation.attitude().heel;
+    if (!isnan(heading)) data.HDM = (int)round(heading);
+    changed = true;
+  }
+  if (pollWind()) changed = true;
+  if (!changed) return false;
+
+  PROFILE_SCOPE(PROF_FUSION);
+  data.sampleTime = clock.millis();
+  updateTrueWind();
+  return true;
+}
+
+bool SensorPipeline::pollImu() {
+  if (!imu.isAvailable()) return false;
+
+  hal::ImuSample sample;
+  bool fresh;
+  {
+    PROFILE_SCOPE(PROF_IMU_READ);
+    fresh = imu.read(sample);
+  }
+  if (!fresh) return false;
+
+  // Heel, pitch, yaw and their rates, once per report for every consumer
+  orientation.update(clock.millis(), Quaternion(sample.quatReal, sample.quatI, sample.quatJ, sample.quatK));
+  lastImuSample = sample;
+  imuSampleWaiting = true;
+
+  LOGV("BNO080", "Heel: %.2f° Pitch: %.2f°", orientation.attitude().heel, orientation.attitude().pitch);
+
+  // Update compass every 100ms for better responsiveness (10Hz)
+  if (clock.millis() - lastCompassUpdate >= 100) {
+    lastCompassUpdate = clock.millis();
+    updateCompass(sample);
+  }
+  return true;
+}
+
+void SensorPipeline::updateImu() {
+  if (!imu.isAvailable()) {
+    // IMU not available - set all values to 0/NaN
+    data.tilt = 0.0;
+    data.HDM = -1; // Use -1 to indicate invalid heading
+    heading = NAN;
+    orientation.clear();
+    data.accelX = NAN;
+    data.accelY = NAN;
+    data.accelZ = NAN;
+    return;
+  }
+
+  // The report due now, if loop() has not already taken it
+  pollImu();
+  if (!imuSampleWaiting) {
+    // No new data since the last pass; only worth a warning once the reports stop
+    if ((!orientation.valid() || clock.millis() - orientation.sampleTime() > ORIENTATION_MAX_GAP_MS) &&
+        clock.millis() - lastNoDataWarning > 30000) { // Warn every 30 seconds
+      LOGW("BNO080", "No new data available");
+      lastNoDataWarning = clock.millis();
+    }
+    return;
+  }
+  imuSampleWaiting = false;
+
+  // Heel from the level-referenced orientation
+  data.tilt = orientation.attitude().heel;
+  if (!isnan(heading)) data.HDM = (int)round(heading);
+
+  // Read accelerometer data
+  data.accelX = lastImuSample.accelX;
+  data.accelY = lastImuSample.accelY;
+  data.accelZ = lastImuSample.accelZ;
+
+  // Store accelerometer data for movement analysis (one per pass, so the
+  // window length stays in refreshes)
+  storeAccelReading(data.accelX, data.accelY, data.accelZ);
+
+  LOGV("BNO080", "Accel: X=%.2f Y=%.2f Z=%.2f m/s²", data.accelX, data.accelY, data.accelZ);
+}
+
+void SensorPipeline::updateCompass(const hal::ImuSample &sample) {
+  // Get fresh magnetometer readings
+  float magX = sample.magX;
+  float magY = sample.magY;
+  float magZ = sample.magZ;
+
+  // Validate magnetometer readings
+  float magMagnitude = sqrt(magX * magX + magY * magY + magZ * magZ);
+
+  LOGV("BNO080", "Mag: X=%.2f Y=%.2f Z=%.2f (magnitude=%.2f)", magX, magY, magZ, magMagnitude);
+
+  // Only proceed if we have reasonable magnetometer readings
+  if (!(magMagnitude > 0.1 && magMagnitude < 200.0)) { // Reasonable range for BNO080
+    LOGD("BNO080", "Invalid magnetometer reading (magnitude=%.2f)", magMagnitude);
+    return;
+  }
+
+  // Tilt compensation: the field rotated into the horizontal plane by the
+  // sensor's tilt from this report's quaternion (no trig)
+  orientation.toHorizontal(magX, magY, magZ);
+
+  // Calculate RAW heading (before calibration)
+  float rawHeading = atan2(magY, magX) * 180.0f / PI;
+  if (rawHeading < 0) rawHeading += 360.0f; // Normalize to 0-360
+
+  // Apply smoothing to RAW heading first (before calibration)
+  if (!compassInitialized) {
+    lastRawHeading = rawHeading;
+    compassInitialized = true;
+
+    LOGD("BNO080", "Compass initialized with raw heading %.1f°", rawHeading);
+  } else {
+    // Simple exponential smoothing on RAW heading with high responsiveness
+    float alpha = 0.8; // Very high responsiveness (80% new value, 20% old)
+
+    // Handle compass wrap-around for smoothing (359° to 1° transition)
+    float headingDiff = rawHeading - lastRawHeading;
+    float adjustedRawHeading = rawHeading;
+
+    if (headingDiff > 180) {
+      adjustedRawHeading = rawHeading - 360;
+    } else if (headingDiff < -180) {
+      adjustedRawHeading = rawHeading + 360;
+    }
+
+    // Apply exponential smoothing to raw heading
+    float smoothedRawHeading = alpha * adjustedRawHeading + (1 - alpha) * lastRawHeading;
+
+    // Normalize back to 0-360 range
+    while (smoothedRawHeading < 0) smoothedRawHeading += 360;
+    while (smoothedRawHeading >= 360) smoothedRawHeading -= 360;
+
+    // Store the smoothed raw heading
+    lastRawHeading = smoothedRawHeading;
+  }
+
+  // Now apply compass calibration to the smoothed raw heading
+  float calibratedHeading = lastRawHeading - compassOffset;
+  if (calibratedHeading < 0) calibratedHeading += 360.0f;
+  if (calibratedHeading >= 360) calibratedHeading -= 360.0f;
+  heading = calibratedHeading;
+
+  LOGV("BNO080", "Compass: Raw=%.1f° Smoothed=%.1f° Offset=%.1f° Final=%.1f°",
+       rawHeading, lastRawHeading, compassOffset, heading);
+}
+
+// Read wind sensor data via RS485 (Modbus RTU)
+bool SensorPipeline::readWindSensor(float &windSpeed, int &windAngle) {
+  // Don't hammer the sensor - one attempt per slot
+  if (clock.millis() - lastWindAttempt < WIND_POLL_INTERVAL_MS) {
+    return false;
+  }
+  lastWindAttempt = clock.millis();
+
+  uint16_t registers[4] = {0};
+  uint8_t result;
+
+  {
+    PROFILE_SCOPE(PROF_MODBUS);
+    if (useIEEE754Format) {
+      // IEEE754 ultrasonic sensor: Read registers 0x0001 for 4 registers (direction + speed float)
+      result = windBus.readHoldingRegisters(0x0001, 4, registers);
+    } else {
+      // Integer ultrasonic sensor: Read registers 0x0000 for 2 registers (speed int + direction)
+      result = windBus.readHoldingRegisters(0x0000, 2, registers);
+    }
+  }
+
+  if (result == hal::Modbus::SUCCESS) {
+
+    if (useIEEE754Format) {
+      // IEEE754 ultrasonic anemometer format:
+      // reg0 = direction (0–359°)
+      // reg1 = speed float low word
+      // reg2 = speed float high word
+      // reg3 = unused
+
+      windAngle = registers[0]; // direction
+      uint16_t speedLow = registers[1];
+      uint16_t speedHigh = registers[2];
+
+      // Convert registers to IEEE 754 float
+      windSpeed = regsToFloat(speedLow, speedHigh);
+
+      LOGV("Wind Sensor", "IEEE754 format: Direction=%d°, Speed=%.3f m/s (raw: low=%d, high=%d)",
+           windAngle, windSpeed, speedLow, speedHigh);
+
+      // Validate data - if it looks wrong, try integer format
+      if (!windSensorTypeDetected && (windAngle < 0 || windAngle > 359 ||
+          isnan(windSpeed) || windSpeed < 0 || windSpeed > 50)) {
+        LOGD("Wind Sensor", "IEEE754 format data invalid, will try integer format next");
+        useIEEE754Format = false;
+
+        // Reconfigure RS485 for integer sensor
+        windBus.configure(4800, false);
+
+        return false; // Try again with integer format
+      }
+
+    } else {
+      // Integer ultrasonic anemometer format:
+      // reg0 = speed (expanded by 100, e.g., 125 = 1.25 m/s)
+      // reg1 = direction (0-359°)
+
+      uint16_t speedRaw = registers[0];
+      windSpeed = speedRaw / 100.0f;
+      windAngle = registers[1];
+
+      LOGV("Wind Sensor", "Integer format: Speed raw=%d (%.2f m/s), Direction=%d°",
+           speedRaw, windSpeed, windAngle);
+
+      // Validate data - if it looks wrong, try IEEE754 format
+      if (!windSensorTypeDetected && (windAngle < 0 || windAngle > 359 || windSpeed < 0 || windSpeed > 50)) {
+        LOGD("Wind Sensor", "Integer format data invalid, will try IEEE754 format next");
+        useIEEE754Format = true;
+
+        // Reconfigure RS485 for IEEE754 sensor
+        windBus.configure(9600, true);
+
+        return false; // Try again with IEEE754 format
+      }
+    }
+
+    // If we get here with valid data, lock in the sensor type
+    if (!windSensorTypeDetected && windAngle >= 0 && windAngle <= 359 &&
+        windSpeed >= 0 && windSpeed <= 50 && !isnan(windSpeed)) {
+      windSensorTypeDetected = true;
+      LOGI("Wind Sensor", "Detected %s format and locked it in",
+           useIEEE754Format ? "IEEE754 float" : "integer");
+    }
+
+    return true;
+
+  } else {
+    LOGD("Wind Sensor", "Modbus error 0x%02X - %s", result, modbusErrorName(result));
+
+    // If we haven't detected sensor type yet, try the other format
+    if (!windSensorTypeDetected) {
+      useIEEE754Format = !useIEEE754Format;
+      LOGD("Wind Sensor", "Switching to %s format for next attempt",
+           useIEEE754Format ? "IEEE754 float" : "integer");
+
+      // Reconfigure RS485 for the other sensor type
+      if (useIEEE754Format) {
+        windBus.configure(9600, true);
+      } else {
+        windBus.configure(4800, false);
+      }
+    }
+
+    return false;
+  }
+}
+
+// Check if GPS has valid, recent data
+bool SensorPipeline::isGPSDataValid() {
+  // Require multiple conditions for valid GPS:
+  // 1. Must have processed characters (indicating actual serial data)
+  // 2. Must have valid sentences with fix data
+  // 3. Location must be valid
+  // 4. Data must be recent (less than 5 seconds old)
+  // 5. Must have reasonable satellite count (not just noise)
+  const NmeaFix &fix = gps.fix();
+  return gps.charsProcessed() > 10 &&        // Must have processed actual data
+         gps.sentencesWithFix() > 0 &&       // Must have valid NMEA sentences
+         fix.has(NMEA_POSITION | NMEA_SATELLITES) &&
+         clock.millis() - fix.positionAt < 5000 &&
+         fix.satellites >= 3;                // Minimum for any fix
+}
+
+// Read GPS data
+bool SensorPipeline::readGPS() {
+  PROFILE_SCOPE(PROF_GPS_PARSE);
+  bool newData = false;
+  int bytesRead = 0;
+
+  // Read available GPS data (but limit to prevent infinite loops)
+  uint32_t now = clock.millis();
+  while (gpsUart.available() > 0 && bytesRead < 256) {
+    if (gps.encode(now, gpsUart.read())) {
+      newData = true;
+    }
+    bytesRead++;
+  }
+
+  if (gpsPolled) {
+    newData = true;
+    gpsPolled = false;
+  }
+
+  // Return true only if we have valid, recent location data
+  return newData && isGPSDataValid();
+}
+
+void SensorPipeline::pollGPS() {
+  PROFILE_SCOPE(PROF_GPS_PARSE);
+  int bytesRead = 0;
+  uint32_t now = clock.millis();
+  while (gpsUart.available() > 0 && bytesRead < 256) {
+    if (gps.encode(now, gpsUart.read())) {
+      gpsPolled = true;
+    }
+    bytesRead++;
+  }
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <Geodesy.h>
+#include <Hal.h>
+#include <HampelFilter.h>
+#include <NmeaParser.h>
+#include <Orientation.h>
+#include <TelemetryCodec.h>
+#include <TrackStats.h>
+#include <TrueWind.h>
+#include <math.h>
+
+// Sensor acquisition and filtering, independent of the Arduino runtime.
+//
+// All hardware access goes through the hal:: interfaces, so the firmware
+// and the native replay harness run exactly the same code.
+
+#define WIND_POLL_INTERVAL_MS 100   // One wind sensor request per slot
+
+// Data structure to hold sensor readings
+struct SensorData {
+  float speed;          // Vessel speed in knots
+  float windSpeed;      // Apparent wind speed in knots
+  int windAngle;        // Apparent wind angle in degrees (0-360)
+  float trueWindSpeed;  // True wind speed over ground in knots (damped, see TrueWind.h)
+  float trueWindAngle;  // True wind angle in degrees (0-360), NAN when unknown
+  float trueWindDirection; // True wind direction in degrees (0-360, magnetic with a compass), NAN without a heading
+  float tilt;           // Vessel heel/tilt angle in degrees
+  int HDM;              // Magnetic heading in degrees (0-359)
+  float accelX;         // Acceleration X-axis in m/s²
+  float accelY;         // Acceleration Y-axis in m/s²
+  float accelZ;         // Acceleration Z-axis in m/s²
+  uint32_t sampleTime;  // Clock time (ms) of the last readSensors() or updateFast() that changed data
+};
+
+// Channels with spike rejection ahead of all other processing
+enum OutlierChannel : uint8_t {
+  OUTLIER_AWS = 0,    // Apparent wind speed, knots
+  OUTLIER_AWA,        // Apparent wind angle, degrees
+  OUTLIER_SOG,        // GPS speed, knots, before the smoothing in filterGPSSpeed()
+  OUTLIER_CHANNEL_COUNT
+};
+
+// Snapshot sensor data as a codec frame (fixed-point units)
+void buildTelemetryFrame(const SensorData &data, const NmeaFix &fix, bool imuAvailable, int rssi,
+                         uint32_t time, TelemetryFrame &frame);
+
+class SensorPipeline {
+public:
+  SensorPipeline(hal::Clock &clock, hal::Uart &gpsUart, NmeaParser &gps, hal::Modbus &windBus, hal::Imu &imu)
+    : clock(clock), gpsUart(gpsUart), gps(gps), windBus(windBus), imu(imu) {}
+
+  // Calibration: the sensor orientation that counts as level (see
+  // Orientation.h) and the compass north offset in degrees
+  void setLevelReference(const Quaternion &level) { orientation.setReference(level); }
+  void setCompassOffset(float degrees) { compassOffset = degrees; }
+
+  // Peak heel window in seconds (1-60)
+  void setPeakHeelWindow(uint8_t seconds) { orientation.setPeakWindow(seconds); }
+
+  // True wind mast height and damping
+  void setTrueWindConfig(const TrueWindConfig &config) { trueWind.setConfig(config); }
+  const TrueWindConfig &trueWindConfig() const { return trueWind.getConfig(); }
+
+  // Movement detection windows: GPS points (3-33) and accelerometer samples
+  // (3-32); clears both windows
+  void setMovementWindows(uint8_t trackPoints, uint8_t accelSamples);
+  uint8_t trackWindow() const { return gpsTrack.window(); }
+  uint8_t accelWindow() const { return accelMagnitudes.window(); }
+
+  // Spike rejection: window in samples (0 = off, up to HAMPEL_MAX_WINDOW)
+  // per channel and the threshold in scaled MADs shared by all of them;
+  // clears the windows, keeps the counters
+  void setOutlierWindow(OutlierChannel channel, uint8_t window) { outlierFilters[channel].setWindow(window); }
+  void setOutlierThreshold(float threshold);
+  void resetOutlierCounters();
+  const HampelFilter &outlierFilter(OutlierChannel channel) const { return outlierFilters[channel]; }
+
+  // One full pass: GPS, wind, IMU and true wind (was readSensors())
+  void readSensors();
+
+  // Individual stages, also used by the replay harness for per-stage timing
+  bool readGPS();
+  void updateSpeed(bool gpsDataValid);
+  bool readWindSensor(float &windSpeed, int &windAngle);
+  void updateWind();
+  void updateTrueWind();
+  void updateImu();
+
+  // Take every IMU report at the sensor's rate (call on each loop() pass);
+  // updateImu() publishes the latest into data. True when a report was taken
+  bool pollImu();
+
+  // Read the wind sensor into data if its WIND_POLL_INTERVAL_MS slot is due
+  // (readSensors() uses it too, so a refresh right after a read keeps it)
+  bool pollWind();
+
+  // Between refreshes, on each loop() pass while active: heel and heading
+  // from the latest IMU report, the wind sensor in its slot and true wind
+  // from them, so a sudden change can be published before the next
+  // refresh. GPS, speed, acceleration and the movement checks stay on
+  // readSensors(). True when data changed (sampleTime is then now).
+  bool updateFast();
+
+  // Drain the GPS UART between refreshes so it does not overflow; sentences
+  // completed here count as new data for the next readSensors()
+  void pollGPS();
+
+  // Last movement verdict (SOG or the GPS track/accelerometer checks), no side effects
+  bool isMoving() const { return data.speed > 0.5f || lastMovementResult || lastAccelResult; }
+
+  bool isGPSDataValid();
+  // Latest GPS position in 1e-7 degrees
+  GeoPoint gpsPosition() const { return gps.fix().position; }
+  // Latest IMU pitch in degrees (+ = bow up), NAN before the first sample
+  float pitchAngle() const { return orientation.valid() ? orientation.attitude().pitch : NAN; }
+  // Attitude at the IMU's rate: heel, pitch, yaw, rates and peak heel
+  const Orientation &imuOrientation() const { return orientation; }
+  // Smoothed, tilt-compensated compass heading before the north offset; NAN
+  // before the first magnetometer reading
+  float rawCompassHeading() const { return compassInitialized ? lastRawHeading : NAN; }
+  float filterGPSSpeed(float rawSpeed, int satellites, float hdop);
+  // Verdicts of the movement checks, updated with every GPS fix and IMU sample
+  bool isMovementConsistent() const { return lastMovementResult; }
+  bool isAccelerometerMovementDetected() const { return imu.isAvailable() && lastAccelResult; }
+
+  SensorData data = {0};
+
+private:
+  void storeAccelReading(float accelX, float accelY, float accelZ);
+  void updateTrackMovement();
+  void updateAccelMovement();
+  void updateCompass(const hal::ImuSample &sample);
+
+  hal::Clock &clock;
+  hal::Uart &gpsUart;
+  NmeaParser &gps;
+  hal::Modbus &windBus;
+  hal::Imu &imu;
+
+  float compassOffset = 0.0f;
+
+  // GPS track-based filtering: sliding windows updated once per fix
+  TrackWindow gpsTrack{10};       // Legs between the last 10 positions
+  WindowStats gpsSpeeds{3};       // Speed smoothing over the last 3 fixes
+  LocalPlane trackPlane;   // Follows the boat; scales for the track distances and bearings
+  float lastValidSpeed = 0.0;
+  bool gpsPolled = false;  // pollGPS() completed a sentence since the last readGPS()
+
+  // Accelerometer-based movement detection: last 8 acceleration magnitudes
+  WindowStats accelMagnitudes{8};
+
+  bool lastMovementResult = false;
+  bool lastAccelResult = false;
+
+  // Spike rejection (see HampelFilter.h); the floors keep a steady signal
+  // from rejecting its first real change
+  HampelFilter outlierFilters[OUTLIER_CHANNEL_COUNT] = {
+    HampelFilter(7, 3.0f, 2.0f),            // AWS: rain and spray read as 40+ kn or 0
+    HampelFilter(7, 3.0f, 15.0f, 360.0f),   // AWA
+    HampelFilter(5, 3.0f, 0.5f),            // SOG: multipath jumps
+  };
+
+  // Wind sensor format detection
+  unsigned long lastWindAttempt = 0;
+  bool windSensorTypeDetected = false;
+  bool useIEEE754Format = true; // true = IEEE754 float (9600,8E1), false = integer (4800,8N1)
+  unsigned long lastWindError = 0;
+
+  // True wind engine and the IMU state it uses
+  TrueWind trueWind;
+  Orientation orientation;
+  float heading = NAN;        // Calibrated compass heading, degrees
+
+  // IMU and compass smoothing
+  hal::ImuSample lastImuSample = {};
+  bool imuSampleWaiting = false;   // pollImu() took a report since the last updateImu()
+  unsigned long lastNoDataWarning = 0;
+  float lastRawHeading = 0;
+  unsigned long lastCompassUpdate = 0;
+  bool compassInitialized = false;
+};
@@ -0,0 +1,264 @@
+#include "SessionLog.h"
+
+bool SessionLog::begin(fs::FS &fs, const char* path, uint32_t capacityBlocks) {
+  this->fs = &fs;
+  this->path = path;
+  capacity = capacityBlocks;
+  ready = false;
+
+  FileHeader header = {};
+  bool valid = false;
+  if (fs.exists(path)) {
+    File file = fs.open(path, "r");
+    if (file && file.read((uint8_t*)&header, sizeof(header)) == sizeof(header)) {
+      valid = header.magic == LOG_BLOCK_MAGIC && header.version == LOG_FILE_VERSION &&
+              header.blockSize == LOG_BLOCK_SIZE && header.capacity == capacity &&
+              header.oldestSeq <= header.openSeq;
+    }
+    file.close();
+  }
+
+  if (!valid) {
+    // Missing file or incompatible layout - start a fresh log
+    ready = true;
+    return erase();
+  }
+
+  oldestSeq = header.oldestSeq;
+  openSeq = header.openSeq;
+  ready = true;
+
+  // A partially filled block flushed before the last reset is sealed rather
+  // than resumed, since the encoder state it was written with is gone
+  memset(&openBlock, 0, sizeof(openBlock));
+  encoder.reset();
+  LogBlockHeader flushed;
+  if (readBlockHeader(openSeq, flushed) && flushed.count > 0) {
+    openSeq++;
+    if (openSeq - oldestSeq > capacity - 1) oldestSeq = openSeq - (capacity - 1);
+    writeHeader();
+  }
+
+  // Recover the newest timestamp for the append ordering check
+  if (openSeq > oldestSeq) {
+    LogBlockHeader previous;
+    if (readBlockHeader(openSeq - 1, previous)) lastRecordUtc = previous.lastUtc;
+  }
+  return true;
+}
+
+bool SessionLog::append(const LogRecord &record) {
+  if (!ready || record.utc < lastRecordUtc) return false;
+
+  bool ok = true;
+  TelemetryFrame frame;
+  uint8_t encoded[TF_MAX_FRAME_SIZE];
+  size_t length = 0;
+
+  if (openBlock.count > 0) {
+    // Time offsets are kept relative to the block start; a block spanning
+    // more than a day is closed so the offset stays small
+    if (record.utc - openBlock.firstUtc < 86400) {
+      logRecordToFrame(record, openBlock.firstUtc, frame);
+      TelemetryEncoder trial = encoder;
+      length = trial.encode(frame, encoded);
+      if (openBlock.length + length <= LOG_PAYLOAD_SIZE) {
+        encoder = trial;
+      } else {
+        length = 0;
+      }
+    }
+    // Block is full - commit it and move the ring forward
+    if (length == 0) ok = commitOpenBlock();
+  }
+
+  if (openBlock.count == 0) {
+    openBlock.magic = LOG_BLOCK_MAGIC;
+    openBlock.seq = openSeq;
+    openBlock.firstUtc = record.utc;
+    openBlock.encoding = LOG_ENCODING_DELTA;
+    encoder.reset();
+    logRecordToFrame(record, record.utc, frame);
+    length = encoder.encode(frame, encoded);
+  }
+
+  memcpy(openPayload + openBlock.length, encoded, length);
+  openBlock.length += length;
+  openBlock.count++;
+  openBlock.lastUtc = record.utc;
+  lastRecordUtc = record.utc;
+  return ok;
+}
+
+bool SessionLog::commitOpenBlock() {
+  bool ok = writeOpenBlock();
+  openSeq++;
+  if (openSeq - oldestSeq > capacity - 1) {
+    oldestSeq = openSeq - (capacity - 1);
+  }
+  memset(&openBlock, 0, sizeof(openBlock));
+  return writeHeader() && ok;
+}
+
+bool SessionLog::flush() {
+  if (!ready) return false;
+  bool ok = true;
+  if (openBlock.count > 0) ok = writeOpenBlock();
+  return writeHeader() && ok;
+}
+
+bool SessionLog::erase() {
+  if (!ready) return false;
+  fs->remove(path);
+  oldestSeq = 0;
+  openSeq = 0;
+  lastRecordUtc = 0;
+  memset(&openBlock, 0, sizeof(openBlock));
+  encoder.reset();
+  return writeHeader();
+}
+
+uint32_t SessionLog::firstUtc() {
+  if (oldestSeq == openSeq) return openBlock.count > 0 ? openBlock.firstUtc : 0;
+  LogBlockHeader header;
+  return readBlockHeader(oldestSeq, header) ? header.firstUtc : 0;
+}
+
+bool SessionLog::readBlock(uint32_t seq, uint8_t* out) {
+  if (!ready || seq < oldestSeq || seq >= endSeq()) return false;
+
+  if (seq == openSeq) {
+    // The open block is served from RAM so readers always see the newest data
+    memset(out, 0, LOG_BLOCK_SIZE);
+    memcpy(out, &openBlock, sizeof(openBlock));
+    memcpy(out + sizeof(LogBlockHeader), openPayload, openBlock.length);
+    return true;
+  }
+
+  File file = fs->open(path, "r");
+  if (!file || !file.seek(blockOffset(seq))) return false;
+  size_t read = file.read(out, LOG_BLOCK_SIZE);
+  file.close();
+
+  // A torn or corrupt block must not claim more payload than a block holds:
+  // readers size their copy from header->length
+  const LogBlockHeader* header = (const LogBlockHeader*)out;
+  return read == LOG_BLOCK_SIZE && header->magic == LOG_BLOCK_MAGIC && header->seq == seq &&
+         header->length <= LOG_PAYLOAD_SIZE;
+}
+
+uint32_t SessionLog::findBlock(uint32_t utc) {
+  // Blocks are in time order, so binary search on the per-block end time
+  uint32_t lo = oldestSeq;
+  uint32_t hi = endSeq();
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    LogBlockHeader header;
+    uint32_t blockEnd = 0;
+    if (mid == openSeq) {
+      blockEnd = openBlock.lastUtc;
+    } else if (readBlockHeader(mid, header)) {
+      blockEnd = header.lastUtc;
+    }
+    if (blockEnd < utc) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+bool SessionLog::writeHeader() {
+  FileHeader header = {LOG_BLOCK_MAGIC, LOG_FILE_VERSION, LOG_BLOCK_SIZE, capacity, oldestSeq, openSeq};
+
+  File file = fs->exists(path) ? fs->open(path, "r+") : fs->open(path, "w");
+  if (!file) return false;
+  uint8_t block[LOG_BLOCK_SIZE] = {0};
+  memcpy(block, &header, sizeof(header));
+  size_t written = file.write(block, LOG_BLOCK_SIZE);
+  file.close();
+  return written == LOG_BLOCK_SIZE;
+}
+
+bool SessionLog::writeOpenBlock() {
+  File file = fs->open(path, "r+");
+  if (!file) return false;
+
+  // Slots are filled in order on the first lap, so a slot is either inside
+  // the file or exactly at its end
+  size_t offset = blockOffset(openSeq);
+  if (offset > file.size() || !file.seek(offset)) {
+    file.close();
+    return false;
+  }
+
+  uint8_t block[LOG_BLOCK_SIZE] = {0};
+  memcpy(block, &openBlock, sizeof(openBlock));
+  memcpy(block + sizeof(LogBlockHeader), openPayload, openBlock.length);
+  size_t written = file.write(block, LOG_BLOCK_SIZE);
+  file.close();
+  return written == LOG_BLOCK_SIZE;
+}
+
+bool SessionLog::readBlockHeader(uint32_t seq, LogBlockHeader &header) {
+  File file = fs->open(path, "r");
+  if (!file || !file.seek(blockOffset(seq))) return false;
+  size_t read = file.read((uint8_t*)&header, sizeof(header));
+  file.close();
+  return read == sizeof(header) && header.magic == LOG_BLOCK_MAGIC && header.seq == seq &&
+         header.length <= LOG_PAYLOAD_SIZE;
+}
+
+void logRecordToFrame(const LogRecord &record, uint32_t baseUtc, TelemetryFrame &frame) {
+  memset(&frame, 0, sizeof(frame));
+  frame.set(TF_TIME, (int32_t)((record.utc - baseUtc) * 1000 + record.ms));
+  if (record.flags & LOG_HAS_FIX) {
+    frame.set(TF_LAT, record.lat);
+    frame.set(TF_LON, record.lon);
+    frame.set(TF_SOG, record.sog);
+    frame.set(TF_COG, record.cog);
+  }
+  if (record.flags & LOG_HAS_WIND) {
+    frame.set(TF_AWS, record.aws);
+    frame.set(TF_AWA, record.awa);
+  }
+  if (record.flags & LOG_HAS_TRUE) {
+    frame.set(TF_TWS, record.tws);
+    frame.set(TF_TWA, record.twa);
+  }
+  if (record.flags & LOG_HAS_HEEL) frame.set(TF_HEEL, record.heel);
+  if (record.flags & LOG_HAS_HDM) frame.set(TF_HDM, record.hdm);
+}
+
+void logFrameToRecord(const TelemetryFrame &frame, uint32_t baseUtc, LogRecord &record) {
+  memset(&record, 0, sizeof(record));
+  uint32_t offset = (uint32_t)frame.value[TF_TIME];
+  record.utc = baseUtc + offset / 1000;
+  record.ms = offset % 1000;
+  if (frame.has(TF_LAT)) {
+    record.flags |= LOG_HAS_FIX;
+    record.lat = frame.value[TF_LAT];
+    record.lon = frame.value[TF_LON];
+    record.sog = frame.value[TF_SOG];
+    record.cog = frame.value[TF_COG];
+  }
+  if (frame.has(TF_AWS)) {
+    record.flags |= LOG_HAS_WIND;
+    record.aws = frame.value[TF_AWS];
+    record.awa = frame.value[TF_AWA];
+  }
+  if (frame.has(TF_TWS)) {
+    record.flags |= LOG_HAS_TRUE;
+    record.tws = frame.value[TF_TWS];
+    record.twa = frame.value[TF_TWA];
+  }
+  if (frame.has(TF_HEEL)) {
+    record.flags |= LOG_HAS_HEEL;
+    record.heel = frame.value[TF_HEEL];
+  }
+  if (frame.has(TF_HDM)) {
+    record.flags |= LOG_HAS_HDM;
+    record.hdm = frame.value[TF_HDM];
+  }
+}
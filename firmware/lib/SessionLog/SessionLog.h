@@ -0,0 +1,121 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include <TelemetryCodec.h>
+
+// Session log stored on the SPIFFS partition as a ring of fixed-size blocks.
+//
+// File layout: one header block followed by LOG_CAPACITY_BLOCKS data blocks.
+// Every data block starts with a LogBlockHeader and carries records in time
+// order, so a block can be streamed to a client as-is and located by time
+// with a binary search over the block headers. Records are stored as
+// TelemetryCodec frames: each block opens with a keyframe and the rest are
+// deltas, so blocks decode independently of each other.
+
+#define LOG_BLOCK_SIZE 512
+#define LOG_BLOCK_MAGIC 0x564C4F47  // "VLOG"
+#define LOG_FILE_VERSION 2
+
+// Block payload encodings
+#define LOG_ENCODING_RAW   0  // Array of LogRecord
+#define LOG_ENCODING_DELTA 1  // TelemetryCodec frames, TF_TIME relative to firstUtc
+
+// Record flags - set when the corresponding field holds a valid value
+#define LOG_HAS_FIX   0x0001
+#define LOG_HAS_WIND  0x0002
+#define LOG_HAS_TRUE  0x0004
+#define LOG_HAS_HEEL  0x0008
+#define LOG_HAS_HDM   0x0010
+
+// One logged sample (little endian, fixed-point units)
+struct __attribute__((packed)) LogRecord {
+  uint32_t utc;        // UTC seconds since 1970-01-01
+  uint16_t ms;         // Milliseconds within the UTC second
+  uint16_t flags;      // LOG_HAS_* bits
+  int32_t lat;         // Latitude in 1e-7 degrees
+  int32_t lon;         // Longitude in 1e-7 degrees
+  uint16_t sog;        // Speed over ground in 0.01 knots
+  uint16_t cog;        // Course over ground in 0.01 degrees
+  uint16_t aws;        // Apparent wind speed in 0.01 knots
+  uint16_t awa;        // Apparent wind angle in 0.01 degrees
+  uint16_t tws;        // True wind speed in 0.01 knots
+  uint16_t twa;        // True wind angle in 0.01 degrees
+  int16_t heel;        // Heel in 0.01 degrees
+  uint16_t hdm;        // Magnetic heading in 0.01 degrees
+};
+
+// Header at the start of every data block (24 bytes)
+struct __attribute__((packed)) LogBlockHeader {
+  uint32_t magic;      // LOG_BLOCK_MAGIC
+  uint32_t seq;        // Monotonic block sequence number
+  uint32_t firstUtc;   // UTC of the first record in the block
+  uint32_t lastUtc;    // UTC of the last record in the block
+  uint16_t count;      // Number of records in the block
+  uint16_t length;     // Payload bytes following the header
+  uint8_t encoding;    // LOG_ENCODING_*
+  uint8_t reserved[3];
+};
+
+#define LOG_PAYLOAD_SIZE (LOG_BLOCK_SIZE - sizeof(LogBlockHeader))
+
+// Conversion between log records and codec frames (TF_TIME in ms since baseUtc)
+void logRecordToFrame(const LogRecord &record, uint32_t baseUtc, TelemetryFrame &frame);
+void logFrameToRecord(const TelemetryFrame &frame, uint32_t baseUtc, LogRecord &record);
+
+class SessionLog {
+public:
+  // Open (or create) the log file; capacity is the number of data blocks kept
+  bool begin(fs::FS &fs, const char* path, uint32_t capacityBlocks);
+  bool isReady() const { return ready; }
+
+  // Append a record; records must be in non-decreasing UTC order
+  bool append(const LogRecord &record);
+
+  // Write the partially filled block and the file header to flash
+  bool flush();
+
+  // Drop all logged data
+  bool erase();
+
+  // Readable block range is [firstSeq(), endSeq()); the last block may be partial
+  uint32_t firstSeq() const { return oldestSeq; }
+  uint32_t endSeq() const { return openBlock.count > 0 ? openSeq + 1 : openSeq; }
+  uint32_t firstUtc();
+  uint32_t lastUtc() const { return lastRecordUtc; }
+
+  // Copy block `seq` (LOG_BLOCK_SIZE bytes) into `out`
+  bool readBlock(uint32_t seq, uint8_t* out);
+
+  // First block whose records end at or after `utc` (endSeq() if none)
+  uint32_t findBlock(uint32_t utc);
+
+private:
+  struct __attribute__((packed)) FileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t blockSize;
+    uint32_t capacity;
+    uint32_t oldestSeq;
+    uint32_t openSeq;
+  };
+
+  bool writeHeader();
+  bool writeOpenBlock();
+  bool commitOpenBlock();
+  bool readBlockHeader(uint32_t seq, LogBlockHeader &header);
+  size_t blockOffset(uint32_t seq) const { return (size_t)(1 + seq % capacity) * LOG_BLOCK_SIZE; }
+
+  fs::FS* fs = nullptr;
+  const char* path = nullptr;
+  bool ready = false;
+  uint32_t capacity = 0;
+  uint32_t oldestSeq = 0;
+  uint32_t openSeq = 0;
+  uint32_t lastRecordUtc = 0;
+
+  // Block currently being filled, kept in RAM until full or flushed
+  LogBlockHeader openBlock = {};
+  uint8_t openPayload[LOG_PAYLOAD_SIZE];
+  TelemetryEncoder encoder{0};
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Lock-free ring buffer for one producer task and one consumer task.
+//
+// The producer only writes `head` and the consumer only writes `tail`; each
+// publishes its index with a release store after copying the element, and
+// reads the other side's index with an acquire load. No lock is taken, so the
+// producer can be a callback on the NimBLE host task and never waits for the
+// consumer. When the ring is full, push() fails and the drop is counted; the
+// producer decides what to do about it.
+//
+// Capacity must be a power of two; one slot stays unused to tell a full ring
+// from an empty one. Elements are copied, so T should be trivially copyable.
+
+template <typename T, size_t Capacity>
+class SpscRing {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+  // Producer side
+  bool push(const T &item) {
+    size_t head = headIndex.load(std::memory_order_relaxed);
+    size_t next = (head + 1) & (Capacity - 1);
+    if (next == tailIndex.load(std::memory_order_acquire)) {
+      droppedCount.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    slots[head] = item;
+    headIndex.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side
+  bool pop(T &item) {
+    size_t tail = tailIndex.load(std::memory_order_relaxed);
+    if (tail == headIndex.load(std::memory_order_acquire)) return false;
+    item = slots[tail];
+    tailIndex.store((tail + 1) & (Capacity - 1), std::memory_order_release);
+    return true;
+  }
+
+  // Either side; only a snapshot while the other side is running
+  size_t size() const {
+    size_t head = headIndex.load(std::memory_order_acquire);
+    size_t tail = tailIndex.load(std::memory_order_acquire);
+    return (head - tail) & (Capacity - 1);
+  }
+  bool empty() const { return size() == 0; }
+  static constexpr size_t capacity() { return Capacity - 1; }
+  uint32_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+private:
+  T slots[Capacity];
+  std::atomic<size_t> headIndex{0};  // Next slot to write (producer)
+  std::atomic<size_t> tailIndex{0};  // Next slot to read (consumer)
+  std::atomic<uint32_t> droppedCount{0};
+};
@@ -0,0 +1,68 @@
+#include "StartLine.h"
+
+#include <math.h>
+
+static const float DEGREES_TO_RADIANS = (float)M_PI / 180.0f;
+static const float MPS_PER_KNOT = 0.514444f;
+
+static float wrap180(float angle) {
+  angle = fmodf(angle, 360.0f);
+  if (angle < -180.0f) angle += 360.0f;
+  if (angle >= 180.0f) angle -= 360.0f;
+  return angle;
+}
+
+bool StartLine::setLine(const GeoPoint &pin, const GeoPoint &boat) {
+  StartLine line;
+  line.plane.anchor(pin);
+
+  float dx, dy;
+  line.plane.project(boat, dx, dy);
+  line.lineLength = sqrtf(dx * dx + dy * dy);
+  if (!(line.lineLength >= START_LINE_MIN_LENGTH)) return false;
+  line.lineEast = dx / line.lineLength;
+  line.lineNorth = dy / line.lineLength;
+  line.hasLine = true;
+  *this = line;
+  return true;
+}
+
+float StartLine::bearing() const {
+  float degrees = atan2f(lineEast, lineNorth) / DEGREES_TO_RADIANS;
+  return degrees < 0 ? degrees + 360.0f : degrees;
+}
+
+void StartLine::update(const GeoPoint &position, float sog, float cog, float twd, float timeToStart,
+                       StartLineState &out) const {
+  out.valid = hasLine;
+  out.distance = NAN;
+  out.alongLine = NAN;
+  out.timeToLine = NAN;
+  out.timeToBurn = NAN;
+  out.bias = NAN;
+  out.biasMetres = NAN;
+  if (!hasLine) return;
+
+  // Course side normal: the line direction turned 90 degrees to the left
+  float normalEast = -lineNorth;
+  float normalNorth = lineEast;
+
+  if (!isnan(twd)) {
+    float normalBearing = atan2f(normalEast, normalNorth) / DEGREES_TO_RADIANS;
+    out.bias = wrap180(twd - normalBearing);
+    out.biasMetres = lineLength * fabsf(sinf(out.bias * DEGREES_TO_RADIANS));
+  }
+
+  float east, north;
+  plane.project(position, east, north);
+  out.distance = east * normalEast + north * normalNorth;
+  out.alongLine = (east * lineEast + north * lineNorth) / lineLength;
+
+  if (isnan(cog) || isnan(sog) || sog < START_LINE_MIN_SPEED) return;
+  float speed = sog * MPS_PER_KNOT;
+  float closing = speed * (sinf(cog * DEGREES_TO_RADIANS) * normalEast + cosf(cog * DEGREES_TO_RADIANS) * normalNorth);
+  if (out.distance * closing < 0) {
+    out.timeToLine = -out.distance / closing;
+    if (!isnan(timeToStart)) out.timeToBurn = timeToStart - out.timeToLine;
+  }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <Geodesy.h>
+
+// Start line geometry on a local east/north plane.
+//
+// The line runs from the pin (port end) to the committee boat (starboard
+// end). When both ends are set, setLine() anchors a LocalPlane (Geodesy.h)
+// at the pin, so every later fix costs an integer subtraction and a few
+// float multiplications instead of a haversine. Within a few kilometres of
+// the line the plane is accurate to centimetres.
+//
+// The course side is ahead of a boat that sees the pin on its left and the
+// committee boat on its right. Distances are signed: negative on the
+// pre-start side, positive over the line. Time to line is how long the boat
+// takes to reach the line at its current SOG and COG. Time to burn is the
+// time left before the start minus that. Line bias compares the line with
+// the true wind direction; a positive bias means the committee boat end is
+// favoured (further upwind).
+
+#define START_LINE_MIN_LENGTH 5.0f   // Metres; shorter lines are rejected
+#define START_LINE_MIN_SPEED 0.3f    // Knots; slower boats get no time to line
+
+enum StartLineEnd : uint8_t {
+  START_LINE_PIN = 0,   // Port end
+  START_LINE_BOAT = 1,  // Committee boat, starboard end
+};
+
+struct StartLineState {
+  bool valid;            // Line set and a position to compare against
+  float distance;        // Signed perpendicular distance to the line in metres (- = pre-start side)
+  float alongLine;       // Position along the line, 0 = pin, 1 = committee boat (outside 0..1 = past an end)
+  float timeToLine;      // Seconds to reach the line at SOG/COG, NAN when not closing on it
+  float timeToBurn;      // Seconds to spare before the start, NAN without a countdown or time to line
+  float bias;            // Degrees, + = committee boat end favoured, NAN without TWD
+  float biasMetres;      // Distance gained by starting at the favoured end, NAN without TWD
+};
+
+class StartLine {
+public:
+  // Set both ends; false when they are too close to form a line
+  bool setLine(const GeoPoint &pin, const GeoPoint &boat);
+  void clear() { hasLine = false; }
+  bool isSet() const { return hasLine; }
+
+  float length() const { return lineLength; }
+  float bearing() const;   // Pin to committee boat, degrees true
+
+  // One GPS fix: position, SOG (knots), COG (degrees, NAN when unknown),
+  // TWD (degrees, NAN when unknown) and seconds until the start (NAN
+  // without a countdown)
+  void update(const GeoPoint &position, float sog, float cog, float twd, float timeToStart, StartLineState &out) const;
+
+private:
+  bool hasLine = false;
+  LocalPlane plane;        // Tangent plane at the pin
+  float lineEast = 0;      // Unit vector pin -> committee boat
+  float lineNorth = 0;
+  float lineLength = 0;
+};
@@ -0,0 +1,175 @@
+#include "TelemetryCodec.h"
+
+#define TF_KEYFRAME   0x80
+#define TF_VALID_MASK 0x40
+#define TF_SEQ_MASK   0x3F
+
+// Angles wrap at one turn (0.01 degree units)
+static const int32_t ANGLE_TURN = 36000;
+
+static bool isAngle(int field) {
+  return field == TF_COG || field == TF_AWA || field == TF_TWA || field == TF_HDM || field == TF_TWD;
+}
+
+// Difference with two's complement wrap, so any int32 pair round-trips
+static int32_t fieldDelta(int field, int32_t value, int32_t previous) {
+  int32_t delta = (int32_t)((uint32_t)value - (uint32_t)previous);
+  if (isAngle(field)) {
+    delta %= ANGLE_TURN;
+    if (delta >= ANGLE_TURN / 2) delta -= ANGLE_TURN;
+    if (delta < -ANGLE_TURN / 2) delta += ANGLE_TURN;
+  }
+  return delta;
+}
+
+static int32_t applyDelta(int field, int32_t previous, int32_t delta) {
+  int32_t value = (int32_t)((uint32_t)previous + (uint32_t)delta);
+  if (isAngle(field)) {
+    value %= ANGLE_TURN;
+    if (value < 0) value += ANGLE_TURN;
+  }
+  return value;
+}
+
+size_t telemetryPutVarint(uint8_t* out, uint32_t value) {
+  size_t n = 0;
+  while (value >= 0x80) {
+    out[n++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[n++] = (uint8_t)value;
+  return n;
+}
+
+size_t telemetryGetVarint(const uint8_t* in, size_t length, uint32_t &value) {
+  value = 0;
+  for (size_t n = 0; n < length && n < 5; n++) {
+    value |= (uint32_t)(in[n] & 0x7F) << (7 * n);
+    if (!(in[n] & 0x80)) return n + 1;
+  }
+  return 0; // Truncated or overlong
+}
+
+size_t TelemetryEncoder::encode(const TelemetryFrame &frame, uint8_t* out) {
+  bool keyframe = !hasPrevious || (interval > 0 && sinceKeyframe >= interval);
+  size_t n = 1;
+
+  if (keyframe) {
+    out[0] = TF_KEYFRAME | TF_VALID_MASK;
+    n += telemetryPutVarint(out + n, frame.valid);
+    for (int f = 0; f < TF_FIELD_COUNT; f++) {
+      if (frame.valid & (1UL << f)) {
+        n += telemetryPutVarint(out + n, telemetryZigzag(frame.value[f]));
+      }
+    }
+    sinceKeyframe = 0;
+  } else {
+    out[0] = 0;
+    if (frame.valid != previous.valid) {
+      out[0] |= TF_VALID_MASK;
+      n += telemetryPutVarint(out + n, frame.valid);
+    }
+
+    // Only valid channels whose value moved are sent
+    uint32_t changed = 0;
+    int32_t deltas[TF_FIELD_COUNT];
+    for (int f = 0; f < TF_FIELD_COUNT; f++) {
+      if (!(frame.valid & (1UL << f))) continue;
+      deltas[f] = fieldDelta(f, frame.value[f], previous.value[f]);
+      if (deltas[f] != 0) changed |= 1UL << f;
+    }
+
+    n += telemetryPutVarint(out + n, changed);
+    for (int f = 0; f < TF_FIELD_COUNT; f++) {
+      if (changed & (1UL << f)) {
+        n += telemetryPutVarint(out + n, telemetryZigzag(deltas[f]));
+      }
+    }
+  }
+
+  out[0] |= sequence & TF_SEQ_MASK;
+  sequence++;
+  sinceKeyframe++;
+  frames++;
+
+  // Invalid channels keep their last value so deltas stay small when they
+  // return; a keyframe clears them so a freshly synced decoder agrees
+  for (int f = 0; f < TF_FIELD_COUNT; f++) {
+    if (frame.valid & (1UL << f)) {
+      previous.value[f] = frame.value[f];
+    } else if (keyframe) {
+      previous.value[f] = 0;
+    }
+  }
+  previous.valid = frame.valid;
+  hasPrevious = true;
+  return n;
+}
+
+size_t TelemetryDecoder::decode(const uint8_t* in, size_t length, TelemetryFrame &frame) {
+  if (length < 2) return 0;
+
+  uint8_t head = in[0];
+  bool keyframe = head & TF_KEYFRAME;
+  uint8_t seq = head & TF_SEQ_MASK;
+
+  // A gap in the sequence means a delta was lost - wait for the next keyframe
+  if (!keyframe && (!synced || seq != expectedSequence)) {
+    synced = false;
+    return 0;
+  }
+
+  size_t n = 1;
+  uint32_t v;
+  TelemetryFrame next = current;
+
+  if (head & TF_VALID_MASK) {
+    size_t used = telemetryGetVarint(in + n, length - n, v);
+    if (!used) return 0;
+    n += used;
+    next.valid = v;
+  }
+
+  if (keyframe) {
+    for (int f = 0; f < TF_FIELD_COUNT; f++) {
+      next.value[f] = 0;
+      if (!(next.valid & (1UL << f))) continue;
+      size_t used = telemetryGetVarint(in + n, length - n, v);
+      if (!used) return 0;
+      n += used;
+      next.value[f] = telemetryUnzigzag(v);
+    }
+  } else {
+    uint32_t changed;
+    size_t used = telemetryGetVarint(in + n, length - n, changed);
+    if (!used) return 0;
+    n += used;
+    for (int f = 0; f < TF_FIELD_COUNT; f++) {
+      if (!(changed & (1UL << f))) continue;
+      used = telemetryGetVarint(in + n, length - n, v);
+      if (!used) return 0;
+      n += used;
+      next.value[f] = applyDelta(f, next.value[f], telemetryUnzigzag(v));
+    }
+  }
+
+  current = next;
+  synced = true;
+  expectedSequence = (seq + 1) & TF_SEQ_MASK;
+  frame = current;
+  return n;
+}
+
+uint32_t TelemetryHistory::push(TelemetryFrame &frame) {
+  uint32_t seq = nextSeq++;
+  frame.set(TF_SEQ, (int32_t)seq);
+  frames[seq % TELEMETRY_HISTORY_FRAMES] = frame;
+  if (count < TELEMETRY_HISTORY_FRAMES) count++;
+  return seq;
+}
+
+bool TelemetryHistory::get(uint32_t seq, TelemetryFrame &frame) const {
+  if (seq - firstSeq() >= count) return false;  // Also rejects seq < firstSeq() (wraps)
+  frame = frames[seq % TELEMETRY_HISTORY_FRAMES];
+  return true;
+}
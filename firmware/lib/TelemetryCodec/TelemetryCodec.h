@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Delta/varint codec for telemetry snapshots.
+//
+// A frame is a fixed set of integer channels in fixed-point units. The
+// encoder emits a keyframe (absolute values) and then only the channels that
+// changed since the previous frame, as zigzag varint deltas. Angles
+// (0..35999) are delta-coded modulo one turn so 359° -> 1° costs one byte.
+// A keyframe is forced every `keyframeInterval` frames so a receiver that
+// missed a frame resynchronises on its own.
+//
+// Frame layout:
+//   byte 0      bit 7 = keyframe, bit 6 = valid mask follows, bits 0-5 = sequence
+//   [varint]    valid mask (always on keyframes, on deltas only when it changed)
+//   keyframe:   zigzag varint value for every valid channel, in channel order
+//   delta:      varint changed mask, then zigzag varint delta per changed channel
+
+enum TelemetryField {
+  TF_TIME = 0,  // Sample time in ms (wraps at 2^32)
+  TF_LAT,       // Latitude in 1e-7 degrees
+  TF_LON,       // Longitude in 1e-7 degrees
+  TF_SOG,       // Speed over ground in 0.01 knots
+  TF_COG,       // Course over ground in 0.01 degrees
+  TF_AWS,       // Apparent wind speed in 0.01 knots
+  TF_AWA,       // Apparent wind angle in 0.01 degrees
+  TF_TWS,       // True wind speed in 0.01 knots
+  TF_TWA,       // True wind angle in 0.01 degrees
+  TF_HEEL,      // Heel in 0.01 degrees
+  TF_HDM,       // Magnetic heading in 0.01 degrees
+  TF_SATS,      // Satellites in use
+  TF_HDOP,      // HDOP in 0.1 units
+  TF_ACCEL_X,   // Acceleration in 0.01 m/s²
+  TF_ACCEL_Y,
+  TF_ACCEL_Z,
+  TF_RSSI,      // BLE RSSI in dBm
+  TF_SEQ,       // Publish sequence, one per published frame (set by TelemetryHistory)
+  TF_TWD,       // True wind direction in 0.01 degrees
+  TF_FIELD_COUNT
+};
+
+#define TF_MAX_FRAME_SIZE (1 + 5 + 5 + TF_FIELD_COUNT * 5)
+
+struct TelemetryFrame {
+  int32_t value[TF_FIELD_COUNT];
+  uint32_t valid;  // Bit per TelemetryField
+
+  void set(TelemetryField field, int32_t v) { value[field] = v; valid |= 1UL << field; }
+  bool has(TelemetryField field) const { return valid & (1UL << field); }
+};
+
+class TelemetryEncoder {
+public:
+  // keyframeInterval = 0 disables periodic keyframes (only the first frame is one)
+  explicit TelemetryEncoder(uint16_t keyframeInterval = 30) : interval(keyframeInterval) {}
+
+  // Encode `frame` into `out`; returns the byte count (at most TF_MAX_FRAME_SIZE)
+  size_t encode(const TelemetryFrame &frame, uint8_t* out);
+
+  // Make the next frame a keyframe (new subscriber, lost frame, new log block)
+  void reset() { sinceKeyframe = 0; hasPrevious = false; }
+
+  uint32_t framesEncoded() const { return frames; }
+
+private:
+  uint16_t interval;
+  uint16_t sinceKeyframe = 0;
+  bool hasPrevious = false;
+  uint8_t sequence = 0;
+  uint32_t frames = 0;
+  TelemetryFrame previous = {};
+};
+
+class TelemetryDecoder {
+public:
+  // Decode one frame from `in`; returns bytes consumed, 0 on error or while
+  // waiting for a keyframe after a sequence gap
+  size_t decode(const uint8_t* in, size_t length, TelemetryFrame &frame);
+
+  void reset() { synced = false; }
+
+private:
+  bool synced = false;
+  uint8_t expectedSequence = 0;
+  TelemetryFrame current = {};
+};
+
+// Recent frames by sequence number, so a client can back-fill a gap after a
+// short disconnect. push() numbers the frame (TF_SEQ) and keeps the last
+// TELEMETRY_HISTORY_FRAMES of them; older sequences are no longer available.
+#ifndef TELEMETRY_HISTORY_FRAMES
+#define TELEMETRY_HISTORY_FRAMES 180
+#endif
+
+class TelemetryHistory {
+public:
+  // Assign the next sequence to `frame` and store it; returns the sequence
+  uint32_t push(TelemetryFrame &frame);
+
+  // Stored frame with sequence `seq`, false if it is not (or no longer) kept
+  bool get(uint32_t seq, TelemetryFrame &frame) const;
+
+  // Kept sequences are [firstSeq(), endSeq())
+  uint32_t firstSeq() const { return nextSeq - count; }
+  uint32_t endSeq() const { return nextSeq; }
+
+private:
+  TelemetryFrame frames[TELEMETRY_HISTORY_FRAMES];
+  uint32_t nextSeq = 0;
+  uint32_t count = 0;
+};
+
+// Varint helpers shared with other binary formats
+size_t telemetryPutVarint(uint8_t* out, uint32_t value);
+size_t telemetryGetVarint(const uint8_t* in, size_t length, uint32_t &value);
+inline uint32_t telemetryZigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+inline int32_t telemetryUnzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
@@ -0,0 +1,152 @@
+// Host benchmark for TelemetryCodec: compression ratio and encode/decode cost.
+//
+// Build and run on the development machine (no Arduino dependencies):
+//   cd firmware/lib/TelemetryCodec
+//   g++ -O2 -I . TelemetryCodec.cpp examples/codec_benchmark/codec_benchmark.cpp -o codec_benchmark
+//   ./codec_benchmark [recording.csv]
+//
+// The CSV has one sample per line:
+//   time_ms,lat,lon,sog_kt,cog_deg,aws_kt,awa_deg,tws_kt,twa_deg,heel_deg,hdm_deg
+// Without a file a synthetic 1 Hz upwind/downwind session is generated.
+// firmware/test/replay/telemetry.csv is the replayed test session in this
+// format.
+
+#include <TelemetryCodec.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+struct Sample {
+  double timeMs, lat, lon, sog, cog, aws, awa, tws, twa, heel, hdm;
+};
+
+static std::vector<Sample> loadCsv(const char* path) {
+  std::vector<Sample> samples;
+  FILE* file = fopen(path, "r");
+  if (!file) return samples;
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    Sample s;
+    if (sscanf(line, "%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf", &s.timeMs, &s.lat, &s.lon, &s.sog,
+               &s.cog, &s.aws, &s.awa, &s.tws, &s.twa, &s.heel, &s.hdm) == 11) {
+      samples.push_back(s);
+    }
+  }
+  fclose(file);
+  return samples;
+}
+
+static std::vector<Sample> synthesize(int count) {
+  std::vector<Sample> samples;
+  double lat = 50.0876, lon = 14.4208;
+  srand(42);
+  for (int i = 0; i < count; i++) {
+    bool upwind = (i / 600) % 2 == 0;  // Ten minute legs
+    double noise = (rand() % 100 - 50) / 100.0;
+    Sample s;
+    s.timeMs = i * 1000.0;
+    s.cog = fmod((upwind ? 40.0 : 200.0) + noise * 3 + 360.0, 360.0);
+    s.sog = (upwind ? 5.5 : 7.0) + noise * 0.3;
+    s.hdm = fmod(s.cog - 4 + noise * 2 + 360.0, 360.0);
+    s.aws = (upwind ? 14.0 : 8.0) + noise;
+    s.awa = upwind ? 32 + noise * 4 : 150 + noise * 6;
+    s.tws = 10.0 + noise * 0.5;
+    s.twa = upwind ? 45 + noise * 3 : 160 + noise * 4;
+    s.heel = (upwind ? 18.0 : 4.0) + noise * 2;
+    double metres = s.sog * 0.5144;
+    lat += metres * cos(s.cog * M_PI / 180.0) / 111320.0;
+    lon += metres * sin(s.cog * M_PI / 180.0) / (111320.0 * cos(lat * M_PI / 180.0));
+    s.lat = lat;
+    s.lon = lon;
+    samples.push_back(s);
+  }
+  return samples;
+}
+
+// Fields missing from a recording (nan) are left out, as on the device
+static void toFrame(const Sample &s, TelemetryFrame &frame) {
+  frame = {};
+  frame.set(TF_TIME, (int32_t)s.timeMs);
+  frame.set(TF_LAT, (int32_t)lround(s.lat * 1e7));
+  frame.set(TF_LON, (int32_t)lround(s.lon * 1e7));
+  frame.set(TF_SOG, (int32_t)lround(s.sog * 100));
+  if (!std::isnan(s.cog)) frame.set(TF_COG, (int32_t)lround(s.cog * 100) % 36000);
+  if (!std::isnan(s.aws)) frame.set(TF_AWS, (int32_t)lround(s.aws * 100));
+  if (!std::isnan(s.awa)) frame.set(TF_AWA, (int32_t)lround(s.awa * 100) % 36000);
+  if (!std::isnan(s.tws)) frame.set(TF_TWS, (int32_t)lround(s.tws * 100));
+  if (!std::isnan(s.twa)) frame.set(TF_TWA, (int32_t)lround(s.twa * 100) % 36000);
+  if (!std::isnan(s.heel)) frame.set(TF_HEEL, (int32_t)lround(s.heel * 100));
+  if (!std::isnan(s.hdm)) frame.set(TF_HDM, (int32_t)lround(s.hdm * 100) % 36000);
+}
+
+// Same field set and rounding as getSensorDataJson(), which leaves out what
+// is missing
+static int jsonSize(const Sample &s) {
+  char buffer[400];
+  int n = snprintf(buffer, sizeof(buffer), "{\"SOG\":%.1f,\"lat\":%.5f,\"lon\":%.5f,\"COG\":%d,\"satellites\":9,"
+                   "\"hdop\":0.9", s.sog, s.lat, s.lon, std::isnan(s.cog) ? 0 : (int)s.cog);
+  if (!std::isnan(s.aws)) n += snprintf(buffer + n, sizeof(buffer) - n, ",\"AWS\":%.1f", s.aws);
+  if (!std::isnan(s.awa)) n += snprintf(buffer + n, sizeof(buffer) - n, ",\"AWA\":%d", (int)s.awa);
+  if (!std::isnan(s.tws)) n += snprintf(buffer + n, sizeof(buffer) - n, ",\"TWS\":%.1f", s.tws);
+  if (!std::isnan(s.twa)) n += snprintf(buffer + n, sizeof(buffer) - n, ",\"TWA\":%d", (int)s.twa);
+  if (!std::isnan(s.heel)) n += snprintf(buffer + n, sizeof(buffer) - n, ",\"heel\":%.1f", s.heel);
+  if (!std::isnan(s.hdm)) n += snprintf(buffer + n, sizeof(buffer) - n, ",\"HDM\":%d", (int)s.hdm);
+  n += snprintf(buffer + n, sizeof(buffer) - n, ",\"rssi\":-60,\"regatta\":false,\"deviceName\":\"Veetr\"}");
+  return n;
+}
+
+int main(int argc, char** argv) {
+  std::vector<Sample> samples = argc > 1 ? loadCsv(argv[1]) : synthesize(3600 * 4);
+  if (samples.empty()) {
+    fprintf(stderr, "No samples loaded\n");
+    return 1;
+  }
+
+  std::vector<TelemetryFrame> frames(samples.size());
+  size_t jsonBytes = 0;
+  for (size_t i = 0; i < samples.size(); i++) {
+    toFrame(samples[i], frames[i]);
+    jsonBytes += jsonSize(samples[i]);
+  }
+
+  std::vector<uint8_t> stream(frames.size() * TF_MAX_FRAME_SIZE);
+  std::vector<size_t> lengths(frames.size());
+  TelemetryEncoder encoder(30);
+  size_t encodedBytes = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < frames.size(); i++) {
+    lengths[i] = encoder.encode(frames[i], stream.data() + encodedBytes);
+    encodedBytes += lengths[i];
+  }
+  auto encoded = std::chrono::steady_clock::now();
+
+  TelemetryDecoder decoder;
+  size_t offset = 0, mismatches = 0;
+  for (size_t i = 0; i < frames.size(); i++) {
+    TelemetryFrame out;
+    offset += decoder.decode(stream.data() + offset, lengths[i], out);
+    // Absent fields keep their last value in the decoder, only present ones count
+    if (out.valid != frames[i].valid) mismatches++;
+    for (int f = 0; f < TF_FIELD_COUNT; f++) {
+      if (frames[i].has((TelemetryField)f) && out.value[f] != frames[i].value[f]) mismatches++;
+    }
+  }
+  auto decoded = std::chrono::steady_clock::now();
+
+  double n = (double)frames.size();
+  double encodeNs = std::chrono::duration<double, std::nano>(encoded - start).count() / n;
+  double decodeNs = std::chrono::duration<double, std::nano>(decoded - encoded).count() / n;
+
+  printf("frames:            %zu\n", frames.size());
+  printf("JSON bytes/frame:  %.1f\n", jsonBytes / n);
+  printf("codec bytes/frame: %.1f (keyframe every 30)\n", encodedBytes / n);
+  printf("ratio vs JSON:     %.1fx\n", (double)jsonBytes / encodedBytes);
+  printf("encode:            %.0f ns/frame\n", encodeNs);
+  printf("decode:            %.0f ns/frame\n", decodeNs);
+  printf("round trip:        %s\n", mismatches ? "MISMATCH" : "exact");
+  return mismatches ? 1 : 0;
+}
@@ -0,0 +1,437 @@
+#include "TelemetryServer.h"
+
+#include <string.h>
+#include <strings.h>
+
+#define WS_OP_TEXT 0x1
+#define WS_OP_BINARY 0x2
+#define WS_OP_CLOSE 0x8
+#define WS_OP_PING 0x9
+#define WS_OP_PONG 0xA
+#define WS_FIN 0x80
+#define WS_MASK 0x80
+#define WS_CLOSE_PROTOCOL_ERROR 1002
+#define WS_CLOSE_TOO_BIG 1009
+
+static const char WS_GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// SHA-1 (FIPS 180-4), only for the handshake
+struct Sha1 {
+  uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+  uint8_t block[64];
+  size_t blockLength = 0;
+  uint64_t totalLength = 0;
+
+  static uint32_t rotl(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+  void compress() {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+      w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 | (uint32_t)block[i * 4 + 2] << 8 |
+             block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+      uint32_t f, k;
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      } else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+      uint32_t t = rotl(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = rotl(b, 30);
+      b = a;
+      a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+
+  void update(const uint8_t* data, size_t length) {
+    totalLength += length;
+    while (length--) {
+      block[blockLength++] = *data++;
+      if (blockLength == 64) {
+        compress();
+        blockLength = 0;
+      }
+    }
+  }
+
+  void finish(uint8_t digest[20]) {
+    uint64_t bits = totalLength * 8;
+    uint8_t pad = 0x80;
+    update(&pad, 1);
+    pad = 0;
+    while (blockLength != 56) update(&pad, 1);
+    for (int i = 7; i >= 0; i--) {
+      uint8_t byte = (uint8_t)(bits >> (i * 8));
+      update(&byte, 1);
+    }
+    for (int i = 0; i < 20; i++) digest[i] = (uint8_t)(h[i / 4] >> (24 - (i % 4) * 8));
+  }
+};
+
+static size_t base64Encode(const uint8_t* data, size_t length, char* out) {
+  static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t used = 0;
+  for (size_t i = 0; i < length; i += 3) {
+    uint32_t group = (uint32_t)data[i] << 16;
+    if (i + 1 < length) group |= (uint32_t)data[i + 1] << 8;
+    if (i + 2 < length) group |= data[i + 2];
+    out[used++] = alphabet[group >> 18 & 0x3F];
+    out[used++] = alphabet[group >> 12 & 0x3F];
+    out[used++] = i + 1 < length ? alphabet[group >> 6 & 0x3F] : '=';
+    out[used++] = i + 2 < length ? alphabet[group & 0x3F] : '=';
+  }
+  out[used] = '\0';
+  return used;
+}
+
+void webSocketAccept(const char* key, size_t keyLength, char* out) {
+  Sha1 sha;
+  uint8_t digest[20];
+  sha.update((const uint8_t*)key, keyLength);
+  sha.update((const uint8_t*)WS_GUID, sizeof(WS_GUID) - 1);
+  sha.finish(digest);
+  base64Encode(digest, sizeof(digest), out);
+}
+
+// Value of header `name` in a request (case-insensitive name), trimmed; false when absent
+static bool findHeader(const char* request, const char* name, const char* &value, size_t &length) {
+  size_t nameLength = strlen(name);
+  const char* line = strstr(request, "\r\n");
+  while (line && line[2] != '\r') {
+    line += 2;
+    const char* end = strstr(line, "\r\n");
+    if (!end) return false;
+    if ((size_t)(end - line) > nameLength && line[nameLength] == ':' && strncasecmp(line, name, nameLength) == 0) {
+      value = line + nameLength + 1;
+      while (value < end && *value == ' ') value++;
+      length = end - value;
+      while (length && value[length - 1] == ' ') length--;
+      return true;
+    }
+    line = end;
+  }
+  return false;
+}
+
+// `token` in a comma-separated header value, case-insensitive
+static bool headerHasToken(const char* value, size_t length, const char* token) {
+  size_t tokenLength = strlen(token);
+  for (size_t i = 0; i + tokenLength <= length; i++) {
+    if (strncasecmp(value + i, token, tokenLength) == 0) return true;
+  }
+  return false;
+}
+
+void TelemetryServer::poll(uint32_t time) {
+  now = time;
+  accept(TELEMETRY_SERVER_HTTP_PORT, TS_CLIENT_HTTP);
+  accept(TELEMETRY_SERVER_NMEA_PORT, TS_CLIENT_NMEA);
+
+  for (Client &client : slots) {
+    if (client.kind == TS_CLIENT_FREE) continue;
+    receive(client);
+    if (client.kind == TS_CLIENT_FREE) continue;
+    flush(client);
+    if (client.kind == TS_CLIENT_FREE) continue;
+
+    uint32_t idle = now - client.lastProgress;
+    if (client.kind == TS_CLIENT_HTTP && idle > TELEMETRY_SERVER_HANDSHAKE_MS) {
+      counters.rejected++;
+      close(client);
+    } else if ((client.count || client.closing) && idle > TELEMETRY_SERVER_STALL_MS) {
+      counters.evicted++;
+      close(client);
+    }
+  }
+}
+
+void TelemetryServer::accept(uint16_t port, TelemetryClientKind kind) {
+  for (;;) {
+    int connection = tcp.accept(port);
+    if (connection < 0) return;
+    Client* slot = nullptr;
+    for (Client &client : slots) {
+      if (client.kind == TS_CLIENT_FREE) {
+        slot = &client;
+        break;
+      }
+    }
+    if (!slot) {
+      counters.rejected++;
+      tcp.close(connection);
+      continue;
+    }
+    slot->kind = kind;
+    slot->connection = connection;
+    slot->closing = false;
+    slot->lastProgress = now;
+    slot->inputLength = 0;
+    slot->head = 0;
+    slot->count = 0;
+    slot->encoder.reset();
+    counters.accepted++;
+  }
+}
+
+void TelemetryServer::receive(Client &client) {
+  for (;;) {
+    uint8_t discard[64];
+    bool keep = client.kind != TS_CLIENT_NMEA && !client.closing;
+    uint8_t* buffer = keep ? client.input + client.inputLength : discard;
+    size_t space = keep ? sizeof(client.input) - client.inputLength : sizeof(discard);
+    if (space == 0) {
+      // A request or frame larger than the input buffer
+      counters.rejected++;
+      if (client.kind == TS_CLIENT_HTTP) {
+        respond(client, "431 Request Header Fields Too Large");
+      } else {
+        uint8_t status[2] = {WS_CLOSE_TOO_BIG >> 8, WS_CLOSE_TOO_BIG & 0xFF};
+        enqueueMessage(client, WS_OP_CLOSE, status, sizeof(status));
+        client.closing = true;
+      }
+      return;
+    }
+    int received = tcp.receive(client.connection, buffer, space);
+    if (received < 0) {
+      close(client);
+      return;
+    }
+    if (received == 0) return;
+    if (!keep) continue;
+    client.inputLength += received;
+    if (client.kind == TS_CLIENT_HTTP) {
+      handleRequest(client);
+    } else {
+      handleFrames(client);
+    }
+    if (client.kind == TS_CLIENT_FREE) return;
+  }
+}
+
+void TelemetryServer::respond(Client &client, const char* status) {
+  char response[96];
+  size_t length = 0;
+  const char* parts[] = {"HTTP/1.1 ", status, "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"};
+  for (const char* part : parts) {
+    size_t partLength = strlen(part);
+    memcpy(response + length, part, partLength);
+    length += partLength;
+  }
+  enqueue(client, (const uint8_t*)response, length);
+  client.closing = true;
+}
+
+// Once the request is complete: upgrade to a WebSocket or answer with an error and close
+void TelemetryServer::handleRequest(Client &client) {
+  if (client.inputLength >= sizeof(client.input)) return;   // Too long; receive() answers
+  client.input[client.inputLength] = 0;
+  const char* request = (const char*)client.input;
+  const char* end = strstr(request, "\r\n\r\n");
+  if (!end) return;
+
+  const char* path = strncmp(request, "GET ", 4) == 0 ? request + 4 : nullptr;
+  size_t pathLength = path ? strcspn(path, " ?\r") : 0;
+  TelemetryClientKind kind = TS_CLIENT_FREE;
+  if (path && ((pathLength == 1 && path[0] == '/') || (pathLength == 5 && strncmp(path, "/json", 5) == 0))) {
+    kind = TS_CLIENT_JSON;
+  } else if (path && pathLength == 10 && strncmp(path, "/telemetry", 10) == 0) {
+    kind = TS_CLIENT_BINARY;
+  }
+
+  const char* value;
+  size_t valueLength;
+  const char* key = nullptr;
+  size_t keyLength = 0;
+  bool upgrade = findHeader(request, "Upgrade", value, valueLength) &&
+                 headerHasToken(value, valueLength, "websocket") &&
+                 findHeader(request, "Sec-WebSocket-Key", key, keyLength) && keyLength > 0 && keyLength < 64;
+
+  if (!path) {
+    client.inputLength = 0;
+    counters.rejected++;
+    respond(client, "405 Method Not Allowed");
+    return;
+  }
+  if (kind == TS_CLIENT_FREE) {
+    client.inputLength = 0;
+    counters.rejected++;
+    respond(client, "404 Not Found");
+    return;
+  }
+  if (!upgrade) {
+    client.inputLength = 0;
+    counters.rejected++;
+    respond(client, "426 Upgrade Required");
+    return;
+  }
+
+  char accept[29];
+  webSocketAccept(key, keyLength, accept);
+  static const char head[] =
+    "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: ";
+  enqueue(client, (const uint8_t*)head, sizeof(head) - 1);
+  enqueue(client, (const uint8_t*)accept, strlen(accept));
+  enqueue(client, (const uint8_t*)"\r\n\r\n", 4);
+  client.kind = kind;
+
+  // Frames the client sent right behind its request
+  size_t requestLength = end + 4 - request;
+  memmove(client.input, client.input + requestLength, client.inputLength - requestLength);
+  client.inputLength -= requestLength;
+  handleFrames(client);
+}
+
+// Client frames: answer pings and close frames, ignore data
+void TelemetryServer::handleFrames(Client &client) {
+  while (client.inputLength >= 2 && !client.closing) {
+    const uint8_t* frame = client.input;
+    uint8_t opcode = frame[0] & 0x0F;
+    size_t payloadLength = frame[1] & 0x7F;
+    size_t headerLength = 2;
+    if (!(frame[1] & WS_MASK) || payloadLength == 127) {
+      // Unmasked (not allowed from a client) or a 64-bit length we never buffer
+      uint16_t code = (frame[1] & WS_MASK) ? WS_CLOSE_TOO_BIG : WS_CLOSE_PROTOCOL_ERROR;
+      uint8_t status[2] = {(uint8_t)(code >> 8), (uint8_t)code};
+      counters.rejected++;
+      enqueueMessage(client, WS_OP_CLOSE, status, sizeof(status));
+      client.closing = true;
+      return;
+    }
+    if (payloadLength == 126) {
+      if (client.inputLength < 4) return;
+      payloadLength = (size_t)frame[2] << 8 | frame[3];
+      headerLength = 4;
+    }
+    const uint8_t* mask = frame + headerLength;
+    headerLength += 4;
+    if (headerLength + payloadLength > sizeof(client.input)) {
+      return;   // receive() closes it once the buffer is full
+    }
+    if (client.inputLength < headerLength + payloadLength) return;
+
+    uint8_t* payload = client.input + headerLength;
+    for (size_t i = 0; i < payloadLength; i++) payload[i] ^= mask[i & 3];
+    if (opcode == WS_OP_PING) {
+      enqueueMessage(client, WS_OP_PONG, payload, payloadLength < 125 ? payloadLength : 125);
+    } else if (opcode == WS_OP_CLOSE) {
+      enqueueMessage(client, WS_OP_CLOSE, payload, payloadLength < 2 ? payloadLength : 2);
+      client.closing = true;
+    }
+
+    size_t consumed = headerLength + payloadLength;
+    memmove(client.input, client.input + consumed, client.inputLength - consumed);
+    client.inputLength -= consumed;
+  }
+}
+
+void TelemetryServer::flush(Client &client) {
+  while (client.count) {
+    size_t contiguous = sizeof(client.queue) - client.head;
+    if (contiguous > client.count) contiguous = client.count;
+    int sent = tcp.send(client.connection, client.queue + client.head, contiguous);
+    if (sent < 0) {
+      close(client);
+      return;
+    }
+    if (sent == 0) return;
+    client.head = (uint16_t)((client.head + sent) % sizeof(client.queue));
+    client.count -= sent;
+    client.lastProgress = now;
+  }
+  if (client.closing) close(client);
+}
+
+void TelemetryServer::close(Client &client) {
+  tcp.close(client.connection);
+  client.kind = TS_CLIENT_FREE;
+  client.connection = -1;
+}
+
+void TelemetryServer::closeAll() {
+  for (Client &client : slots) {
+    if (client.kind != TS_CLIENT_FREE) close(client);
+  }
+}
+
+bool TelemetryServer::enqueue(Client &client, const uint8_t* data, size_t length) {
+  if (length > sizeof(client.queue) - client.count) return false;
+  if (client.count == 0) client.lastProgress = now;   // The stall timer starts with the first queued byte
+  size_t tail = (client.head + client.count) % sizeof(client.queue);
+  size_t first = sizeof(client.queue) - tail;
+  if (first > length) first = length;
+  memcpy(client.queue + tail, data, first);
+  memcpy(client.queue, data + first, length - first);
+  client.count += length;
+  return true;
+}
+
+// One unmasked WebSocket message, queued whole or not at all
+bool TelemetryServer::enqueueMessage(Client &client, uint8_t opcode, const uint8_t* payload, size_t length) {
+  uint8_t header[4] = {(uint8_t)(WS_FIN | opcode)};
+  size_t headerLength = 2;
+  if (length < 126) {
+    header[1] = (uint8_t)length;
+  } else {
+    header[1] = 126;
+    header[2] = (uint8_t)(length >> 8);
+    header[3] = (uint8_t)length;
+    headerLength = 4;
+  }
+  if (headerLength + length > sizeof(client.queue) - client.count) return false;
+  enqueue(client, header, headerLength);
+  enqueue(client, payload, length);
+  return true;
+}
+
+void TelemetryServer::publishFrame(const TelemetryFrame &frame) {
+  for (Client &client : slots) {
+    if (client.kind != TS_CLIENT_BINARY || client.closing) continue;
+    uint8_t encoded[TF_MAX_FRAME_SIZE];
+    size_t length = client.encoder.encode(frame, encoded);
+    if (!enqueueMessage(client, WS_OP_BINARY, encoded, length)) {
+      // The delta chain is broken: start over with a keyframe
+      client.encoder.reset();
+      counters.dropped++;
+    }
+  }
+}
+
+void TelemetryServer::publishJson(const char* text, size_t length) {
+  for (Client &client : slots) {
+    if (client.kind != TS_CLIENT_JSON || client.closing) continue;
+    if (!enqueueMessage(client, WS_OP_TEXT, (const uint8_t*)text, length)) counters.dropped++;
+  }
+}
+
+void TelemetryServer::publishNmea(const char* text, size_t length) {
+  for (Client &client : slots) {
+    if (client.kind != TS_CLIENT_NMEA || client.closing) continue;
+    if (!enqueue(client, (const uint8_t*)text, length)) counters.dropped++;
+  }
+}
+
+uint8_t TelemetryServer::clients(TelemetryClientKind kind) const {
+  uint8_t count = 0;
+  for (const Client &client : slots) {
+    if (client.kind == kind) count++;
+  }
+  return count;
+}
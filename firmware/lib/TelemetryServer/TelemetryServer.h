@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <Hal.h>
+#include <TelemetryCodec.h>
+
+// Telemetry for Wi-Fi clients: WebSocket on the HTTP port, NMEA 0183 on TCP.
+//
+// Clients are accepted on two ports:
+//   TELEMETRY_SERVER_HTTP_PORT  WebSocket upgrade (RFC 6455); the path picks the stream:
+//                               "/" or "/json"  JSON snapshots as text messages
+//                               "/telemetry"    TelemetryCodec frames as binary messages
+//   TELEMETRY_SERVER_NMEA_PORT  NMEA 0183 sentences as a raw byte stream (incoming data ignored)
+// Every client gets the same snapshots, pushed by publish*(); binary
+// clients have their own encoder, so each stream starts on a keyframe.
+//
+// Backpressure is per client. Each one has a queue of whole messages that
+// poll() hands to the stack as far as it takes them; a message that does not
+// fit is dropped whole (a binary client's next frame is then a keyframe),
+// so a slow client loses snapshots instead of holding up the others. A
+// client that takes nothing for TELEMETRY_SERVER_STALL_MS with data waiting
+// is closed. All network access goes through hal::Tcp and never blocks, so
+// the server runs in a task of its own (or on the host against a stand-in).
+
+#define TELEMETRY_SERVER_HTTP_PORT 80
+#define TELEMETRY_SERVER_NMEA_PORT 10110         // NMEA over TCP, as expected by OpenCPN and others
+#define TELEMETRY_SERVER_MAX_CLIENTS 6
+#define TELEMETRY_SERVER_QUEUE 2048              // Bytes queued per client
+#define TELEMETRY_SERVER_INPUT 512               // HTTP request or incoming WebSocket frame
+#define TELEMETRY_SERVER_STALL_MS 10000          // Queue not moving for this long closes the client
+#define TELEMETRY_SERVER_HANDSHAKE_MS 5000       // Time to send the upgrade request
+
+enum TelemetryClientKind : uint8_t {
+  TS_CLIENT_FREE = 0,
+  TS_CLIENT_HTTP,       // Connected, request not complete yet
+  TS_CLIENT_JSON,       // WebSocket, JSON text messages
+  TS_CLIENT_BINARY,     // WebSocket, TelemetryCodec binary messages
+  TS_CLIENT_NMEA,       // Raw TCP, NMEA 0183 sentences
+};
+
+struct TelemetryServerStats {
+  uint32_t accepted;
+  uint32_t rejected;    // No free client slot, bad request or protocol error
+  uint32_t evicted;     // Closed for not taking data
+  uint32_t dropped;     // Messages that did not fit a client's queue
+};
+
+class TelemetryServer {
+public:
+  explicit TelemetryServer(hal::Tcp &tcp) : tcp(tcp) {}
+
+  // Accept, read requests and control frames, send what the stack takes,
+  // close stalled clients. Call every few milliseconds
+  void poll(uint32_t now);
+
+  // Queue one snapshot for every client of the matching kind
+  void publishFrame(const TelemetryFrame &frame);
+  void publishJson(const char* text, size_t length);
+  void publishNmea(const char* text, size_t length);
+
+  void closeAll();
+
+  uint8_t clients(TelemetryClientKind kind) const;
+  const TelemetryServerStats &stats() const { return counters; }
+
+private:
+  struct Client {
+    TelemetryClientKind kind = TS_CLIENT_FREE;
+    int connection = -1;
+    bool closing = false;      // Close once the queue is sent (error response, close frame)
+    uint32_t lastProgress = 0; // Accept time, then when the stack last took bytes or the queue filled
+    uint16_t inputLength = 0;
+    uint16_t head = 0;         // Oldest queued byte
+    uint16_t count = 0;        // Queued bytes
+    uint8_t input[TELEMETRY_SERVER_INPUT];
+    uint8_t queue[TELEMETRY_SERVER_QUEUE];
+    TelemetryEncoder encoder;
+  };
+
+  void accept(uint16_t port, TelemetryClientKind kind);
+  void receive(Client &client);
+  void handleRequest(Client &client);
+  void handleFrames(Client &client);
+  void flush(Client &client);
+  void close(Client &client);
+
+  bool enqueue(Client &client, const uint8_t* data, size_t length);
+  bool enqueueMessage(Client &client, uint8_t opcode, const uint8_t* payload, size_t length);
+  void respond(Client &client, const char* status);
+
+  hal::Tcp &tcp;
+  Client slots[TELEMETRY_SERVER_MAX_CLIENTS];
+  uint32_t now = 0;
+  TelemetryServerStats counters = {};
+};
+
+// Sec-WebSocket-Accept for a Sec-WebSocket-Key (base64 of SHA-1 of key +
+// RFC 6455 GUID); `out` takes 29 characters with the terminator
+void webSocketAccept(const char* key, size_t keyLength, char* out);
@@ -0,0 +1,356 @@
+// Host check for TelemetryServer against an in-memory stand-in for the
+// socket layer: handshakes, message framing, binary frames through
+// TelemetryDecoder, NMEA over TCP, and the backpressure policy (a slow client
+// drops snapshots and resumes on a keyframe, a stalled one is closed, a
+// fast one is not affected).
+//
+// Build and run on the development machine (no Arduino dependencies):
+//   cd firmware/lib
+//   g++ -O2 -I TelemetryServer -I TelemetryCodec -I VeetrHal TelemetryServer/TelemetryServer.cpp
+//       TelemetryCodec/TelemetryCodec.cpp TelemetryServer/examples/server_check/server_check.cpp -o server_check
+//   ./server_check
+//
+// Exits 1 on a failed check.
+
+#include <TelemetryServer.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  printf("%-52s %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok) failures++;
+}
+
+// Loopback stand-in: each connection has a byte pipe each way, and the
+// server-to-client pipe holds at most `window` unread bytes, like a socket
+// send buffer that only empties when the client reads
+class FakeTcp : public hal::Tcp {
+public:
+  struct Connection {
+    std::deque<uint8_t> toServer;
+    std::string toClient;
+    size_t window = 1 << 20;
+    bool clientClosed = false;
+    bool serverClosed = false;
+  };
+
+  int connect(uint16_t port, size_t window = 1 << 20) {
+    int id = nextId++;
+    connections[id].window = window;
+    pending[port].push_back(id);
+    return id;
+  }
+
+  void clientSend(int id, const std::string &data) {
+    for (char c : data) connections[id].toServer.push_back((uint8_t)c);
+  }
+
+  // What the server sent since the last call
+  std::string clientRead(int id) {
+    std::string data;
+    data.swap(connections[id].toClient);
+    return data;
+  }
+
+  Connection &connection(int id) { return connections[id]; }
+
+  int accept(uint16_t port) override {
+    std::deque<int> &queue = pending[port];
+    if (queue.empty()) return -1;
+    int id = queue.front();
+    queue.pop_front();
+    return id;
+  }
+
+  int receive(int id, uint8_t* buffer, size_t length) override {
+    Connection &c = connections[id];
+    if (c.toServer.empty()) return c.clientClosed ? -1 : 0;
+    size_t n = 0;
+    // Trickle: at most 7 bytes per call, so requests and frames arrive in pieces
+    while (n < length && n < 7 && !c.toServer.empty()) {
+      buffer[n++] = c.toServer.front();
+      c.toServer.pop_front();
+    }
+    return (int)n;
+  }
+
+  int send(int id, const uint8_t* data, size_t length) override {
+    Connection &c = connections[id];
+    if (c.clientClosed) return -1;
+    size_t room = c.window > c.toClient.size() ? c.window - c.toClient.size() : 0;
+    size_t n = length < room ? length : room;
+    c.toClient.append((const char*)data, n);
+    return (int)n;
+  }
+
+  void close(int id) override { connections[id].serverClosed = true; }
+
+private:
+  int nextId = 3;
+  std::map<int, Connection> connections;
+  std::map<uint16_t, std::deque<int>> pending;
+};
+
+struct WsMessage {
+  uint8_t opcode;
+  std::string payload;
+};
+
+// Server frames (unmasked) from a byte stream; incomplete ones stay in `stream`
+static std::vector<WsMessage> parseFrames(std::string &stream) {
+  std::vector<WsMessage> messages;
+  for (;;) {
+    if (stream.size() < 2) break;
+    size_t length = (uint8_t)stream[1] & 0x7F, header = 2;
+    if ((uint8_t)stream[1] & 0x80) {
+      messages.push_back({0xFF, "masked"});
+      break;
+    }
+    if (length == 126) {
+      if (stream.size() < 4) break;
+      length = (size_t)(uint8_t)stream[2] << 8 | (uint8_t)stream[3];
+      header = 4;
+    }
+    if (stream.size() < header + length) break;
+    messages.push_back({(uint8_t)(stream[0] & 0x0F), stream.substr(header, length)});
+    stream.erase(0, header + length);
+  }
+  return messages;
+}
+
+// A masked client frame
+static std::string clientFrame(uint8_t opcode, const std::string &payload, bool masked = true) {
+  std::string frame;
+  frame += (char)(0x80 | opcode);
+  frame += (char)((masked ? 0x80 : 0) | payload.size());
+  const uint8_t mask[4] = {0x37, 0xFA, 0x21, 0x3D};
+  if (masked) frame.append((const char*)mask, 4);
+  for (size_t i = 0; i < payload.size(); i++) frame += (char)(payload[i] ^ (masked ? mask[i & 3] : 0));
+  return frame;
+}
+
+static std::string upgradeRequest(const char* path) {
+  return std::string("GET ") + path +
+         " HTTP/1.1\r\nHost: 192.168.4.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+         "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+}
+
+static const char* EXPECTED_ACCEPT = "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=";   // RFC 6455, section 1.3
+
+static uint32_t clock_ = 0;
+
+static void pollFor(TelemetryServer &server, uint32_t ms) {
+  for (uint32_t t = 0; t < ms; t += 10) server.poll(clock_ += 10);
+}
+
+// Read the upgrade response off a client; true when it is a 101 with the right accept key
+static bool upgraded(FakeTcp &tcp, int id, std::string &rest) {
+  std::string data = tcp.clientRead(id);
+  size_t end = data.find("\r\n\r\n");
+  if (end == std::string::npos) return false;
+  std::string head = data.substr(0, end);
+  rest = data.substr(end + 4);
+  return head.compare(0, 12, "HTTP/1.1 101") == 0 &&
+         head.find(std::string("Sec-WebSocket-Accept: ") + EXPECTED_ACCEPT) != std::string::npos;
+}
+
+static TelemetryFrame makeFrame(int i) {
+  TelemetryFrame frame = {};
+  frame.set(TF_TIME, 1000 * i);
+  frame.set(TF_LAT, -338500000 + i * 37);
+  frame.set(TF_LON, 1512500000 - i * 41);
+  frame.set(TF_SOG, 550 + (i % 20));
+  frame.set(TF_AWA, (i * 700) % 36000);
+  frame.set(TF_AWS, 1200 + (i % 7) * 10);
+  if (i % 3) frame.set(TF_HEEL, -500 + i % 100);
+  return frame;
+}
+
+static bool sameFrame(const TelemetryFrame &a, const TelemetryFrame &b) {
+  if (a.valid != b.valid) return false;
+  for (int f = 0; f < TF_FIELD_COUNT; f++) {
+    if (a.has((TelemetryField)f) && a.value[f] != b.value[f]) return false;
+  }
+  return true;
+}
+
+int main() {
+  char accept[29];
+  webSocketAccept("dGhlIHNhbXBsZSBub25jZQ==", 24, accept);
+  check(strcmp(accept, EXPECTED_ACCEPT) == 0, "Sec-WebSocket-Accept (RFC 6455 example)");
+
+  FakeTcp tcp;
+  TelemetryServer server(tcp);
+  std::string rest;
+
+  // JSON client, request trickled in 7 byte pieces
+  int json = tcp.connect(TELEMETRY_SERVER_HTTP_PORT);
+  tcp.clientSend(json, upgradeRequest("/json"));
+  pollFor(server, 200);
+  check(upgraded(tcp, json, rest) && rest.empty(), "JSON client upgraded");
+  std::string small = "{\"SOG\":5.5}", large(300, 'x');
+  server.publishJson(small.c_str(), small.size());
+  server.publishJson(large.c_str(), large.size());
+  pollFor(server, 10);
+  std::string stream = tcp.clientRead(json);
+  std::vector<WsMessage> messages = parseFrames(stream);
+  check(messages.size() == 2 && messages[0].opcode == 1 && messages[0].payload == small &&
+        messages[1].payload == large && stream.empty(), "JSON snapshots as text messages (short and 16-bit length)");
+
+  // Ping and close
+  tcp.clientSend(json, clientFrame(0x9, "hello"));
+  pollFor(server, 30);
+  stream = tcp.clientRead(json);
+  messages = parseFrames(stream);
+  check(messages.size() == 1 && messages[0].opcode == 0xA && messages[0].payload == "hello", "ping answered with pong");
+  tcp.clientSend(json, clientFrame(0x8, std::string("\x03\xE8", 2)));
+  pollFor(server, 30);
+  stream = tcp.clientRead(json);
+  messages = parseFrames(stream);
+  check(messages.size() == 1 && messages[0].opcode == 0x8 && messages[0].payload == std::string("\x03\xE8", 2) &&
+        tcp.connection(json).serverClosed && server.clients(TS_CLIENT_JSON) == 0, "close echoed, connection closed");
+
+  // Unmasked client frame is a protocol error
+  int unmasked = tcp.connect(TELEMETRY_SERVER_HTTP_PORT);
+  tcp.clientSend(unmasked, upgradeRequest("/") + clientFrame(0x1, "hi", false));
+  pollFor(server, 100);
+  upgraded(tcp, unmasked, rest);
+  messages = parseFrames(rest);
+  check(messages.size() == 1 && messages[0].opcode == 0x8 && messages[0].payload == std::string("\x03\xEA", 2) &&
+        tcp.connection(unmasked).serverClosed, "unmasked client frame closed with 1002");
+
+  // Bad requests
+  int notFound = tcp.connect(TELEMETRY_SERVER_HTTP_PORT);
+  tcp.clientSend(notFound, upgradeRequest("/nothing"));
+  int plain = tcp.connect(TELEMETRY_SERVER_HTTP_PORT);
+  tcp.clientSend(plain, "GET /json HTTP/1.1\r\nHost: 192.168.4.1\r\n\r\n");
+  int silent = tcp.connect(TELEMETRY_SERVER_HTTP_PORT);
+  pollFor(server, 200);
+  check(tcp.clientRead(notFound).compare(0, 12, "HTTP/1.1 404") == 0 && tcp.connection(notFound).serverClosed,
+        "unknown path answered 404 and closed");
+  check(tcp.clientRead(plain).compare(0, 12, "HTTP/1.1 426") == 0 && tcp.connection(plain).serverClosed,
+        "request without upgrade answered 426 and closed");
+  pollFor(server, TELEMETRY_SERVER_HANDSHAKE_MS);
+  check(tcp.connection(silent).serverClosed, "client without a request closed after the timeout");
+
+  // Binary clients: one reading everything, one that stops reading for a while
+  int fast = tcp.connect(TELEMETRY_SERVER_HTTP_PORT);
+  int slow = tcp.connect(TELEMETRY_SERVER_HTTP_PORT, 256);
+  int nmea = tcp.connect(TELEMETRY_SERVER_NMEA_PORT);
+  tcp.clientSend(fast, upgradeRequest("/telemetry"));
+  tcp.clientSend(slow, upgradeRequest("/telemetry?since=0"));
+  pollFor(server, 200);
+  bool fastUp = upgraded(tcp, fast, rest);
+  std::string slowStream;
+  bool slowUp = upgraded(tcp, slow, slowStream);
+  check(fastUp && slowUp && server.clients(TS_CLIENT_BINARY) == 2 && server.clients(TS_CLIENT_NMEA) == 1,
+        "binary and NMEA clients connected");
+
+  TelemetryDecoder fastDecoder, slowDecoder;
+  std::string fastStream;
+  std::vector<TelemetryFrame> sent;
+  int fastDecoded = 0, fastWrong = 0, slowDecoded = 0, slowWrong = 0;
+  std::string nmeaExpected, nmeaReceived;
+  uint32_t droppedBefore = server.stats().dropped;
+  const int frames = 500;
+  for (int i = 0; i < frames; i++) {
+    TelemetryFrame frame = makeFrame(i);
+    sent.push_back(frame);
+    server.publishFrame(frame);
+    char sentence[64];
+    int length = snprintf(sentence, sizeof(sentence), "$IIHDM,%d.0,M*00\r\n", i % 360);
+    server.publishNmea(sentence, length);
+    nmeaExpected.append(sentence, length);
+    server.poll(clock_ += 25);
+
+    fastStream += tcp.clientRead(fast);
+    for (const WsMessage &m : parseFrames(fastStream)) {
+      TelemetryFrame decoded;
+      if (m.opcode == 2 && fastDecoder.decode((const uint8_t*)m.payload.data(), m.payload.size(), decoded)) {
+        fastDecoded++;
+        if (!sameFrame(decoded, sent[fastDecoded - 1])) fastWrong++;
+      }
+    }
+    nmeaReceived += tcp.clientRead(nmea);
+    // The slow client reads nothing for frames 100-349 (6.25 s, more than its queue holds)
+    if (i < 100 || i >= 350) {
+      slowStream += tcp.clientRead(slow);
+      for (const WsMessage &m : parseFrames(slowStream)) {
+        TelemetryFrame decoded;
+        if (m.opcode == 2 && slowDecoder.decode((const uint8_t*)m.payload.data(), m.payload.size(), decoded)) {
+          slowDecoded++;
+          if (!sameFrame(decoded, makeFrame((int)(decoded.value[TF_TIME] / 1000)))) slowWrong++;
+        }
+      }
+    }
+  }
+  uint32_t dropped = server.stats().dropped - droppedBefore;
+  printf("slow client:       %d of %d frames decoded, %u dropped by the server\n", slowDecoded, frames,
+         (unsigned)dropped);
+  check(fastDecoded == frames && fastWrong == 0, "fast client got every frame, unchanged");
+  check(nmeaReceived == nmeaExpected, "NMEA client got every sentence");
+  check(dropped > 0 && slowDecoded > frames / 2 && slowDecoded < frames && slowWrong == 0,
+        "slow client dropped frames, resumed on a keyframe");
+  check(!tcp.connection(slow).serverClosed, "slow client kept (under the stall limit)");
+
+  // A client that never reads again is closed; the others stay
+  for (int i = 0; i < TELEMETRY_SERVER_STALL_MS / 100 + 20; i++) {
+    server.publishFrame(makeFrame(frames + i));
+    server.poll(clock_ += 100);
+    tcp.clientRead(fast);
+    tcp.clientRead(nmea);
+  }
+  check(tcp.connection(slow).serverClosed && server.stats().evicted == 1 && !tcp.connection(fast).serverClosed,
+        "stalled client evicted, others kept");
+
+  // Peer closing is noticed
+  tcp.connection(nmea).clientClosed = true;
+  pollFor(server, 10);
+  check(tcp.connection(nmea).serverClosed && server.clients(TS_CLIENT_NMEA) == 0, "closed NMEA peer released");
+
+  // More clients than slots
+  std::vector<int> many;
+  for (int i = 0; i < TELEMETRY_SERVER_MAX_CLIENTS + 2; i++) many.push_back(tcp.connect(TELEMETRY_SERVER_NMEA_PORT));
+  uint32_t rejectedBefore = server.stats().rejected;
+  pollFor(server, 10);
+  check(server.clients(TS_CLIENT_NMEA) == TELEMETRY_SERVER_MAX_CLIENTS - 1 &&
+        server.stats().rejected - rejectedBefore == 3, "connections beyond the client slots refused");
+  server.closeAll();
+
+  // Cost of one snapshot to every slot taken, half binary, half NMEA
+  FakeTcp benchTcp;
+  TelemetryServer bench(benchTcp);
+  std::vector<int> benchClients;
+  for (int i = 0; i < TELEMETRY_SERVER_MAX_CLIENTS; i++) {
+    int id = i % 2 ? benchTcp.connect(TELEMETRY_SERVER_NMEA_PORT) : benchTcp.connect(TELEMETRY_SERVER_HTTP_PORT);
+    if (i % 2 == 0) benchTcp.clientSend(id, upgradeRequest("/telemetry"));
+    benchClients.push_back(id);
+  }
+  for (int i = 0; i < 30; i++) bench.poll(i * 10);
+  for (int id : benchClients) benchTcp.clientRead(id);
+  const char* sentences = "$IIMWV,45.7,R,38.7,N,A*37\r\n$IIHDM,13.0,M*10\r\n";
+  const int rounds = 20000;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) {
+    bench.publishFrame(makeFrame(r));
+    bench.publishNmea(sentences, strlen(sentences));
+    bench.poll(1000 + r);
+    if (r % 16 == 0) {
+      for (int id : benchClients) benchTcp.clientRead(id);
+    }
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  printf("publish + poll:    %.2f us per snapshot to %d clients\n",
+         std::chrono::duration<double, std::micro>(t1 - t0).count() / rounds, TELEMETRY_SERVER_MAX_CLIENTS);
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,195 @@
+#include "TrackStats.h"
+
+#include <math.h>
+
+void WindowStats::setWindow(uint8_t window) {
+  if (window < 1) window = 1;
+  if (window > TRACK_STATS_MAX_WINDOW) window = TRACK_STATS_MAX_WINDOW;
+  size = window;
+  clear();
+}
+
+void WindowStats::clear() {
+  filled = 0;
+  next = 0;
+  meanValue = 0;
+  m2 = 0;
+  sinceResync = 0;
+  minHead = minCount = 0;
+  maxHead = maxCount = 0;
+}
+
+void WindowStats::add(float value) {
+  uint8_t slot = next % size;
+  if (filled == 0) shift = value;
+  float shifted = value - shift;
+  if (filled < size) {
+    filled++;
+    float delta = shifted - meanValue;
+    meanValue += delta / filled;
+    m2 += delta * (shifted - meanValue);
+  } else {
+    // Replace the oldest sample: both updates of Welford's method in one step
+    float old = samples[slot] - shift;
+    float newMean = meanValue + (shifted - old) / size;
+    m2 += (shifted - old) * (shifted - newMean + old - meanValue);
+    meanValue = newMean;
+  }
+  samples[slot] = value;
+
+  // Drop expired sequence numbers from the front and dominated ones from the back
+  if (minCount && minQueue[minHead] + size <= next) {
+    minHead = (minHead + 1) % TRACK_STATS_MAX_WINDOW;
+    minCount--;
+  }
+  while (minCount && samples[minQueue[(minHead + minCount - 1) % TRACK_STATS_MAX_WINDOW] % size] >= value) minCount--;
+  minQueue[(minHead + minCount) % TRACK_STATS_MAX_WINDOW] = next;
+  minCount++;
+
+  if (maxCount && maxQueue[maxHead] + size <= next) {
+    maxHead = (maxHead + 1) % TRACK_STATS_MAX_WINDOW;
+    maxCount--;
+  }
+  while (maxCount && samples[maxQueue[(maxHead + maxCount - 1) % TRACK_STATS_MAX_WINDOW] % size] <= value) maxCount--;
+  maxQueue[(maxHead + maxCount) % TRACK_STATS_MAX_WINDOW] = next;
+  maxCount++;
+
+  next++;
+  if (++sinceResync >= TRACK_STATS_RESYNC_SAMPLES) resync();
+}
+
+// Two-pass mean and squared deviations over the window, shifted to the current mean
+void WindowStats::resync() {
+  sinceResync = 0;
+  float sum = 0;
+  for (uint8_t i = 0; i < filled; i++) sum += samples[i] - shift;
+  shift += sum / filled;
+  meanValue = 0;
+  m2 = 0;
+  for (uint8_t i = 0; i < filled; i++) {
+    float delta = samples[i] - shift;
+    meanValue += delta;
+    m2 += delta * delta;
+  }
+  meanValue /= filled;
+  m2 -= meanValue * meanValue * filled;
+}
+
+float WindowStats::variance() const {
+  if (!filled) return 0.0f;
+  return m2 > 0 ? m2 / filled : 0.0f;
+}
+
+float WindowStats::stdDev() const {
+  return sqrtf(variance());
+}
+
+float WindowStats::min() const {
+  return minCount ? samples[minQueue[minHead] % size] : 0.0f;
+}
+
+float WindowStats::max() const {
+  return maxCount ? samples[maxQueue[maxHead] % size] : 0.0f;
+}
+
+void TrackWindow::setWindow(uint8_t points) {
+  if (points < 2) points = 2;
+  if (points > TRACK_STATS_MAX_WINDOW + 1) points = TRACK_STATS_MAX_WINDOW + 1;
+  size = (uint8_t)(points - 1);
+  clear();
+}
+
+void TrackWindow::clear() {
+  filled = 0;
+  oldest = 0;
+  legs = 0;
+  distanceSum = 0;
+  changeSum = 0;
+  sinceResync = 0;
+  hasLast = false;
+  lastValid = false;
+  longHead = longCount = 0;
+}
+
+void TrackWindow::add(const GeoPoint &position, bool valid, const LocalPlane &plane) {
+  if (!hasLast) {
+    hasLast = true;
+    last = position;
+    lastValid = valid;
+    return;
+  }
+
+  Leg leg = {};
+  bool isLong = false;
+  if (lastValid && valid) {
+    leg.exists = true;
+    leg.distance = plane.distance(last, position);
+    if (leg.distance > TRACK_STATS_BEARING_MIN_LEG) {
+      isLong = true;
+      leg.bearing = plane.bearing(last, position);
+    }
+  }
+  last = position;
+  lastValid = valid;
+
+  if (filled == size) removeOldest();
+  uint8_t slot = (oldest + filled) % size;
+  filled++;
+
+  if (leg.exists) {
+    legs++;
+    distanceSum += leg.distance;
+  }
+  if (isLong) {
+    if (longCount) {
+      const Leg &previous = slots[longLegs[(longHead + longCount - 1) % TRACK_STATS_MAX_WINDOW]];
+      float change = fabsf(leg.bearing - previous.bearing);
+      if (change > 180.0f) change = 360.0f - change;
+      leg.change = change;
+      leg.counted = true;
+      changeSum += change;
+    }
+    longLegs[(longHead + longCount) % TRACK_STATS_MAX_WINDOW] = slot;
+    longCount++;
+  }
+  slots[slot] = leg;
+
+  if (++sinceResync >= TRACK_STATS_RESYNC_SAMPLES) resync();
+}
+
+void TrackWindow::removeOldest() {
+  Leg &leg = slots[oldest];
+  if (leg.exists) {
+    legs--;
+    distanceSum -= leg.distance;
+  }
+  if (leg.counted) changeSum -= leg.change;
+
+  // The next long leg's change was measured from this one, or from one
+  // already gone; either way it is now the first long leg in the window
+  if (longCount && longLegs[longHead] == oldest) {
+    longHead = (longHead + 1) % TRACK_STATS_MAX_WINDOW;
+    longCount--;
+    if (longCount) {
+      Leg &first = slots[longLegs[longHead]];
+      if (first.counted) {
+        changeSum -= first.change;
+        first.counted = false;
+      }
+    }
+  }
+
+  oldest = (oldest + 1) % size;
+  filled--;
+}
+
+void TrackWindow::resync() {
+  sinceResync = 0;
+  distanceSum = 0;
+  changeSum = 0;
+  for (uint8_t i = 0; i < filled; i++) {
+    const Leg &leg = slots[(oldest + i) % size];
+    if (leg.exists) distanceSum += leg.distance;
+    if (leg.counted) changeSum += leg.change;
+  }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdint.h>
+#include <Geodesy.h>
+
+// Sliding-window statistics updated once per sample, so movement decisions
+// can be taken on every tick at a constant cost instead of rescanning a
+// buffer every few seconds.
+//
+// WindowStats keeps the mean and variance of the last `window` samples with
+// Welford's update (one add and, once full, one remove per sample) and their
+// minimum and maximum with monotonic queues (amortised O(1)). The sums are
+// kept relative to a shift near the mean, so a small spread on a large value
+// (vibration on gravity) keeps its precision, and rounding is cleared by an
+// exact recomputation every TRACK_STATS_RESYNC_SAMPLES samples (TrackWindow's
+// sums likewise).
+//
+// TrackWindow keeps the legs between the last `window` GPS points: their
+// total distance, and the total bearing change between successive legs
+// longer than TRACK_STATS_BEARING_MIN_LEG. A leg only exists between two
+// consecutive points with a fix.
+
+#define TRACK_STATS_MAX_WINDOW 32          // Largest window for either class
+#define TRACK_STATS_RESYNC_SAMPLES 256     // Exact recomputation of WindowStats' sums
+#define TRACK_STATS_BEARING_MIN_LEG 2.0f   // Metres; shorter legs have no meaningful bearing
+
+class WindowStats {
+public:
+  explicit WindowStats(uint8_t window = 8) { setWindow(window); }
+
+  // Window length in samples (1..TRACK_STATS_MAX_WINDOW); clears the window
+  void setWindow(uint8_t window);
+  uint8_t window() const { return size; }
+  void clear();
+
+  void add(float value);
+
+  uint8_t count() const { return filled; }
+  float mean() const { return filled ? shift + meanValue : 0.0f; }
+  float variance() const;   // Population variance of the samples in the window
+  float stdDev() const;
+  float min() const;
+  float max() const;
+
+private:
+  void resync();
+
+  float samples[TRACK_STATS_MAX_WINDOW];
+  uint8_t size = 0;
+  uint8_t filled = 0;
+  uint32_t next = 0;                      // Sequence number of the next sample; slot = sequence % size
+  float shift = 0;                        // Subtracted from every sample in the sums
+  float meanValue = 0;                    // Mean of the shifted samples
+  float m2 = 0;                           // Sum of squared deviations from the mean
+  uint16_t sinceResync = 0;
+
+  // Sequence numbers with increasing (min) and decreasing (max) values
+  uint32_t minQueue[TRACK_STATS_MAX_WINDOW];
+  uint32_t maxQueue[TRACK_STATS_MAX_WINDOW];
+  uint8_t minHead = 0, minCount = 0;
+  uint8_t maxHead = 0, maxCount = 0;
+};
+
+class TrackWindow {
+public:
+  explicit TrackWindow(uint8_t points = 10) { setWindow(points); }
+
+  // Window length in GPS points (2..TRACK_STATS_MAX_WINDOW + 1); clears the window
+  void setWindow(uint8_t points);
+  uint8_t window() const { return (uint8_t)(size + 1); }
+  void clear();
+
+  // One GPS point; `valid` false for a point without a fix, which breaks
+  // the track. Distances and bearings come from `plane`
+  void add(const GeoPoint &position, bool valid, const LocalPlane &plane);
+
+  uint8_t points() const { return filled ? (uint8_t)(filled + 1) : (hasLast ? 1 : 0); }
+  uint8_t legCount() const { return legs; }           // Legs between two points with a fix
+  float totalDistance() const { return distanceSum; } // Metres over those legs
+  float totalBearingChange() const { return changeSum; }  // Degrees between successive long legs
+
+private:
+  struct Leg {
+    bool exists;
+    bool counted;          // `change` is part of changeSum
+    float distance;
+    float bearing;         // Degrees, only for long legs
+    float change;          // Bearing change from the previous long leg
+  };
+
+  void removeOldest();
+  void resync();
+
+  Leg slots[TRACK_STATS_MAX_WINDOW];
+  uint8_t size = 0;        // Legs in a full window (points - 1)
+  uint8_t filled = 0;
+  uint8_t oldest = 0;
+  uint8_t legs = 0;
+  float distanceSum = 0;
+  float changeSum = 0;
+  uint16_t sinceResync = 0;
+
+  GeoPoint last = {0, 0};
+  bool hasLast = false;
+  bool lastValid = false;
+
+  // Slots of the long legs in the window, oldest first
+  uint8_t longLegs[TRACK_STATS_MAX_WINDOW];
+  uint8_t longHead = 0, longCount = 0;
+};
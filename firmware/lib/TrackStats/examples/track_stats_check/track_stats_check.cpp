@@ -0,0 +1,174 @@
+// Host check for TrackStats: the sliding accumulators against a rescan of
+// the same window after every sample, and the cost of both.
+//
+// Build and run on the development machine (no Arduino dependencies):
+//   cd firmware/lib
+//   g++ -O2 -I TrackStats -I Geodesy TrackStats/TrackStats.cpp Geodesy/Geodesy.cpp
+//       TrackStats/examples/track_stats_check/track_stats_check.cpp -o track_stats_check
+//   ./track_stats_check
+//
+// The rescans are what SensorPipeline did before (every 500 ms for the
+// accelerometer, every 2 s for the GPS track). Exits 1 on a mismatch.
+
+#include <TrackStats.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define STATS_TOLERANCE 1e-3f   // Float sums against a fresh two-pass computation
+#define TRACK_TOLERANCE 1e-2f
+
+static float uniform(float low, float high) {
+  return low + (high - low) * rand() / (float)RAND_MAX;
+}
+
+struct Rescan {
+  float mean, stdDev, min, max;
+};
+
+static Rescan rescanStats(const std::vector<float> &values, size_t end, size_t window) {
+  size_t start = end > window ? end - window : 0;
+  size_t n = end - start;
+  Rescan r = {0, 0, 1e30f, -1e30f};
+  for (size_t i = start; i < end; i++) {
+    r.mean += values[i];
+    r.min = fminf(r.min, values[i]);
+    r.max = fmaxf(r.max, values[i]);
+  }
+  r.mean /= n;
+  float variance = 0;
+  for (size_t i = start; i < end; i++) variance += (values[i] - r.mean) * (values[i] - r.mean);
+  r.stdDev = sqrtf(variance / n);
+  return r;
+}
+
+struct Point {
+  GeoPoint position;
+  bool valid;
+};
+
+// The former isMovementConsistent() loop over the last `window` points
+static void rescanTrack(const std::vector<Point> &points, size_t end, size_t window, const LocalPlane &plane,
+                        int &legs, float &distance, float &change) {
+  size_t start = end > window ? end - window : 0;
+  legs = 0;
+  distance = 0;
+  change = 0;
+  bool first = true;
+  float lastBearing = 0;
+  for (size_t i = start + 1; i < end; i++) {
+    if (!points[i - 1].valid || !points[i].valid) continue;
+    float d = plane.distance(points[i - 1].position, points[i].position);
+    distance += d;
+    legs++;
+    if (d > TRACK_STATS_BEARING_MIN_LEG) {
+      float bearing = plane.bearing(points[i - 1].position, points[i].position);
+      if (!first) {
+        float diff = fabsf(bearing - lastBearing);
+        if (diff > 180) diff = 360 - diff;
+        change += diff;
+      }
+      lastBearing = bearing;
+      first = false;
+    }
+  }
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  printf("%-34s %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok) failures++;
+}
+
+int main() {
+  srand(5);
+  const size_t samples = 100000;
+
+  // Accelerometer magnitudes: gravity with bursts of motion
+  std::vector<float> magnitudes(samples);
+  for (size_t i = 0; i < samples; i++) {
+    float motion = (i / 500) % 2 ? 1.5f : 0.1f;
+    magnitudes[i] = 9.81f + uniform(-motion, motion);
+  }
+  float statsError = 0;
+  for (uint8_t window : {3, 8, 32}) {
+    WindowStats stats(window);
+    for (size_t i = 0; i < samples; i++) {
+      stats.add(magnitudes[i]);
+      Rescan r = rescanStats(magnitudes, i + 1, window);
+      statsError = fmaxf(statsError, fabsf(stats.mean() - r.mean));
+      statsError = fmaxf(statsError, fabsf(stats.stdDev() - r.stdDev));
+      statsError = fmaxf(statsError, fabsf(stats.min() - r.min));
+      statsError = fmaxf(statsError, fabsf(stats.max() - r.max));
+    }
+  }
+  printf("window stats:      %.2e max error (mean, std dev, min, max)\n", statsError);
+  check(statsError <= STATS_TOLERANCE, "window stats match rescan");
+
+  // GPS track: drifting at anchor, then sailing with tacks, with fix dropouts
+  LocalPlane plane;
+  plane.anchor(geoFromDegrees(43.3, 5.35));
+  std::vector<Point> points(samples);
+  double lat = 43.3, lon = 5.35, course = 40;
+  for (size_t i = 0; i < samples; i++) {
+    bool sailing = (i / 300) % 2;
+    if (sailing) {
+      if (i % 60 == 0) course += 90;
+      lat += 3.0 * cos(course * M_PI / 180) / 111000.0;
+      lon += 3.0 * sin(course * M_PI / 180) / 81000.0;
+    }
+    double jitter = sailing ? 0.3 : 2.5;
+    points[i].position = geoFromDegrees(lat + uniform(-jitter, jitter) / 111000.0, lon + uniform(-jitter, jitter) / 81000.0);
+    points[i].valid = rand() % 50 != 0;
+    if ((i + 1) % 20000 == 0) lat = 43.3, lon = 5.35;  // Stay on the plane
+  }
+  float trackError = 0;
+  bool legsMatch = true;
+  for (uint8_t window : {3, 10, 33}) {
+    TrackWindow track(window);
+    for (size_t i = 0; i < samples; i++) {
+      track.add(points[i].position, points[i].valid, plane);
+      int legs;
+      float distance, change;
+      rescanTrack(points, i + 1, window, plane, legs, distance, change);
+      if (legs != track.legCount()) legsMatch = false;
+      trackError = fmaxf(trackError, fabsf(track.totalDistance() - distance));
+      trackError = fmaxf(trackError, fabsf(track.totalBearingChange() - change));
+    }
+  }
+  printf("track window:      %.2e max error (distance m, bearing change deg)\n", trackError);
+  check(legsMatch && trackError <= TRACK_TOLERANCE, "track window matches rescan");
+
+  // Cost per sample: one update against one rescan of a default window
+  const int iterations = 1000000;
+  WindowStats stats(8);
+  TrackWindow track(10);
+  float sink = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    size_t k = i % samples;
+    stats.add(magnitudes[k]);
+    track.add(points[k].position, points[k].valid, plane);
+    sink += stats.stdDev() + stats.max() - stats.min() + track.totalDistance() + track.totalBearingChange();
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    size_t k = i % (samples - 16) + 16;
+    Rescan r = rescanStats(magnitudes, k, 8);
+    int legs;
+    float distance, change;
+    rescanTrack(points, k, 10, plane, legs, distance, change);
+    sink += r.stdDev + r.max - r.min + distance + change;
+  }
+  auto t2 = std::chrono::steady_clock::now();
+  printf("sliding:           %.1f ns per sample\n",
+         std::chrono::duration<double, std::nano>(t1 - t0).count() / iterations);
+  printf("rescan:            %.1f ns per sample (checksum %.0f)\n",
+         std::chrono::duration<double, std::nano>(t2 - t1).count() / iterations, sink);
+
+  return failures ? 1 : 0;
+}
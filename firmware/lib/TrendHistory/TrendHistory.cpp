@@ -0,0 +1,170 @@
+#include "TrendHistory.h"
+
+#include <string.h>
+
+const uint32_t TrendHistory::PERIOD_MS[TREND_TIER_COUNT] = {1000, 10000, 300000};
+const uint16_t TrendHistory::DEPTH[TREND_TIER_COUNT] = {TREND_TIER0_BUCKETS, TREND_TIER1_BUCKETS,
+                                                        TREND_TIER2_BUCKETS};
+const uint16_t TrendHistory::BASE[TREND_TIER_COUNT] = {0, TREND_TIER0_BUCKETS,
+                                                       TREND_TIER0_BUCKETS + TREND_TIER1_BUCKETS};
+const uint8_t TrendHistory::STEP[TREND_CHANNEL_COUNT] = {
+  TREND_SPEED_STEP, TREND_SPEED_STEP, TREND_ANGLE_STEP, TREND_SPEED_STEP, TREND_ANGLE_STEP, TREND_HEEL_STEP,
+  TREND_ANGLE_STEP,
+};
+
+// Frame channel behind each trend channel (all in 0.01 units)
+static const TelemetryField SOURCE[TREND_CHANNEL_COUNT] = {TF_SOG, TF_AWS, TF_AWA, TF_TWS, TF_TWD, TF_HEEL, TF_HDM};
+
+// `value` / `divisor`, rounded half away from zero
+static int32_t divRound(int32_t value, int32_t divisor) {
+  return (value + (value >= 0 ? divisor / 2 : -divisor / 2)) / divisor;
+}
+
+// Angle in tenths of a degree to 0..3599
+static int32_t normalizeAngle(int32_t tenths) {
+  tenths %= 3600;
+  return tenths < 0 ? tenths + 3600 : tenths;
+}
+
+// Distance in tenths to spread steps, rounded up so the band covers the extreme
+static uint8_t toSteps(int32_t distance, uint8_t step) {
+  int32_t steps = (distance + step - 1) / step;
+  return steps > 255 ? 255 : (uint8_t)steps;
+}
+
+void TrendHistory::clear() {
+  memset(tiers, 0, sizeof(tiers));
+}
+
+uint32_t TrendHistory::firstBucket(uint8_t tier) const {
+  uint32_t closed = tiers[tier].closed;
+  return closed > DEPTH[tier] ? closed - DEPTH[tier] : 0;
+}
+
+void TrendHistory::add(uint32_t now, const TelemetryFrame &frame) {
+  // Tenths of each channel's unit, shared by the tiers
+  int32_t value[TREND_CHANNEL_COUNT];
+  bool present[TREND_CHANNEL_COUNT];
+  for (uint8_t channel = 0; channel < TREND_CHANNEL_COUNT; channel++) {
+    present[channel] = frame.has(SOURCE[channel]);
+    if (!present[channel]) continue;
+    int32_t tenths = divRound(frame.value[SOURCE[channel]], 10);
+    if (isAngle((TrendChannel)channel)) {
+      tenths = normalizeAngle(tenths);
+    } else if (tenths > INT16_MAX) {
+      tenths = INT16_MAX;
+    } else if (tenths < -INT16_MAX) {
+      tenths = -INT16_MAX;
+    }
+    value[channel] = tenths;
+  }
+
+  for (uint8_t tier = 0; tier < TREND_TIER_COUNT; tier++) {
+    Tier &t = tiers[tier];
+    if (!t.started) {
+      t.started = true;
+      t.bucketStart = now;
+    }
+
+    // Close the open bucket, then one empty bucket per period of a gap (a
+    // ring's worth at most)
+    uint32_t elapsed = (now - t.bucketStart) / PERIOD_MS[tier];
+    if (elapsed > 0) {
+      uint32_t empty = elapsed - 1 < DEPTH[tier] ? elapsed - 1 : DEPTH[tier];
+      closeBucket(tier);
+      for (uint32_t i = 0; i < empty; i++) closeBucket(tier);
+      t.bucketStart += elapsed * PERIOD_MS[tier];
+    }
+
+    for (uint8_t channel = 0; channel < TREND_CHANNEL_COUNT; channel++) {
+      if (!present[channel]) continue;
+      Accumulator &a = t.open[channel];
+      if (a.count == 0) {
+        a.reference = value[channel];
+        a.sum = 0;
+        a.low = 0;
+        a.high = 0;
+      }
+      int32_t offset = value[channel] - a.reference;
+      if (isAngle((TrendChannel)channel)) {
+        // Shorter way round, -1800..1799
+        if (offset >= 1800) offset -= 3600;
+        if (offset < -1800) offset += 3600;
+      }
+      a.sum += offset;
+      if (offset < a.low) a.low = offset;
+      if (offset > a.high) a.high = offset;
+      a.count++;
+    }
+  }
+}
+
+void TrendHistory::closeBucket(uint8_t tier) {
+  Tier &t = tiers[tier];
+  uint16_t slot = BASE[tier] + t.closed % DEPTH[tier];
+  for (uint8_t channel = 0; channel < TREND_CHANNEL_COUNT; channel++) {
+    Accumulator &a = t.open[channel];
+    if (a.count == 0) {
+      mean[channel][slot] = TREND_NO_DATA;
+      below[channel][slot] = 0;
+      above[channel][slot] = 0;
+      continue;
+    }
+    int32_t center = divRound(a.sum, (int32_t)a.count);
+    int32_t value = a.reference + center;
+    if (isAngle((TrendChannel)channel)) value = normalizeAngle(value);
+    mean[channel][slot] = (int16_t)value;
+    below[channel][slot] = toSteps(center - a.low, STEP[channel]);
+    above[channel][slot] = toSteps(a.high - center, STEP[channel]);
+    a.count = 0;
+  }
+  t.closed++;
+}
+
+bool TrendHistory::slotOf(uint8_t tier, uint32_t bucket, uint16_t &slot) const {
+  uint32_t first = firstBucket(tier);
+  if (bucket - first >= tiers[tier].closed - first) return false;
+  slot = BASE[tier] + bucket % DEPTH[tier];
+  return true;
+}
+
+bool TrendHistory::get(uint8_t tier, TrendChannel channel, uint32_t bucket, TrendBucket &out) const {
+  uint16_t slot;
+  if (!slotOf(tier, bucket, slot) || mean[channel][slot] == TREND_NO_DATA) {
+    out.mean = out.min = out.max = TREND_NO_DATA;
+    return false;
+  }
+  out.mean = mean[channel][slot];
+  out.min = (int16_t)(out.mean - below[channel][slot] * STEP[channel]);
+  out.max = (int16_t)(out.mean + above[channel][slot] * STEP[channel]);
+  return true;
+}
+
+size_t TrendHistory::read(uint8_t tier, uint32_t first, uint32_t end, size_t offset, uint8_t* out,
+                          size_t length) const {
+  size_t n = end - first;
+  size_t size = blobSize(first, end);
+  if (offset >= size) return 0;
+  if (length > size - offset) length = size - offset;
+
+  for (size_t i = 0; i < length; i++) {
+    size_t position = offset + i;
+    uint8_t channel = (uint8_t)(position / (4 * n));
+    size_t within = position % (4 * n);
+    uint16_t slot;
+    if (within < 2 * n) {
+      int16_t value = slotOf(tier, first + (uint32_t)(within / 2), slot) ? mean[channel][slot] : TREND_NO_DATA;
+      out[i] = (within & 1) ? (uint8_t)((uint16_t)value >> 8) : (uint8_t)value;
+    } else if (within < 3 * n) {
+      out[i] = slotOf(tier, first + (uint32_t)(within - 2 * n), slot) ? below[channel][slot] : 0;
+    } else {
+      out[i] = slotOf(tier, first + (uint32_t)(within - 3 * n), slot) ? above[channel][slot] : 0;
+    }
+  }
+  return length;
+}
+
+const char* TrendHistory::channelName(TrendChannel channel) {
+  static const char* const names[TREND_CHANNEL_COUNT] = {"sog", "aws", "awa", "tws", "twd", "heel", "hdm"};
+  return channel < TREND_CHANNEL_COUNT ? names[channel] : "?";
+}
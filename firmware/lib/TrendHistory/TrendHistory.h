@@ -0,0 +1,125 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <TelemetryCodec.h>
+
+// Multi-resolution history of the main channels, for charts that should be
+// full the moment a client connects.
+//
+// Every snapshot goes into the open bucket of each tier; when a bucket's
+// period is over it is closed into that tier's ring as min/mean/max. Nothing
+// is recomputed from older data, so add() costs the same on every tick.
+//
+//   tier 0   1 s buckets,  TREND_TIER0_BUCKETS (10 min)
+//   tier 1   10 s buckets, TREND_TIER1_BUCKETS (2 h)
+//   tier 2   5 min buckets, TREND_TIER2_BUCKETS (24 h)
+//
+// Storage is struct-of-arrays per channel: the mean as int16 in tenths of
+// the channel's unit (0.1 kn, 0.1 degree) and the distance from the mean to
+// the minimum and the maximum as uint8 in TREND_*_STEP units, rounded out and
+// saturating at 255 steps. That is 4 bytes per channel and bucket. A bucket
+// without samples for a channel has a mean of TREND_NO_DATA. All three tiers
+// take 45 KB (28 bytes per bucket), static on a board without PSRAM.
+//
+// Angles (AWA, TWD, HDM) are averaged around the bucket's first sample, so
+// a bucket that spans north has a mean near 0/360 and not 180; min and max
+// are then offsets on either side of that mean.
+//
+// Buckets are numbered from the first one closed; a tier keeps
+// [firstBucket(), endBucket()). A gap in the samples closes empty buckets.
+
+#ifndef TREND_TIER0_BUCKETS
+#define TREND_TIER0_BUCKETS 600
+#endif
+#ifndef TREND_TIER1_BUCKETS
+#define TREND_TIER1_BUCKETS 720
+#endif
+#ifndef TREND_TIER2_BUCKETS
+#define TREND_TIER2_BUCKETS 288
+#endif
+#define TREND_TIER_COUNT 3
+#define TREND_NO_DATA INT16_MIN
+#define TREND_SPEED_STEP 1      // 0.1 kn: spreads up to 25.5 kn
+#define TREND_ANGLE_STEP 10     // 1 degree: up to 255 degrees
+#define TREND_HEEL_STEP 2       // 0.2 degree: up to 51 degrees
+
+enum TrendChannel : uint8_t {
+  TREND_SOG = 0,
+  TREND_AWS,
+  TREND_AWA,
+  TREND_TWS,
+  TREND_TWD,
+  TREND_HEEL,
+  TREND_HDM,
+  TREND_CHANNEL_COUNT
+};
+
+// One bucket of one channel, in tenths of the channel's unit
+struct TrendBucket {
+  int16_t mean;   // TREND_NO_DATA when the bucket had no samples
+  int16_t min;    // Rounded out to the spread step; angles may fall outside 0..3599
+  int16_t max;
+};
+
+class TrendHistory {
+public:
+  TrendHistory() { clear(); }
+
+  // One snapshot taken at `now` (ms); channels the frame lacks count as
+  // missing for this sample only
+  void add(uint32_t now, const TelemetryFrame &frame);
+  void clear();
+
+  uint32_t period(uint8_t tier) const { return PERIOD_MS[tier]; }
+  uint16_t depth(uint8_t tier) const { return DEPTH[tier]; }
+  uint32_t firstBucket(uint8_t tier) const;
+  uint32_t endBucket(uint8_t tier) const { return tiers[tier].closed; }
+  // When the newest closed bucket ended (ms, same clock as add())
+  uint32_t newestEnd(uint8_t tier) const { return tiers[tier].bucketStart; }
+
+  // Closed bucket `bucket` of `channel`; false (and no data) if it is not kept
+  bool get(uint8_t tier, TrendChannel channel, uint32_t bucket, TrendBucket &out) const;
+
+  // Buckets [first, end) of a tier as one blob, channel after channel:
+  //   int16 mean[n] (little-endian), uint8 below[n], uint8 above[n]
+  // (min = mean - below * step, max = mean + above * step). read() copies
+  // `length` bytes from `offset`, so the blob can be sent in pieces without
+  // a copy; buckets that drop out of the ring meanwhile read as no data
+  static size_t blobSize(uint32_t first, uint32_t end) { return (size_t)(end - first) * 4 * TREND_CHANNEL_COUNT; }
+  size_t read(uint8_t tier, uint32_t first, uint32_t end, size_t offset, uint8_t* out, size_t length) const;
+
+  static const char* channelName(TrendChannel channel);
+  static uint8_t spreadStep(TrendChannel channel) { return STEP[channel]; }
+  static bool isAngle(TrendChannel channel) { return channel == TREND_AWA || channel == TREND_TWD || channel == TREND_HDM; }
+
+private:
+  struct Accumulator {
+    int32_t reference;  // First sample of the bucket
+    int32_t sum;        // Of the offsets from `reference`
+    int32_t low;        // Offsets of the extremes
+    int32_t high;
+    uint16_t count;
+  };
+
+  struct Tier {
+    bool started;
+    uint32_t bucketStart;   // Start of the open bucket (ms)
+    uint32_t closed;        // Buckets closed so far
+    Accumulator open[TREND_CHANNEL_COUNT];
+  };
+
+  void closeBucket(uint8_t tier);
+  bool slotOf(uint8_t tier, uint32_t bucket, uint16_t &slot) const;
+
+  static const uint32_t PERIOD_MS[TREND_TIER_COUNT];
+  static const uint16_t DEPTH[TREND_TIER_COUNT];
+  static const uint16_t BASE[TREND_TIER_COUNT];   // First slot of each tier in the arrays
+  static const uint8_t STEP[TREND_CHANNEL_COUNT];
+
+  static const uint16_t TOTAL = TREND_TIER0_BUCKETS + TREND_TIER1_BUCKETS + TREND_TIER2_BUCKETS;
+  int16_t mean[TREND_CHANNEL_COUNT][TOTAL];
+  uint8_t below[TREND_CHANNEL_COUNT][TOTAL];
+  uint8_t above[TREND_CHANNEL_COUNT][TOTAL];
+  Tier tiers[TREND_TIER_COUNT];
+};
@@ -0,0 +1,199 @@
+// Host check for TrendHistory: a day of synthetic snapshots (with a gap, a
+// stretch without wind data and angles crossing north) against min/mean/max
+// recomputed from the raw samples for every kept bucket of every tier, the
+// blob layout against get(), and the cost of add().
+//
+// Build and run on the development machine (no Arduino dependencies):
+//   cd firmware/lib
+//   g++ -O2 -I TrendHistory -I TelemetryCodec TrendHistory/TrendHistory.cpp TelemetryCodec/TelemetryCodec.cpp
+//       TrendHistory/examples/trend_check/trend_check.cpp -o trend_check
+//   ./trend_check
+//
+// Exits 1 on a mismatch.
+
+#include <TrendHistory.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define MEAN_TOLERANCE 1         // Tenths: rounding of the mean
+#define ANGLE_MEAN_TOLERANCE 5   // Tenths: mean around the first sample against the vector mean
+
+static const TelemetryField SOURCE[TREND_CHANNEL_COUNT] = {TF_SOG, TF_AWS, TF_AWA, TF_TWS, TF_TWD, TF_HEEL, TF_HDM};
+
+struct Sample {
+  uint32_t time;
+  TelemetryFrame frame;
+};
+
+static float uniform(float low, float high) {
+  return low + (high - low) * rand() / (float)RAND_MAX;
+}
+
+static int32_t wrap(int32_t tenths) {
+  tenths %= 3600;
+  return tenths < 0 ? tenths + 3600 : tenths;
+}
+
+// Signed difference a - b of two angles in tenths, -1800..1799
+static int32_t angleDiff(int32_t a, int32_t b) {
+  int32_t d = wrap(a - b);
+  return d >= 1800 ? d - 3600 : d;
+}
+
+// 26 hours at 1 Hz, the last half hour at 10 Hz; a 7 minute gap at 3 h; no
+// wind for 6 minutes at 24.5 h
+static std::vector<Sample> makeSamples() {
+  std::vector<Sample> samples;
+  uint32_t start = 4000000000u;   // millis() wraps during the run
+  for (uint32_t t = 0; t < 26u * 3600000u;) {
+    bool gap = t >= 3u * 3600000u && t < 3u * 3600000u + 420000u;
+    bool noWind = t >= 88200000u && t < 88200000u + 360000u;
+    if (!gap) {
+      float hours = t / 3600000.0f;
+      Sample s = {start + t, {}};
+      s.frame.set(TF_SOG, (int32_t)lroundf((6.0f + 2.0f * sinf(hours) + uniform(-0.5f, 0.5f)) * 100));
+      if (!noWind) {
+        s.frame.set(TF_AWS, (int32_t)lroundf((14.0f + 4.0f * sinf(hours * 3) + uniform(-3, 3)) * 100));
+        s.frame.set(TF_AWA, wrap((int32_t)lroundf((10.0f * sinf(hours * 5) + uniform(-15, 15)) * 10)) * 10);
+        s.frame.set(TF_TWS, (int32_t)lroundf((12.0f + 3.0f * sinf(hours * 3) + uniform(-2, 2)) * 100));
+        s.frame.set(TF_TWD, wrap((int32_t)lroundf((hours * 40.0f + uniform(-10, 10)) * 10)) * 10);
+      }
+      s.frame.set(TF_HEEL, (int32_t)lroundf((15.0f * sinf(hours * 7) + uniform(-5, 5)) * 100));
+      s.frame.set(TF_HDM, wrap((int32_t)lroundf((355.0f + 20.0f * sinf(hours * 2) + uniform(-4, 4)) * 10)) * 10);
+      samples.push_back(s);
+    }
+    t += t >= 25u * 3600000u + 1800000u ? 100 : 1000;
+  }
+  return samples;
+}
+
+struct Expected {
+  bool any;
+  float mean, min, max;   // Tenths; angles unwrapped around the mean
+};
+
+// Bucket `index` of a tier from the raw samples (buckets start at the first sample)
+static Expected expected(const std::vector<Sample> &samples, uint32_t period, uint32_t index, TrendChannel channel) {
+  uint32_t origin = samples[0].time;
+  auto from = std::lower_bound(samples.begin(), samples.end(), (uint64_t)index * period,
+                               [origin](const Sample &s, uint64_t t) { return s.time - origin < t; });
+  std::vector<int32_t> values;
+  for (auto s = from; s != samples.end() && (s->time - origin) / period == index; ++s) {
+    if (!s->frame.has(SOURCE[channel])) continue;
+    int32_t tenths = (int32_t)lround(s->frame.value[SOURCE[channel]] / 10.0);
+    values.push_back(TrendHistory::isAngle(channel) ? wrap(tenths) : tenths);
+  }
+  Expected e = {!values.empty(), 0, 0, 0};
+  if (!e.any) return e;
+  if (TrendHistory::isAngle(channel)) {
+    double x = 0, y = 0;
+    for (int32_t v : values) {
+      x += cos(v * M_PI / 1800);
+      y += sin(v * M_PI / 1800);
+    }
+    e.mean = (float)wrap((int32_t)lround(atan2(y, x) * 1800 / M_PI));
+    e.min = e.max = 0;
+    for (int32_t v : values) {
+      float d = (float)angleDiff(v, (int32_t)e.mean);
+      e.min = fminf(e.min, d);
+      e.max = fmaxf(e.max, d);
+    }
+    e.min += e.mean;
+    e.max += e.mean;
+  } else {
+    double sum = 0;
+    e.min = 1e9f;
+    e.max = -1e9f;
+    for (int32_t v : values) {
+      sum += v;
+      e.min = fminf(e.min, (float)v);
+      e.max = fmaxf(e.max, (float)v);
+    }
+    e.mean = (float)(sum / values.size());
+  }
+  return e;
+}
+
+int main() {
+  srand(7);
+  std::vector<Sample> samples = makeSamples();
+  static TrendHistory history;
+
+  auto start = std::chrono::steady_clock::now();
+  for (const Sample &s : samples) history.add(s.time, s.frame);
+  double addUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() /
+                 samples.size();
+
+  int failures = 0;
+  for (uint8_t tier = 0; tier < TREND_TIER_COUNT; tier++) {
+    uint32_t period = history.period(tier);
+    uint32_t first = history.firstBucket(tier), end = history.endBucket(tier);
+    uint32_t withData = 0, empty = 0, saturated = 0;
+    float worstMean = 0;
+    for (uint32_t bucket = first; bucket != end; bucket++) {
+      for (uint8_t c = 0; c < TREND_CHANNEL_COUNT; c++) {
+        TrendChannel channel = (TrendChannel)c;
+        Expected e = expected(samples, period, bucket, channel);
+        TrendBucket b;
+        bool has = history.get(tier, channel, bucket, b);
+        if (has != e.any) {
+          if (failures++ < 10) printf("tier %u bucket %u %s: data %d, expected %d\n", tier, bucket,
+                                      TrendHistory::channelName(channel), has, e.any);
+          continue;
+        }
+        if (!has) {
+          empty++;
+          continue;
+        }
+        withData++;
+        bool angle = TrendHistory::isAngle(channel);
+        float meanError = angle ? fabsf((float)angleDiff(b.mean, (int32_t)e.mean)) : fabsf(b.mean - e.mean);
+        worstMean = fmaxf(worstMean, meanError);
+        // Extremes relative to the stored mean, as a chart draws them
+        float low = angle ? b.mean + angleDiff((int32_t)e.min, b.mean) : e.min;
+        float high = angle ? b.mean + angleDiff((int32_t)e.max, b.mean) : e.max;
+        uint8_t step = TrendHistory::spreadStep(channel);
+        bool lowSaturated = b.mean - b.min >= 255 * step, highSaturated = b.max - b.mean >= 255 * step;
+        if (lowSaturated || highSaturated) saturated++;
+        bool bad = meanError > (angle ? ANGLE_MEAN_TOLERANCE : MEAN_TOLERANCE) ||
+                   (!lowSaturated && (b.min > low + 1 || b.min < low - step - 1)) ||
+                   (!highSaturated && (b.max < high - 1 || b.max > high + step + 1));
+        if (bad && failures++ < 10) {
+          printf("tier %u bucket %u %s: %d [%d, %d], expected %.1f [%.1f, %.1f]\n", tier, bucket,
+                 TrendHistory::channelName(channel), b.mean, b.min, b.max, e.mean, low, high);
+        }
+      }
+    }
+    printf("tier %u: %4u s x %4u buckets kept, %6u with data, %5u empty, %u saturated, mean error <= %.1f tenths\n",
+           tier, period / 1000, end - first, withData, empty, saturated, worstMean);
+
+    // The blob, read in odd-sized pieces, decodes to what get() returns
+    std::vector<uint8_t> blob(TrendHistory::blobSize(first, end));
+    for (size_t offset = 0; offset < blob.size(); offset += 237) {
+      history.read(tier, first, end, offset, blob.data() + offset, 237);
+    }
+    uint32_t n = end - first;
+    for (uint8_t c = 0; c < TREND_CHANNEL_COUNT; c++) {
+      const uint8_t* block = blob.data() + (size_t)c * 4 * n;
+      uint8_t step = TrendHistory::spreadStep((TrendChannel)c);
+      for (uint32_t i = 0; i < n; i++) {
+        TrendBucket b;
+        history.get(tier, (TrendChannel)c, first + i, b);
+        int16_t mean = (int16_t)(block[2 * i] | block[2 * i + 1] << 8);
+        bool match = mean == b.mean &&
+                     (mean == TREND_NO_DATA || (mean - block[2 * n + i] * step == b.min &&
+                                                mean + block[3 * n + i] * step == b.max));
+        if (!match && failures++ < 10) printf("tier %u blob bucket %u channel %u differs\n", tier, first + i, c);
+      }
+    }
+  }
+
+  printf("add: %.3f us per snapshot, %u bytes for all tiers\n", addUs, (unsigned)sizeof(TrendHistory));
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
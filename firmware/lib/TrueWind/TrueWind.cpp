@@ -0,0 +1,80 @@
+#include "TrueWind.h"
+
+#include <math.h>
+
+static const float DEGREES_TO_RADIANS = (float)M_PI / 180.0f;
+static const float KNOTS_PER_MPS = 1.943844f;
+
+static float wrap360(float angle) {
+  angle = fmodf(angle, 360.0f);
+  return angle < 0 ? angle + 360.0f : angle;
+}
+
+static float wrap180(float angle) {
+  angle = wrap360(angle);
+  return angle >= 180.0f ? angle - 360.0f : angle;
+}
+
+// Share of a new sample in a first-order filter after dtS seconds
+static float filterWeight(float dtS, float tau) {
+  if (tau <= 0 || dtS <= 0) return 1.0f;
+  return 1.0f - expf(-dtS / tau);
+}
+
+void TrueWind::update(uint32_t now, const TrueWindInput &in, TrueWindOutput &out) {
+  float along = in.aws * cosf(in.awa * DEGREES_TO_RADIANS);  // From ahead
+  float cross = in.aws * sinf(in.awa * DEGREES_TO_RADIANS);  // From starboard
+
+  // Tilted sensor and masthead motion (only with an IMU)
+  if (!isnan(in.heel)) {
+    float heel = fminf(fabsf(in.heel), TRUE_WIND_MAX_TILT);
+    float pitch = isnan(in.pitch) ? 0.0f : fminf(fabsf(in.pitch), TRUE_WIND_MAX_TILT);
+    cross /= cosf(heel * DEGREES_TO_RADIANS);
+    along /= cosf(pitch * DEGREES_TO_RADIANS);
+
+    // Heeling to starboard moves the sensor to starboard (wind from starboard),
+    // the bow rising moves it aft (wind from astern)
+    float knotsPerDegreeSecond = config.mastHeight * DEGREES_TO_RADIANS * KNOTS_PER_MPS;
+    if (!isnan(in.rollRate)) cross -= in.rollRate * knotsPerDegreeSecond;
+    if (!isnan(in.pitchRate)) along += in.pitchRate * knotsPerDegreeSecond;
+  }
+  out.aws = sqrtf(along * along + cross * cross);
+  out.awa = wrap360(atan2f(cross, along) / DEGREES_TO_RADIANS);
+
+  // Boat velocity over ground in the boat frame
+  float sog = isnan(in.sog) ? 0.0f : in.sog;
+  bool cogValid = !isnan(in.cog) && sog >= TRUE_WIND_MIN_COG_SPEED;
+  bool compass = !isnan(in.heading);
+  float heading = compass ? in.heading : (cogValid ? in.cog : NAN);
+  float drift = (compass && cogValid) ? wrap180(in.cog - in.heading) : 0.0f;
+  float trueAlong = along - sog * cosf(drift * DEGREES_TO_RADIANS);
+  float trueCross = cross - sog * sinf(drift * DEGREES_TO_RADIANS);
+  float rawSpeed = sqrtf(trueAlong * trueAlong + trueCross * trueCross);
+  float rawAngle = atan2f(trueCross, trueAlong) / DEGREES_TO_RADIANS;
+  out.leeway = drift;
+
+  // Damp in the ground frame; without any heading reference the boat frame
+  // stands in for it and TWD stays unknown
+  float reference = isnan(heading) ? 0.0f : heading;
+  float direction = (reference + rawAngle) * DEGREES_TO_RADIANS;
+  float rawNorth = cosf(direction);
+  float rawEast = sinf(direction);
+  if (!initialized) {
+    speed = rawSpeed;
+    north = rawNorth;
+    east = rawEast;
+    initialized = true;
+  } else {
+    float dtS = (now - lastUpdate) / 1000.0f;
+    speed += (rawSpeed - speed) * filterWeight(dtS, config.speedTau);
+    float weight = filterWeight(dtS, config.directionTau);
+    north += (rawNorth - north) * weight;
+    east += (rawEast - east) * weight;
+  }
+  lastUpdate = now;
+
+  float twd = wrap360(atan2f(east, north) / DEGREES_TO_RADIANS);
+  out.tws = speed;
+  out.twd = isnan(heading) ? NAN : twd;
+  out.twa = wrap360(twd - reference);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+
+// True wind from the masthead anemometer, GPS and IMU.
+//
+// Each wind sample goes through these steps:
+//  1. Heel and pitch correction. A tilted sensor only sees the horizontal
+//     wind projected onto its plane, so the cross and along components are
+//     divided by cos(heel) and cos(pitch) (limited to TRUE_WIND_MAX_TILT).
+//  2. Masthead motion. Rolling and pitching move the sensor at
+//     mastHeight * rate, which adds its own apparent wind; it is removed.
+//  3. Boat motion over ground. The boat moves at SOG along COG, which is
+//     (COG - heading) off the bow when it drifts or makes leeway. Subtracting
+//     that vector gives the wind over ground in the boat frame.
+//  4. Damping. The wind is filtered as a ground-referenced vector (TWD
+//     direction and TWS speed separately, each with its own time constant),
+//     so tacking does not smear it; TWA is the damped TWD minus the current
+//     heading and follows the boat immediately.
+//
+// Heading is the calibrated compass (magnetic, so TWD is magnetic too);
+// without a compass COG is used and leeway is taken as zero. The filter
+// uses the real time between samples, so the time constants do not depend
+// on the refresh rate.
+
+#define TRUE_WIND_MAX_TILT 45.0f      // Tilt correction stops growing beyond this
+#define TRUE_WIND_MIN_COG_SPEED 1.0f  // Below this SOG (knots) COG is noise and is ignored
+
+struct TrueWindConfig {
+  float mastHeight = 10.0f;     // Sensor height above the roll/pitch axis in metres (0 = no motion correction)
+  float speedTau = 2.0f;        // TWS time constant in seconds (0 = undamped)
+  float directionTau = 4.0f;    // TWD time constant in seconds (0 = undamped)
+};
+
+struct TrueWindInput {
+  float aws;          // Apparent wind speed at the sensor, knots
+  float awa;          // Apparent wind angle at the sensor, degrees clockwise from the bow
+  float sog;          // Speed over ground, knots
+  float cog;          // Course over ground in degrees, NAN when unknown
+  float heading;      // Calibrated heading in degrees, NAN without a compass
+  float heel;         // Degrees, + = starboard down, NAN without an IMU
+  float pitch;        // Degrees, + = bow up
+  float rollRate;     // Degrees per second, + = heeling further to starboard
+  float pitchRate;    // Degrees per second, + = bow rising
+};
+
+struct TrueWindOutput {
+  float aws;          // Apparent wind after tilt and motion correction, knots
+  float awa;          // Degrees 0-360
+  float tws;          // Damped true wind speed over ground, knots
+  float twa;          // Degrees 0-360 clockwise from the bow
+  float twd;          // Degrees 0-360, the direction the wind blows from
+  float leeway;       // COG - heading in degrees (-180..180), 0 when not known
+};
+
+class TrueWind {
+public:
+  explicit TrueWind(const TrueWindConfig &config = TrueWindConfig()) : config(config) {}
+
+  void setConfig(const TrueWindConfig &newConfig) { config = newConfig; }
+  const TrueWindConfig &getConfig() const { return config; }
+
+  // One wind sample taken at `now` (ms)
+  void update(uint32_t now, const TrueWindInput &in, TrueWindOutput &out);
+
+  // Forget the damping state (wind sensor lost)
+  void reset() { initialized = false; }
+
+private:
+  TrueWindConfig config;
+  bool initialized = false;
+  uint32_t lastUpdate = 0;
+  float speed = 0;        // Damped TWS
+  float north = 0;        // Damped TWD unit vector
+  float east = 0;
+};
@@ -0,0 +1,26 @@
+#include "TxPowerControl.h"
+
+int8_t txPowerLevelDbm(uint8_t level) {
+  return (int8_t)(-12 + 3 * level);
+}
+
+bool TxPowerControl::update(uint32_t now, int weakestRssi, bool connected) {
+  if (!connected) return setLevel(now, TX_POWER_DEFAULT_LEVEL);
+  if (now - lastStep < TX_POWER_STEP_MS) return false;
+
+  if (weakestRssi < TX_POWER_RSSI_LOW && currentLevel < TX_POWER_LEVEL_COUNT - 1) {
+    return setLevel(now, currentLevel + 1);
+  }
+  if (weakestRssi > TX_POWER_RSSI_HIGH && currentLevel > 0) {
+    return setLevel(now, currentLevel - 1);
+  }
+  return false;
+}
+
+bool TxPowerControl::setLevel(uint32_t now, uint8_t level) {
+  if (level == currentLevel) return false;
+  currentLevel = level;
+  lastStep = now;
+  changeCount++;
+  return true;
+}
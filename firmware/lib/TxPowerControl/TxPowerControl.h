@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+// Transmit power follows the weakest connected client.
+//
+// update() receives the filtered RSSI of the weakest connection. When it is
+// below TX_POWER_RSSI_LOW the power goes up one step, above
+// TX_POWER_RSSI_HIGH it goes down one step; in between it holds. Steps are
+// at least TX_POWER_STEP_MS apart so the RSSI filter sees the effect of the
+// previous step before the next one. With nobody connected the power
+// returns to the default level, so a new client starts with full margin.
+//
+// Levels index the ESP32 power table (esp_power_level_t): 0 = -12 dBm in
+// 3 dB steps up to 7 = +9 dBm.
+
+#define TX_POWER_LEVEL_COUNT 8
+#define TX_POWER_DEFAULT_LEVEL 5     // +3 dBm, the previous fixed setting
+#define TX_POWER_RSSI_LOW -80        // dBm, below this the link margin is thin
+#define TX_POWER_RSSI_HIGH -62       // dBm, above this power can be saved
+#define TX_POWER_STEP_MS 5000
+
+int8_t txPowerLevelDbm(uint8_t level);
+
+class TxPowerControl {
+public:
+  // Returns true when the level changed and has to be applied
+  bool update(uint32_t now, int weakestRssi, bool connected);
+
+  uint8_t level() const { return currentLevel; }
+  int8_t dbm() const { return txPowerLevelDbm(currentLevel); }
+  uint32_t changes() const { return changeCount; }
+
+private:
+  bool setLevel(uint32_t now, uint8_t level);
+
+  uint8_t currentLevel = TX_POWER_DEFAULT_LEVEL;
+  uint32_t lastStep = 0;
+  uint32_t changeCount = 0;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Hardware abstraction for the sensor pipeline.
+//
+// The firmware implements these on top of Arduino/ESP-IDF drivers in
+// main.cpp; the native build implements them with recorded data so the same
+// pipeline code runs on the development machine (see firmware/src/native).
+
+namespace hal {
+
+// Monotonic time source (replaces millis()/micros())
+class Clock {
+public:
+  virtual ~Clock() {}
+  virtual uint32_t millis() = 0;
+  virtual uint32_t micros() = 0;
+};
+
+// Byte stream such as the GPS UART
+class Uart {
+public:
+  virtual ~Uart() {}
+  virtual int available() = 0;
+  virtual int read() = 0;  // -1 when empty
+  virtual size_t write(const uint8_t* data, size_t length) = 0;
+};
+
+// Modbus RTU master on the RS485 bus
+class Modbus {
+public:
+  static const uint8_t SUCCESS = 0x00;
+  static const uint8_t TIMEOUT = 0xE2;
+
+  virtual ~Modbus() {}
+  // Read `count` holding registers into `registers`; returns SUCCESS or a Modbus error code
+  virtual uint8_t readHoldingRegisters(uint16_t address, uint16_t count, uint16_t* registers) = 0;
+  // Change the line settings (8E1 when evenParity, otherwise 8N1)
+  virtual void configure(uint32_t baud, bool evenParity) = 0;
+};
+
+// One report from the I2C IMU (BNO080)
+struct ImuSample {
+  float quatI, quatJ, quatK, quatReal;  // Rotation vector quaternion
+  float magX, magY, magZ;               // Magnetometer in uT
+  float accelX, accelY, accelZ;         // Acceleration in m/s²
+};
+
+// Orientation sensor on the I2C bus
+class Imu {
+public:
+  virtual ~Imu() {}
+  virtual bool isAvailable() = 0;            // Sensor detected at boot
+  virtual bool read(ImuSample &sample) = 0;  // False when no new report is ready
+};
+
+// Notify channel towards connected BLE clients
+class BleLink {
+public:
+  virtual ~BleLink() {}
+  virtual size_t connectedCount() = 0;
+  virtual bool notify(const uint8_t* data, size_t length) = 0;
+};
+
+// Non-blocking TCP for the Wi-Fi telemetry server. Connections are small
+// integer handles; nothing here ever waits for the network
+class Tcp {
+public:
+  virtual ~Tcp() {}
+  // A new connection on listening `port`, -1 when none is pending
+  virtual int accept(uint16_t port) = 0;
+  // Bytes read into `buffer`: 0 when nothing arrived, -1 when the peer closed
+  virtual int receive(int connection, uint8_t* buffer, size_t length) = 0;
+  // Bytes the stack took (possibly fewer than `length`, or 0), -1 on a broken connection
+  virtual int send(int connection, const uint8_t* data, size_t length) = 0;
+  virtual void close(int connection) = 0;
+};
+
+}  // namespace hal
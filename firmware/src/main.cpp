@@ -2,13 +2,41 @@
 #include <ArduinoJson.h>
 #include <Preferences.h>
 #include <vector>
-#include <TinyGPS++.h>
+#include <new>
+#include <atomic>
+#include <algorithm>
+#include <NmeaParser.h>
 #include <Wire.h>
 #include <SparkFun_BNO080_Arduino_Library.h>
 #include <NimBLEDevice.h>
 #include <ModbusMaster.h>
 #include <Update.h>
 #include <esp_ota_ops.h>
+#include <SPIFFS.h>
+#include <SessionLog.h>
+#include <TelemetryCodec.h>
+#include <Hal.h>
+#include <SensorPipeline.h>
+#include <Profiler.h>
+#include <Logger.h>
+#include <PowerScheduler.h>
+#include <ConnParams.h>
+#include <TxPowerControl.h>
+#include <SpscRing.h>
+#include <ChangePublisher.h>
+#include <PolarTable.h>
+#include <StartLine.h>
+#include <NmeaOutput.h>
+#include <TrendHistory.h>
+#include <TelemetryServer.h>
+#include <DeltaPatch.h>
+#include <Lzss.h>
+#include <WiFi.h>
+#include <lwip/sockets.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <driver/uart.h>
+#include <sys/time.h>
 
 // Firmware version
 #define FIRMWARE_VERSION "0.0.26"
@@ -45,18 +73,13 @@ int base64_decode(const char* input, uint8_t* output) {
   return output_len;
 }
 
-// Debug flags - uncomment for verbose output
-// #define DEBUG_BLE_DATA
-#define DEBUG_WIND_SENSOR
-// #define DEBUG_GPS
-#define DEBUG_BNO080
-
 // Persistent storage for settings
 Preferences preferences;
-float heelAngleDelta = 0.0f;
+Quaternion levelReference; // Sensor orientation with the boat level (see Orientation.h)
 float compassOffsetDelta = 0.0f; // Compass calibration offset in degrees
 int deadWindAngle = 40; // default
 float refreshRateSeconds = 1.0f; // Default 1.0 second refresh rate
+TrueWindConfig trueWindConfig; // Mast height and true wind damping (see TrueWind.h)
 bool otaInProgress = false; // Flag to pause sensor data during firmware updates
 unsigned long otaStartTime = 0; // Track when OTA started for timeout
 unsigned long lastOTAActivity = 0; // Track last OTA activity for debugging
@@ -68,21 +91,174 @@ const unsigned long OTA_STATUS_INTERVAL_MS = 5000; // Status check every 5 secon
 #define SERVICE_UUID        "12345678-1234-1234-1234-123456789abc"
 #define SENSOR_DATA_UUID    "87654321-4321-4321-4321-cba987654321"
 #define COMMAND_UUID        "11111111-2222-3333-4444-555555555555"
+#define LOG_TRANSFER_UUID   "22222222-3333-4444-5555-666666666666"
+#define TELEMETRY_UUID      "33333333-4444-5555-6666-777777777777"
+#define TREND_UUID          "44444444-5555-6666-7777-888888888888"
+
+// Nordic UART Service: NMEA 0183 sentences for chart plotters (see NmeaOutput.h)
+#define NMEA_UART_SERVICE_UUID "6E400001-B5A3-F393-E0A9-E50E24DCCA9E"
+#define NMEA_UART_RX_UUID      "6E400002-B5A3-F393-E0A9-E50E24DCCA9E"
+#define NMEA_UART_TX_UUID      "6E400003-B5A3-F393-E0A9-E50E24DCCA9E"
 
 NimBLEServer* pServer = NULL;
 NimBLECharacteristic* pSensorDataCharacteristic = NULL;
 NimBLECharacteristic* pCommandCharacteristic = NULL;
+NimBLECharacteristic* pLogTransferCharacteristic = NULL;
+NimBLECharacteristic* pTelemetryCharacteristic = NULL;
+NimBLECharacteristic* pTrendCharacteristic = NULL;
+NimBLECharacteristic* pNmeaTxCharacteristic = NULL;
 bool deviceConnected = false;
 bool oldDeviceConnected = false;
-int bleRSSI = 0; // BLE signal strength
-int bleRSSIFiltered = 0; // Smoothed RSSI value for display
-uint16_t connectedDeviceCount = 0; // Track number of connected devices
-bool bleSending = false; // Prevent concurrent BLE transmissions
+int bleRSSIFiltered = 0; // Filtered RSSI of the weakest connected client, 0 = none
+std::atomic<uint16_t> connectedDeviceCount{0}; // Updated by the NimBLE host task, read by loop()
+std::atomic<bool> bleSending{false}; // Prevent concurrent BLE transmissions
+
+// Per-connection link parameters, tracked from loop() (see updateConnectionParams)
+#define CONN_PARAMS_CHECK_MS 500                // How often the connections are reviewed
+#define CONN_PARAMS_SETTLE_MS 5000              // Let the central finish discovery before asking
+struct BleConnection {
+  bool inUse;
+  uint16_t handle;
+  unsigned long connectedAt;
+  ConnProfile requested;      // Profile last requested from the central
+  int requestedRefresh;       // Refresh interval the dashboard request was sized for
+  uint16_t interval;          // Parameters in effect: 1.25 ms units
+  uint16_t latency;
+  uint16_t timeout;           // 10 ms units
+  float rssi;                 // Exponentially filtered RSSI (dBm)
+  bool rssiValid;             // At least one reading succeeded
+  uint32_t rssiFailures;      // Failed reads since the connection started
+};
+static BleConnection bleConnections[CONFIG_BT_NIMBLE_MAX_CONNECTIONS] = {};
+static unsigned long lastConnParamsCheck = 0;
+
+// RSSI per connection and transmit power for the weakest client
+#define RSSI_SAMPLE_MS 1000
+#define RSSI_FILTER_ALPHA 0.3f                  // Weight of a new reading, ~3 s time constant
+TxPowerControl txPowerControl;
 
 // BLE-based OTA update variables
 static bool bleOTAActive = false;
 static size_t otaWritten = 0;
 static size_t otaSize = 0;
+static bool otaDelta = false; // Receiving a patch against the running image (see DeltaPatch.h)
+static bool otaCompressed = false; // The image or patch arrives compressed (see Lzss.h)
+
+// Session log on the SPIFFS partition
+#define SESSION_LOG_PATH "/session.log"
+#define SESSION_LOG_MAX_BLOCKS 2048             // 1 MB of 512 byte blocks
+const unsigned long SESSION_LOG_FLUSH_MS = 60000; // Persist the partial block every minute
+SessionLog sessionLog;
+
+// Bulk log transfer state (blocks streamed on the log transfer characteristic)
+#define LOG_PACKET_HEADER_SIZE 8                // seq (4) + offset (2) + block length (2)
+#define LOG_PACKETS_PER_LOOP 6                  // Notifies per loop() pass, below the ACL buffer count
+struct LogTransfer {
+  bool active;
+  uint32_t nextSeq;       // Block currently being sent
+  uint32_t endSeq;        // One past the last block of the requested range
+  uint32_t ackedSeq;      // Client has confirmed every block below this
+  uint16_t window;        // Blocks allowed in flight beyond ackedSeq
+  uint16_t blockOffset;   // Bytes of the current block already sent
+  uint16_t blockLength;   // Used bytes of the current block, 0 = not loaded
+  uint8_t block[LOG_BLOCK_SIZE];
+};
+static LogTransfer logTransfer = {};
+
+// Profiler diagnostics (PROFILE / PROFILE_RESET / PROFILE_TRACE commands)
+#define PROFILE_TRACE_EVENTS_PER_MESSAGE 2      // Keeps each notify around 200 bytes
+#define PROFILE_TRACE_MESSAGES_PER_LOOP 4
+static bool profileResetPending = false;        // Reset runs in loop(), where the scopes are
+static bool profileTraceActive = false;
+static size_t profileTraceNext = 0;
+
+// Log output: a low-priority task on the protocol core drains the logger ring
+// to Serial, so a full UART FIFO stalls that task instead of the refresh loop
+#define LOG_DRAIN_TASK_PRIORITY 1               // Above idle, below the NimBLE host
+#define LOG_DRAIN_TASK_CORE 0                   // loop() runs on core 1
+#define LOG_DRAIN_STACK_SIZE 2048
+#define LOG_DRAIN_BYTES_PER_PASS 256
+#define LOG_DRAIN_IDLE_MS 10
+
+// Power management: loop() waits for its next deadline or a BLE/button event
+// instead of spinning. Moored with no clients, the refresh slows down and
+// automatic light sleep is allowed (needs CONFIG_PM_ENABLE and tickless idle)
+#define POWER_MIN_CPU_MHZ 80                    // Keeps APB at 80 MHz for the UARTs and I2C
+#define GPS_UART_WAKEUP_THRESHOLD 3             // RX edges that wake the chip from light sleep
+PowerScheduler powerScheduler;
+static TaskHandle_t loopTaskHandle = nullptr;
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t noLightSleepLock = nullptr;  // Held while active (GPS UART)
+static esp_pm_lock_handle_t cpuMaxLock = nullptr;        // Held while loop() is working
+#endif
+
+// Channels from the NimBLE host task to loop(). The callbacks only copy what
+// arrived and wake the loop; commands and connection changes are handled in
+// loop() context, which owns the sensor data, regatta and transfer state
+#define BLE_COMMAND_MAX 512                     // Largest attribute value
+#define BLE_COMMAND_QUEUE_DEPTH 8               // Power of two, one slot stays free
+#define LINK_EVENT_QUEUE_DEPTH 16
+#define VERSION_SEND_DELAY_MS 1000              // Give a new client time to subscribe
+#define ADVERTISING_RESTART_DELAY_MS 500        // Let the stack release a closed connection
+struct BleCommand {
+  uint16_t length;
+  char text[BLE_COMMAND_MAX + 1];
+};
+enum LinkEventType : uint8_t {
+  LINK_CONNECTED,
+  LINK_DISCONNECTED,
+};
+struct LinkEvent {
+  LinkEventType type;
+  uint16_t connHandle;
+};
+static SpscRing<BleCommand, BLE_COMMAND_QUEUE_DEPTH> commandQueue;
+static std::atomic<uint32_t> commandsTooLong{0};   // Dropped before the queue (commandQueue counts the rest)
+static SpscRing<LinkEvent, LINK_EVENT_QUEUE_DEPTH> linkEvents;
+static unsigned long versionSendAt = 0;         // Deferred connect/disconnect work, 0 = none
+static unsigned long advertisingRestartAt = 0;
+
+// Compact binary telemetry stream (keyframe every 30 frames, deltas in between)
+TelemetryEncoder telemetryEncoder(30);
+
+// Refresh snapshots are published only when a channel moved past its
+// deadband, or on the heartbeat (see ChangePublisher.h). Published frames
+// are numbered (TF_SEQ) and the last TELEMETRY_HISTORY_FRAMES are kept in
+// RAM, so a reconnecting client can back-fill its charts with GET_HISTORY;
+// frames are streamed a few per loop() pass
+#define HISTORY_FRAMES_PER_MESSAGE 2            // Keeps each notify around 300 bytes
+#define HISTORY_MESSAGES_PER_LOOP 4
+ChangePublisher changePublisher;
+TelemetryHistory telemetryHistory;
+static TelemetryFrame latestFrame = {};         // This tick's snapshot, as published
+struct HistoryTransfer {
+  bool active;
+  uint32_t nextSeq;
+  uint32_t endSeq;        // One past the last requested frame
+};
+static HistoryTransfer historyTransfer = {};
+
+// Chart history at 1 s / 10 s / 5 min resolution (see TrendHistory.h), fed
+// every refresh tick. TREND_READ streams one tier as a single blob on the
+// trend characteristic, so a client can draw full charts on connect
+#define TREND_PACKET_HEADER_SIZE 4              // Blob offset (u32)
+#define TREND_PACKETS_PER_LOOP 6                // Notifies per loop() pass, below the ACL buffer count
+TrendHistory trendHistory;
+struct TrendTransfer {
+  bool active;
+  uint8_t tier;
+  uint32_t first;         // Buckets [first, end) as they were when the read started
+  uint32_t end;
+  uint32_t offset;        // Blob bytes already sent
+  uint32_t size;
+};
+static TrendTransfer trendTransfer = {};
+
+// Spike rejection windows per OutlierChannel (threshold under "hampelK")
+static const char* const OUTLIER_NVS_KEYS[OUTLIER_CHANNEL_COUNT] = {"hampelAws", "hampelAwa", "hampelSog"};
+
+// Device name cached at boot (changing it restarts the device)
+String deviceNameCache = "Veetr";
 
 // BNO080 IMU Sensor (I2C)
 #define BNO080_SDA 21
@@ -119,25 +295,118 @@ ModbusMaster windSensor;
 
 // GPS Module
 HardwareSerial gpsSerial(GPS_UART);
-TinyGPSPlus gps;
+NmeaParser gps;
 
-// Regatta start line data structure
+// Regatta start line: both ends as pinged and the start countdown. The line
+// itself (local plane, direction, length) lives in startLine and is rebuilt
+// whenever an end moves. Everything here is kept in NVS (see saveRaceState())
 struct RegattaData {
-  bool hasStartLine;         // True if both port and starboard positions are set
-  double portLat;           // Port end GPS latitude
-  double portLon;           // Port end GPS longitude
-  double starboardLat;      // Starboard end GPS latitude  
-  double starboardLon;      // Starboard end GPS longitude
-  float distanceToLine;     // Current distance to start line in meters
+  bool hasPin;              // Pin (port) end pinged
+  bool hasBoat;             // Committee boat (starboard) end pinged
+  GeoPoint pin;             // Pin end position
+  GeoPoint boat;            // Committee boat end position
+  bool timerRunning;        // Start countdown running (startAt is valid)
+  unsigned long startAt;    // millis() at the start signal
+  uint64_t startUtcMs;      // UTC of the start signal (ms since 1970), 0 until the clock is known
+};
+
+// Race state as stored in NVS under "race". Positions are GeoPoints
+// (1e-7 degrees, about 1 cm); the flags say which parts are set, so no coordinate doubles
+// as a "not set" marker. The countdown is stored as the UTC of the start
+// signal: the system clock is kept on GPS time and survives a soft reset
+// (OTA, rename, watchdog), so a restart in the sequence resumes the
+// countdown before the first fix. After a power cycle it resumes with GPS time
+#define RACE_STATE_VERSION 1
+#define RACE_HAS_PIN 0x01
+#define RACE_HAS_BOAT 0x02
+#define RACE_HAS_START 0x04
+#define RACE_START_MAX_AGE_MS (60UL * 60 * 1000)   // A countdown this long past its start is dropped at boot
+#define RACE_CLOCK_MAX_ERROR_MS 500                // Reset the system clock from GPS beyond this drift
+struct RaceStateRecord {
+  uint8_t version;
+  uint8_t flags;            // RACE_HAS_*
+  uint8_t reserved[2];
+  GeoPoint pin;
+  GeoPoint boat;
+  uint64_t startUtcMs;      // Valid with RACE_HAS_START
 };
 
 // Regatta data
-RegattaData regattaData = {false, 0.0, 0.0, 0.0, 0.0, -1.0};
+RegattaData regattaData = {};
+StartLine startLine;
+StartLineState startState = {};   // Latest fix against the line, updated on every GPS fix
+uint32_t startStateFixAt = 0;      // NmeaFix::positionAt of the fix in startState
+
+// NMEA 0183 output on its own timer, from the latest snapshot. On the
+// serial side it takes over the console UART (UART1 and UART2 carry the GPS
+// and the wind sensor): logging is muted while it is on
+#define NMEA_OUTPUT_MAX_RATE 10                 // Hz
+#define NMEA_SERIAL_TX_BUFFER 1024              // Console UART transmit buffer, a few snapshots
+#define CONSOLE_BAUD 115200
+NmeaOutput nmeaOutput;
+uint8_t nmeaOutputRate = 1;                     // Snapshots per second, 0 = off
+uint32_t nmeaSerialBaud = 38400;
+std::atomic<bool> nmeaSerialOutput{false};      // Read by the log drain task
+unsigned long nextNmeaOutput = 0;
+uint32_t nmeaSerialSkipped = 0;                 // Snapshots not sent because the UART was still busy
+void updateNmeaOutput();
+void setNmeaSerialOutput(bool enable, uint32_t baud);
+
+// Optional Wi-Fi soft-AP for clients beyond BLE (see TelemetryServer.h). The
+// network task owns the access point, the sockets and the server; loop()
+// hands it every published snapshot through wifiMessages
+#define WIFI_TASK_PRIORITY 1                    // Above idle, below the NimBLE host
+#define WIFI_TASK_CORE 0                        // loop() runs on core 1
+#define WIFI_TASK_STACK_SIZE 4096
+#define WIFI_POLL_MS 10                         // Server poll while the access point is up
+#define WIFI_IDLE_MS 500                        // Check for the enable flag while it is down
+#define WIFI_MESSAGE_MAX 512                    // A JSON snapshot (BLE attribute limit) or an NMEA batch
+#define WIFI_AP_CHANNEL 6
+enum WifiMessageKind : uint8_t { WIFI_MSG_FRAME, WIFI_MSG_JSON, WIFI_MSG_NMEA };
+struct WifiMessage {
+  WifiMessageKind kind;
+  uint16_t length;
+  TelemetryFrame frame;
+  char text[WIFI_MESSAGE_MAX];
+};
+SpscRing<WifiMessage, 8> wifiMessages;          // loop() -> network task
+std::atomic<bool> wifiEnabled{false};           // Wanted state, set by commands; applied by the network task
+std::atomic<bool> wifiReconfigure{false};       // SSID or password changed while up
+std::atomic<bool> wifiRunning{false};
+std::atomic<uint8_t> wifiJsonClients{0};        // Client counts, published by the network task
+std::atomic<uint8_t> wifiBinaryClients{0};
+std::atomic<uint8_t> wifiNmeaClients{0};
+char wifiSsid[33] = "";
+char wifiPassword[65] = "";
+portMUX_TYPE wifiConfigLock = portMUX_INITIALIZER_UNLOCKED;   // wifiSsid and wifiPassword
+void wifiTask(void* parameter);
+void publishWifiSnapshot(const String &jsonData);
+void setWifiConfig(const char* ssid, const char* password);
 
 // Regatta Functions (prototypes)
-float haversineDistance(double lat1, double lon1, double lat2, double lon2);
-float distanceToLine(double px, double py, double x1, double y1, double x2, double y2);
 void calculateRegattaData();
+float secondsToStart();
+bool pingLineEnd(StartLineEnd end, const GeoPoint &position);
+void sendStartLineInfo(const char* error = nullptr);
+void saveRaceState();
+void setStartSignal(long msToStart);
+void loadRaceState();
+void updateRaceClock();
+uint64_t utcNowMs();
+
+// Boat polar, uploaded in chunks (POLAR_BEGIN / POLAR_CHUNK / POLAR_END) and
+// kept in NVS as the raw blob; performance is evaluated every refresh tick
+PolarTable polarTable;
+PolarPerformance polarPerformance = {};
+bool polarValid = false;    // This tick had true wind to evaluate against
+struct PolarUpload {
+  bool active;
+  uint32_t size;
+  uint32_t crc;             // CRC-32 of the whole blob, from POLAR_BEGIN
+  uint32_t received;
+  uint8_t data[POLAR_MAX_BLOB_SIZE];
+};
+static PolarUpload polarUpload = {};
 
 // Function prototypes (declared early for use in callbacks)
 bool safeBLESend(const String& data, bool isCommand = false);
@@ -153,131 +422,337 @@ void startDiscoveryMode();
 void stopDiscoveryMode();
 void updateDiscoveryStatus();
 void updateRefreshRate();
+void sendLogInfo();
+void startLogTransfer(uint32_t startSeq, uint32_t endSeq, uint16_t window);
+void stopLogTransfer(const char* reason);
+void sendProfileReport();
+const char* writeImageChunk(const uint8_t* data, size_t length);
+void sendConnectionInfo();
+void startHistoryTransfer(uint32_t fromSeq, uint32_t toSeq);
+void startTrendTransfer(uint8_t tier);
+void sendTrendDone();
+void updateTrendTransfer();
+void sendPolarInfo(const char* error = nullptr);
+void finishPolarUpload();
+std::vector<uint16_t> syncConnections();
+BleConnection* trackConnection(uint16_t handle);
+void logDrainTask(void* parameter);
+void wakeLoop();
+void processBleEvents();
+
+// Hardware bindings for the sensor pipeline
+class ArduinoClock : public hal::Clock {
+public:
+  uint32_t millis() override { return ::millis(); }
+  uint32_t micros() override { return ::micros(); }
+};
+
+class SerialUart : public hal::Uart {
+public:
+  explicit SerialUart(HardwareSerial &serial) : serial(serial) {}
+  int available() override { return serial.available(); }
+  int read() override { return serial.read(); }
+  size_t write(const uint8_t* data, size_t length) override { return serial.write(data, length); }
+private:
+  HardwareSerial &serial;
+};
+
+class RS485Modbus : public hal::Modbus {
+public:
+  uint8_t readHoldingRegisters(uint16_t address, uint16_t count, uint16_t* registers) override {
+    // Clear any existing response data
+    windSensor.clearResponseBuffer();
+    uint8_t result = windSensor.readHoldingRegisters(address, count);
+    if (result == windSensor.ku8MBSuccess) {
+      for (uint16_t i = 0; i < count; i++) registers[i] = windSensor.getResponseBuffer(i);
+    }
+    return result;
+  }
+  
+  void configure(uint32_t baud, bool evenParity) override {
+    rs485.end();
+    rs485.begin(baud, evenParity ? SERIAL_8E1 : SERIAL_8N1, RS485_RX, RS485_TX);
+    windSensor.begin(1, rs485);
+    windSensor.preTransmission(preTransmission);
+    windSensor.postTransmission(postTransmission);
+  }
+};
+
+class BNO080Imu : public hal::Imu {
+public:
+  bool isAvailable() override { return imuAvailable; }
+  bool read(hal::ImuSample &sample) override {
+    if (!imu.dataAvailable()) return false;
+    sample.quatI = imu.getQuatI();
+    sample.quatJ = imu.getQuatJ();
+    sample.quatK = imu.getQuatK();
+    sample.quatReal = imu.getQuatReal();
+    sample.magX = imu.getMagX();
+    sample.magY = imu.getMagY();
+    sample.magZ = imu.getMagZ();
+    sample.accelX = imu.getAccelX();
+    sample.accelY = imu.getAccelY();
+    sample.accelZ = imu.getAccelZ();
+    return true;
+  }
+};
+
+// Non-blocking lwIP sockets for the Wi-Fi telemetry server
+class LwipTcp : public hal::Tcp {
+public:
+  bool begin() {
+    httpListener = listenOn(TELEMETRY_SERVER_HTTP_PORT);
+    nmeaListener = listenOn(TELEMETRY_SERVER_NMEA_PORT);
+    return httpListener >= 0 && nmeaListener >= 0;
+  }
+  
+  void end() {
+    if (httpListener >= 0) ::close(httpListener);
+    if (nmeaListener >= 0) ::close(nmeaListener);
+    httpListener = nmeaListener = -1;
+  }
+  
+  int accept(uint16_t port) override {
+    int listener = port == TELEMETRY_SERVER_HTTP_PORT ? httpListener : nmeaListener;
+    if (listener < 0) return -1;
+    int connection = ::accept(listener, nullptr, nullptr);
+    if (connection < 0) return -1;
+    fcntl(connection, F_SETFL, O_NONBLOCK);
+    int noDelay = 1;
+    setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return connection;
+  }
+  
+  int receive(int connection, uint8_t* buffer, size_t length) override {
+    int received = recv(connection, buffer, length, MSG_DONTWAIT);
+    if (received > 0) return received;
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+    return -1;
+  }
+  
+  int send(int connection, const uint8_t* data, size_t length) override {
+    int sent = ::send(connection, data, length, MSG_DONTWAIT);
+    if (sent >= 0) return sent;
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+  }
+  
+  void close(int connection) override { ::close(connection); }
+  
+private:
+  static int listenOn(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(fd, 2) < 0) {
+      ::close(fd);
+      return -1;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+  }
+  
+  int httpListener = -1;
+  int nmeaListener = -1;
+};
+
+// Firmware patches read the running app partition and write through Update
+class RunningImage : public PatchSource {
+public:
+  uint32_t size() override { return esp_ota_get_running_partition()->size; }
+  bool read(uint32_t offset, uint8_t* out, size_t length) override {
+    return esp_partition_read(esp_ota_get_running_partition(), offset, out, length) == ESP_OK;
+  }
+};
+
+class UpdateWriter : public PatchSink {
+public:
+  bool write(const uint8_t* data, size_t length) override {
+    return Update.write(const_cast<uint8_t*>(data), length) == length;
+  }
+};
+
+// Decompressed OTA data goes on as if it had been received that way
+class ImageOutput : public LzssOutput {
+public:
+  bool write(const uint8_t* data, size_t length) override {
+    failure = writeImageChunk(data, length);
+    return failure == nullptr;
+  }
+  const char* failure = nullptr;
+};
+
+ArduinoClock systemClock;
+SerialUart gpsUart(gpsSerial);
+RS485Modbus windBus;
+BNO080Imu imuSensor;
+SensorPipeline sensorPipeline(systemClock, gpsUart, gps, windBus, imuSensor);
+LwipTcp wifiTcp;
+TelemetryServer* telemetryServer = nullptr;   // 16 KB of client slots, only while the access point is up
+RunningImage runningImage;
+UpdateWriter updateWriter;
+DeltaPatch deltaPatch(runningImage, updateWriter);
+ImageOutput imageOutput;
+LzssDecoder otaDecoder(imageOutput);
+
+// Current sensor data
+SensorData &currentData = sensorPipeline.data;
+
+// Logger sink, only called from the drain task
+void serialLogSink(const char* text, size_t length) {
+  if (nmeaSerialOutput) return;   // The console UART carries NMEA sentences
+  Serial.write((const uint8_t*)text, length);
+}
+
+void logDrainTask(void* parameter) {
+  for (;;) {
+    if (logger.drain(LOG_DRAIN_BYTES_PER_PASS) == 0) {
+      vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_IDLE_MS));
+    }
+  }
+}
 
 // Safe BLE transmission function to prevent data corruption
 bool safeBLESend(const String& data, bool isCommand) {
-  Serial.printf("[BLE DEBUG] Attempting to send %d chars, command=%s\n", 
-               data.length(), isCommand ? "true" : "false");
+  LOGV("BLE", "Attempting to send %d chars, command=%s",
+       data.length(), isCommand ? "true" : "false");
   
   // Check if we have a valid connection and characteristic
   if (!pServer || pServer->getConnectedCount() == 0 || !pSensorDataCharacteristic) {
-    Serial.println("[BLE DEBUG] FAILED: No server, connection, or characteristic");
+    LOGV("BLE", "No server, connection, or characteristic");
     return false;
   }
   
-  Serial.printf("[BLE DEBUG] Connected devices: %d\n", pServer->getConnectedCount());
+  LOGV("BLE", "Connected devices: %d", (int)pServer->getConnectedCount());
   
-  // Wait for any ongoing transmission to complete (max 100ms timeout)
+  // Claim the sending flag, waiting for any ongoing transmission (max 100ms timeout)
   unsigned long startTime = millis();
-  while (bleSending && (millis() - startTime) < 100) {
+  bool idle = false;
+  while (!bleSending.compare_exchange_weak(idle, true)) {
+    idle = false;
+    if (millis() - startTime >= 100) {
+      LOGV("BLE", "Transmission timeout, skipping...");
+      return false;
+    }
     delay(1);
   }
-  
-  // If still sending after timeout, skip this transmission
-  if (bleSending) {
-    Serial.println("[BLE DEBUG] FAILED: Transmission timeout, skipping...");
-    return false;
-  }
-  
-  // Set sending flag
-  bleSending = true;
-  Serial.println("[BLE DEBUG] Sending flag set, starting transmission...");
+  LOGV("BLE", "Sending flag set, starting transmission...");
   
   try {
     // Convert string to byte array to avoid encoding issues
     std::vector<uint8_t> dataBytes(data.begin(), data.end());
-    Serial.printf("[BLE DEBUG] Converted to %d bytes\n", dataBytes.size());
+    LOGV("BLE", "Converted to %d bytes", (int)dataBytes.size());
     
     pSensorDataCharacteristic->setValue(dataBytes);
-    Serial.println("[BLE DEBUG] Characteristic value set");
+    LOGV("BLE", "Characteristic value set");
     
     pSensorDataCharacteristic->notify();
-    Serial.println("[BLE DEBUG] Notify called");
+    LOGV("BLE", "Notify called");
     
     // Small delay to ensure transmission completes
     delay(isCommand ? 10 : 5);
-    Serial.printf("[BLE DEBUG] Delay completed (%d ms)\n", isCommand ? 10 : 5);
+    LOGV("BLE", "Delay completed (%d ms)", isCommand ? 10 : 5);
     
     bleSending = false;
-    Serial.println("[BLE DEBUG] SUCCESS: Transmission completed");
+    LOGV("BLE", "Transmission completed");
     return true;
   } catch (...) {
     bleSending = false;
-    Serial.println("[BLE DEBUG] FAILED: Exception during transmission");
+    LOGV("BLE", "Exception during transmission");
     return false;
   }
 }
 
-// BLE Server Callbacks
+// Feed received patch bytes. Once the header is in, the running image must
+// be the one the patch was made from before the update slot is opened.
+// Returns an error message, nullptr when every byte was taken
+const char* applyPatchChunk(const uint8_t* data, size_t length) {
+  size_t used = 0;
+  while (used < length && deltaPatch.state() != DELTA_FAILED) {
+    used += deltaPatch.feed(data + used, length - used);
+    if (deltaPatch.state() != DELTA_READY) continue;
+    
+    const DeltaHeader &header = deltaPatch.header();
+    LOGI("BLE OTA", "Patch from a %u byte image to %u bytes, checking the running image",
+         (unsigned)header.sourceSize, (unsigned)header.targetSize);
+    if (!deltaPatch.verifySource()) break;
+    if (!Update.begin(header.targetSize)) {
+      LOGE("BLE OTA", "Update.begin() failed: %s", Update.errorString());
+      return "Failed to begin update";
+    }
+    deltaPatch.start();
+  }
+  if (deltaPatch.state() == DELTA_FAILED) {
+    LOGE("BLE OTA", "Patch failed: %s", deltaPatch.error());
+    return deltaPatch.error();
+  }
+  return nullptr;
+}
+
+// Image or patch bytes, as received or decompressed. Returns an error
+// message, nullptr when written
+const char* writeImageChunk(const uint8_t* data, size_t length) {
+  if (otaDelta) return applyPatchChunk(data, length);
+  if (Update.write(const_cast<uint8_t*>(data), length) != length) {
+    LOGE("BLE OTA", "Write failed: %s", Update.errorString());
+    return "Write failed";
+  }
+  return nullptr;
+}
+
+// Decompress received bytes into the image or patch
+const char* inflateChunk(const uint8_t* data, size_t length) {
+  if (otaDecoder.feed(data, length)) return nullptr;
+  // The output's own message says more than the decoder's "Image write failed"
+  return imageOutput.failure ? imageOutput.failure : otaDecoder.error();
+}
+
+// BLE Server Callbacks (NimBLE host task: queue the change, handled in processBleEvents)
 class MyServerCallbacks: public NimBLEServerCallbacks {
-    void onConnect(NimBLEServer* pServer) {
-      connectedDeviceCount++;
-      deviceConnected = true;
-      Serial.printf("BLE Client connected (total: %d)\n", connectedDeviceCount);
-      
-      // Send firmware version after connection
-      delay(1000); // Give client time to set up characteristics
-      if (pSensorDataCharacteristic) {
-        DynamicJsonDocument doc(128);
-        doc["type"] = "firmware_version";
-        doc["version"] = FIRMWARE_VERSION;
-        String versionData;
-        serializeJson(doc, versionData);
-        
-        if (safeBLESend(versionData, true)) {
-          Serial.printf("Sent firmware version on connect: %s\n", FIRMWARE_VERSION);
-        } else {
-          Serial.println("Failed to send firmware version on connect");
-        }
-      }
-      
-      // Continue advertising if we haven't reached max connections AND discovery mode is active
-      if (connectedDeviceCount < CONFIG_BT_NIMBLE_MAX_CONNECTIONS && discoveryModeActive) {
-        delay(100); // Small delay before restarting advertising
-        NimBLEDevice::startAdvertising();
-        Serial.printf("Continuing advertising for additional connections... (%d/%d connected)\n", 
-                     connectedDeviceCount, CONFIG_BT_NIMBLE_MAX_CONNECTIONS);
-      } else {
-        if (connectedDeviceCount >= CONFIG_BT_NIMBLE_MAX_CONNECTIONS) {
-          Serial.printf("Maximum connections reached (%d/%d)\n", 
-                       connectedDeviceCount, CONFIG_BT_NIMBLE_MAX_CONNECTIONS);
-        } else {
-          Serial.println("Discovery mode not active, stopping advertising for new connections");
-        }
+    void onConnect(NimBLEServer* pServer, ble_gap_conn_desc* desc) {
+      connectedDeviceCount.fetch_add(1);
+      if (!linkEvents.push({LINK_CONNECTED, desc->conn_handle})) {
+        LOGW("BLE", "Link event queue full, connect of %u not handled", desc->conn_handle);
       }
+      wakeLoop();
     };
 
-    void onDisconnect(NimBLEServer* pServer) {
-      connectedDeviceCount--;
-      if (connectedDeviceCount == 0) {
-        deviceConnected = false;
-        bleRSSI = 0; // Reset RSSI when all devices disconnected
-      }
-      Serial.printf("BLE Client disconnected (remaining: %d/%d)\n", 
-                   connectedDeviceCount, CONFIG_BT_NIMBLE_MAX_CONNECTIONS);
-      
-      // Restart advertising when a device disconnects if discovery mode is active
-      delay(500);
-      if (!NimBLEDevice::getAdvertising()->isAdvertising() && discoveryModeActive && connectedDeviceCount < CONFIG_BT_NIMBLE_MAX_CONNECTIONS) {
-        NimBLEDevice::startAdvertising();
-        Serial.println("Restarting advertising after disconnection (discovery mode active)...");
-      } else if (!discoveryModeActive) {
-        Serial.println("Discovery mode not active, not restarting advertising");
+    void onDisconnect(NimBLEServer* pServer, ble_gap_conn_desc* desc) {
+      connectedDeviceCount.fetch_sub(1);
+      if (!linkEvents.push({LINK_DISCONNECTED, desc->conn_handle})) {
+        LOGW("BLE", "Link event queue full, disconnect of %u not handled", desc->conn_handle);
       }
+      wakeLoop();
     }
 };
 
 class CommandCallbacks: public NimBLECharacteristicCallbacks {
+  public:
+    // NimBLE host task: copy the command for loop() and return
     void onWrite(NimBLECharacteristic *pCharacteristic) {
       std::string value = pCharacteristic->getValue();
-      
+      BleCommand command;
+      command.length = value.length() < BLE_COMMAND_MAX ? value.length() : BLE_COMMAND_MAX;
+      memcpy(command.text, value.data(), command.length);
+      command.text[command.length] = '\0';
+      if (value.length() > BLE_COMMAND_MAX) {
+        commandsTooLong.fetch_add(1);
+        LOGW("BLE RECV", "Command dropped (%d bytes, longer than %d)", (int)value.length(), BLE_COMMAND_MAX);
+      } else if (!commandQueue.push(command)) {
+        LOGW("BLE RECV", "Command dropped (%d bytes, %u queued)", (int)value.length(), (unsigned)commandQueue.size());
+      }
+      wakeLoop();
+    }
+
+    // loop() context: parse and run one command
+    void execute(const std::string &value) {
       if (value.length() > 0) {
-        Serial.printf("[BLE RECV] Received %d bytes\n", value.length());
-        
-        #ifdef DEBUG_BLE_DATA
-        Serial.print("BLE Command received: ");
-        Serial.println(value.c_str());
-        #endif
+        LOGD("BLE RECV", "Received %d bytes", (int)value.length());
+        LOGV("BLE RECV", "Command: %s", value.c_str());
         
         // Parse JSON command - increased buffer size for base64 chunk data
         // Base64 chunks can be ~440 bytes total with JSON overhead
@@ -288,92 +763,60 @@ class CommandCallbacks: public NimBLECharacteristicCallbacks {
           String action = doc["action"];
           String cmd = doc["cmd"];
           
-          Serial.printf("[BLE RECV] Parsed JSON - action: '%s', cmd: '%s'\n", 
-                       action.c_str(), cmd.c_str());
+          LOGD("BLE RECV", "Parsed JSON - action: '%s', cmd: '%s'",
+               action.c_str(), cmd.c_str());
           
           // Log OTA-related commands with extra detail
           if (cmd == "START_FW_UPDATE" || cmd == "FW_CHUNK" || cmd == "VERIFY_FW" || cmd == "APPLY_FW") {
-            Serial.printf("[OTA CMD] Received: %s\n", cmd.c_str());
             if (cmd == "FW_CHUNK") {
-              int chunkIndex = doc["index"];
-              Serial.printf("[OTA CMD] Chunk index: %d\n", chunkIndex);
+              LOGD("OTA CMD", "Received: %s, chunk index: %d", cmd.c_str(), doc["index"].as<int>());
+            } else {
+              LOGD("OTA CMD", "Received: %s", cmd.c_str());
             }
           }
           
           if (action == "resetHeelAngle") {
             // Calibrate vessel level position (sets current orientation as zero reference)
-            if (imuAvailable) {
-              // Get current rotation vector for calibration
-              if (imu.dataAvailable()) {
-                // Use rotation vector to calculate current heel angle
-                float i = imu.getQuatI();
-                float j = imu.getQuatJ();
-                float k = imu.getQuatK();
-                float real = imu.getQuatReal();
-                
-                // Convert quaternion to heel angle (roll around X-axis)
-                float roll = atan2(2.0f * (real * i + j * k), 1.0f - 2.0f * (i * i + j * j)) * 180.0f / PI;
-                heelAngleDelta = roll;
-                preferences.putFloat("delta", heelAngleDelta);
-                Serial.printf("Vessel level calibrated - offset set to %.2f degrees\n", heelAngleDelta);
-              } else {
-                Serial.println("Level calibration failed - can't read IMU sensor");
-              }
+            const Orientation &orientation = sensorPipeline.imuOrientation();
+            if (!imuAvailable) {
+              LOGW("Command", "Level calibration failed - IMU sensor not available");
+            } else if (!orientation.valid() || millis() - orientation.sampleTime() > ORIENTATION_MAX_GAP_MS) {
+              LOGW("Command", "Level calibration failed - can't read IMU sensor");
             } else {
-              Serial.println("Level calibration failed - IMU sensor not available");
+              // The tilt of the latest report becomes level, pitch included
+              float heel = orientation.attitude().heel;
+              float pitch = orientation.attitude().pitch;
+              levelReference = orientation.levelHere();
+              preferences.putBytes("levelQuat", &levelReference, sizeof(levelReference));
+              sensorPipeline.setLevelReference(levelReference);
+              LOGI("Command", "Vessel level calibrated - removed %.2f degrees heel, %.2f degrees pitch", heel, pitch);
             }
           }
           else if (action == "resetCompassNorth") {
             // Calibrate compass to north - saves current magnetic heading as north reference
-            if (imuAvailable) {
-              // Get current magnetometer data
-              if (imu.dataAvailable()) {
-                float magX = imu.getMagX();
-                float magY = imu.getMagY();
-                
-                // Calculate current magnetic heading
-                float currentHeading = atan2(magY, magX) * 180.0f / PI;
-                if (currentHeading < 0) currentHeading += 360.0f;
-                
-                // Store this heading as the offset (what the device reads when vessel points north)
-                compassOffsetDelta = currentHeading;
-                preferences.putFloat("compassOffset", compassOffsetDelta);
-                Serial.printf("Compass calibrated - north offset set to %.2f degrees\n", compassOffsetDelta);
-              } else {
-                Serial.println("Compass calibration failed - can't read magnetometer");
-              }
-            } else {
-              Serial.println("Compass calibration failed - IMU sensor not available");
-            }
-          }
-          else if (action == "regattaSetPort") {
-            if (gps.location.isValid()) {
-              regattaData.portLat = gps.location.lat();
-              regattaData.portLon = gps.location.lng();
-              
-              // Check if we now have both ends of the line
-              if (regattaData.starboardLat != 0.0 && regattaData.starboardLon != 0.0) {
-                regattaData.hasStartLine = true;
-              }
-              
-              Serial.printf("Regatta port position set: %.6f, %.6f\n", regattaData.portLat, regattaData.portLon);
+            float currentHeading = sensorPipeline.rawCompassHeading();
+            if (!imuAvailable) {
+              LOGW("Command", "Compass calibration failed - IMU sensor not available");
+            } else if (isnan(currentHeading)) {
+              LOGW("Command", "Compass calibration failed - can't read magnetometer");
             } else {
-              Serial.println("Cannot set regatta port position - GPS fix not available");
+              // Store this heading as the offset (what the device reads when vessel points north);
+              // the same tilt-compensated, smoothed heading the offset is applied to
+              compassOffsetDelta = currentHeading;
+              preferences.putFloat("compassOffset", compassOffsetDelta);
+              sensorPipeline.setCompassOffset(compassOffsetDelta);
+              LOGI("Command", "Compass calibrated - north offset set to %.2f degrees", compassOffsetDelta);
             }
           }
-          else if (action == "regattaSetStarboard") {
-            if (gps.location.isValid()) {
-              regattaData.starboardLat = gps.location.lat();
-              regattaData.starboardLon = gps.location.lng();
-              
-              // Check if we now have both ends of the line
-              if (regattaData.portLat != 0.0 && regattaData.portLon != 0.0) {
-                regattaData.hasStartLine = true;
-              }
-              
-              Serial.printf("Regatta starboard position set: %.6f, %.6f\n", regattaData.starboardLat, regattaData.starboardLon);
+          else if (action == "regattaSetPort" || action == "regattaSetStarboard") {
+            // Older clients: ping the pin (port) or committee boat (starboard) end at the boat's position
+            StartLineEnd end = action == "regattaSetPort" ? START_LINE_PIN : START_LINE_BOAT;
+            if (!gps.fix().has(NMEA_POSITION)) {
+              sendStartLineInfo("No GPS fix to ping the line end");
+            } else if (pingLineEnd(end, sensorPipeline.gpsPosition())) {
+              sendStartLineInfo();
             } else {
-              Serial.println("Cannot set regatta starboard position - GPS fix not available");
+              sendStartLineInfo("Line ends less than 5 m apart");
             }
           }
           else if (action == "setRefreshRate") {
@@ -382,7 +825,7 @@ class CommandCallbacks: public NimBLECharacteristicCallbacks {
               refreshRateSeconds = newRefreshRate;
               preferences.putFloat("refreshRate", refreshRateSeconds);
               updateRefreshRate();
-              Serial.printf("Refresh rate changed to %.1f seconds (%d ms)\n", refreshRateSeconds, (int)(refreshRateSeconds * 1000.0f));
+              LOGI("Command", "Refresh rate changed to %.1f seconds (%d ms)", refreshRateSeconds, (int)(refreshRateSeconds * 1000.0f));
               
               // Send confirmation response
               DynamicJsonDocument response(128);
@@ -392,7 +835,236 @@ class CommandCallbacks: public NimBLECharacteristicCallbacks {
               serializeJson(response, responseStr);
               safeBLESend(responseStr, true);
             } else {
-              Serial.println("Invalid refresh rate - must be between 0.5 and 2.0 seconds");
+              LOGW("Command", "Invalid refresh rate - must be between 0.5 and 2.0 seconds");
+            }
+          }
+          else if (action == "setTrueWind") {
+            // Any of mastHeight (m), speedTau and directionTau (s); omitted values are kept
+            float mastHeight = doc["mastHeight"] | trueWindConfig.mastHeight;
+            float speedTau = doc["speedTau"] | trueWindConfig.speedTau;
+            float directionTau = doc["directionTau"] | trueWindConfig.directionTau;
+            if (mastHeight >= 0.0f && mastHeight <= 50.0f && speedTau >= 0.0f && speedTau <= 60.0f &&
+                directionTau >= 0.0f && directionTau <= 60.0f) {
+              trueWindConfig.mastHeight = mastHeight;
+              trueWindConfig.speedTau = speedTau;
+              trueWindConfig.directionTau = directionTau;
+              preferences.putFloat("mastHeight", mastHeight);
+              preferences.putFloat("windSpeedTau", speedTau);
+              preferences.putFloat("windDirTau", directionTau);
+              sensorPipeline.setTrueWindConfig(trueWindConfig);
+              LOGI("Command", "True wind settings: mast %.1f m, TWS %.1f s, TWD %.1f s",
+                   mastHeight, speedTau, directionTau);
+              
+              DynamicJsonDocument response(128);
+              response["type"] = "true_wind_updated";
+              response["mastHeight"] = mastHeight;
+              response["speedTau"] = speedTau;
+              response["directionTau"] = directionTau;
+              String responseStr;
+              serializeJson(response, responseStr);
+              safeBLESend(responseStr, true);
+            } else {
+              LOGW("Command", "Invalid true wind settings - mast 0-50 m, time constants 0-60 s");
+            }
+          }
+          else if (action == "setMovementWindows") {
+            // trackPoints (GPS fixes) and/or accelSamples (IMU samples); omitted values are kept
+            int trackPoints = doc["trackPoints"] | (int)sensorPipeline.trackWindow();
+            int accelSamples = doc["accelSamples"] | (int)sensorPipeline.accelWindow();
+            if (trackPoints >= 3 && trackPoints <= TRACK_STATS_MAX_WINDOW + 1 &&
+                accelSamples >= 3 && accelSamples <= TRACK_STATS_MAX_WINDOW) {
+              preferences.putUChar("trackPoints", (uint8_t)trackPoints);
+              preferences.putUChar("accelSamples", (uint8_t)accelSamples);
+              sensorPipeline.setMovementWindows((uint8_t)trackPoints, (uint8_t)accelSamples);
+              LOGI("Command", "Movement windows: %d GPS points, %d accelerometer samples", trackPoints, accelSamples);
+              
+              DynamicJsonDocument response(128);
+              response["type"] = "movement_windows_updated";
+              response["trackPoints"] = trackPoints;
+              response["accelSamples"] = accelSamples;
+              String responseStr;
+              serializeJson(response, responseStr);
+              safeBLESend(responseStr, true);
+            } else {
+              LOGW("Command", "Invalid movement windows - GPS points 3-%d, accelerometer samples 3-%d",
+                   TRACK_STATS_MAX_WINDOW + 1, TRACK_STATS_MAX_WINDOW);
+            }
+          }
+          else if (action == "setOutlierFilter") {
+            // Spike rejection: awsWindow, awaWindow, sogWindow (samples, 0 = off)
+            // and/or threshold (scaled MADs); omitted values are kept. "reset"
+            // clears the rejection counters
+            static const char* const windowKeys[OUTLIER_CHANNEL_COUNT] = {"awsWindow", "awaWindow", "sogWindow"};
+            int windows[OUTLIER_CHANNEL_COUNT];
+            bool valid = true;
+            for (uint8_t channel = 0; channel < OUTLIER_CHANNEL_COUNT; channel++) {
+              windows[channel] = doc[windowKeys[channel]] | (int)sensorPipeline.outlierFilter((OutlierChannel)channel).window();
+              valid = valid && (windows[channel] == 0 || (windows[channel] >= HAMPEL_MIN_SAMPLES && windows[channel] <= HAMPEL_MAX_WINDOW));
+            }
+            float threshold = doc["threshold"] | sensorPipeline.outlierFilter(OUTLIER_AWS).getThreshold();
+            valid = valid && threshold >= 1.5f && threshold <= 10.0f;
+            if (valid) {
+              for (uint8_t channel = 0; channel < OUTLIER_CHANNEL_COUNT; channel++) {
+                if (!doc.containsKey(windowKeys[channel])) continue;
+                preferences.putUChar(OUTLIER_NVS_KEYS[channel], (uint8_t)windows[channel]);
+                sensorPipeline.setOutlierWindow((OutlierChannel)channel, (uint8_t)windows[channel]);
+              }
+              preferences.putFloat("hampelK", threshold);
+              sensorPipeline.setOutlierThreshold(threshold);
+              if (doc["reset"] | false) sensorPipeline.resetOutlierCounters();
+              LOGI("Command", "Spike rejection: windows AWS %d, AWA %d, SOG %d, threshold %.1f",
+                   windows[OUTLIER_AWS], windows[OUTLIER_AWA], windows[OUTLIER_SOG], threshold);
+              
+              DynamicJsonDocument response(384);
+              response["type"] = "outlier_filter_updated";
+              response["threshold"] = threshold;
+              for (uint8_t channel = 0; channel < OUTLIER_CHANNEL_COUNT; channel++) {
+                const HampelFilter &filter = sensorPipeline.outlierFilter((OutlierChannel)channel);
+                response[windowKeys[channel]] = filter.window();
+              }
+              // Rejected samples of all samples seen, per channel
+              JsonObject rejected = response.createNestedObject("rejected");
+              static const char* const names[OUTLIER_CHANNEL_COUNT] = {"aws", "awa", "sog"};
+              for (uint8_t channel = 0; channel < OUTLIER_CHANNEL_COUNT; channel++) {
+                const HampelFilter &filter = sensorPipeline.outlierFilter((OutlierChannel)channel);
+                JsonArray counts = rejected.createNestedArray(names[channel]);
+                counts.add(filter.rejected());
+                counts.add(filter.total());
+              }
+              String responseStr;
+              serializeJson(response, responseStr);
+              safeBLESend(responseStr, true);
+            } else {
+              LOGW("Command", "Invalid spike rejection settings - windows 0 or %d-%d, threshold 1.5-10",
+                   HAMPEL_MIN_SAMPLES, HAMPEL_MAX_WINDOW);
+            }
+          }
+          else if (action == "setOrientation") {
+            // peakWindow (seconds of peak heel); omitted keeps it, so an empty
+            // request reads the attitude back
+            const Orientation &orientation = sensorPipeline.imuOrientation();
+            int peakWindow = doc["peakWindow"] | (int)orientation.peakWindow();
+            if (peakWindow >= 1 && peakWindow <= ORIENTATION_PEAK_SLOTS) {
+              if (doc.containsKey("peakWindow")) {
+                preferences.putUChar("peakWindow", (uint8_t)peakWindow);
+                sensorPipeline.setPeakHeelWindow((uint8_t)peakWindow);
+                LOGI("Command", "Peak heel window: %d s", peakWindow);
+              }
+              
+              DynamicJsonDocument response(384);
+              response["type"] = "orientation_updated";
+              response["peakWindow"] = orientation.peakWindow();
+              if (imuAvailable && orientation.valid()) {
+                const Attitude &attitude = orientation.attitude();
+                response["heel"] = round(attitude.heel * 10) / 10.0;
+                response["pitch"] = round(attitude.pitch * 10) / 10.0;
+                response["yaw"] = round(attitude.yaw * 10) / 10.0;
+                response["heelRate"] = round(attitude.heelRate * 10) / 10.0;
+                response["pitchRate"] = round(attitude.pitchRate * 10) / 10.0;
+                response["yawRate"] = round(attitude.yawRate * 10) / 10.0;
+                float heelMax = orientation.heelMax(millis());
+                if (!isnan(heelMax)) {
+                  response["heelMax"] = round(heelMax * 10) / 10.0;
+                  response["heelMin"] = round(orientation.heelMin(millis()) * 10) / 10.0;
+                }
+                response["samples"] = orientation.samples();
+              }
+              // Level reference quaternion (w, x, y, z)
+              JsonArray reference = response.createNestedArray("reference");
+              reference.add(levelReference.w);
+              reference.add(levelReference.x);
+              reference.add(levelReference.y);
+              reference.add(levelReference.z);
+              String responseStr;
+              serializeJson(response, responseStr);
+              safeBLESend(responseStr, true);
+            } else {
+              LOGW("Command", "Invalid peak heel window - 1-%d s", ORIENTATION_PEAK_SLOTS);
+            }
+          }
+          else if (action == "setNmeaOutput") {
+            // Any of rate (Hz, 0 = off), serial (bool), baud and sentences
+            // (names, see nmeaOutputBit()); omitted values are kept
+            int rate = doc["rate"] | (int)nmeaOutputRate;
+            bool serial = doc["serial"] | nmeaSerialOutput.load();
+            uint32_t baud = doc["baud"] | nmeaSerialBaud;
+            uint8_t sentences = nmeaOutput.sentences();
+            bool valid = rate >= 0 && rate <= NMEA_OUTPUT_MAX_RATE &&
+                         (baud == 4800 || baud == 9600 || baud == 19200 || baud == 38400 ||
+                          baud == 57600 || baud == 115200);
+            if (doc.containsKey("sentences")) {
+              sentences = 0;
+              for (JsonVariant name : doc["sentences"].as<JsonArray>()) {
+                uint8_t bit = nmeaOutputBit(name.as<const char*>() ? name.as<const char*>() : "");
+                if (!bit) valid = false;
+                sentences |= bit;
+              }
+            }
+            if (valid) {
+              nmeaOutputRate = (uint8_t)rate;
+              nmeaOutput.setSentences(sentences);
+              preferences.putUChar("nmeaRate", nmeaOutputRate);
+              preferences.putUChar("nmeaSentences", sentences);
+              preferences.putBool("nmeaSerial", serial);
+              preferences.putUInt("nmeaBaud", baud);
+              LOGI("Command", "NMEA output: %d Hz, sentences 0x%02X, serial %s at %lu baud", rate, sentences,
+                   serial ? "on" : "off", (unsigned long)baud);
+              setNmeaSerialOutput(serial, baud);
+              
+              DynamicJsonDocument response(128);
+              response["type"] = "nmea_output_updated";
+              response["rate"] = nmeaOutputRate;
+              response["serial"] = serial;
+              response["baud"] = baud;
+              response["sentences"] = sentences;
+              String responseStr;
+              serializeJson(response, responseStr);
+              safeBLESend(responseStr, true);
+            } else {
+              LOGW("Command", "Invalid NMEA output settings - rate 0-%d Hz, baud 4800-115200, sentences "
+                   "MWV, MWVR, MWVT, HDM, XDR, RMC, VTG, LINE", NMEA_OUTPUT_MAX_RATE);
+            }
+          }
+          else if (action == "setWifi") {
+            // Any of enabled, ssid and password; omitted values are kept. No
+            // field at all just reports the state. There is no default
+            // password: the first enable has to bring one the client knows
+            String ssid = doc["ssid"] | preferences.getString("wifiSsid", deviceNameCache);
+            String password = doc["password"] | preferences.getString("wifiPass", "");
+            bool enabled = doc["enabled"] | wifiEnabled.load();
+            if (enabled && password.length() == 0) {
+              LOGW("Command", "Wi-Fi access point needs a password before it can be enabled");
+              DynamicJsonDocument response(128);
+              response["type"] = "error";
+              response["message"] = "Wi-Fi password required";
+              String responseStr;
+              serializeJson(response, responseStr);
+              safeBLESend(responseStr, true);
+            } else if (ssid.length() >= 1 && ssid.length() <= 32 &&
+                       (password.length() == 0 || (password.length() >= 8 && password.length() <= 63))) {
+              if (doc.containsKey("ssid") || doc.containsKey("password")) {
+                preferences.putString("wifiSsid", ssid);
+                preferences.putString("wifiPass", password);
+                setWifiConfig(ssid.c_str(), password.c_str());
+              }
+              preferences.putBool("wifiOn", enabled);
+              wifiEnabled = enabled;
+              LOGI("Command", "Wi-Fi access point '%s' %s", ssid.c_str(), enabled ? "on" : "off");
+              
+              DynamicJsonDocument response(256);
+              response["type"] = "wifi_updated";
+              response["enabled"] = enabled;
+              response["running"] = wifiRunning.load();
+              response["ssid"] = ssid;
+              response["passwordSet"] = password.length() > 0;   // Never the password itself: BLE is not paired
+              response["json"] = wifiJsonClients.load();
+              response["binary"] = wifiBinaryClients.load();
+              response["nmea"] = wifiNmeaClients.load();
+              String responseStr;
+              serializeJson(response, responseStr);
+              safeBLESend(responseStr, true);
+            } else {
+              LOGW("Command", "Invalid Wi-Fi settings - SSID 1-32 characters, password 8-63");
             }
           }
           else if (action == "setDeviceName") {
@@ -427,33 +1099,33 @@ class CommandCallbacks: public NimBLECharacteristicCallbacks {
                 
                 // Verify the name was actually saved
                 String savedName = preferences.getString("deviceName", "Veetr");
-                Serial.printf("Device name changed from '%s' to '%s'\n", currentDeviceName.c_str(), newDeviceName.c_str());
-                Serial.printf("Verified saved name: '%s'\n", savedName.c_str());
+                LOGI("Command", "Device name changed from '%s' to '%s'", currentDeviceName.c_str(), newDeviceName.c_str());
+                LOGI("Command", "Verified saved name: '%s'", savedName.c_str());
                 
                 if (savedName != newDeviceName) {
-                  Serial.println("ERROR: Device name not saved properly to NVS!");
+                  LOGE("Command", "Device name not saved properly to NVS!");
                   return; // Don't restart if save failed
                 }
                 
                 // Send success response first before restarting
-                Serial.println("Device name saved successfully - ESP32 will restart to apply changes");
+                LOGI("Command", "Device name saved successfully - ESP32 will restart to apply changes");
                 
                 // Reset BLE with new random address to bypass client cache
                 resetBLEForNewName(newDeviceName);
                 
                 // Restart ESP32 to apply new device name
-                Serial.println("ESP32 will restart in 1 second");
+                LOGI("Command", "ESP32 will restart in 1 second");
                 delay(200); // Brief delay to ensure BLE response is sent
                 ESP.restart();
               } else {
-                Serial.println("Invalid device name - only alphanumeric, underscore, hyphen, and space allowed");
+                LOGW("Command", "Invalid device name - only alphanumeric, underscore, hyphen, and space allowed");
               }
             } else {
-              Serial.println("Invalid device name - must be 1-20 characters");
+              LOGW("Command", "Invalid device name - must be 1-20 characters");
             }
           }
           else if (action == "restartWithNewName") {
-            Serial.println("Restarting ESP32 to apply new device name...");
+            LOGI("Command", "Restarting ESP32 to apply new device name...");
             delay(500); // Give time for response to be sent
             ESP.restart();
           }
@@ -466,17 +1138,17 @@ class CommandCallbacks: public NimBLECharacteristicCallbacks {
             serializeJson(response, responseStr);
             
             if (safeBLESend(responseStr, true)) {
-              Serial.printf("Sent firmware version: %s\n", FIRMWARE_VERSION);
+              LOGI("Command", "Sent firmware version: %s", FIRMWARE_VERSION);
             } else {
-              Serial.println("Failed to send firmware version response");
+              LOGW("Command", "Failed to send firmware version response");
             }
           }
           else if (doc["cmd"] == "START_FW_UPDATE") {
-            Serial.println("[BLE OTA] Starting firmware update using ESP32 Update library");
+            LOGI("BLE OTA", "Starting firmware update using ESP32 Update library");
             
             // Get firmware size - required for Update.begin()
             if (!doc.containsKey("size")) {
-              Serial.println("[BLE OTA] Error: Firmware size not provided");
+              LOGE("BLE OTA", "Firmware size not provided");
               DynamicJsonDocument response(128);
               response["type"] = "error";
               response["message"] = "Firmware size required";
@@ -486,23 +1158,35 @@ class CommandCallbacks: public NimBLECharacteristicCallbacks {
               return;
             }
             
+            // "patch": the data is a patch against the running image, "compressed":
+            // it is compressed. "size" is always the length sent
             otaSize = doc["size"];
-            Serial.printf("[BLE OTA] Firmware size: %u bytes\n", otaSize);
+            otaDelta = doc["patch"] | false;
+            otaCompressed = doc["compressed"] | false;
+            LOGI("BLE OTA", "%s%s size: %u bytes", otaCompressed ? "Compressed " : "",
+                 otaDelta ? "patch" : "firmware", (unsigned)otaSize);
             
             // Check available space and state
-            Serial.printf("[BLE OTA] Free heap: %u bytes\n", ESP.getFreeHeap());
-            Serial.printf("[BLE OTA] Flash size: %u bytes\n", ESP.getFlashChipSize());
+            LOGI("BLE OTA", "Free heap: %u bytes", ESP.getFreeHeap());
+            LOGI("BLE OTA", "Flash size: %u bytes", ESP.getFlashChipSize());
             
             // Ensure clean state by aborting any previous update
             if (Update.isRunning()) {
-              Serial.println("[BLE OTA] Aborting previous update operation");
+              LOGI("BLE OTA", "Aborting previous update operation");
               Update.abort();
             }
             
-            // Begin OTA update
-            if (!Update.begin(otaSize)) {
+            // Begin OTA update (for a patch once its header gives the image size;
+            // a compressed image fills the slot up to where it ends)
+            if (otaCompressed) {
+              imageOutput.failure = nullptr;
+              otaDecoder.begin();
+            }
+            if (otaDelta) {
+              deltaPatch.begin();
+            } else if (!Update.begin(otaCompressed ? UPDATE_SIZE_UNKNOWN : otaSize)) {
               uint8_t error = Update.getError();
-              Serial.printf("[BLE OTA] Update.begin() failed: %s (error code: %u)\n", Update.errorString(), error);
+              LOGE("BLE OTA", "Update.begin() failed: %s (error code: %u)", Update.errorString(), error);
               DynamicJsonDocument response(128);
               response["type"] = "error";
               response["message"] = "Failed to begin update";
@@ -516,27 +1200,31 @@ class CommandCallbacks: public NimBLECharacteristicCallbacks {
             otaStartTime = millis();
             otaWritten = 0;
             
-            Serial.println("[BLE OTA] Ready to receive firmware data");
+            LOGI("BLE OTA", "Ready to receive firmware data");
             
             // Send acknowledgment
             DynamicJsonDocument response(128);
             response["type"] = "update_ready";
+            response["patch"] = otaDelta;
+            response["compressed"] = otaCompressed;
             String responseStr;
             serializeJson(response, responseStr);
             safeBLESend(responseStr, true);
           }
           else if (doc["cmd"] == "STOP_FW_UPDATE") {
-            Serial.println("[BLE OTA] Stopping firmware update");
+            LOGI("BLE OTA", "Stopping firmware update");
             
             if (bleOTAActive) {
               Update.abort();
-              Serial.println("[BLE OTA] Update aborted");
+              LOGI("BLE OTA", "Update aborted");
             }
             
             bleOTAActive = false;
             otaStartTime = 0;
             otaWritten = 0;
             otaSize = 0;
+            otaDelta = false;
+            otaCompressed = false;
             
             DynamicJsonDocument response(128);
             response["type"] = "update_stopped";
@@ -550,6 +1238,8 @@ class CommandCallbacks: public NimBLECharacteristicCallbacks {
             response["type"] = "ota_status";
             response["active"] = bleOTAActive;
             response["library"] = "ESP32 Update";
+            response["patch"] = otaDelta;
+            response["compressed"] = otaCompressed;
             
             if (bleOTAActive && otaStartTime > 0) {
               response["elapsed_ms"] = millis() - otaStartTime;
@@ -566,7 +1256,7 @@ class CommandCallbacks: public NimBLECharacteristicCallbacks {
           }
           else if (doc["cmd"] == "FW_CHUNK") {
             if (!bleOTAActive) {
-              Serial.println("[BLE OTA] Error: Firmware update not active");
+              LOGE("BLE OTA", "Firmware update not active");
               DynamicJsonDocument response(128);
               response["type"] = "error";
               response["message"] = "Update not active";
@@ -579,7 +1269,7 @@ class CommandCallbacks: public NimBLECharacteristicCallbacks {
             // Get chunk index and data from base64
             int chunkIndex = doc["index"];
             if (!doc.containsKey("data")) {
-              Serial.println("[BLE OTA] Error: No data in chunk");
+              LOGE("BLE OTA", "No data in chunk");
               DynamicJsonDocument response(128);
               response["type"] = "error";
               response["message"] = "No chunk data";
@@ -596,7 +1286,7 @@ class CommandCallbacks: public NimBLECharacteristicCallbacks {
             int actualLen = base64_decode(dataB64.c_str(), decodedData);
             
             if (actualLen <= 0) {
-              Serial.println("[BLE OTA] Base64 decode failed");
+              LOGW("BLE OTA", "Base64 decode failed");
               free(decodedData);
               DynamicJsonDocument response(128);
               response["type"] = "error";
@@ -607,24 +1297,24 @@ class CommandCallbacks: public NimBLECharacteristicCallbacks {
               return;
             }
             
-            // Write chunk to flash
-            size_t written = Update.write(decodedData, actualLen);
+            // Write chunk to flash, or rebuild the image from the running one with it
+            const char* writeError = otaCompressed ? inflateChunk(decodedData, actualLen)
+                                                   : writeImageChunk(decodedData, actualLen);
             free(decodedData);
             
-            if (written != actualLen) {
-              Serial.printf("[BLE OTA] Write failed: %s\n", Update.errorString());
+            if (writeError) {
               DynamicJsonDocument response(128);
               response["type"] = "error";
-              response["message"] = "Write failed";
+              response["message"] = writeError;
               String responseStr;
               serializeJson(response, responseStr);
               safeBLESend(responseStr, true);
               return;
             }
             
-            otaWritten += written;
-            Serial.printf("[BLE OTA] Wrote %u bytes, total: %u/%u (%.1f%%)\n", 
-                         written, otaWritten, otaSize, (float)otaWritten/otaSize*100.0);
+            otaWritten += actualLen;
+            LOGD("BLE OTA", "Wrote %u bytes, total: %u/%u (%.1f%%)",
+                 (unsigned)actualLen, (unsigned)otaWritten, (unsigned)otaSize, (float)otaWritten/otaSize*100.0);
             
             // Send chunk acknowledgment
             DynamicJsonDocument response(128);
@@ -638,7 +1328,7 @@ class CommandCallbacks: public NimBLECharacteristicCallbacks {
           }
           else if (doc["cmd"] == "VERIFY_FW") {
             if (!bleOTAActive) {
-              Serial.println("[BLE OTA] Error: Firmware update not active");
+              LOGE("BLE OTA", "Firmware update not active");
               DynamicJsonDocument response(128);
               response["type"] = "error";
               response["message"] = "Update not active";
@@ -648,9 +1338,27 @@ class CommandCallbacks: public NimBLECharacteristicCallbacks {
               return;
             }
             
-            // Finalize the update
-            if (Update.end(true)) {
-              Serial.println("[BLE OTA] Firmware update completed successfully!");
+            // Finalize the update. A compressed stream must end where it should,
+            // and a patch must have rebuilt the whole image with its expected hash
+            // before Update.end() makes it the boot image
+            const char* imageError = nullptr;
+            if (otaCompressed && !otaDecoder.finish()) {
+              imageError = imageOutput.failure ? imageOutput.failure : otaDecoder.error();
+            } else if (otaDelta && !deltaPatch.finish()) {
+              imageError = deltaPatch.error();
+            }
+            if (imageError) {
+              LOGE("BLE OTA", "Update failed: %s", imageError);
+              Update.abort();
+              
+              DynamicJsonDocument response(128);
+              response["type"] = "error";
+              response["message"] = imageError;
+              String responseStr;
+              serializeJson(response, responseStr);
+              safeBLESend(responseStr, true);
+            } else if (Update.end(true)) {
+              LOGI("BLE OTA", "Firmware update completed successfully!");
               
               DynamicJsonDocument response(128);
               response["type"] = "update_complete";
@@ -659,7 +1367,7 @@ class CommandCallbacks: public NimBLECharacteristicCallbacks {
               serializeJson(response, responseStr);
               safeBLESend(responseStr, true);
             } else {
-              Serial.printf("[BLE OTA] Update failed: %s\n", Update.errorString());
+              LOGE("BLE OTA", "Update failed: %s", Update.errorString());
               
               DynamicJsonDocument response(128);
               response["type"] = "error";
@@ -673,9 +1381,213 @@ class CommandCallbacks: public NimBLECharacteristicCallbacks {
             otaStartTime = 0;
             otaWritten = 0;
             otaSize = 0;
+            otaDelta = false;
+            otaCompressed = false;
+          }
+          else if (doc["cmd"] == "TELEMETRY_KEYFRAME") {
+            // Client lost a delta frame - resynchronise on the next notify
+            telemetryEncoder.reset();
+          }
+          else if (doc["cmd"] == "LOG_INFO") {
+            sendLogInfo();
+          }
+          else if (doc["cmd"] == "LOG_READ") {
+            // Stream log blocks covering [from, to] (UTC seconds), or resume from block "seq"
+            if (!sessionLog.isReady()) {
+              DynamicJsonDocument response(128);
+              response["type"] = "error";
+              response["message"] = "Session log not available";
+              String responseStr;
+              serializeJson(response, responseStr);
+              safeBLESend(responseStr, true);
+              return;
+            }
+            
+            sessionLog.flush();
+            uint32_t startSeq = sessionLog.firstSeq();
+            uint32_t endSeq = sessionLog.endSeq();
+            
+            if (doc.containsKey("seq")) {
+              startSeq = max(startSeq, doc["seq"].as<uint32_t>());
+            } else if (doc.containsKey("from")) {
+              startSeq = sessionLog.findBlock(doc["from"].as<uint32_t>());
+            }
+            if (doc.containsKey("to")) {
+              // Include the block that straddles the end of the range
+              uint32_t to = doc["to"].as<uint32_t>();
+              endSeq = min(endSeq, sessionLog.findBlock(to + 1) + 1);
+            }
+            
+            uint16_t window = doc["window"] | 8;
+            startLogTransfer(startSeq, endSeq, window);
+          }
+          else if (doc["cmd"] == "LOG_ACK") {
+            // Flow control: client confirms blocks below "seq" and grants a new window
+            if (logTransfer.active) {
+              uint32_t acked = doc["seq"].as<uint32_t>();
+              if (acked > logTransfer.ackedSeq) logTransfer.ackedSeq = acked;
+              // At least one block, or the transfer stalls in the active power mode
+              if (doc.containsKey("window")) logTransfer.window = max((uint16_t)1, doc["window"].as<uint16_t>());
+            }
+          }
+          else if (doc["cmd"] == "LOG_STOP") {
+            stopLogTransfer("stopped");
+          }
+          else if (doc["cmd"] == "LOG_ERASE") {
+            stopLogTransfer("erased");
+            bool erased = sessionLog.erase();
+            LOGI("LOG", "Session log erase %s", erased ? "succeeded" : "failed");
+            sendLogInfo();
+          }
+          else if (doc["cmd"] == "PROFILE") {
+            sendProfileReport();
+          }
+          else if (doc["cmd"] == "PROFILE_RESET") {
+            profileResetPending = true;
+          }
+          else if (doc["cmd"] == "PROFILE_TRACE") {
+            // Freeze the trace ring and stream it from loop()
+            profiler.setTraceEnabled(false);
+            profileTraceNext = 0;
+            profileTraceActive = true;
+          }
+          else if (doc["cmd"] == "GET_HISTORY") {
+            // Back-fill frames with sequence in [from, to) that are still in RAM
+            uint32_t from = doc["from"] | telemetryHistory.firstSeq();
+            uint32_t to = doc["to"] | telemetryHistory.endSeq();
+            startHistoryTransfer(from, to);
+          }
+          else if (doc["cmd"] == "TREND_READ") {
+            // One tier of the chart history as a binary blob (0 = 1 s, 1 = 10 s, 2 = 5 min)
+            startTrendTransfer(doc["tier"] | 0);
+          }
+          else if (doc["cmd"] == "GET_CONNECTIONS") {
+            sendConnectionInfo();
+          }
+          else if (doc["cmd"] == "POLAR_BEGIN") {
+            // Upload a polar blob of "size" bytes with CRC-32 "crc" (see PolarTable.h)
+            uint32_t size = doc["size"] | 0;
+            if (size < sizeof(PolarHeader) || size > POLAR_MAX_BLOB_SIZE || !doc.containsKey("crc")) {
+              sendPolarInfo("Polar size or crc missing or out of range");
+              return;
+            }
+            polarUpload.active = true;
+            polarUpload.size = size;
+            polarUpload.crc = doc["crc"].as<uint32_t>();
+            polarUpload.received = 0;
+            LOGI("Polar", "Upload started, %u bytes", (unsigned)size);
+            sendPolarInfo();
+          }
+          else if (doc["cmd"] == "POLAR_CHUNK") {
+            // Chunks are base64 and must arrive in order: "offset" is where this one starts
+            if (!polarUpload.active) {
+              sendPolarInfo("Polar upload not active");
+              return;
+            }
+            uint32_t offset = doc["offset"] | 0;
+            const char* dataB64 = doc["data"] | "";
+            size_t encodedLength = strlen(dataB64);
+            if (offset != polarUpload.received || encodedLength == 0 ||
+                encodedLength / 4 * 3 > polarUpload.size - offset + 2) {
+              sendPolarInfo("Polar chunk out of order or too long");
+              return;
+            }
+            uint8_t chunk[BLE_COMMAND_MAX / 4 * 3];
+            int length = base64_decode(dataB64, chunk);
+            if (length <= 0 || (uint32_t)length > polarUpload.size - offset) {
+              sendPolarInfo("Polar chunk decode failed");
+              return;
+            }
+            memcpy(polarUpload.data + offset, chunk, length);
+            polarUpload.received += length;
+            sendPolarInfo();
+          }
+          else if (doc["cmd"] == "POLAR_END") {
+            finishPolarUpload();
+          }
+          else if (doc["cmd"] == "POLAR_CLEAR") {
+            polarUpload.active = false;
+            polarTable.clear();
+            preferences.remove("polar");
+            LOGI("Polar", "Polar cleared");
+            sendPolarInfo();
+          }
+          else if (doc["cmd"] == "GET_POLAR") {
+            sendPolarInfo();
+          }
+          else if (doc["cmd"] == "LINE_PING") {
+            // Set one end of the start line: "end" is "pin" or "boat", at "lat"/"lon" or the boat's position
+            const char* endName = doc["end"] | "";
+            if (strcmp(endName, "pin") != 0 && strcmp(endName, "boat") != 0) {
+              sendStartLineInfo("Line end must be pin or boat");
+              return;
+            }
+            StartLineEnd end = strcmp(endName, "pin") == 0 ? START_LINE_PIN : START_LINE_BOAT;
+            GeoPoint position;
+            if (doc.containsKey("lat") && doc.containsKey("lon")) {
+              double lat = doc["lat"].as<double>();
+              double lon = doc["lon"].as<double>();
+              if (!(fabs(lat) <= 90.0) || !(fabs(lon) <= 180.0)) {
+                sendStartLineInfo("Line end position out of range");
+                return;
+              }
+              position = geoFromDegrees(lat, lon);
+            } else if (gps.fix().has(NMEA_POSITION)) {
+              position = sensorPipeline.gpsPosition();
+            } else {
+              sendStartLineInfo("No GPS fix to ping the line end");
+              return;
+            }
+            if (pingLineEnd(end, position)) {
+              sendStartLineInfo();
+            } else {
+              sendStartLineInfo("Line ends less than 5 m apart");
+            }
+          }
+          else if (doc["cmd"] == "LINE_CLEAR") {
+            regattaData.hasPin = false;
+            regattaData.hasBoat = false;
+            startLine.clear();
+            startState.valid = false;
+            saveRaceState();
+            LOGI("Regatta", "Start line cleared");
+            sendStartLineInfo();
+          }
+          else if (doc["cmd"] == "START_TIMER") {
+            // Start the countdown: the start signal is "seconds" from now
+            float seconds = doc["seconds"] | 0.0f;
+            if (!(seconds > 0 && seconds <= 3600)) {
+              sendStartLineInfo("Countdown must be 1-3600 seconds");
+              return;
+            }
+            setStartSignal(lroundf(seconds * 1000.0f));
+            LOGI("Regatta", "Countdown started, %.0f s to the start", seconds);
+            sendStartLineInfo();
+          }
+          else if (doc["cmd"] == "START_SYNC") {
+            // Round the countdown to the nearest full minute, at a sound or flag signal
+            if (!regattaData.timerRunning) {
+              sendStartLineInfo("Countdown not running");
+              return;
+            }
+            long remaining = (long)(regattaData.startAt - millis());
+            long minutes = remaining > 0 ? (remaining + 30000) / 60000 : 0;
+            setStartSignal(minutes * 60000);
+            LOGI("Regatta", "Countdown synced to %ld min", minutes);
+            sendStartLineInfo();
+          }
+          else if (doc["cmd"] == "START_CANCEL") {
+            regattaData.timerRunning = false;
+            regattaData.startUtcMs = 0;
+            saveRaceState();
+            LOGI("Regatta", "Countdown cancelled");
+            sendStartLineInfo();
+          }
+          else if (doc["cmd"] == "GET_START_LINE") {
+            sendStartLineInfo();
           }
           else if (doc["cmd"] == "APPLY_FW") {
-            Serial.println("[BLE OTA] Applying firmware update - restarting...");
+            LOGI("BLE OTA", "Applying firmware update - restarting...");
             
             // Send response before restart
             DynamicJsonDocument response(128);
@@ -689,87 +1601,154 @@ class CommandCallbacks: public NimBLECharacteristicCallbacks {
             ESP.restart();
           }
         } else {
-          Serial.printf("[BLE RECV] JSON parsing failed: %s\n", error.c_str());
-          Serial.printf("[BLE RECV] Raw data: %s\n", value.c_str());
+          LOGW("BLE RECV", "JSON parsing failed: %s", error.c_str());
+          LOGW("BLE RECV", "Raw data: %s", value.c_str());
         }
       } else {
-        Serial.println("[BLE RECV] Received empty message");
+        LOGW("BLE RECV", "Received empty message");
       }
     }
 };
-
-// Function to read BLE connection RSSI
-void updateBLERSSI() {
-  static unsigned long lastRSSIUpdate = 0;
-  static int rssiReadings[5] = {0}; // Sliding window for smoothing
-  static int rssiIndex = 0;
-  static bool rssiArrayInitialized = false;
-  
-  // Only update RSSI every 3 seconds to reduce noise
-  if (millis() - lastRSSIUpdate < 3000) {
-    return;
-  }
-  
-  if (deviceConnected && pServer) {
-    // Get the actual RSSI from connected devices
-    std::vector<uint16_t> connIds = pServer->getPeerDevices();
-    if (!connIds.empty()) {
-      // Use NimBLE API to get RSSI for the first connected device
-      uint16_t connHandle = connIds[0];
+static CommandCallbacks commandCallbacks;
+
+// Drain the channels from the NimBLE host task; called at the top of loop()
+void processBleEvents() {
+  LinkEvent event;
+  while (linkEvents.pop(event)) {
+    uint16_t connected = connectedDeviceCount.load();
+    if (event.type == LINK_CONNECTED) {
+      deviceConnected = true;
+      telemetryEncoder.reset(); // New subscriber needs a keyframe
+      changePublisher.reset();  // and a full snapshot on the next tick
+      versionSendAt = millis() + VERSION_SEND_DELAY_MS;
+      LOGI("BLE", "Client %u connected (total: %u)", event.connHandle, connected);
       
-      // Call the NimBLE function to read RSSI
-      int8_t rssi = 0;
-      if (ble_gap_conn_rssi(connHandle, &rssi) == 0) {
-        bleRSSI = rssi;
-        
-        // Initialize array with first reading
-        if (!rssiArrayInitialized) {
-          for (int i = 0; i < 5; i++) {
-            rssiReadings[i] = rssi;
-          }
-          rssiArrayInitialized = true;
-        }
-        
-        // Add new reading to sliding window
-        rssiReadings[rssiIndex] = rssi;
-        rssiIndex = (rssiIndex + 1) % 5;
-        
-        // Calculate smoothed average
-        int sum = 0;
-        for (int i = 0; i < 5; i++) {
-          sum += rssiReadings[i];
-        }
-        bleRSSIFiltered = sum / 5;
-        
+      // Continue advertising if we haven't reached max connections AND discovery mode is active
+      if (connected < CONFIG_BT_NIMBLE_MAX_CONNECTIONS && discoveryModeActive) {
+        NimBLEDevice::startAdvertising();
+        LOGI("BLE", "Continuing advertising for additional connections... (%u/%d connected)",
+             connected, CONFIG_BT_NIMBLE_MAX_CONNECTIONS);
+      } else if (connected >= CONFIG_BT_NIMBLE_MAX_CONNECTIONS) {
+        LOGI("BLE", "Maximum connections reached (%u/%d)", connected, CONFIG_BT_NIMBLE_MAX_CONNECTIONS);
       } else {
-        bleRSSI = -50; // Fallback if RSSI read fails
-        bleRSSIFiltered = -50;
+        LOGI("BLE", "Discovery mode not active, stopping advertising for new connections");
       }
-      
-      #ifdef DEBUG_BLE_DATA
-      static unsigned long lastRSSIDebug = 0;
-      if (millis() - lastRSSIDebug > 10000) { // Debug every 10 seconds
-        Serial.printf("[BLE] %d devices connected, RSSI: %d dBm (filtered: %d dBm)\n", connIds.size(), bleRSSI, bleRSSIFiltered);
-        // Show RSSI for all connected devices
-        for (uint16_t connId : connIds) {
-          int8_t deviceRSSI = 0;
-          if (ble_gap_conn_rssi(connId, &deviceRSSI) == 0) {
-            Serial.printf("  Device %d: %d dBm\n", connId, deviceRSSI);
-          }
-        }
-        lastRSSIDebug = millis();
-      }
-      #endif
     } else {
-      bleRSSI = 0; // No valid connection IDs
-      bleRSSIFiltered = 0;
+      if (connected == 0) {
+        deviceConnected = false;
+        bleRSSIFiltered = 0; // Reset RSSI when all devices disconnected
+      }
+      advertisingRestartAt = millis() + ADVERTISING_RESTART_DELAY_MS;
+      LOGI("BLE", "Client %u disconnected (remaining: %u/%d)",
+           event.connHandle, connected, CONFIG_BT_NIMBLE_MAX_CONNECTIONS);
     }
-  } else {
-    bleRSSI = 0; // No connection
-    bleRSSIFiltered = 0;
   }
-  
+
+  // Send firmware version once the new client has set up its subscriptions
+  if (versionSendAt && (long)(millis() - versionSendAt) >= 0) {
+    versionSendAt = 0;
+    DynamicJsonDocument doc(128);
+    doc["type"] = "firmware_version";
+    doc["version"] = FIRMWARE_VERSION;
+    String versionData;
+    serializeJson(doc, versionData);
+    
+    if (safeBLESend(versionData, true)) {
+      LOGI("BLE", "Sent firmware version on connect: %s", FIRMWARE_VERSION);
+    } else {
+      LOGW("BLE", "Failed to send firmware version on connect");
+    }
+  }
+  
+  // Restart advertising after a disconnection if discovery mode is active
+  if (advertisingRestartAt && (long)(millis() - advertisingRestartAt) >= 0) {
+    advertisingRestartAt = 0;
+    if (!NimBLEDevice::getAdvertising()->isAdvertising() && discoveryModeActive &&
+        connectedDeviceCount.load() < CONFIG_BT_NIMBLE_MAX_CONNECTIONS) {
+      NimBLEDevice::startAdvertising();
+      LOGI("BLE", "Restarting advertising after disconnection (discovery mode active)...");
+    } else if (!discoveryModeActive) {
+      LOGI("BLE", "Discovery mode not active, not restarting advertising");
+    }
+  }
+
+  BleCommand command;
+  while (commandQueue.pop(command)) {
+    commandCallbacks.execute(std::string(command.text, command.length));
+  }
+  
+  // Commands are no longer run as they are written, so a full queue can
+  // lose one: tell the client, which cannot tell otherwise, so it can resend
+  static uint32_t droppedReported = 0;
+  uint32_t dropped = commandQueue.dropped() + commandsTooLong.load();
+  if (dropped != droppedReported && connectedDeviceCount.load() == 0) {
+    droppedReported = dropped;   // Nobody left to resend them
+  } else if (dropped != droppedReported) {
+    DynamicJsonDocument response(128);
+    response["type"] = "error";
+    response["message"] = "Command dropped, send again";
+    response["dropped"] = dropped - droppedReported;
+    String responseStr;
+    serializeJson(response, responseStr);
+    safeBLESend(responseStr, true);
+    droppedReported = dropped;   // Once per drop, sent or not
+  }
+}
+
+// Apply a transmit power level to every connection handle
+void applyConnectionTxPower(uint8_t level) {
+  for (int type = ESP_BLE_PWR_TYPE_CONN_HDL0; type <= ESP_BLE_PWR_TYPE_CONN_HDL8; type++) {
+    NimBLEDevice::setPower((esp_power_level_t)(ESP_PWR_LVL_N12 + level), (esp_ble_power_type_t)type);
+  }
+}
+
+// Sample RSSI for every connection, filter it per connection and steer the
+// transmit power towards the weakest client
+void updateBLERSSI() {
+  static unsigned long lastRSSIUpdate = 0;
+  if (millis() - lastRSSIUpdate < RSSI_SAMPLE_MS) return;
   lastRSSIUpdate = millis();
+
+  int weakest = 0;
+  bool connected = false;
+  for (uint16_t handle : syncConnections()) {
+    BleConnection* conn = trackConnection(handle);
+    if (!conn) continue;
+    connected = true;
+
+    // A failed read keeps the previous estimate instead of inventing one
+    int8_t rssi = 0;
+    if (ble_gap_conn_rssi(handle, &rssi) == 0 && rssi < 0) {
+      conn->rssi = conn->rssiValid ? conn->rssi + RSSI_FILTER_ALPHA * (rssi - conn->rssi) : rssi;
+      conn->rssiValid = true;
+    } else {
+      conn->rssiFailures++;
+    }
+    if (conn->rssiValid) {
+      int filtered = (int)lroundf(conn->rssi);
+      if (weakest == 0 || filtered < weakest) weakest = filtered;
+    }
+  }
+  bleRSSIFiltered = weakest;
+
+  // Wait for a first reading before stepping down from the default level
+  if (txPowerControl.update(millis(), weakest, connected && weakest != 0)) {
+    applyConnectionTxPower(txPowerControl.level());
+    LOGI("BLE", "TX power %+d dBm (weakest client %d dBm)", txPowerControl.dbm(), weakest);
+  }
+
+  #if VEETR_LOG_LEVEL >= VEETR_LOG_VERBOSE
+  static unsigned long lastRSSIDebug = 0;
+  if (millis() - lastRSSIDebug > 10000) { // Debug every 10 seconds
+    for (const BleConnection &conn : bleConnections) {
+      if (conn.inUse) {
+        LOGV("BLE", "Connection %u: RSSI %.1f dBm (%lu failed reads)", conn.handle,
+             conn.rssiValid ? conn.rssi : 0.0f, (unsigned long)conn.rssiFailures);
+      }
+    }
+    lastRSSIDebug = millis();
+  }
+  #endif
 }
 
 // Discovery Mode Functions
@@ -779,8 +1758,8 @@ void handleDiscoveryButton() {
   // Check for state change
   if (reading != lastButtonState) {
     lastButtonDebounceTime = millis();
-    Serial.printf("[DISCOVERY] Button state changed: %s (raw value: %d)\n", 
-                  reading == LOW ? "PRESSED" : "RELEASED", reading);
+    LOGI("DISCOVERY", "Button state changed: %s (raw value: %d)",
+         reading == LOW ? "PRESSED" : "RELEASED", reading);
     lastButtonState = reading;  // Update immediately on state change
   }
   
@@ -788,14 +1767,14 @@ void handleDiscoveryButton() {
   if ((millis() - lastButtonDebounceTime) > debounceDelay) {
     if (reading == LOW && !buttonProcessed) {
       // Button is pressed and stable, and we haven't processed this press yet
-      Serial.println("[DISCOVERY] *** BUTTON PRESS DETECTED! ***");
+      LOGI("DISCOVERY", "*** BUTTON PRESS DETECTED! ***");
       buttonProcessed = true;  // Mark as processed
       
       if (!discoveryModeActive) {
-        Serial.println("[DISCOVERY] Starting discovery mode...");
+        LOGI("DISCOVERY", "Starting discovery mode...");
         startDiscoveryMode();
       } else {
-        Serial.println("[DISCOVERY] Stopping discovery mode...");
+        LOGI("DISCOVERY", "Stopping discovery mode...");
         stopDiscoveryMode();
       }
     } else if (reading == HIGH) {
@@ -806,38 +1785,38 @@ void handleDiscoveryButton() {
 }
 
 void startDiscoveryMode() {
-  Serial.println("[DISCOVERY] Starting discovery mode for 5 minutes...");
+  LOGI("DISCOVERY", "Starting discovery mode for 5 minutes...");
   discoveryModeActive = true;
   discoveryModeStartTime = millis();
   
   // Turn on discovery LED (solid, not blinking initially)
   digitalWrite(DISCOVERY_LED_PIN, HIGH);
-  Serial.printf("[DISCOVERY] LED pin %d set to HIGH\n", DISCOVERY_LED_PIN);
+  LOGI("DISCOVERY", "LED pin %d set to HIGH", DISCOVERY_LED_PIN);
   
   // Start BLE advertising if not already active
   if (!NimBLEDevice::getAdvertising()->isAdvertising()) {
     NimBLEDevice::startAdvertising();
-    Serial.println("[DISCOVERY] BLE advertising started");
+    LOGI("DISCOVERY", "BLE advertising started");
   } else {
-    Serial.println("[DISCOVERY] BLE advertising already active");
+    LOGI("DISCOVERY", "BLE advertising already active");
   }
 }
 
 void stopDiscoveryMode() {
-  Serial.println("[DISCOVERY] Stopping discovery mode");
+  LOGI("DISCOVERY", "Stopping discovery mode");
   discoveryModeActive = false;
   
   // Turn off discovery LED
   digitalWrite(DISCOVERY_LED_PIN, LOW);
-  Serial.printf("[DISCOVERY] LED pin %d set to LOW\n", DISCOVERY_LED_PIN);
+  LOGI("DISCOVERY", "LED pin %d set to LOW", DISCOVERY_LED_PIN);
   
   // Stop BLE advertising if no devices are connected
   if (pServer && pServer->getConnectedCount() == 0) {
     NimBLEDevice::getAdvertising()->stop();
-    Serial.println("[DISCOVERY] BLE advertising stopped (no connected devices)");
+    LOGI("DISCOVERY", "BLE advertising stopped (no connected devices)");
   } else {
-    Serial.printf("[DISCOVERY] BLE advertising continues (%d devices connected)\n", 
-                  pServer ? pServer->getConnectedCount() : 0);
+    LOGI("DISCOVERY", "BLE advertising continues (%d devices connected)",
+         pServer ? (int)pServer->getConnectedCount() : 0);
   }
 }
 
@@ -868,57 +1847,6 @@ void postTransmission() {
   digitalWrite(RS485_DE, LOW); 
 }
 
-// Data structure to hold sensor readings
-struct SensorData {
-  float speed;          // Vessel speed in knots
-  float windSpeed;      // Apparent wind speed in knots
-  int windAngle;        // Apparent wind angle in degrees (0-360)
-  float trueWindSpeed;  // True wind speed in knots
-  int trueWindAngle;    // True wind angle in degrees (0-360)
-  float tilt;           // Vessel heel/tilt angle in degrees
-  int HDM;              // Magnetic heading in degrees (0-359)
-  float accelX;         // Acceleration X-axis in m/s²
-  float accelY;         // Acceleration Y-axis in m/s²
-  float accelZ;         // Acceleration Z-axis in m/s²
-};
-
-// Function to calculate true wind angle from apparent wind angle
-void calculateTrueWind(float vesselSpeed, int apparentWindAngle, float apparentWindSpeed, 
-                       float &trueWindSpeed, int &trueWindAngle) {
-  
-  // Convert apparent wind angle to radians (0-360° input)
-  float appWindAngleRad = apparentWindAngle * PI / 180.0;
-  
-  // Convert apparent wind to velocity components (relative to vessel)
-  // Apparent wind angle is measured clockwise from bow (0°=ahead, 90°=starboard, 180°=behind, 270°=port)
-  float appWindX = apparentWindSpeed * sin(appWindAngleRad);  // Cross-track component (positive = starboard)
-  float appWindY = apparentWindSpeed * cos(appWindAngleRad);  // Along-track component (positive = ahead)
-  
-  // True wind components = apparent wind - vessel velocity
-  // Vessel is moving forward (positive Y direction)
-  float trueWindX = appWindX;  // Cross-track component unchanged
-  float trueWindY = appWindY - vesselSpeed;  // Subtract vessel forward speed
-  
-  // Calculate true wind speed
-  trueWindSpeed = sqrt(trueWindX * trueWindX + trueWindY * trueWindY);
-  
-  // Calculate true wind angle (relative to vessel bow, 0-360°)
-  float trueWindAngleRad = atan2(trueWindX, trueWindY);
-  trueWindAngle = round(trueWindAngleRad * 180.0 / PI);
-  
-  // Normalize angle to 0-359° range
-  if (trueWindAngle < 0) trueWindAngle += 360;
-  if (trueWindAngle >= 360) trueWindAngle -= 360;
-  
-  // Ensure we don't have negative wind speeds
-  if (trueWindSpeed < 0) {
-    trueWindSpeed = 0;
-  }
-}
-
-// Current sensor data
-SensorData currentData = {0};
-
 // GPS status
 bool gpsDataValid = false;
 
@@ -937,24 +1865,13 @@ void updateRefreshRate() {
 unsigned long nextUpdate = 0;
 
 // Regatta Functions (prototypes)
-float haversineDistance(double lat1, double lon1, double lat2, double lon2);
-float distanceToLine(double px, double py, double x1, double y1, double x2, double y2);
 void calculateRegattaData();
 
 // Function prototypes
-void readSensors();
+void updatePolarPerformance();
 String getSensorDataJson();
 void setupBLE();
-void updateBLEData();
-float filterGPSSpeed(float rawSpeed, int satellites, float hdop);
-
-// Wind Sensor Functions
-bool readWindSensor(float &windSpeed, int &windAngle);
-float regsToFloat(uint16_t lowReg, uint16_t highReg);
-
-// GPS Functions
-bool readGPS();
-bool isGPSDataValid();
+void updateBLEData(const String &jsonData);
 
 // Generate random BLE address to help bypass client cache
 void generateRandomBLEAddress() {
@@ -966,27 +1883,27 @@ void generateRandomBLEAddress() {
   // Ensure it's a valid random address (first two bits should be '11')
   randomAddr[5] |= 0xC0;
   
-  Serial.printf("[BLE] Generated random address: %02X:%02X:%02X:%02X:%02X:%02X\n",
-               randomAddr[5], randomAddr[4], randomAddr[3], 
-               randomAddr[2], randomAddr[1], randomAddr[0]);
+  LOGI("BLE", "Generated random address: %02X:%02X:%02X:%02X:%02X:%02X",
+       randomAddr[5], randomAddr[4], randomAddr[3],
+       randomAddr[2], randomAddr[1], randomAddr[0]);
 }
 
 // Reset BLE with new name and random address to bypass client cache
 void resetBLEForNewName(const String& newName) {
-  Serial.printf("[BLE] Preparing reset for device name: '%s'\n", newName.c_str());
+  LOGI("BLE", "Preparing reset for device name: '%s'", newName.c_str());
   
   // Generate new random address before restart to help bypass client cache
   generateRandomBLEAddress();
   
-  Serial.println("[BLE] ESP32 will restart with new name and random address");
+  LOGI("BLE", "ESP32 will restart with new name and random address");
 }
 
 // BLE Setup Function
 void setupBLE() {
   // Get device name from preferences
   String deviceName = preferences.getString("deviceName", "Veetr");
-  Serial.printf("[BLE] Initializing as '%s'\n", deviceName.c_str());
-  Serial.printf("[BLE] Max connections configured: %d\n", CONFIG_BT_NIMBLE_MAX_CONNECTIONS);
+  LOGI("BLE", "Initializing as '%s'", deviceName.c_str());
+  LOGI("BLE", "Max connections configured: %d", CONFIG_BT_NIMBLE_MAX_CONNECTIONS);
   
   // Initialize NimBLE with device name
   NimBLEDevice::init(deviceName.c_str());
@@ -994,40 +1911,46 @@ void setupBLE() {
   // Use random address type to help bypass client cache on name changes
   NimBLEDevice::setOwnAddrType(BLE_OWN_ADDR_RANDOM);
   
-  // Set TX power for good range
-  NimBLEDevice::setPower(ESP_PWR_LVL_P3); // +3dBm
+  // Start at +3dBm; updateBLERSSI() adjusts connections to the weakest client
+  NimBLEDevice::setPower(ESP_PWR_LVL_P3);
+  txPowerControl = TxPowerControl();
+  
+  // Allow clients to negotiate large packets for bulk log transfer
+  NimBLEDevice::setMTU(BLE_ATT_MTU_MAX);
   
   // Setup the BLE server
   setupBLEServer();
   
-  Serial.printf("BLE Server started as '%s'\n", deviceName.c_str());
+  LOGI("BLE", "Server started as '%s'", deviceName.c_str());
 }
 
 // BLE Restart Function (for device name changes)
 void restartBLE() {
   // Get device name from preferences
   String deviceName = preferences.getString("deviceName", "Veetr");
-  Serial.printf("[BLE Restart] Using device name from preferences: '%s'\n", deviceName.c_str());
+  LOGI("BLE Restart", "Using device name from preferences: '%s'", deviceName.c_str());
   
   // Ensure BLE is completely deinitialized first (only when restarting)
-  Serial.println("[BLE Restart] Deinitializing existing BLE stack...");
+  LOGI("BLE Restart", "Deinitializing existing BLE stack...");
   NimBLEDevice::deinit(true); // true = clear all bonding info
   delay(100); // Give time for cleanup
   
   // Initialize NimBLE with new device name
-  Serial.printf("[BLE Restart] Initializing NimBLE with name: '%s'\n", deviceName.c_str());
-  Serial.printf("[BLE Restart] Max connections configured: %d\n", CONFIG_BT_NIMBLE_MAX_CONNECTIONS);
+  LOGI("BLE Restart", "Initializing NimBLE with name: '%s'", deviceName.c_str());
+  LOGI("BLE Restart", "Max connections configured: %d", CONFIG_BT_NIMBLE_MAX_CONNECTIONS);
   
   NimBLEDevice::init(deviceName.c_str());
   
-  // Set TX power for balance between range and power consumption
-  NimBLEDevice::setPower(ESP_PWR_LVL_P3); // +3dBm for better range
+  // Start at +3dBm; updateBLERSSI() adjusts connections to the weakest client
+  NimBLEDevice::setPower(ESP_PWR_LVL_P3);
+  txPowerControl = TxPowerControl();
+  NimBLEDevice::setMTU(BLE_ATT_MTU_MAX);
   
   // Setup the BLE server
   setupBLEServer();
   
-  Serial.printf("NimBLE Server restarted as '%s', waiting for client connections...\n", deviceName.c_str());
-  Serial.printf("Multiple connections supported (max %d)\n", CONFIG_BT_NIMBLE_MAX_CONNECTIONS);
+  LOGI("BLE Restart", "NimBLE Server restarted as '%s', waiting for client connections...", deviceName.c_str());
+  LOGI("BLE Restart", "Multiple connections supported (max %d)", CONFIG_BT_NIMBLE_MAX_CONNECTIONS);
 }
 
 // BLE Server Setup Function (without device initialization)
@@ -1049,11 +1972,42 @@ void setupBLEServer() {
                       COMMAND_UUID,
                       NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::WRITE_NR
                     );
-  pCommandCharacteristic->setCallbacks(new CommandCallbacks());
+  pCommandCharacteristic->setCallbacks(&commandCallbacks);
+
+  // Delta-encoded binary telemetry (see TelemetryCodec.h)
+  pTelemetryCharacteristic = pService->createCharacteristic(
+                      TELEMETRY_UUID,
+                      NIMBLE_PROPERTY::NOTIFY
+                    );
+
+  // Binary chart history, one tier per TREND_READ (see TrendHistory.h)
+  pTrendCharacteristic = pService->createCharacteristic(
+                      TREND_UUID,
+                      NIMBLE_PROPERTY::NOTIFY
+                    );
+
+  // Binary bulk transfer of the session log (see LOG_READ)
+  pLogTransferCharacteristic = pService->createCharacteristic(
+                      LOG_TRANSFER_UUID,
+                      NIMBLE_PROPERTY::NOTIFY
+                    );
 
   // Start the service
   pService->start();
 
+  // NMEA 0183 sentences on a Nordic UART Service, for chart plotter apps.
+  // Output only: writes to RX are accepted and ignored
+  NimBLEService *pNmeaService = pServer->createService(NMEA_UART_SERVICE_UUID);
+  pNmeaTxCharacteristic = pNmeaService->createCharacteristic(
+                      NMEA_UART_TX_UUID,
+                      NIMBLE_PROPERTY::NOTIFY
+                    );
+  pNmeaService->createCharacteristic(
+                      NMEA_UART_RX_UUID,
+                      NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::WRITE_NR
+                    );
+  pNmeaService->start();
+
   // Configure advertising for multiple connections
   NimBLEAdvertising *pAdvertising = NimBLEDevice::getAdvertising();
   pAdvertising->addServiceUUID(SERVICE_UUID);
@@ -1066,204 +2020,1129 @@ void setupBLEServer() {
   String deviceName = preferences.getString("deviceName", "Veetr");
   pAdvertising->setName(deviceName.c_str());
   
-  Serial.printf("[BLE] BLE server configured for up to %d connections\n", CONFIG_BT_NIMBLE_MAX_CONNECTIONS);
-  Serial.println("[BLE] Advertising configured - press discovery button to enable connections");
+  LOGI("BLE", "Server configured for up to %d connections", CONFIG_BT_NIMBLE_MAX_CONNECTIONS);
+  LOGI("BLE", "Advertising configured - press discovery button to enable connections");
 }
 
-// Update BLE with current sensor data
-void updateBLEData() {
+// Update BLE with current sensor data (the JSON snapshot built for this tick)
+void updateBLEData(const String &jsonData) {
   if (deviceConnected && pSensorDataCharacteristic) {
-    String jsonData = getSensorDataJson();
-    
     // Check if JSON is valid and not too large for BLE
-    const int MAX_BLE_PACKET_SIZE = 300; // Increased for marine standard JSON
+    const int MAX_BLE_PACKET_SIZE = 512; // Marine standard JSON plus seq/t, polar targets and start line, the attribute limit
     
     if (jsonData.length() > MAX_BLE_PACKET_SIZE) {
-      Serial.printf("[BLE] ERROR: JSON too large (%d bytes, max %d)\n", jsonData.length(), MAX_BLE_PACKET_SIZE);
+      LOGE("BLE", "JSON too large (%d bytes, max %d)", jsonData.length(), MAX_BLE_PACKET_SIZE);
       return; // Don't send invalid data
     }
     
     // Validate JSON format
     if (!jsonData.startsWith("{") || !jsonData.endsWith("}")) {
-      Serial.println("[BLE] ERROR: Invalid JSON format");
+      LOGE("BLE", "Invalid JSON format");
       return;
     }
     
-    #ifdef DEBUG_BLE_DATA
-    Serial.printf("[BLE] %lu: Sending %d bytes to %d devices: %s\n", 
-                  millis(), jsonData.length(), connectedDeviceCount, jsonData.c_str());
-    #endif
+    LOGV("BLE", "%lu: Sending %d bytes to %d devices: %s",
+         millis(), jsonData.length(), connectedDeviceCount.load(), jsonData.c_str());
     
     // Send to all connected devices
     // Double-check connection state before sending
     if (pServer->getConnectedCount() > 0) {
-      if (safeBLESend(jsonData, false)) {
-        #ifdef DEBUG_BLE_DATA
-        Serial.printf("[BLE] Successfully sent %d bytes to %d devices\n", 
-                      jsonData.length(), connectedDeviceCount);
-        #endif
-      } else {
-        Serial.println("[BLE] Failed to send sensor data");
+      PROFILE_SCOPE(PROF_BLE_NOTIFY);
+      if (!safeBLESend(jsonData, false)) {
+        LOGW("BLE", "Failed to send sensor data");
       }
     } else {
-      Serial.println("[BLE] No connected devices found, skipping transmission");
+      LOGD("BLE", "No connected devices found, skipping transmission");
+    }
+    
+    // Binary stream for clients that subscribed to it
+    if (pTelemetryCharacteristic && pTelemetryCharacteristic->getSubscribedCount() > 0) {
+      uint8_t encoded[TF_MAX_FRAME_SIZE];
+      size_t length;
+      {
+        PROFILE_SCOPE(PROF_SERIALIZE);
+        length = telemetryEncoder.encode(latestFrame, encoded);
+      }
+      PROFILE_SCOPE(PROF_BLE_NOTIFY);
+      pTelemetryCharacteristic->setValue(encoded, length);
+      pTelemetryCharacteristic->notify();
     }
   }
 }
 
-void setup() {
-  // Initialize serial communication first
-  Serial.begin(115200);
-  delay(1000); // Give serial time to initialize
-  Serial.println("\n=== Veetr Starting ===");
-  Serial.printf("[Boot] Firmware Version: %s\n", FIRMWARE_VERSION);
+// Convert the GPS date and time to UTC seconds since 1970 (0 if not available)
+uint32_t gpsEpochSeconds() {
+  const NmeaFix &fix = gps.fix();
+  if (!fix.has(NMEA_DATE | NMEA_TIME) || fix.year < 2020) {
+    return 0;
+  }
+  
+  // Days from civil date (proleptic Gregorian calendar)
+  int y = fix.year;
+  unsigned m = fix.month;
+  unsigned d = fix.day;
+  y -= m <= 2;
+  int era = y / 400;
+  unsigned yoe = (unsigned)(y - era * 400);
+  unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  uint32_t days = (uint32_t)(era * 146097 + (int)doe - 719468);
+  
+  return days * 86400UL + fix.hour * 3600UL + fix.minute * 60UL + fix.second;
+}
+
+// Append the current sensor snapshot to the session log
+void logSessionRecord() {
+  static unsigned long lastFlush = 0;
+  PROFILE_SCOPE(PROF_LOG);
   
-  // Debug OTA partition information
-  const esp_partition_t* configured = esp_ota_get_boot_partition();
-  const esp_partition_t* running = esp_ota_get_running_partition();
-  Serial.printf("[Boot] Running partition: %s (address: 0x%x)\n", running->label, running->address);
-  Serial.printf("[Boot] Configured boot partition: %s (address: 0x%x)\n", configured->label, configured->address);
-  if (configured != running) {
-    Serial.println("[Boot] WARNING: Configured partition differs from running partition!");
-  }
+  if (!sessionLog.isReady()) return;
   
-  // Initialize Preferences for persistent storage
-  preferences.begin("settings", false);
-  heelAngleDelta = preferences.getFloat("delta", 0.0f);
-  compassOffsetDelta = preferences.getFloat("compassOffset", 0.0f);
-  deadWindAngle = preferences.getInt("deadWindAngle", 40);
-  refreshRateSeconds = preferences.getFloat("refreshRate", 1.0f);
-  String deviceName = preferences.getString("deviceName", "Veetr");
-  Serial.print("[Boot] Loaded level calibration offset from NVS: ");
-  Serial.println(heelAngleDelta);
-  Serial.print("[Boot] Loaded compass calibration offset from NVS: ");
-  Serial.println(compassOffsetDelta);
-  Serial.print("[Boot] Loaded deadWindAngle from NVS: ");
-  Serial.println(deadWindAngle);
-  Serial.print("[Boot] Loaded refreshRate from NVS: ");
-  Serial.println(refreshRateSeconds);
-  Serial.print("[Boot] Loaded deviceName from NVS: ");
-  Serial.println(deviceName);
+  uint32_t utc = gpsEpochSeconds();
+  if (utc == 0) return; // Records are indexed by time, wait for GPS time
   
-  // Update refresh rate from loaded value
-  updateRefreshRate();
-  Serial.printf("[Boot] Refresh rate set to %d ms (%.1f seconds)\n", refreshRate, refreshRateSeconds);
+  LogRecord record = {};
+  record.utc = utc;
+  const NmeaFix &fix = gps.fix();
+  record.ms = fix.centisecond * 10;
   
-  // Initialize I2C for BNO080 with detection
-  Wire.begin(BNO080_SDA, BNO080_SCL);
-  Wire.setTimeout(100); // Set I2C timeout to 100ms to prevent long blocking
+  if (fix.has(NMEA_POSITION)) {
+    record.flags |= LOG_HAS_FIX;
+    record.lat = fix.position.lat;
+    record.lon = fix.position.lon;
+    record.sog = (uint16_t)lround((isnan(currentData.speed) ? 0.0f : currentData.speed) * 100.0f);
+    record.cog = fix.has(NMEA_COURSE) ? fix.course : 0;
+  }
+  if (!isnan(currentData.windSpeed) && currentData.windAngle >= 0 && currentData.windAngle <= 359) {
+    record.flags |= LOG_HAS_WIND;
+    record.aws = (uint16_t)lround(currentData.windSpeed * 100.0f);
+    record.awa = (uint16_t)(currentData.windAngle * 100);
+  }
+  if (!isnan(currentData.trueWindSpeed) && !isnan(currentData.trueWindAngle)) {
+    record.flags |= LOG_HAS_TRUE;
+    record.tws = (uint16_t)lround(currentData.trueWindSpeed * 100.0f);
+    record.twa = (uint16_t)(lround(currentData.trueWindAngle * 100.0f) % 36000);
+  }
+  if (imuAvailable && !isnan(currentData.tilt)) {
+    record.flags |= LOG_HAS_HEEL;
+    record.heel = (int16_t)lround(currentData.tilt * 100.0f);
+  }
+  if (imuAvailable && currentData.HDM >= 0 && currentData.HDM <= 359) {
+    record.flags |= LOG_HAS_HDM;
+    record.hdm = (uint16_t)(currentData.HDM * 100);
+  }
   
-  Serial.print("Testing BNO080 connection... ");
-  Serial.printf("I2C SDA=%d, SCL=%d\n", BNO080_SDA, BNO080_SCL);
+  sessionLog.append(record);
   
-  // Test I2C bus first
-  Wire.beginTransmission(0x4A); // BNO080 default I2C address
-  uint8_t i2cError = Wire.endTransmission();
-  Serial.printf("I2C scan result: %d (0=success, 2=NACK, 4=other error)\n", i2cError);
+  // Persist the partially filled block so a power loss costs at most a minute
+  if (millis() - lastFlush > SESSION_LOG_FLUSH_MS) {
+    sessionLog.flush();
+    lastFlush = millis();
+  }
+}
+
+// Report the stored log range to BLE clients
+void sendLogInfo() {
+  DynamicJsonDocument response(256);
+  response["type"] = "log_info";
+  response["ready"] = sessionLog.isReady();
+  response["firstSeq"] = sessionLog.firstSeq();
+  response["endSeq"] = sessionLog.endSeq();
+  response["firstUtc"] = sessionLog.firstUtc();
+  response["lastUtc"] = sessionLog.lastUtc();
+  response["blockSize"] = LOG_BLOCK_SIZE;
+  response["recordSize"] = sizeof(LogRecord);
+  String responseStr;
+  serializeJson(response, responseStr);
+  safeBLESend(responseStr, true);
+}
+
+// Polar state; every polar command answers with this, plus "error" when it failed
+void sendPolarInfo(const char* error) {
+  DynamicJsonDocument response(256);
+  response["type"] = "polar";
+  response["loaded"] = polarTable.isLoaded();
+  if (polarTable.isLoaded()) {
+    response["tws"] = polarTable.twsCount();
+    response["twa"] = polarTable.twaCount();
+    response["maxTws"] = polarTable.maxTws();
+  }
+  if (polarUpload.active) {
+    response["received"] = polarUpload.received;
+    response["size"] = polarUpload.size;
+  }
+  if (error) {
+    response["error"] = error;
+    LOGW("Polar", "%s", error);
+  }
+  String responseStr;
+  serializeJson(response, responseStr);
+  safeBLESend(responseStr, true);
+}
+
+// Check the uploaded blob and make it the active polar, persisted in NVS
+void finishPolarUpload() {
+  if (!polarUpload.active) {
+    sendPolarInfo("Polar upload not active");
+    return;
+  }
+  polarUpload.active = false;
+  if (polarUpload.received != polarUpload.size) {
+    sendPolarInfo("Polar upload incomplete");
+    return;
+  }
+  if (polarCrc32(polarUpload.data, polarUpload.size) != polarUpload.crc) {
+    sendPolarInfo("Polar CRC mismatch");
+    return;
+  }
+  if (!polarTable.load(polarUpload.data, polarUpload.size)) {
+    sendPolarInfo("Polar table invalid");
+    return;
+  }
+  if (preferences.putBytes("polar", polarUpload.data, polarUpload.size) != polarUpload.size) {
+    sendPolarInfo("Polar loaded but not saved");
+    return;
+  }
+  LOGI("Polar", "Polar loaded and saved: %u TWS x %u TWA, up to %.1f kn",
+       polarTable.twsCount(), polarTable.twaCount(), polarTable.maxTws());
+  sendPolarInfo();
+}
+
+// Smallest negotiated MTU among connected clients (notifies must fit all subscribers)
+uint16_t minPeerMTU() {
+  uint16_t mtu = BLE_ATT_MTU_MAX;
+  if (pServer) {
+    for (uint16_t connId : pServer->getPeerDevices()) {
+      uint16_t peerMTU = pServer->getPeerMTU(connId);
+      if (peerMTU > 0 && peerMTU < mtu) mtu = peerMTU;
+    }
+  }
+  return mtu;
+}
+
+// Slot for a connection handle, claiming a free one for a new connection
+BleConnection* trackConnection(uint16_t handle) {
+  BleConnection* freeSlot = nullptr;
+  for (BleConnection &conn : bleConnections) {
+    if (conn.inUse && conn.handle == handle) return &conn;
+    if (!conn.inUse && !freeSlot) freeSlot = &conn;
+  }
+  if (freeSlot) {
+    *freeSlot = {};
+    freeSlot->inUse = true;
+    freeSlot->handle = handle;
+    freeSlot->connectedAt = millis();
+  }
+  return freeSlot;
+}
+
+// Connected handles, with slots of closed connections released
+std::vector<uint16_t> syncConnections() {
+  std::vector<uint16_t> peers;
+  if (pServer) peers = pServer->getPeerDevices();
+  for (BleConnection &conn : bleConnections) {
+    if (conn.inUse && std::find(peers.begin(), peers.end(), conn.handle) == peers.end()) {
+      conn.inUse = false;
+    }
+  }
+  return peers;
+}
+
+// Ask each central for parameters matching its use: short intervals while a
+// bulk transfer runs, long intervals with slave latency for periodic telemetry.
+// A request is only repeated when the profile or the refresh rate changes, so
+// a central that rejects it is not asked again every pass.
+void updateConnectionParams() {
+  if (!pServer || millis() - lastConnParamsCheck < CONN_PARAMS_CHECK_MS) return;
+  lastConnParamsCheck = millis();
+
+  std::vector<uint16_t> peers = syncConnections();
+  bool bulk = bleOTAActive || logTransfer.active || profileTraceActive || historyTransfer.active ||
+              trendTransfer.active;
+  ConnProfile profile = bulk ? CONN_PROFILE_BULK : CONN_PROFILE_DASHBOARD;
+  for (uint16_t handle : peers) {
+    BleConnection* conn = trackConnection(handle);
+    if (!conn) continue;
+
+    ble_gap_conn_desc desc;
+    if (ble_gap_conn_find(handle, &desc) == 0 &&
+        (desc.conn_itvl != conn->interval || desc.conn_latency != conn->latency ||
+         desc.supervision_timeout != conn->timeout)) {
+      conn->interval = desc.conn_itvl;
+      conn->latency = desc.conn_latency;
+      conn->timeout = desc.supervision_timeout;
+      LOGI("BLE", "Connection %u: interval %.2f ms, latency %u, timeout %u ms", handle,
+           conn->interval * CONN_INTERVAL_UNIT_US / 1000.0f, conn->latency, conn->timeout * CONN_TIMEOUT_UNIT_MS);
+    }
+
+    if (profile != CONN_PROFILE_BULK && millis() - conn->connectedAt < CONN_PARAMS_SETTLE_MS) continue;
+    if (conn->requested == profile && (profile == CONN_PROFILE_BULK || conn->requestedRefresh == refreshRate)) continue;
+
+    ConnParams params = connParamsFor(profile, refreshRate);
+    pServer->updateConnParams(handle, params.minInterval, params.maxInterval, params.latency, params.timeout);
+    conn->requested = profile;
+    conn->requestedRefresh = refreshRate;
+    LOGD("BLE", "Connection %u: requested %s parameters (%u-%u units, latency %u, timeout %u)", handle,
+         connProfileName(profile), params.minInterval, params.maxInterval, params.latency, params.timeout);
+  }
+}
+
+// Parameters in effect for every connection
+void sendConnectionInfo() {
+  DynamicJsonDocument response(1024);
+  response["type"] = "connections";
+  JsonArray list = response.createNestedArray("connections");
+  if (pServer) {
+    for (uint16_t handle : pServer->getPeerDevices()) {
+      ble_gap_conn_desc desc;
+      if (ble_gap_conn_find(handle, &desc) != 0) continue;
+      JsonObject entry = list.createNestedObject();
+      entry["handle"] = handle;
+      entry["interval"] = desc.conn_itvl * CONN_INTERVAL_UNIT_US / 1000.0f;
+      entry["latency"] = desc.conn_latency;
+      entry["timeout"] = desc.supervision_timeout * CONN_TIMEOUT_UNIT_MS;
+      entry["mtu"] = pServer->getPeerMTU(handle);
+      const char* profile = connProfileName(CONN_PROFILE_NONE);
+      for (const BleConnection &conn : bleConnections) {
+        if (!conn.inUse || conn.handle != handle) continue;
+        profile = connProfileName(conn.requested);
+        if (conn.rssiValid) entry["rssi"] = (int)lroundf(conn.rssi);
+      }
+      entry["profile"] = profile;
+    }
+  }
+  response["txPower"] = txPowerControl.dbm();
+  String responseStr;
+  serializeJson(response, responseStr);
+  safeBLESend(responseStr, true);
+}
+
+void startLogTransfer(uint32_t startSeq, uint32_t endSeq, uint16_t window) {
+  logTransfer.active = startSeq < endSeq;
+  logTransfer.nextSeq = startSeq;
+  logTransfer.endSeq = endSeq;
+  logTransfer.ackedSeq = startSeq;
+  logTransfer.window = max((uint16_t)1, window);
+  logTransfer.blockOffset = 0;
+  logTransfer.blockLength = 0;
+  
+  LOGI("LOG", "Transfer of blocks %u-%u requested (window %u, MTU %u)",
+       startSeq, endSeq, logTransfer.window, minPeerMTU());
+  
+  DynamicJsonDocument response(192);
+  response["type"] = "log_read";
+  response["start"] = startSeq;
+  response["end"] = endSeq;
+  response["mtu"] = minPeerMTU();
+  String responseStr;
+  serializeJson(response, responseStr);
+  safeBLESend(responseStr, true);
+}
+
+void stopLogTransfer(const char* reason) {
+  if (!logTransfer.active) return;
+  logTransfer.active = false;
+  
+  DynamicJsonDocument response(128);
+  response["type"] = "log_done";
+  response["reason"] = reason;
+  response["next"] = logTransfer.nextSeq;
+  String responseStr;
+  serializeJson(response, responseStr);
+  safeBLESend(responseStr, true);
+}
+
+// Stream pending log blocks, a few packets per loop() pass
+// Packet: [seq u32][offset u16][block length u16][block bytes...]
+void updateLogTransfer() {
+  if (!logTransfer.active) return;
   
-  if (imu.begin()) {
-    Serial.println("BNO080 begin() successful, configuring sensor...");
+  if (!pServer || pServer->getConnectedCount() == 0 || !pLogTransferCharacteristic) {
+    logTransfer.active = false;
+    return;
+  }
+  
+  uint16_t payloadSize = minPeerMTU() - 3 - LOG_PACKET_HEADER_SIZE;
+  uint8_t packet[BLE_ATT_MTU_MAX];
+  
+  for (int sent = 0; sent < LOG_PACKETS_PER_LOOP; sent++) {
+    if (logTransfer.nextSeq >= logTransfer.endSeq) {
+      stopLogTransfer("complete");
+      return;
+    }
     
-    // Enable rotation vector for tilt/heel angle calculation
-    imu.enableRotationVector(50); // 50ms = 20Hz update rate
-    Serial.println("Rotation vector configuration sent");
+    // Wait for the client to acknowledge before running past the window
+    if (logTransfer.nextSeq >= logTransfer.ackedSeq + logTransfer.window) return;
     
-    // Enable magnetometer for compass heading with responsive update rate
-    imu.enableMagnetometer(50); // 50ms = 20Hz update rate (responsive but stable)
-    Serial.println("Magnetometer configuration sent (20Hz)");
+    if (logTransfer.blockLength == 0) {
+      if (!sessionLog.readBlock(logTransfer.nextSeq, logTransfer.block)) {
+        // Block was overwritten by the ring or is unreadable - skip it
+        LOGI("LOG", "Block %u unavailable, skipping", logTransfer.nextSeq);
+        logTransfer.nextSeq++;
+        continue;
+      }
+      const LogBlockHeader* header = (const LogBlockHeader*)logTransfer.block;
+      logTransfer.blockLength = sizeof(LogBlockHeader) + header->length;
+      logTransfer.blockOffset = 0;
+    }
     
-    // Enable accelerometer for acceleration data
-    imu.enableAccelerometer(50); // 50ms = 20Hz update rate
-    Serial.println("Accelerometer configuration sent");
+    uint16_t length = min((uint16_t)(logTransfer.blockLength - logTransfer.blockOffset), payloadSize);
+    memcpy(packet, &logTransfer.nextSeq, 4);
+    memcpy(packet + 4, &logTransfer.blockOffset, 2);
+    memcpy(packet + 6, &logTransfer.blockLength, 2);
+    memcpy(packet + LOG_PACKET_HEADER_SIZE, logTransfer.block + logTransfer.blockOffset, length);
     
-    // Give sensor more time to initialize and start providing data
-    Serial.println("Waiting for sensor data...");
-    delay(500); // Longer delay for BNO080 to stabilize
+    pLogTransferCharacteristic->setValue(packet, LOG_PACKET_HEADER_SIZE + length);
+    pLogTransferCharacteristic->notify();
     
-    // Try multiple times to get data
-    bool dataFound = false;
-    for (int attempt = 0; attempt < 10; attempt++) {
-      if (imu.dataAvailable()) {
-        dataFound = true;
-        Serial.printf("Data available after %d attempts!\n", attempt + 1);
-        break;
+    logTransfer.blockOffset += length;
+    if (logTransfer.blockOffset >= logTransfer.blockLength) {
+      logTransfer.nextSeq++;
+      logTransfer.blockLength = 0;
+    }
+  }
+}
+
+// Report per-section timings, one message per section
+void sendProfileReport() {
+  for (int section = 0; section < PROF_SECTION_COUNT; section++) {
+    ProfileSummary summary;
+    profiler.summary(section, summary);
+    
+    DynamicJsonDocument response(256);
+    response["type"] = "profile";
+    response["section"] = profileSectionName(section);
+    response["index"] = section;
+    response["total"] = PROF_SECTION_COUNT;
+    response["n"] = summary.count;
+    response["min"] = round(summary.minUs * 10) / 10.0;
+    response["avg"] = round(summary.avgUs * 10) / 10.0;
+    response["max"] = round(summary.maxUs * 10) / 10.0;
+    response["p99"] = round(summary.p99Us * 10) / 10.0;
+    String responseStr;
+    serializeJson(response, responseStr);
+    safeBLESend(responseStr, true);
+  }
+  
+  // Heap after the static buffers (trend history, telemetry history, queues),
+  // with whatever BLE and the access point hold at the moment
+  DynamicJsonDocument response(192);
+  response["type"] = "memory";
+  response["heap"] = ESP.getFreeHeap();
+  response["minHeap"] = ESP.getMinFreeHeap();
+  response["largest"] = ESP.getMaxAllocHeap();
+  response["wifi"] = wifiRunning.load();
+  response["clients"] = connectedDeviceCount.load();
+  String responseStr;
+  serializeJson(response, responseStr);
+  safeBLESend(responseStr, true);
+}
+
+// Stream the trace ring as Chrome trace events; the client joins the
+// "events" arrays into {"traceEvents": [...]}
+void updateProfileTrace() {
+  if (!profileTraceActive) return;
+  
+  if (!pServer || pServer->getConnectedCount() == 0) {
+    profileTraceActive = false;
+    profiler.setTraceEnabled(true);
+    return;
+  }
+  
+  size_t total = profiler.traceCount();
+  for (int sent = 0; sent < PROFILE_TRACE_MESSAGES_PER_LOOP; sent++) {
+    DynamicJsonDocument response(512);
+    response["type"] = "profile_trace";
+    response["index"] = profileTraceNext;
+    response["total"] = total;
+    JsonArray events = response.createNestedArray("events");
+    
+    char buffer[128];
+    for (int i = 0; i < PROFILE_TRACE_EVENTS_PER_MESSAGE && profileTraceNext < total; i++) {
+      ProfileEvent event;
+      if (profiler.traceEvent(profileTraceNext++, event) &&
+          profiler.formatTraceEvent(event, buffer, sizeof(buffer)) > 0) {
+        events.add(serialized(String(buffer)));
       }
-      delay(100); // Wait 100ms between attempts
-      Serial.print(".");
     }
-    Serial.println();
     
-    if (dataFound) {
-      imuAvailable = true;
-      Serial.println("BNO080 connected and working!");
-      
-      // Test reading actual data
-      float testI = imu.getQuatI();
-      float testReal = imu.getQuatReal();
-      Serial.printf("Test quaternion read: i=%.3f, real=%.3f\n", testI, testReal);
-    } else {
-      imuAvailable = false;
-      Serial.println("BNO080 detected but no data available after 10 attempts");
-      Serial.println("Check power supply (3.3V) and wiring connections");
+    bool done = profileTraceNext >= total;
+    response["done"] = done;
+    String responseStr;
+    serializeJson(response, responseStr);
+    safeBLESend(responseStr, true);
+    
+    if (done) {
+      profileTraceActive = false;
+      profiler.setTraceEnabled(true);
+      return;
     }
+  }
+}
+
+// Snapshot the current data; when it is published, number it and keep it for
+// back-fill. Only refresh ticks are charted; between them (`refresh` false)
+// the snapshot goes out only if a channel crossed its deadband.
+bool publishTelemetryFrame(bool refresh) {
+  PROFILE_SCOPE(PROF_SERIALIZE);
+  TelemetryFrame frame;
+  buildTelemetryFrame(currentData, gps.fix(), imuAvailable, bleRSSIFiltered, currentData.sampleTime, frame);
+  if (refresh) trendHistory.add(currentData.sampleTime, frame);
+  
+  // Distance to the start line is not a frame channel: publish every tick while it counts down
+  PublishReason reason = changePublisher.update(currentData.sampleTime, frame, refresh && startLine.isSet());
+  if (reason == PUBLISH_NONE) return false;
+  
+  latestFrame = frame;
+  telemetryHistory.push(latestFrame);
+  return true;
+}
+
+// Send the published snapshot to the BLE and Wi-Fi clients
+void notifySnapshot() {
+  String jsonData;
+  if ((deviceConnected && pSensorDataCharacteristic) || wifiJsonClients > 0) {
+    PROFILE_SCOPE(PROF_SERIALIZE);
+    jsonData = getSensorDataJson();
+  }
+  updateBLEData(jsonData);
+  publishWifiSnapshot(jsonData);
+}
+
+// Console UART as an NMEA 0183 talker at `baud`, or back to logging
+void setNmeaSerialOutput(bool enable, uint32_t baud) {
+  nmeaSerialBaud = baud;
+  if (enable == nmeaSerialOutput) {
+    if (enable) Serial.updateBaudRate(baud);
+    return;
+  }
+  if (enable) {
+    LOGI("NMEA", "NMEA 0183 on the console UART at %lu baud, logging muted", (unsigned long)baud);
+    nmeaSerialOutput = true;
+    Serial.flush();
+    Serial.updateBaudRate(baud);
   } else {
-    imuAvailable = false;
-    Serial.println("Not detected - check wiring/address");
-    Serial.println("Trying alternative I2C address 0x4B...");
-    
-    // Try alternative address
-    Wire.beginTransmission(0x4B);
-    i2cError = Wire.endTransmission();
-    Serial.printf("I2C scan 0x4B result: %d\n", i2cError);
+    Serial.flush();
+    Serial.updateBaudRate(CONSOLE_BAUD);
+    nmeaSerialOutput = false;
+    LOGI("NMEA", "Console UART back to logging (%lu snapshots skipped while busy)",
+         (unsigned long)nmeaSerialSkipped);
+  }
+}
+
+// Build the enabled sentences and send them to the NMEA UART service
+// subscribers and the console UART; never waits for either
+void updateNmeaOutput() {
+  if (nmeaOutputRate == 0 || (long)(millis() - nextNmeaOutput) < 0) return;
+  nextNmeaOutput = millis() + 1000 / nmeaOutputRate;
+  bool bleSubscribed = deviceConnected && pNmeaTxCharacteristic && pNmeaTxCharacteristic->getSubscribedCount() > 0;
+  bool wifiSubscribed = wifiRunning && wifiNmeaClients > 0;
+  if (!bleSubscribed && !nmeaSerialOutput && !wifiSubscribed) return;
+  
+  PROFILE_SCOPE(PROF_SERIALIZE);
+  TelemetryFrame frame;
+  buildTelemetryFrame(currentData, gps.fix(), imuAvailable, bleRSSIFiltered, currentData.sampleTime, frame);
+  float pitch = imuAvailable ? sensorPipeline.pitchAngle() : NAN;
+  size_t length = nmeaOutput.build(millis(), frame, gps.fix(), pitch, startState, secondsToStart());
+  if (length == 0) return;
+  const uint8_t* text = (const uint8_t*)nmeaOutput.text();
+  
+  if (nmeaSerialOutput) {
+    // A whole snapshot or nothing, so the UART never blocks the loop
+    if ((size_t)Serial.availableForWrite() >= length) {
+      Serial.write(text, length);
+    } else {
+      nmeaSerialSkipped++;
+    }
   }
   
-  if (imuAvailable) {
-    Serial.println("BNO080 IMU sensor enabled");
-  } else {
-    Serial.println("BNO080 IMU sensor disabled - tilt will be set to 0");
+  if (wifiSubscribed && length <= WIFI_MESSAGE_MAX) {
+    static WifiMessage message;   // loop() only; too large for its stack
+    message.kind = WIFI_MSG_NMEA;
+    message.length = (uint16_t)length;
+    memcpy(message.text, text, length);
+    wifiMessages.push(message);
   }
   
-  // Scan I2C bus for all devices
-  Serial.println("Scanning I2C bus...");
-  int devicesFound = 0;
-  for (byte address = 1; address < 127; address++) {
-    Wire.beginTransmission(address);
-    byte error = Wire.endTransmission();
-    
-    if (error == 0) {
-      Serial.printf("I2C device found at address 0x%02X\n", address);
-      devicesFound++;
+  // Notifies of up to MTU - 3 bytes; a sentence split across two is joined by the client
+  if (bleSubscribed) {
+    size_t chunk = minPeerMTU() - 3;
+    for (size_t offset = 0; offset < length; offset += chunk) {
+      size_t count = std::min(chunk, length - offset);
+      pNmeaTxCharacteristic->setValue(text + offset, count);
+      pNmeaTxCharacteristic->notify();
     }
   }
+}
+
+// Hand a published snapshot to the network task, in the forms its clients take
+void publishWifiSnapshot(const String &jsonData) {
+  if (!wifiRunning) return;
+  static WifiMessage message;   // loop() only; too large for its stack
+  if (wifiBinaryClients > 0) {
+    message.kind = WIFI_MSG_FRAME;
+    message.length = 0;
+    message.frame = latestFrame;
+    wifiMessages.push(message);
+  }
+  if (wifiJsonClients > 0 && jsonData.length() > 0 && jsonData.length() <= WIFI_MESSAGE_MAX) {
+    message.kind = WIFI_MSG_JSON;
+    message.length = (uint16_t)jsonData.length();
+    memcpy(message.text, jsonData.c_str(), message.length);
+    wifiMessages.push(message);
+  }
+}
+
+// New access point credentials, applied by the network task
+void setWifiConfig(const char* ssid, const char* password) {
+  portENTER_CRITICAL(&wifiConfigLock);
+  strlcpy(wifiSsid, ssid, sizeof(wifiSsid));
+  strlcpy(wifiPassword, password, sizeof(wifiPassword));
+  portEXIT_CRITICAL(&wifiConfigLock);
+  wifiReconfigure = true;
+}
+
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t wifiSleepLock = nullptr;
+#endif
+
+void startWifi() {
+  char ssid[sizeof(wifiSsid)];
+  char password[sizeof(wifiPassword)];
+  portENTER_CRITICAL(&wifiConfigLock);
+  memcpy(ssid, wifiSsid, sizeof(ssid));
+  memcpy(password, wifiPassword, sizeof(password));
+  wifiReconfigure = false;
+  portEXIT_CRITICAL(&wifiConfigLock);
+  
+  telemetryServer = new (std::nothrow) TelemetryServer(wifiTcp);
+  if (!telemetryServer) {
+    LOGE("WiFi", "No memory for the telemetry server, access point stays off");
+    wifiEnabled = false;
+    return;
+  }
   
-  if (devicesFound == 0) {
-    Serial.println("No I2C devices found. Check wiring and power.");
-  } else {
-    Serial.printf("Found %d I2C device(s)\n", devicesFound);
+  WiFi.mode(WIFI_AP);
+  if (!WiFi.softAP(ssid, password, WIFI_AP_CHANNEL, 0, TELEMETRY_SERVER_MAX_CLIENTS) || !wifiTcp.begin()) {
+    LOGE("WiFi", "Could not start the access point '%s'", ssid);
+    wifiTcp.end();
+    WiFi.mode(WIFI_OFF);
+    delete telemetryServer;
+    telemetryServer = nullptr;
+    wifiEnabled = false;
+    return;
+  }
+#if CONFIG_PM_ENABLE
+  // Stations expect the beacon on time: no light sleep while the access point is up
+  if (!wifiSleepLock) esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "wifi", &wifiSleepLock);
+  if (wifiSleepLock) esp_pm_lock_acquire(wifiSleepLock);
+#endif
+  wifiRunning = true;
+  String ip = WiFi.softAPIP().toString();
+  LOGI("WiFi", "Access point '%s' up: ws://%s/json, ws://%s/telemetry, NMEA on TCP %s:%d", ssid, ip.c_str(),
+       ip.c_str(), ip.c_str(), TELEMETRY_SERVER_NMEA_PORT);
+}
+
+void stopWifi() {
+  wifiRunning = false;
+  telemetryServer->closeAll();
+  delete telemetryServer;
+  telemetryServer = nullptr;
+  wifiTcp.end();
+  WiFi.softAPdisconnect(true);
+  WiFi.mode(WIFI_OFF);
+  wifiJsonClients = 0;
+  wifiBinaryClients = 0;
+  wifiNmeaClients = 0;
+  static WifiMessage stale;
+  while (wifiMessages.pop(stale)) {}
+#if CONFIG_PM_ENABLE
+  if (wifiSleepLock) esp_pm_lock_release(wifiSleepLock);
+#endif
+  LOGI("WiFi", "Access point down");
+}
+
+// Network task: brings the access point up and down, feeds the server the
+// snapshots from loop() and polls it; never blocks on a client
+void wifiTask(void* parameter) {
+  static WifiMessage message;
+  uint32_t reportedDrops = 0;
+  for (;;) {
+    bool wanted = wifiEnabled;
+    if (wifiRunning && (!wanted || wifiReconfigure)) stopWifi();
+    if (!wifiRunning && wanted) {
+      startWifi();
+      reportedDrops = 0;   // A new server counts from zero
+    }
+    if (!wifiRunning) {
+      vTaskDelay(pdMS_TO_TICKS(WIFI_IDLE_MS));
+      continue;
+    }
+    
+    while (wifiMessages.pop(message)) {
+      if (message.kind == WIFI_MSG_FRAME) {
+        telemetryServer->publishFrame(message.frame);
+      } else if (message.kind == WIFI_MSG_JSON) {
+        telemetryServer->publishJson(message.text, message.length);
+      } else {
+        telemetryServer->publishNmea(message.text, message.length);
+      }
+    }
+    telemetryServer->poll(millis());
+    wifiJsonClients = telemetryServer->clients(TS_CLIENT_JSON);
+    wifiBinaryClients = telemetryServer->clients(TS_CLIENT_BINARY);
+    wifiNmeaClients = telemetryServer->clients(TS_CLIENT_NMEA);
+    
+    const TelemetryServerStats &stats = telemetryServer->stats();
+    if (stats.dropped - reportedDrops >= 100) {
+      LOGW("WiFi", "%lu snapshots dropped for slow clients, %lu clients evicted",
+           (unsigned long)stats.dropped, (unsigned long)stats.evicted);
+      reportedDrops = stats.dropped;
+    }
+    vTaskDelay(pdMS_TO_TICKS(WIFI_POLL_MS));
+  }
+}
+
+void sendHistoryDone(uint32_t nextSeq) {
+  DynamicJsonDocument response(128);
+  response["type"] = "history_done";
+  response["next"] = nextSeq;
+  response["first"] = telemetryHistory.firstSeq();
+  response["end"] = telemetryHistory.endSeq();
+  String responseStr;
+  serializeJson(response, responseStr);
+  safeBLESend(responseStr, true);
+}
+
+void startHistoryTransfer(uint32_t fromSeq, uint32_t toSeq) {
+  // Clamp to what is still kept (offsets from the oldest frame, so wrap is harmless)
+  uint32_t first = telemetryHistory.firstSeq();
+  uint32_t span = telemetryHistory.endSeq() - first;
+  if (fromSeq - first > span) fromSeq = first;
+  if (toSeq - first > span) toSeq = first + span;
+  LOGI("BLE", "History back-fill of frames %lu-%lu requested (kept %lu-%lu)", (unsigned long)fromSeq,
+       (unsigned long)toSeq, (unsigned long)first, (unsigned long)(first + span));
+  
+  if (toSeq - first <= fromSeq - first) {
+    sendHistoryDone(toSeq);
+    return;
   }
+  historyTransfer.active = true;
+  historyTransfer.nextSeq = fromSeq;
+  historyTransfer.endSeq = toSeq;
+}
+
+void updateHistoryTransfer() {
+  if (!historyTransfer.active) return;
   
-  // Initialize BLE with the loaded device name
-  Serial.printf("[Boot] Initializing BLE with device name: '%s'\n", deviceName.c_str());
-  setupBLE();
+  if (!pServer || pServer->getConnectedCount() == 0) {
+    historyTransfer.active = false;
+    return;
+  }
   
-  // Initialize Discovery Mode GPIO
+  for (int sent = 0; sent < HISTORY_MESSAGES_PER_LOOP; sent++) {
+    DynamicJsonDocument response(1024);
+    response["type"] = "history";
+    JsonArray frames = response.createNestedArray("frames");
+    for (int i = 0; i < HISTORY_FRAMES_PER_MESSAGE && historyTransfer.nextSeq != historyTransfer.endSeq; i++) {
+      // A frame that dropped out of the ring while streaming is skipped
+      TelemetryFrame frame;
+      if (!telemetryHistory.get(historyTransfer.nextSeq++, frame)) continue;
+      
+      // [valid mask, values of the valid fields in TelemetryField order]
+      JsonArray entry = frames.createNestedArray();
+      entry.add(frame.valid);
+      for (int f = 0; f < TF_FIELD_COUNT; f++) {
+        if (frame.has((TelemetryField)f)) entry.add(frame.value[f]);
+      }
+    }
+    if (frames.size() > 0) {
+      String responseStr;
+      serializeJson(response, responseStr);
+      safeBLESend(responseStr, true);
+    }
+    
+    if (historyTransfer.nextSeq == historyTransfer.endSeq) {
+      historyTransfer.active = false;
+      sendHistoryDone(historyTransfer.endSeq);
+      return;
+    }
+  }
+}
+
+void startTrendTransfer(uint8_t tier) {
+  if (tier >= TREND_TIER_COUNT) {
+    LOGW("BLE", "Trend read of tier %u refused (0-%u)", tier, TREND_TIER_COUNT - 1);
+    return;
+  }
+  trendTransfer.tier = tier;
+  trendTransfer.first = trendHistory.firstBucket(tier);
+  trendTransfer.end = trendHistory.endBucket(tier);
+  trendTransfer.offset = 0;
+  trendTransfer.size = TrendHistory::blobSize(trendTransfer.first, trendTransfer.end);
+  trendTransfer.active = trendTransfer.size > 0;
+  LOGI("BLE", "Trend read of tier %u: %lu buckets, %lu bytes", tier,
+       (unsigned long)(trendTransfer.end - trendTransfer.first), (unsigned long)trendTransfer.size);
+  
+  // Everything needed to place and scale the blob: the newest bucket ended
+  // `age` ms ago, the others are `period` apart before it
+  DynamicJsonDocument response(512);
+  response["type"] = "trend_read";
+  response["tier"] = tier;
+  response["period"] = trendHistory.period(tier) / 1000;
+  response["first"] = trendTransfer.first;
+  response["count"] = trendTransfer.end - trendTransfer.first;
+  response["age"] = (uint32_t)(millis() - trendHistory.newestEnd(tier));
+  response["size"] = trendTransfer.size;
+  response["mtu"] = minPeerMTU();
+  JsonArray channels = response.createNestedArray("channels");
+  JsonArray steps = response.createNestedArray("steps");
+  for (uint8_t channel = 0; channel < TREND_CHANNEL_COUNT; channel++) {
+    channels.add(TrendHistory::channelName((TrendChannel)channel));
+    steps.add(TrendHistory::spreadStep((TrendChannel)channel));
+  }
+  String responseStr;
+  serializeJson(response, responseStr);
+  safeBLESend(responseStr, true);
+  
+  if (!trendTransfer.active) sendTrendDone();
+}
+
+void sendTrendDone() {
+  DynamicJsonDocument response(128);
+  response["type"] = "trend_done";
+  response["tier"] = trendTransfer.tier;
+  response["size"] = trendTransfer.offset;
+  String responseStr;
+  serializeJson(response, responseStr);
+  safeBLESend(responseStr, true);
+}
+
+// Stream the requested tier, a few packets per loop() pass
+// Packet: [blob offset u32][blob bytes...]
+void updateTrendTransfer() {
+  if (!trendTransfer.active) return;
+  
+  if (!pServer || pServer->getConnectedCount() == 0 || !pTrendCharacteristic) {
+    trendTransfer.active = false;
+    return;
+  }
+  
+  uint16_t payloadSize = minPeerMTU() - 3 - TREND_PACKET_HEADER_SIZE;
+  uint8_t packet[BLE_ATT_MTU_MAX];
+  for (int sent = 0; sent < TREND_PACKETS_PER_LOOP; sent++) {
+    memcpy(packet, &trendTransfer.offset, 4);
+    size_t length = trendHistory.read(trendTransfer.tier, trendTransfer.first, trendTransfer.end,
+                                      trendTransfer.offset, packet + TREND_PACKET_HEADER_SIZE, payloadSize);
+    pTrendCharacteristic->setValue(packet, TREND_PACKET_HEADER_SIZE + length);
+    pTrendCharacteristic->notify();
+    
+    trendTransfer.offset += length;
+    if (trendTransfer.offset >= trendTransfer.size) {
+      trendTransfer.active = false;
+      sendTrendDone();
+      return;
+    }
+  }
+}
+
+// Wake loop() early from another task
+void wakeLoop() {
+  if (loopTaskHandle) xTaskNotifyGive(loopTaskHandle);
+}
+
+void IRAM_ATTR onDiscoveryButtonEdge() {
+  BaseType_t higherPriorityWoken = pdFALSE;
+  if (loopTaskHandle) vTaskNotifyGiveFromISR(loopTaskHandle, &higherPriorityWoken);
+  if (higherPriorityWoken) portYIELD_FROM_ISR();
+}
+
+void setupPowerManagement() {
+  loopTaskHandle = xTaskGetCurrentTaskHandle();
+  attachInterrupt(digitalPinToInterrupt(DISCOVERY_BUTTON_PIN), onDiscoveryButtonEdge, CHANGE);
+  
+#if CONFIG_PM_ENABLE
+  esp_pm_config_esp32_t pmConfig = {};
+  pmConfig.max_freq_mhz = getCpuFrequencyMhz();
+  pmConfig.min_freq_mhz = POWER_MIN_CPU_MHZ;
+  pmConfig.light_sleep_enable = true;
+  if (esp_pm_configure(&pmConfig) == ESP_OK &&
+      esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "gpsUart", &noLightSleepLock) == ESP_OK &&
+      esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "loop", &cpuMaxLock) == ESP_OK) {
+    esp_pm_lock_acquire(noLightSleepLock);
+    esp_pm_lock_acquire(cpuMaxLock);
+    
+    // While moored, GPS sentences wake the chip so the UART FIFO is drained in time
+    uart_set_wakeup_threshold((uart_port_t)GPS_UART, GPS_UART_WAKEUP_THRESHOLD);
+    esp_sleep_enable_uart_wakeup(GPS_UART);
+    LOGI("Power", "Automatic light sleep enabled (%d-%d MHz)", POWER_MIN_CPU_MHZ, pmConfig.max_freq_mhz);
+    return;
+  }
+  LOGW("Power", "esp_pm_configure failed, waiting without light sleep");
+#else
+  LOGI("Power", "Built without CONFIG_PM_ENABLE, waiting without light sleep");
+#endif
+}
+
+// Light sleep only while moored; back to the normal refresh right away when active
+void applyPowerMode(PowerMode mode) {
+#if CONFIG_PM_ENABLE
+  if (noLightSleepLock) {
+    if (mode == POWER_MOORED) {
+      esp_pm_lock_release(noLightSleepLock);
+    } else {
+      esp_pm_lock_acquire(noLightSleepLock);
+    }
+  }
+#endif
+  if (mode == POWER_ACTIVE) nextUpdate = millis();
+  LOGI("Power", "Mode %s (loop duty cycle %.1f%%)", powerModeName(mode), powerScheduler.dutyCycle() * 100.0f);
+}
+
+// Block until the next refresh, the poll interval or a wakeLoop() call
+void waitForNextEvent(unsigned long passStart) {
+  powerScheduler.recordAwake(micros() - passStart);
+  
+  // Bulk transfers pump a few packets per pass and must not wait
+  if (logTransfer.active || profileTraceActive || historyTransfer.active || trendTransfer.active) return;
+  
+  uint32_t budget = powerScheduler.waitBudget(millis(), nextUpdate);
+  if (budget == 0) return;
+  
+  unsigned long waitStart = micros();
+#if CONFIG_PM_ENABLE
+  if (cpuMaxLock) esp_pm_lock_release(cpuMaxLock);
+#endif
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(budget));
+#if CONFIG_PM_ENABLE
+  if (cpuMaxLock) esp_pm_lock_acquire(cpuMaxLock);
+#endif
+  powerScheduler.recordWait(micros() - waitStart);
+}
+
+void setup() {
+  // Initialize serial communication first
+  Serial.setTxBufferSize(NMEA_SERIAL_TX_BUFFER);
+  Serial.begin(CONSOLE_BAUD);
+  logger.begin(serialLogSink);
+  xTaskCreatePinnedToCore(logDrainTask, "logDrain", LOG_DRAIN_STACK_SIZE, nullptr,
+                          LOG_DRAIN_TASK_PRIORITY, nullptr, LOG_DRAIN_TASK_CORE);
+  delay(1000); // Give serial time to initialize
+  LOGI("Boot", "=== Veetr Starting ===");
+  LOGI("Boot", "Firmware Version: %s", FIRMWARE_VERSION);
+  
+  // Cycle counter runs at the CPU clock
+  profiler.begin(getCpuFrequencyMhz());
+  
+  // Debug OTA partition information
+  const esp_partition_t* configured = esp_ota_get_boot_partition();
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  LOGI("Boot", "Running partition: %s (address: 0x%x)", running->label, running->address);
+  LOGI("Boot", "Configured boot partition: %s (address: 0x%x)", configured->label, configured->address);
+  if (configured != running) {
+    LOGW("Boot", "Configured partition differs from running partition!");
+  }
+  
+  // Initialize Preferences for persistent storage
+  preferences.begin("settings", false);
+  compassOffsetDelta = preferences.getFloat("compassOffset", 0.0f);
+  deadWindAngle = preferences.getInt("deadWindAngle", 40);
+  refreshRateSeconds = preferences.getFloat("refreshRate", 1.0f);
+  String deviceName = preferences.getString("deviceName", "Veetr");
+  deviceNameCache = deviceName;
+  if (preferences.getBytesLength("levelQuat") == sizeof(levelReference)) {
+    preferences.getBytes("levelQuat", &levelReference, sizeof(levelReference));
+  } else {
+    // Calibrated before the level reference: a heel offset only
+    levelReference = Quaternion::aboutX(preferences.getFloat("delta", 0.0f));
+  }
+  LOGI("Boot", "Loaded level reference from NVS: %.4f %.4f %.4f %.4f",
+       levelReference.w, levelReference.x, levelReference.y, levelReference.z);
+  LOGI("Boot", "Loaded compass calibration offset from NVS: %.2f", compassOffsetDelta);
+  sensorPipeline.setLevelReference(levelReference);
+  sensorPipeline.setCompassOffset(compassOffsetDelta);
+  sensorPipeline.setPeakHeelWindow(preferences.getUChar("peakWindow", ORIENTATION_PEAK_WINDOW));
+  LOGI("Boot", "Loaded deadWindAngle from NVS: %d", deadWindAngle);
+  trueWindConfig.mastHeight = preferences.getFloat("mastHeight", trueWindConfig.mastHeight);
+  trueWindConfig.speedTau = preferences.getFloat("windSpeedTau", trueWindConfig.speedTau);
+  trueWindConfig.directionTau = preferences.getFloat("windDirTau", trueWindConfig.directionTau);
+  sensorPipeline.setTrueWindConfig(trueWindConfig);
+  LOGI("Boot", "Loaded true wind settings from NVS: mast %.1f m, TWS %.1f s, TWD %.1f s",
+       trueWindConfig.mastHeight, trueWindConfig.speedTau, trueWindConfig.directionTau);
+  uint8_t trackPoints = preferences.getUChar("trackPoints", sensorPipeline.trackWindow());
+  uint8_t accelSamples = preferences.getUChar("accelSamples", sensorPipeline.accelWindow());
+  sensorPipeline.setMovementWindows(trackPoints, accelSamples);
+  LOGI("Boot", "Loaded movement windows from NVS: %u GPS points, %u accelerometer samples",
+       trackPoints, accelSamples);
+  for (uint8_t channel = 0; channel < OUTLIER_CHANNEL_COUNT; channel++) {
+    uint8_t window = sensorPipeline.outlierFilter((OutlierChannel)channel).window();
+    sensorPipeline.setOutlierWindow((OutlierChannel)channel, preferences.getUChar(OUTLIER_NVS_KEYS[channel], window));
+  }
+  sensorPipeline.setOutlierThreshold(preferences.getFloat("hampelK", sensorPipeline.outlierFilter(OUTLIER_AWS).getThreshold()));
+  LOGI("Boot", "Loaded spike rejection from NVS: windows AWS %u, AWA %u, SOG %u, threshold %.1f",
+       sensorPipeline.outlierFilter(OUTLIER_AWS).window(), sensorPipeline.outlierFilter(OUTLIER_AWA).window(),
+       sensorPipeline.outlierFilter(OUTLIER_SOG).window(), sensorPipeline.outlierFilter(OUTLIER_AWS).getThreshold());
+  nmeaOutputRate = preferences.getUChar("nmeaRate", nmeaOutputRate);
+  nmeaOutput.setSentences(preferences.getUChar("nmeaSentences", NMEA_OUT_ALL));
+  uint32_t nmeaBaud = preferences.getUInt("nmeaBaud", nmeaSerialBaud);
+  LOGI("Boot", "Loaded NMEA output from NVS: %u Hz, sentences 0x%02X, serial %s at %lu baud", nmeaOutputRate,
+       nmeaOutput.sentences(), preferences.getBool("nmeaSerial", false) ? "on" : "off", (unsigned long)nmeaBaud);
+  setNmeaSerialOutput(preferences.getBool("nmeaSerial", false), nmeaBaud);
+  setWifiConfig(preferences.getString("wifiSsid", deviceName).c_str(), preferences.getString("wifiPass", "").c_str());
+  // Never an open access point: without a password it stays off
+  wifiEnabled = preferences.getBool("wifiOn", false) && preferences.getString("wifiPass", "").length() > 0;
+  LOGI("Boot", "Loaded Wi-Fi access point from NVS: %s", wifiEnabled ? "on" : "off");
+  LOGI("Boot", "Loaded refreshRate from NVS: %.2f", refreshRateSeconds);
+  LOGI("Boot", "Loaded deviceName from NVS: %s", deviceName.c_str());
+  
+  // Boat polar, if one was uploaded
+  size_t polarSize = preferences.getBytesLength("polar");
+  if (polarSize > 0 && polarSize <= POLAR_MAX_BLOB_SIZE &&
+      preferences.getBytes("polar", polarUpload.data, polarSize) == polarSize &&
+      polarTable.load(polarUpload.data, polarSize)) {
+    LOGI("Boot", "Loaded polar from NVS: %u TWS x %u TWA", polarTable.twsCount(), polarTable.twaCount());
+  } else if (polarSize > 0) {
+    LOGW("Boot", "Stored polar is invalid (%u bytes), ignoring it", (unsigned)polarSize);
+  }
+  
+  // Start line and countdown, so a restart in the sequence keeps them
+  loadRaceState();
+  
+  // Update refresh rate from loaded value
+  updateRefreshRate();
+  LOGI("Boot", "Refresh rate set to %d ms (%.1f seconds)", refreshRate, refreshRateSeconds);
+  
+  // Mount SPIFFS and open the session log
+  if (SPIFFS.begin(true)) {
+    // Keep a quarter of the filesystem free so SPIFFS garbage collection stays fast
+    uint32_t capacity = min((uint32_t)SESSION_LOG_MAX_BLOCKS, (uint32_t)(SPIFFS.totalBytes() * 3 / 4 / LOG_BLOCK_SIZE) - 1);
+    if (sessionLog.begin(SPIFFS, SESSION_LOG_PATH, capacity)) {
+      LOGI("Boot", "Session log ready: %u blocks (%u-%u), capacity %u",
+           sessionLog.endSeq() - sessionLog.firstSeq(), sessionLog.firstSeq(), sessionLog.endSeq(), capacity);
+    } else {
+      LOGW("Boot", "Session log could not be opened");
+    }
+  } else {
+    LOGW("Boot", "SPIFFS mount failed - session logging disabled");
+  }
+  
+  // Initialize I2C for BNO080 with detection
+  Wire.begin(BNO080_SDA, BNO080_SCL);
+  Wire.setTimeout(100); // Set I2C timeout to 100ms to prevent long blocking
+  
+  LOGI("BNO080", "Testing connection... I2C SDA=%d, SCL=%d", BNO080_SDA, BNO080_SCL);
+  
+  // Test I2C bus first
+  Wire.beginTransmission(0x4A); // BNO080 default I2C address
+  uint8_t i2cError = Wire.endTransmission();
+  LOGI("I2C", "I2C scan result: %d (0=success, 2=NACK, 4=other error)", i2cError);
+  
+  if (imu.begin()) {
+    LOGI("BNO080", "BNO080 begin() successful, configuring sensor...");
+    
+    // Enable rotation vector for tilt/heel angle calculation
+    imu.enableRotationVector(50); // 50ms = 20Hz update rate
+    LOGI("BNO080", "Rotation vector configuration sent");
+    
+    // Enable magnetometer for compass heading with responsive update rate
+    imu.enableMagnetometer(50); // 50ms = 20Hz update rate (responsive but stable)
+    LOGI("BNO080", "Magnetometer configuration sent (20Hz)");
+    
+    // Enable accelerometer for acceleration data
+    imu.enableAccelerometer(50); // 50ms = 20Hz update rate
+    LOGI("BNO080", "Accelerometer configuration sent");
+    
+    // Give sensor more time to initialize and start providing data
+    LOGI("BNO080", "Waiting for sensor data...");
+    delay(500); // Longer delay for BNO080 to stabilize
+    
+    // Try multiple times to get data
+    bool dataFound = false;
+    for (int attempt = 0; attempt < 10; attempt++) {
+      if (imu.dataAvailable()) {
+        dataFound = true;
+        LOGI("BNO080", "Data available after %d attempts!", attempt + 1);
+        break;
+      }
+      delay(100); // Wait 100ms between attempts
+    }
+    
+    if (dataFound) {
+      imuAvailable = true;
+      LOGI("BNO080", "BNO080 connected and working!");
+      
+      // Test reading actual data
+      float testI = imu.getQuatI();
+      float testReal = imu.getQuatReal();
+      LOGI("BNO080", "Test quaternion read: i=%.3f, real=%.3f", testI, testReal);
+    } else {
+      imuAvailable = false;
+      LOGW("BNO080", "BNO080 detected but no data available after 10 attempts");
+      LOGW("BNO080", "Check power supply (3.3V) and wiring connections");
+    }
+  } else {
+    imuAvailable = false;
+    LOGW("BNO080", "Not detected - check wiring/address");
+    LOGI("BNO080", "Trying alternative I2C address 0x4B...");
+    
+    // Try alternative address
+    Wire.beginTransmission(0x4B);
+    i2cError = Wire.endTransmission();
+    LOGI("I2C", "I2C scan 0x4B result: %d", i2cError);
+  }
+  
+  if (imuAvailable) {
+    LOGI("BNO080", "BNO080 IMU sensor enabled");
+  } else {
+    LOGW("BNO080", "BNO080 IMU sensor disabled - tilt will be set to 0");
+  }
+  
+  // Scan I2C bus for all devices
+  LOGI("I2C", "Scanning I2C bus...");
+  int devicesFound = 0;
+  for (byte address = 1; address < 127; address++) {
+    Wire.beginTransmission(address);
+    byte error = Wire.endTransmission();
+    
+    if (error == 0) {
+      LOGI("I2C", "I2C device found at address 0x%02X", address);
+      devicesFound++;
+    }
+  }
+  
+  if (devicesFound == 0) {
+    LOGW("I2C", "No I2C devices found. Check wiring and power.");
+  } else {
+    LOGI("I2C", "Found %d I2C device(s)", devicesFound);
+  }
+  
+  // Initialize BLE with the loaded device name
+  LOGI("Boot", "Initializing BLE with device name: '%s'", deviceName.c_str());
+  setupBLE();
+  
+  // Initialize Discovery Mode GPIO
   pinMode(DISCOVERY_BUTTON_PIN, INPUT_PULLUP);  // Button with internal pullup
   pinMode(DISCOVERY_LED_PIN, OUTPUT);           // LED output
   digitalWrite(DISCOVERY_LED_PIN, LOW);         // Start with LED off
-  Serial.printf("[Boot] Discovery button: GPIO%d, LED: GPIO%d\n", DISCOVERY_BUTTON_PIN, DISCOVERY_LED_PIN);
+  setupPowerManagement();
+  LOGI("Boot", "Discovery button: GPIO%d, LED: GPIO%d", DISCOVERY_BUTTON_PIN, DISCOVERY_LED_PIN);
+  
+  // Network task; brings the access point up when it is enabled
+  xTaskCreatePinnedToCore(wifiTask, "wifi", WIFI_TASK_STACK_SIZE, nullptr,
+                          WIFI_TASK_PRIORITY, nullptr, WIFI_TASK_CORE);
   
   // Test button reading at startup
   int buttonTest = digitalRead(DISCOVERY_BUTTON_PIN);
-  Serial.printf("[Boot] Button test reading: %d (%s)\n", buttonTest, buttonTest == HIGH ? "NOT PRESSED" : "PRESSED");
-  Serial.println("[Boot] Press discovery button to toggle BLE discovery mode");
+  LOGI("Boot", "Button test reading: %d (%s)", buttonTest, buttonTest == HIGH ? "NOT PRESSED" : "PRESSED");
+  LOGI("Boot", "Press discovery button to toggle BLE discovery mode");
   
   // IMPORTANT: Start discovery mode automatically on boot
-  Serial.println("[Boot] Auto-starting discovery mode for 5 minutes...");
+  LOGI("Boot", "Auto-starting discovery mode for 5 minutes...");
   startDiscoveryMode();
   
   // Initialize GPS module
   gpsSerial.begin(9600, SERIAL_8N1, GPS_RX, GPS_TX);
-  Serial.println("GPS module initialized");
+  LOGI("GPS", "GPS module initialized");
   
   // Initialize RS485 for wind sensor with ModbusMaster
   // Try both sensor configurations - start with 9600 baud format first
@@ -1287,33 +3166,41 @@ void setup() {
   windSensor.setResponseTimeout(500); // 500ms timeout instead of default 2000ms
   #endif
   
-  Serial.println("RS485 wind sensor initialized with ModbusMaster");
-  Serial.printf("RS485 pins: RX=%d, TX=%d, DE=%d\n", RS485_RX, RS485_TX, RS485_DE);
-  Serial.println("RS485 settings: Auto-detect between IEEE754 float (9600,8E1) and integer (4800,8N1) formats");
-  Serial.println("Anemometer format: Auto-detect between IEEE 754 float and integer data types");
+  LOGI("Wind Sensor", "RS485 wind sensor initialized with ModbusMaster");
+  LOGI("Wind Sensor", "RS485 pins: RX=%d, TX=%d, DE=%d", RS485_RX, RS485_TX, RS485_DE);
+  LOGI("Wind Sensor", "RS485 settings: Auto-detect between IEEE754 float (9600,8E1) and integer (4800,8N1) formats");
+  LOGI("Wind Sensor", "Anemometer format: Auto-detect between IEEE 754 float and integer data types");
   
   // Test wind sensor connection
   delay(1000);
-  Serial.println("Testing wind sensor connection...");
+  LOGI("Wind Sensor", "Testing wind sensor connection...");
   
   float testSpeed;
   int testDirection;
-  bool testResult = readWindSensor(testSpeed, testDirection);
+  bool testResult = sensorPipeline.readWindSensor(testSpeed, testDirection);
   if (testResult) {
-    Serial.printf("Wind sensor test PASSED: %.2f m/s (%.1f kt) @ %d°\n", 
-                  testSpeed, testSpeed * 1.944, testDirection);
+    LOGI("Wind Sensor", "Wind sensor test PASSED: %.2f m/s (%.1f kt) @ %d°",
+         testSpeed, testSpeed * 1.944, testDirection);
   } else {
-    Serial.println("Wind sensor test FAILED - check connections and power");
+    LOGW("Wind Sensor", "Wind sensor test FAILED - check connections and power");
   }
   
-  Serial.println("Setup complete");
+  LOGI("Boot", "Setup complete");
 }
 
 void loop() {
+  unsigned long passStart = micros();
+  
+  // Commands and connection changes queued by the NimBLE callbacks
+  processBleEvents();
+  
   // Handle discovery button and mode
   handleDiscoveryButton();
   updateDiscoveryStatus();
   
+  // Match each connection's parameters to what it is used for (also during OTA)
+  updateConnectionParams();
+  
   // Handle OTA progress LED blinking using official component
   if (bleOTAActive) {
     unsigned long currentTime = millis();
@@ -1322,12 +3209,12 @@ void loop() {
     static unsigned long lastStatusReport = 0;
     if (currentTime - lastStatusReport > 5000) {
       unsigned long elapsedMinutes = (currentTime - otaStartTime) / 60000;
-      Serial.printf("[BLE OTA] Status: Active for %lu ms (%lu minutes) using official Espressif component\n", 
-                   currentTime - otaStartTime, elapsedMinutes);
+      LOGI("BLE OTA", "Status: Active for %lu ms (%lu minutes) using official Espressif component",
+           currentTime - otaStartTime, elapsedMinutes);
       
       // Warn when approaching timeout (at 50 minutes)
       if (elapsedMinutes >= 50) {
-        Serial.printf("[BLE OTA] WARNING: Approaching timeout in %lu minutes\n", 60 - elapsedMinutes);
+        LOGW("BLE OTA", "Approaching timeout in %lu minutes", 60 - elapsedMinutes);
       }
       
       lastStatusReport = currentTime;
@@ -1335,14 +3222,14 @@ void loop() {
     
     // Check for total OTA timeout (60 minutes - allow for very large firmware and slow BLE)
     if (currentTime - otaStartTime > 3600000) { // 60 minutes
-      Serial.printf("[BLE OTA] Total timeout after %lu ms (%lu minutes). Component will handle cleanup.\n", 
-                   currentTime - otaStartTime, (currentTime - otaStartTime) / 60000);
+      LOGW("BLE OTA", "Total timeout after %lu ms (%lu minutes). Component will handle cleanup.",
+           currentTime - otaStartTime, (currentTime - otaStartTime) / 60000);
       bleOTAActive = false;
       otaStartTime = 0;
       
       // Turn off LED and resume normal operation
       digitalWrite(DISCOVERY_LED_PIN, LOW);
-      Serial.println("[BLE OTA] Timeout recovery complete - resuming sensor data transmission");
+      LOGI("BLE OTA", "Timeout recovery complete - resuming sensor data transmission");
       return;
     }
     
@@ -1355,137 +3242,147 @@ void loop() {
     return;
   }
   
+  // Stream session log blocks to a client between sensor updates
+  updateLogTransfer();
+  
+  // Send the frozen profiler trace, a few messages per pass
+  updateProfileTrace();
+  
+  // Back-fill telemetry history for a reconnected client
+  updateHistoryTransfer();
+  
+  // Chart history blob for a client that asked for a tier
+  updateTrendTransfer();
+  
+  // Start line at the receiver's rate: drain the GPS UART on every pass and
+  // update on each new fix, not just once per refresh tick
+  if (startLine.isSet()) {
+    sensorPipeline.pollGPS();
+    if (gps.fix().positionAt != startStateFixAt) calculateRegattaData();
+  }
+  
+  // Every IMU report at the sensor's rate, so heel rates and peaks see the
+  // whole motion, and the wind sensor every 100 ms: a header, gust or heel
+  // change past its deadband goes out now (at most every 250 ms), not on the
+  // next refresh, which stays the full read and the heartbeat
+  if (powerScheduler.mode() == POWER_ACTIVE && sensorPipeline.updateFast() && publishTelemetryFrame(false)) {
+    notifySnapshot();
+  }
+
+  // NMEA 0183 sentences at their own rate, from the latest snapshot
+  updateNmeaOutput();
+
   // Check if it's time to update data
   if (millis() >= nextUpdate) {
+    if (profileResetPending) {
+      profiler.reset();
+      profileResetPending = false;
+    }
+    PROFILE_SCOPE(PROF_REFRESH);
+    
     // Read sensor data
-    readSensors();
+    sensorPipeline.readSensors();
     
-    // Calculate regatta data if start line is set
+    // System clock and countdown on GPS time, then the start line against this tick's fix and wind
+    updateRaceClock();
     calculateRegattaData();
     
+    // VMG and targets from the polar
+    updatePolarPerformance();
+    
     // Update BLE RSSI if connected
     updateBLERSSI();
     
-    // Update BLE clients with sensor data
-    updateBLEData();
+    // Update BLE and Wi-Fi clients if the snapshot changed enough (or on the heartbeat)
+    if (publishTelemetryFrame(true)) notifySnapshot();
     
-    // Set next update time
-    nextUpdate = millis() + refreshRate;
+    // Record the snapshot to flash
+    logSessionRecord();
+    
+    // Set next update time (slower while moored)
+    nextUpdate = millis() + powerScheduler.refreshInterval(refreshRate);
     
     // Print concise status summary every 5 seconds
+    #if VEETR_LOG_LEVEL >= VEETR_LOG_INFO
     static unsigned long lastStatusTime = 0;
     if (millis() - lastStatusTime > 5000) {
-      Serial.print("Status: ");
+      char status[160];
+      size_t used = 0;
+      auto append = [&](const char* format, ...) {
+        if (used >= sizeof(status)) return;
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(status + used, sizeof(status) - used, format, args);
+        va_end(args);
+        if (n > 0) used += n;
+      };
+      status[0] = '\0';
       if (deviceConnected) {
-        Serial.printf("BLE✓(%d) ", connectedDeviceCount);
-        if (bleRSSIFiltered != 0) Serial.printf("RSSI:%ddBm ", bleRSSIFiltered);
+        append("BLE✓(%d) ", connectedDeviceCount.load());
+        if (bleRSSIFiltered != 0) append("RSSI:%ddBm ", bleRSSIFiltered);
       }
       if (discoveryModeActive) {
         unsigned long remaining = (DISCOVERY_TIMEOUT_MS - (millis() - discoveryModeStartTime)) / 1000;
-        Serial.printf("Discovery:%lus ", remaining);
+        append("Discovery:%lus ", remaining);
       }
       if (!isnan(currentData.speed) && currentData.speed > 0) 
-        Serial.printf("Spd:%.1fkt ", currentData.speed);
+        append("Spd:%.1fkt ", currentData.speed);
       if (!isnan(currentData.windSpeed)) 
-        Serial.printf("Wind:%.1fkt AWA:%d° ", currentData.windSpeed, currentData.windAngle);
+        append("Wind:%.1fkt AWA:%d° ", currentData.windSpeed, currentData.windAngle);
       if (!isnan(currentData.tilt)) 
-        Serial.printf("Tilt:%.1f° ", currentData.tilt);
+        append("Tilt:%.1f° ", currentData.tilt);
       if (currentData.HDM >= 0 && currentData.HDM <= 359) 
-        Serial.printf("Hdm:%d° ", currentData.HDM);
+        append("Hdm:%d° ", currentData.HDM);
       
       // GPS status - only show satellite count if we have actual GPS data
       if (gps.charsProcessed() > 10) {
         // We're receiving GPS data
-        if (isGPSDataValid()) {
-          Serial.printf("GPS:%dsat✓ ", gps.satellites.value());
-        } else if (gps.satellites.isValid()) {
-          Serial.printf("GPS:%dsat(no fix) ", gps.satellites.value());
+        if (sensorPipeline.isGPSDataValid()) {
+          append("GPS:%dsat✓ ", gps.fix().satellites);
+        } else if (gps.fix().has(NMEA_SATELLITES)) {
+          append("GPS:%dsat(no fix) ", gps.fix().satellites);
         } else {
-          Serial.print("GPS:parsing ");
+          append("GPS:parsing ");
         }
       } else {
         // No GPS data being received
-        Serial.print("GPS:no data ");
+        append("GPS:no data ");
       }
+      append("Pwr:%s %.0f%%", powerModeName(powerScheduler.mode()), powerScheduler.dutyCycle() * 100.0f);
       
-      Serial.println();
+      LOGI("Status", "%s", status);
       lastStatusTime = millis();
     }
+    #endif
+  } else if (powerScheduler.mode() == POWER_MOORED) {
+    // Keep the GPS UART from overflowing between the slow refreshes
+    sensorPipeline.pollGPS();
   }
-}
-
-// GPS track-based filtering variables
-const int GPS_TRACK_BUFFER_SIZE = 10;  // Track last 10 positions
-struct GPSPoint {
-  double lat;
-  double lon;
-  float speed;
-  unsigned long timestamp;
-  bool valid;
-};
-
-// Accelerometer-based movement detection variables
-const int ACCEL_BUFFER_SIZE = 8;  // Track last 8 acceleration readings
-struct AccelPoint {
-  float x, y, z;
-  float magnitude;
-  unsigned long timestamp;
-  bool valid;
-};
-
-static GPSPoint gpsTrackBuffer[GPS_TRACK_BUFFER_SIZE];
-static int gpsTrackIndex = 0;
-static bool gpsTrackBufferFull = false;
-static float lastValidSpeed = 0.0;
-
-static AccelPoint accelBuffer[ACCEL_BUFFER_SIZE];
-static int accelIndex = 0;
-static bool accelBufferFull = false;
-
-// Calculate distance between two GPS points in meters
-float calculateDistance(double lat1, double lon1, double lat2, double lon2) {
-  const float R = 6371000; // Earth's radius in meters
-  float dLat = (lat2 - lat1) * PI / 180.0;
-  float dLon = (lon2 - lon1) * PI / 180.0;
-  float a = sin(dLat/2) * sin(dLat/2) +
-            cos(lat1 * PI / 180.0) * cos(lat2 * PI / 180.0) *
-            sin(dLon/2) * sin(dLon/2);
-  float c = 2 * atan2(sqrt(a), sqrt(1-a));
-  return R * c;
-}
-
-// Calculate bearing between two GPS points in degrees
-float calculateBearing(double lat1, double lon1, double lat2, double lon2) {
-  float dLon = (lon2 - lon1) * PI / 180.0;
-  float y = sin(dLon) * cos(lat2 * PI / 180.0);
-  float x = cos(lat1 * PI / 180.0) * sin(lat2 * PI / 180.0) -
-            sin(lat1 * PI / 180.0) * cos(lat2 * PI / 180.0) * cos(dLon);
-  float bearing = atan2(y, x) * 180.0 / PI;
-  return fmod(bearing + 360.0, 360.0);
+  
+  // Stay active while moving, connected, racing, feeding a plotter on the
+  // console UART or busy with a transfer or discovery
+  bool busy = discoveryModeActive || logTransfer.active || profileTraceActive || historyTransfer.active ||
+              trendTransfer.active || startLine.isSet() || regattaData.timerRunning || nmeaSerialOutput;
+  // Wi-Fi clients count like BLE ones: they get the same snapshots
+  size_t clients = connectedDeviceCount.load() + wifiJsonClients.load() + wifiBinaryClients.load() +
+                   wifiNmeaClients.load();
+  if (powerScheduler.update(millis(), sensorPipeline.isMoving(), clients, busy)) {
+    applyPowerMode(powerScheduler.mode());
+  }
+  
+  waitForNextEvent(passStart);
 }
 
 // Transform accelerometer data from device coordinates to vessel coordinates using calibration
-// This uses the level calibration (heelAngleDelta) and compass calibration (compassOffsetDelta)
-// to create a rotation matrix that transforms device coordinates to vessel coordinates
+// The level reference (see Orientation.h) is the device's mounting tilt, so
+// rotating by it takes device axes to the vessel's
 void transformAccelerometerToVessel(float deviceX, float deviceY, float deviceZ, 
                                    float &vesselForward, float &vesselStarboard, float &vesselUp) {
-  
-  // For now, we'll assume the device coordinate system aligns with vessel coordinates
-  // after level and compass calibration. This is a simplified approach.
-  // In a full implementation, we'd need to determine the device mounting orientation
-  // and create proper rotation matrices.
-  
-  // Simplified mapping (this assumes device X=forward, Y=starboard, Z=up)
-  // This will need to be enhanced based on actual device mounting
+  // Device X=forward, Y=starboard, Z=up once the mount's tilt is taken out
+  levelReference.rotate(deviceX, deviceY, deviceZ);
   vesselForward = deviceX;    // Forward/aft acceleration
   vesselStarboard = deviceY;  // Port/starboard acceleration  
   vesselUp = deviceZ;         // Up/down acceleration
-  
-  // TODO: Apply proper rotation matrix transformation using heelAngleDelta and compassOffsetDelta
-  // This would involve creating a 3D rotation matrix that accounts for:
-  // 1. Device mounting orientation relative to vessel
-  // 2. Current heel angle compensation
-  // 3. Compass heading compensation
 }
 
 // Get forward acceleration (positive = accelerating forward)
@@ -1509,611 +3406,52 @@ float getUpAcceleration(float accelX, float accelY, float accelZ) {
   return up;
 }
 
-// Store accelerometer reading for movement analysis
-void storeAccelReading(float accelX, float accelY, float accelZ) {
-  if (!imuAvailable) return;
-  
-  AccelPoint point;
-  point.x = accelX;
-  point.y = accelY;
-  point.z = accelZ;
-  point.magnitude = sqrt(accelX * accelX + accelY * accelY + accelZ * accelZ);
-  point.timestamp = millis();
-  point.valid = true;
-  
-  accelBuffer[accelIndex] = point;
-  accelIndex = (accelIndex + 1) % ACCEL_BUFFER_SIZE;
-  
-  if (!accelBufferFull && accelIndex == 0) {
-    accelBufferFull = true;
+// Evaluate this tick against the polar (VMG is reported even without one)
+void updatePolarPerformance() {
+  PROFILE_SCOPE(PROF_FUSION);
+  polarValid = !isnan(currentData.trueWindSpeed) && !isnan(currentData.speed) && !isnan(currentData.trueWindAngle);
+  if (polarValid) {
+    polarTable.evaluate(currentData.trueWindSpeed, currentData.trueWindAngle, currentData.speed, polarPerformance);
   }
 }
 
-// Analyze accelerometer data to detect movement
-bool isAccelerometerMovementDetected() {
-  if (!imuAvailable || (!accelBufferFull && accelIndex < 3)) {
-    return false; // Not enough data or no IMU
-  }
-  
-  static unsigned long lastAnalysisTime = 0;
-  static bool lastResult = false;
-  
-  // Only analyze every 500ms to reduce CPU load
-  if (millis() - lastAnalysisTime < 500) {
-    return lastResult;
-  }
-  lastAnalysisTime = millis();
-  
-  int validPoints = accelBufferFull ? ACCEL_BUFFER_SIZE : accelIndex;
-  if (validPoints < 3) return false;
-  
-  // Calculate acceleration variance to detect movement
-  float totalMagnitude = 0.0;
-  float maxMagnitude = 0.0;
-  float minMagnitude = 1000.0;
-  
-  for (int i = 0; i < validPoints; i++) {
-    int idx = (accelIndex - validPoints + i + ACCEL_BUFFER_SIZE) % ACCEL_BUFFER_SIZE;
-    if (!accelBuffer[idx].valid) continue;
-    
-    float mag = accelBuffer[idx].magnitude;
-    totalMagnitude += mag;
-    maxMagnitude = max(maxMagnitude, mag);
-    minMagnitude = min(minMagnitude, mag);
-  }
-  
-  float avgMagnitude = totalMagnitude / validPoints;
-  float magnitudeRange = maxMagnitude - minMagnitude;
-  
-  // Calculate standard deviation of acceleration magnitude
-  float variance = 0.0;
-  for (int i = 0; i < validPoints; i++) {
-    int idx = (accelIndex - validPoints + i + ACCEL_BUFFER_SIZE) % ACCEL_BUFFER_SIZE;
-    if (!accelBuffer[idx].valid) continue;
-    
-    float diff = accelBuffer[idx].magnitude - avgMagnitude;
-    variance += diff * diff;
-  }
-  variance /= validPoints;
-  float stdDev = sqrt(variance);
-  
-  // Movement detection thresholds
-  const float MOVEMENT_STD_DEV_THRESHOLD = 0.5;  // m/s² - acceleration variation indicating movement
-  const float MOVEMENT_RANGE_THRESHOLD = 1.0;    // m/s² - total acceleration range indicating movement
-  const float MIN_AVERAGE_ACCEL = 8.0;           // m/s² - minimum for valid readings (gravity ~9.81)
-  const float MAX_AVERAGE_ACCEL = 12.0;          // m/s² - maximum for valid readings
-  
-  // Check if accelerometer readings are reasonable (detecting presence of gravity)
-  bool validAccelData = (avgMagnitude >= MIN_AVERAGE_ACCEL && avgMagnitude <= MAX_AVERAGE_ACCEL);
-  
-  // Movement detected if significant variation in acceleration
-  bool movementDetected = validAccelData && 
-                         (stdDev > MOVEMENT_STD_DEV_THRESHOLD || magnitudeRange > MOVEMENT_RANGE_THRESHOLD);
-  
-  #ifdef DEBUG_GPS
-  static unsigned long lastAccelDebugTime = 0;
-  if (millis() - lastAccelDebugTime > 2000) { // Debug every 2 seconds
-    Serial.printf("[Accel Movement] Avg: %.2f m/s², StdDev: %.2f, Range: %.2f, Movement: %s\n",
-                  avgMagnitude, stdDev, magnitudeRange, movementDetected ? "YES" : "NO");
-    lastAccelDebugTime = millis();
-  }
-  #endif
-  
-  lastResult = movementDetected;
-  return movementDetected;
-}
-
-// Analyze GPS track to determine if movement is real
-bool isMovementConsistent() {
-  static unsigned long lastAnalysisTime = 0;
-  static bool lastResult = false;
-  
-  // Only analyze movement every 2 seconds to reduce CPU load
-  if (millis() - lastAnalysisTime < 2000) {
-    return lastResult;
-  }
-  lastAnalysisTime = millis();
-  
-  if (!gpsTrackBufferFull && gpsTrackIndex < 3) {
-    lastResult = false;
-    return false; // Need at least 3 points
-  }
-  
-  int validPoints = gpsTrackBufferFull ? GPS_TRACK_BUFFER_SIZE : gpsTrackIndex;
-  if (validPoints < 3) {
-    lastResult = false;
-    return false;
-  }
-  
-  // Calculate total distance and bearing changes
-  float totalDistance = 0.0;
-  float totalBearingChange = 0.0;
-  float lastBearing = 0.0;
-  bool firstBearing = true;
-  int consecutivePoints = 0;
-  
-  for (int i = 1; i < validPoints; i++) {
-    int prevIdx = (gpsTrackIndex - validPoints + i - 1 + GPS_TRACK_BUFFER_SIZE) % GPS_TRACK_BUFFER_SIZE;
-    int currIdx = (gpsTrackIndex - validPoints + i + GPS_TRACK_BUFFER_SIZE) % GPS_TRACK_BUFFER_SIZE;
-    
-    if (!gpsTrackBuffer[prevIdx].valid || !gpsTrackBuffer[currIdx].valid) continue;
-    
-    float distance = calculateDistance(
-      gpsTrackBuffer[prevIdx].lat, gpsTrackBuffer[prevIdx].lon,
-      gpsTrackBuffer[currIdx].lat, gpsTrackBuffer[currIdx].lon
-    );
-    
-    totalDistance += distance;
-    consecutivePoints++;
-    
-    if (distance > 2.0) { // Only calculate bearing for significant movement
-      float bearing = calculateBearing(
-        gpsTrackBuffer[prevIdx].lat, gpsTrackBuffer[prevIdx].lon,
-        gpsTrackBuffer[currIdx].lat, gpsTrackBuffer[currIdx].lon
-      );
-      
-      if (!firstBearing) {
-        float bearingDiff = fabs(bearing - lastBearing);
-        if (bearingDiff > 180) bearingDiff = 360 - bearingDiff;
-        totalBearingChange += bearingDiff;
-      }
-      
-      lastBearing = bearing;
-      firstBearing = false;
-    }
-  }
-  
-  if (consecutivePoints < 2) return false;
-  
-  // Calculate average distance per sample
-  float avgDistance = totalDistance / consecutivePoints;
-  
-  // If we're moving very little, check for GPS noise pattern
-  if (avgDistance < 3.0) { // Less than 3 meters per sample = likely stationary
-    return false;
-  }
-  
-  // If we're moving significantly, check for consistent track
-  if (avgDistance > 5.0) { // More than 5 meters per sample = likely real movement
-    // Check if bearing changes are reasonable (not jumping around randomly)
-    float avgBearingChange = totalBearingChange / max(1, consecutivePoints - 1);
-    
-    // Allow for reasonable course changes in sailing
-    if (avgBearingChange < 45.0) { // Less than 45° average change = consistent track
-      lastResult = true;
-      return true;
-    }
-  }
-  
-  lastResult = false;
-  return false;
-}
-
-// Enhanced GPS speed filtering with accelerometer data
-float filterGPSSpeed(float rawSpeed, int satellites, float hdop) {
-  // Basic GPS quality check - less strict than before
-  bool goodGPSQuality = (satellites >= 4 && hdop <= 3.0);
-  
-  // If GPS quality is very poor, don't trust readings
-  if (!goodGPSQuality) {
-    return lastValidSpeed * 0.95; // Gradually decay speed if no GPS
-  }
-  
-  // Store current GPS point in track buffer
-  GPSPoint currentPoint;
-  currentPoint.lat = gps.location.lat();
-  currentPoint.lon = gps.location.lng();
-  currentPoint.speed = rawSpeed;
-  currentPoint.timestamp = millis();
-  currentPoint.valid = gps.location.isValid();
-  
-  gpsTrackBuffer[gpsTrackIndex] = currentPoint;
-  gpsTrackIndex = (gpsTrackIndex + 1) % GPS_TRACK_BUFFER_SIZE;
-  
-  if (!gpsTrackBufferFull && gpsTrackIndex == 0) {
-    gpsTrackBufferFull = true;
-  }
-  
-  // Basic speed smoothing with smaller window
-  const int SPEED_SMOOTH_SIZE = 3;
-  float speedSum = 0.0;
-  int speedCount = 0;
-  
-  for (int i = 0; i < SPEED_SMOOTH_SIZE && i < (gpsTrackBufferFull ? GPS_TRACK_BUFFER_SIZE : gpsTrackIndex); i++) {
-    int idx = (gpsTrackIndex - 1 - i + GPS_TRACK_BUFFER_SIZE) % GPS_TRACK_BUFFER_SIZE;
-    if (gpsTrackBuffer[idx].valid) {
-      speedSum += gpsTrackBuffer[idx].speed;
-      speedCount++;
-    }
-  }
-  
-  float smoothedSpeed = speedCount > 0 ? speedSum / speedCount : rawSpeed;
-  
-  // Enhanced movement detection combining GPS track and accelerometer
-  bool gpsMovementDetected = isMovementConsistent();
-  bool accelMovementDetected = isAccelerometerMovementDetected();
-  
-  // Combined movement detection logic
-  bool realMovementDetected = false;
-  
-  if (imuAvailable) {
-    // When IMU is available, use both GPS and accelerometer
-    // Movement confirmed if EITHER sensor detects movement (OR logic for sensitivity)
-    // But both must agree for stationary state (AND logic for stability)
-    if (gpsMovementDetected || accelMovementDetected) {
-      realMovementDetected = true;
-    } else {
-      // Both sensors agree: no movement
-      realMovementDetected = false;
-    }
-  } else {
-    // Fall back to GPS-only detection when no IMU
-    realMovementDetected = gpsMovementDetected;
-  }
-  
-  // Adaptive noise threshold based on movement detection confidence
-  float noiseThreshold = 0.08; // Base threshold: 0.08 knots
-  
-  if (imuAvailable && accelMovementDetected && gpsMovementDetected) {
-    // Both sensors confirm movement - lower threshold for better sensitivity
-    noiseThreshold = 0.05; // More sensitive when movement is confirmed
-  } else if (imuAvailable && !accelMovementDetected && !gpsMovementDetected) {
-    // Both sensors confirm stationary - higher threshold to filter noise
-    noiseThreshold = 0.12; // Less sensitive when stationary is confirmed
-  }
-  
-  if (smoothedSpeed < noiseThreshold) {
-    if (realMovementDetected) {
-      // Movement detected by sensors, trust the GPS speed even if low
-      lastValidSpeed = smoothedSpeed;
-      return smoothedSpeed;
-    } else {
-      // No movement detected, likely stationary or GPS noise
-      lastValidSpeed = 0.0;
-      return 0.0;
-    }
-  }
-  
-  // For higher speeds, use lighter filtering with hysteresis
-  const float HYSTERESIS_FACTOR = 0.1; // 10% hysteresis
-  
-  if (lastValidSpeed < noiseThreshold) {
-    // Was stationary, need slightly higher speed to register movement
-    if (smoothedSpeed > (noiseThreshold + HYSTERESIS_FACTOR)) {
-      lastValidSpeed = smoothedSpeed;
-      return smoothedSpeed;
-    } else {
-      return 0.0;
-    }
-  } else {
-    // Was moving, use current speed with minimal filtering
-    lastValidSpeed = smoothedSpeed;
-    return smoothedSpeed;
-  }
-}
-
-// Read sensor data
-void readSensors() {
-  #ifdef DEBUG_BLE_DATA
-  unsigned long startTime = millis();
-  #endif
-  
-  // Read GPS data first
-  bool gpsDataValid = readGPS();
-  
-  #ifdef DEBUG_BLE_DATA
-  unsigned long gpsTime = millis();
-  #endif
-  
-  // Apply track-based GPS speed filtering
-  if (gpsDataValid && gps.speed.isValid()) {
-    static unsigned long lastGPSDebugTime = 0;
-    
-    float rawSpeed = gps.speed.knots();
-    int satellites = gps.satellites.isValid() ? gps.satellites.value() : 0;
-    float hdop = gps.hdop.isValid() ? gps.hdop.hdop() : 99.9;
-    
-    // Use enhanced GPS filtering with accelerometer data
-    currentData.speed = filterGPSSpeed(rawSpeed, satellites, hdop);
-    
-    #ifdef DEBUG_GPS
-    Serial.printf("[GPS Filter] Raw: %.2f, Filtered: %.2f, Sats: %d, HDOP: %.1f, GPS Track: %s, Accel: %s\n", 
-                  rawSpeed, currentData.speed, satellites, hdop,
-                  isMovementConsistent() ? "MOVING" : "STATIONARY",
-                  imuAvailable ? (isAccelerometerMovementDetected() ? "MOVING" : "STATIONARY") : "N/A");
-    #endif
-    
-    // Additional debug for enhanced movement detection (always show when speed > 0.3 knots raw)
-    if (rawSpeed > 0.3) {
-      Serial.printf("[Enhanced GPS] Raw: %.3f kt, Filtered: %.3f kt, GPS: %s, Accel: %s\n", 
-                    rawSpeed, currentData.speed, 
-                    isMovementConsistent() ? "MOVING" : "STATIONARY",
-                    imuAvailable ? (isAccelerometerMovementDetected() ? "MOVING" : "STATIONARY") : "N/A");
-    }
-  } else {
-    currentData.speed = 0.0;
-  }
-
-  #ifdef DEBUG_BLE_DATA
-  unsigned long filterTime = millis();
-  #endif
-
-  // Read wind sensor using ModbusMaster
-  float sensorWindSpeed;
-  int sensorWindAngle;
-  if (readWindSensor(sensorWindSpeed, sensorWindAngle)) {
-    // Speed is already in m/s from the sensor, convert to knots (1 m/s = 1.944 knots)
-    currentData.windSpeed = sensorWindSpeed * 1.944;
-    
-    // Store wind angle directly (0-360°)
-    currentData.windAngle = sensorWindAngle;
-    
-    #ifdef DEBUG_WIND_SENSOR
-    Serial.printf("Wind: %.1f kt @ %d°\\n", currentData.windSpeed, currentData.windAngle);
-    #endif
-  } else {
-    currentData.windSpeed = NAN;
-    currentData.windAngle = -999; // Use clearly invalid value (not -1 which could be valid)
-    // Only show error once every 10 seconds to avoid spam
-    static unsigned long lastErrorTime = 0;
-    if (millis() - lastErrorTime > 10000) {
-      Serial.println("Wind sensor read failed");
-      lastErrorTime = millis();
-    }
-  }
-  
-  #ifdef DEBUG_BLE_DATA
-  unsigned long windTime = millis();
-  #endif
-  
-  // Enhanced GPS debug output (only when needed)
-  #ifdef DEBUG_GPS
-  Serial.print("[GPS Debug] TinyGPS++ chars processed: ");
-  Serial.print(gps.charsProcessed());
-  Serial.print(", Sentences with fix: ");
-  Serial.print(gps.sentencesWithFix());
-  Serial.print(", Satellites: ");
-  Serial.print(gps.satellites.value());
-  Serial.print(", HDOP: ");
-  Serial.print(gps.hdop.value());
-  Serial.print(", Age: ");
-  Serial.print(gps.location.age());
-  Serial.print(" ms");
-  if (gps.location.isValid() && gps.speed.isValid() && gps.satellites.value() >= 5) {
-    Serial.print(" | GPS FIX: Lat: ");
-    Serial.print(gps.location.lat(), 6);
-    Serial.print(", Lng: ");
-    Serial.print(gps.location.lng(), 6);
-    Serial.print(", Speed: ");
-    Serial.print(gps.speed.knots(), 2);
-    Serial.println(" knots");
-  } else {
-    Serial.println(" | No valid GPS fix or insufficient satellites");
-  }
-  #endif
-  // Optionally, print raw NMEA sentences for troubleshooting
-  // while (gpsSerial.available() > 0) {
-  //   char c = gpsSerial.read();
-  //   Serial.write(c);
-  // }
-  
-  // Calculate true wind: if speed is very low, set true wind = apparent wind
-  const float SPEED_THRESHOLD = 0.5; // knots
-  if (!isnan(currentData.windSpeed) && currentData.windAngle >= 0 && currentData.windAngle <= 359) {
-    if (!isnan(currentData.speed) && currentData.speed >= SPEED_THRESHOLD) {
-      // We have valid speed and wind data - calculate true wind
-      calculateTrueWind(currentData.speed, currentData.windAngle, currentData.windSpeed,
-                        currentData.trueWindSpeed, currentData.trueWindAngle);
-    } else {
-      // Boat is stationary or moving very slowly: true wind = apparent wind
-      currentData.trueWindSpeed = currentData.windSpeed;
-      currentData.trueWindAngle = currentData.windAngle;
-    }
-  } else {
-    currentData.trueWindSpeed = NAN;
-    currentData.trueWindAngle = -999;
-  }
-  
-  // Read tilt from BNO080 (only if available)
-  if (imuAvailable) {
-    static unsigned long lastIMURead = 0;
-    const unsigned long IMU_READ_INTERVAL = 50; // Read IMU every 50ms (20Hz for good responsiveness)
-    
-    if (millis() - lastIMURead >= IMU_READ_INTERVAL) {
-      lastIMURead = millis();
-      
-      if (imu.dataAvailable()) {
-        // Get quaternion data for precise orientation
-        float i = imu.getQuatI();
-        float j = imu.getQuatJ();
-        float k = imu.getQuatK();
-        float real = imu.getQuatReal();
-        
-        // Convert quaternion to roll angle (heel angle)
-        // Roll is rotation around X-axis (fore-aft axis of boat)
-        float roll = atan2(2.0f * (real * i + j * k), 1.0f - 2.0f * (i * i + j * j)) * 180.0f / PI;
-        
-        // Apply calibration offset
-        float zeroedTilt = roll - heelAngleDelta;
-        currentData.tilt = zeroedTilt;
-        
-        #ifdef DEBUG_BNO080
-        Serial.printf("[BNO080] Raw Roll: %.2f°, Calibrated Heel: %.2f°\n", roll, zeroedTilt);
-        #endif
-        
-        // Improved compass calculation with lighter filtering
-        static float lastRawHeading = 0;
-        static unsigned long lastCompassUpdate = 0;
-        static bool compassInitialized = false;
-        
-        // Update compass every 100ms for better responsiveness (10Hz)
-        if (millis() - lastCompassUpdate >= 100) {
-          lastCompassUpdate = millis();
-          
-          // Get fresh magnetometer readings
-          float magX = imu.getMagX();
-          float magY = imu.getMagY();
-          float magZ = imu.getMagZ();
-          
-          // Validate magnetometer readings
-          float magMagnitude = sqrt(magX * magX + magY * magY + magZ * magZ);
-          
-          #ifdef DEBUG_BNO080
-          Serial.printf("[BNO080] Mag: X=%.2f Y=%.2f Z=%.2f (magnitude=%.2f)\n", 
-                        magX, magY, magZ, magMagnitude);
-          #endif
-          
-          // Only proceed if we have reasonable magnetometer readings
-          if (magMagnitude > 0.1 && magMagnitude < 200.0) { // Reasonable range for BNO080
-            
-            // Calculate raw heading from magnetometer with light tilt compensation
-            // Get pitch and roll for tilt compensation
-            float pitch = atan2(2.0f * (real * j - k * i), 1.0f - 2.0f * (j * j + i * i)) * 180.0f / PI;
-            float pitchRad = pitch * PI / 180.0f;
-            float rollRad = roll * PI / 180.0f;
-            
-            // Simple tilt compensation (only apply if tilt is significant)
-            float magXComp = magX;
-            float magYComp = magY;
-            
-            if (abs(pitch) > 5 || abs(roll) > 5) { // Only compensate for significant tilt
-              magXComp = magX * cos(pitchRad) + magZ * sin(pitchRad);
-              magYComp = magX * sin(rollRad) * sin(pitchRad) + magY * cos(rollRad) - magZ * sin(rollRad) * cos(pitchRad);
-            }
-            
-            // Calculate RAW heading (before calibration)
-            float rawHeading = atan2(magYComp, magXComp) * 180.0f / PI;
-            if (rawHeading < 0) rawHeading += 360.0f; // Normalize to 0-360
-            
-            // Apply smoothing to RAW heading first (before calibration)
-            if (!compassInitialized) {
-              lastRawHeading = rawHeading;
-              compassInitialized = true;
-              
-              #ifdef DEBUG_BNO080
-              Serial.printf("[BNO080] Compass initialized with raw heading %.1f°\n", rawHeading);
-              #endif
-            } else {
-              // Simple exponential smoothing on RAW heading with high responsiveness
-              float alpha = 0.8; // Very high responsiveness (80% new value, 20% old)
-              
-              // Handle compass wrap-around for smoothing (359° to 1° transition)
-              float headingDiff = rawHeading - lastRawHeading;
-              float adjustedRawHeading = rawHeading;
-              
-              if (headingDiff > 180) {
-                adjustedRawHeading = rawHeading - 360;
-              } else if (headingDiff < -180) {
-                adjustedRawHeading = rawHeading + 360;
-              }
-              
-              // Apply exponential smoothing to raw heading
-              float smoothedRawHeading = alpha * adjustedRawHeading + (1 - alpha) * lastRawHeading;
-              
-              // Normalize back to 0-360 range
-              while (smoothedRawHeading < 0) smoothedRawHeading += 360;
-              while (smoothedRawHeading >= 360) smoothedRawHeading -= 360;
-              
-              // Store the smoothed raw heading
-              lastRawHeading = smoothedRawHeading;
-            }
-            
-            // Now apply compass calibration to the smoothed raw heading
-            float calibratedHeading = lastRawHeading - compassOffsetDelta;
-            if (calibratedHeading < 0) calibratedHeading += 360.0f;
-            if (calibratedHeading >= 360) calibratedHeading -= 360.0f;
-            
-            // Update compass reading
-            currentData.HDM = (int)round(calibratedHeading);
-            
-            #ifdef DEBUG_BNO080
-            Serial.printf("[BNO080] Compass: Raw=%.1f° Smoothed=%.1f° Offset=%.1f° Final=%d°\n", 
-                          rawHeading, lastRawHeading, compassOffsetDelta, currentData.HDM);
-            #endif
-          } else {
-            #ifdef DEBUG_BNO080
-            Serial.printf("[BNO080] Invalid magnetometer reading (magnitude=%.2f)\n", magMagnitude);
-            #endif
-          }
-        }
-        
-        // Read accelerometer data
-        currentData.accelX = imu.getAccelX();
-        currentData.accelY = imu.getAccelY();
-        currentData.accelZ = imu.getAccelZ();
-        
-        // Store accelerometer data for movement analysis
-        storeAccelReading(currentData.accelX, currentData.accelY, currentData.accelZ);
-        
-        #ifdef DEBUG_BNO080
-        static unsigned long lastAccelDebug = 0;
-        if (millis() - lastAccelDebug > 2000) { // Debug every 2 seconds
-          Serial.printf("[BNO080] Accel: X=%.2f Y=%.2f Z=%.2f m/s²\n", 
-                        currentData.accelX, currentData.accelY, currentData.accelZ);
-          lastAccelDebug = millis();
-        }
-        #endif
-        
-      } else {
-        // No new data available
-        static unsigned long lastNoDataWarning = 0;
-        if (millis() - lastNoDataWarning > 30000) { // Warn every 30 seconds
-          Serial.println("[BNO080] Warning: No new data available");
-          lastNoDataWarning = millis();
-        }
-      }
-    }
-  } else {
-    // IMU not available - set all values to 0/NaN
-    currentData.tilt = 0.0;
-    currentData.HDM = -1; // Use -1 to indicate invalid heading
-    currentData.accelX = NAN;
-    currentData.accelY = NAN;
-    currentData.accelZ = NAN;
-  }
-  
-  #ifdef DEBUG_BLE_DATA
-  unsigned long endTime = millis();
-  static unsigned long lastTimingReport = 0;
-  if (millis() - lastTimingReport > 5000) { // Report timing every 5 seconds
-    Serial.printf("[Timing] Total: %lums, GPS: %lums, Filter: %lums, Wind: %lums, IMU: %lums\n",
-                  endTime - startTime,
-                  gpsTime - startTime,
-                  filterTime - gpsTime, 
-                  windTime - filterTime,
-                  endTime - windTime);
-    lastTimingReport = millis();
-  }
-  #endif
+// A GeoPoint coordinate in units of `step` x 1e-7 degrees, rounded half away from zero
+int32_t roundedE7(int32_t value, int32_t step) {
+  return (value + (value >= 0 ? step / 2 : -step / 2)) / step;
 }
 
 // Generate JSON string with current sensor data using marine standard terminology
 String getSensorDataJson() {
-  DynamicJsonDocument doc(400); // Larger size to accommodate all fields including acceleration and device name
+  DynamicJsonDocument doc(768); // Larger size to accommodate all fields including acceleration, polar targets and device name
+  
+  // Publish sequence and sensor time of this snapshot, to detect and back-fill gaps
+  doc["seq"] = (uint32_t)latestFrame.value[TF_SEQ];
+  doc["t"] = currentData.sampleTime;
   
   // Core sailing data (rounded to reduce JSON size)
   doc["SOG"] = round((isnan(currentData.speed) ? 0.0 : currentData.speed) * 10) / 10.0; // Speed Over Ground
   
-  // GPS coordinates (reduced precision for BLE efficiency)
-  if (gps.location.isValid()) {
-    doc["lat"] = round(gps.location.lat() * 100000) / 100000.0; // 5 decimal places
-    doc["lon"] = round(gps.location.lng() * 100000) / 100000.0; // 5 decimal places
+  // GPS coordinates (reduced precision for BLE efficiency), rounded in 1e-7 degrees
+  const NmeaFix &fix = gps.fix();
+  if (fix.has(NMEA_POSITION)) {
+    doc["lat"] = roundedE7(fix.position.lat, 100) / 100000.0; // 5 decimal places
+    doc["lon"] = roundedE7(fix.position.lon, 100) / 100000.0; // 5 decimal places
   } else {
     doc["lat"] = 0.0;
     doc["lon"] = 0.0;
   }
   
-  if (gps.course.isValid()) {
-    doc["COG"] = round(gps.course.deg()); // Course Over Ground (integer)
+  if (fix.has(NMEA_COURSE)) {
+    doc["COG"] = (fix.course + 50) / 100; // Course Over Ground (integer)
   } else {
     doc["COG"] = 0;
   }
   
   // GPS quality indicators
-  doc["satellites"] = (gps.charsProcessed() > 10 && gps.satellites.isValid()) ? gps.satellites.value() : 0;
+  doc["satellites"] = (gps.charsProcessed() > 10 && fix.has(NMEA_SATELLITES)) ? fix.satellites : 0;
   
-  if (gps.hdop.isValid()) {
-    doc["hdop"] = round(gps.hdop.hdop() * 10) / 10.0; // 1 decimal place
+  if (fix.has(NMEA_HDOP)) {
+    doc["hdop"] = (fix.hdop + 5) / 10 / 10.0; // 1 decimal place
   } else {
     doc["hdop"] = 99.9; // Invalid HDOP value
   }
@@ -2134,8 +3472,13 @@ String getSensorDataJson() {
   }
   
   // True wind angle data 
-  if (currentData.trueWindAngle >= 0 && currentData.trueWindAngle <= 359) {
-    doc["TWA"] = round(currentData.trueWindAngle); // True Wind Angle (integer, 0-359°)
+  if (!isnan(currentData.trueWindAngle)) {
+    doc["TWA"] = (int)lround(currentData.trueWindAngle) % 360; // True Wind Angle (integer, 0-359°)
+  }
+  
+  // True wind direction - needs a compass or COG
+  if (!isnan(currentData.trueWindDirection)) {
+    doc["TWD"] = (int)lround(currentData.trueWindDirection) % 360; // True Wind Direction (integer, 0-359°)
   }
   
   // Heel angle - only include if IMU is available
@@ -2143,6 +3486,17 @@ String getSensorDataJson() {
     doc["heel"] = round(currentData.tilt * 10) / 10.0; // Vessel heel angle (1 decimal)
   }
   
+  // Pitch and the heel extremes over the peak window (from every IMU report)
+  const Orientation &orientation = sensorPipeline.imuOrientation();
+  if (imuAvailable && orientation.valid()) {
+    doc["pitch"] = round(orientation.attitude().pitch * 10) / 10.0; // + = bow up (1 decimal)
+    float heelMax = orientation.heelMax(millis());
+    if (!isnan(heelMax)) {
+      doc["heelMax"] = round(heelMax * 10) / 10.0;
+      doc["heelMin"] = round(orientation.heelMin(millis()) * 10) / 10.0;
+    }
+  }
+  
   // Magnetic heading - only include if IMU is available and has valid data
   if (imuAvailable && currentData.HDM >= 0 && currentData.HDM <= 359) {
     doc["HDM"] = round(currentData.HDM); // Magnetic heading in degrees (integer)
@@ -2155,294 +3509,247 @@ String getSensorDataJson() {
     doc["accelZ"] = round(currentData.accelZ * 100) / 100.0; // Acceleration Z-axis in m/s² (2 decimals)
   }
   
+  // Polar performance - VMG needs true wind, the targets also need a polar
+  if (polarValid) {
+    doc["VMG"] = round(polarPerformance.vmg * 100) / 100.0; // Velocity made good (+ upwind, - downwind)
+    if (polarTable.isLoaded()) {
+      doc["targetSOG"] = round(polarPerformance.targetSpeed * 10) / 10.0; // Polar speed at this TWS/TWA
+      if (!isnan(polarPerformance.percent)) {
+        doc["polarPct"] = round(polarPerformance.percent); // SOG as a percentage of targetSOG
+      }
+      doc["targetVMG"] = round(polarPerformance.targetVmg * 100) / 100.0; // Best VMG on this side of 90°
+      doc["upwindTWA"] = round(polarPerformance.upwind.twa); // Best upwind angle at this TWS
+      doc["downwindTWA"] = round(polarPerformance.downwind.twa); // Best downwind angle at this TWS
+    }
+  }
+  
   // BLE connection quality (smoothed RSSI for stable readings)
   doc["rssi"] = bleRSSIFiltered;
   
+  // Power state (0 = active, 1 = moored) and loop duty cycle in percent
+  doc["pwr"] = (int)powerScheduler.mode();
+  doc["duty"] = (int)round(powerScheduler.dutyCycle() * 100.0f);
+  
   // Device identification (proper device name)
-  // Regatta data - only include if start line is configured
-  if (regattaData.hasStartLine) {
-    doc["regatta"] = true;
-    
-    if (regattaData.distanceToLine >= 0) {
-      doc["distanceToLine"] = round(regattaData.distanceToLine * 10) / 10.0; // Distance in meters (1 decimal)
+  // Regatta data - line numbers only while a start line is configured
+  doc["regatta"] = startLine.isSet();
+  if (startState.valid) {
+    // Unsigned as the app expects (negative reads as invalid); the side separately
+    doc["distanceToLine"] = round(fabs(startState.distance) * 10) / 10.0; // Meters (1 decimal)
+    doc["lineSide"] = startState.distance < 0 ? -1 : 1;                   // -1 = pre-start side, 1 = over
+    if (!isnan(startState.timeToLine)) {
+      doc["timeToLine"] = round(startState.timeToLine); // Seconds at current SOG/COG
     }
-  } else {
-    doc["regatta"] = false;
+    if (!isnan(startState.timeToBurn)) {
+      doc["timeToBurn"] = round(startState.timeToBurn); // Seconds to spare before the start
+    }
+    if (!isnan(startState.bias)) {
+      doc["lineBias"] = round(startState.bias); // Degrees, + = committee boat end favoured
+    }
+  }
+  if (regattaData.timerRunning) {
+    doc["timeToStart"] = round(secondsToStart()); // Countdown in seconds, negative after the start
   }
   
-  String deviceName = preferences.getString("deviceName", "Veetr");
-  doc["deviceName"] = deviceName;
+  doc["deviceName"] = deviceNameCache;
   
   String output;
   serializeJson(doc, output);
   return output;
 }
 
-// Wind Sensor Functions
+// Regatta Functions
 
-// Convert two Modbus registers (32 bits) to float
-float regsToFloat(uint16_t lowReg, uint16_t highReg) {
-  uint32_t combined = ((uint32_t)highReg << 16) | lowReg;
-  float value;
-  memcpy(&value, &combined, sizeof(value));
-  return value;
+// Seconds until the start signal (negative after it), NAN without a countdown
+float secondsToStart() {
+  if (!regattaData.timerRunning) return NAN;
+  return (long)(regattaData.startAt - millis()) / 1000.0f;
 }
 
-// Read wind sensor data via RS485 using ModbusMaster
-bool readWindSensor(float &windSpeed, int &windAngle) {
-  static unsigned long lastAttempt = 0;
-  static bool sensorTypeDetected = false;
-  static bool useIEEE754Format = true; // true = IEEE754 float (9600,8E1), false = integer (4800,8N1)
-  
-  // Don't hammer the sensor - minimum 100ms between attempts
-  if (millis() - lastAttempt < 100) {
-    return false;
-  }
-  lastAttempt = millis();
-  
-  #ifdef DEBUG_WIND_SENSOR
-  Serial.print("[Wind Sensor] Reading ");
-  if (useIEEE754Format) {
-    Serial.print("IEEE754 format (9600,8E1,float)... ");
-  } else {
-    Serial.print("integer format (4800,8N1,int)... ");
-  }
-  unsigned long modbusStart = millis();
-  #endif
-  
-  // Clear any existing response data
-  windSensor.clearResponseBuffer();
-  
-  uint8_t result;
-  
-  if (useIEEE754Format) {
-    // IEEE754 ultrasonic sensor: Read registers 0x0001 for 4 registers (direction + speed float)
-    result = windSensor.readHoldingRegisters(0x0001, 4);
-  } else {
-    // Integer ultrasonic sensor: Read registers 0x0000 for 2 registers (speed int + direction)  
-    result = windSensor.readHoldingRegisters(0x0000, 2);
-  }
+// Start signal msToStart from now, on millis() and, once known, on UTC
+void setStartSignal(long msToStart) {
+  regattaData.timerRunning = true;
+  regattaData.startAt = millis() + msToStart;
+  uint64_t now = utcNowMs();
+  regattaData.startUtcMs = now ? now + msToStart : 0;
+  saveRaceState();
+}
 
-  #ifdef DEBUG_WIND_SENSOR
-  unsigned long modbusTime = millis() - modbusStart;
-  Serial.printf("(took %lums) ", modbusTime);
-  #endif
+// UTC from the system clock in ms since 1970, 0 while it is not set
+uint64_t utcNowMs() {
+  struct timeval now;
+  gettimeofday(&now, nullptr);
+  if (now.tv_sec < 1577836800) return 0;  // Before 2020: the clock restarted at 0 on power-up
+  return (uint64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+}
 
-  if (result == windSensor.ku8MBSuccess) {
-    
-    if (useIEEE754Format) {
-      // IEEE754 ultrasonic anemometer format:
-      // reg0 = direction (0–359°)
-      // reg1 = speed float low word
-      // reg2 = speed float high word  
-      // reg3 = unused
-      
-      windAngle = windSensor.getResponseBuffer(0); // direction
-      uint16_t speedLow = windSensor.getResponseBuffer(1);
-      uint16_t speedHigh = windSensor.getResponseBuffer(2);
-      
-      // Convert registers to IEEE 754 float
-      windSpeed = regsToFloat(speedLow, speedHigh);
-      
-      #ifdef DEBUG_WIND_SENSOR
-      Serial.printf("SUCCESS - IEEE754 format: Direction=%d°, Speed=%.3f m/s (raw: low=%d, high=%d)\n", 
-                    windAngle, windSpeed, speedLow, speedHigh);
-      #endif
-      
-      // Validate data - if it looks wrong, try integer format
-      if (!sensorTypeDetected && (windAngle < 0 || windAngle > 359 || 
-          isnan(windSpeed) || windSpeed < 0 || windSpeed > 50)) {
-        #ifdef DEBUG_WIND_SENSOR
-        Serial.println("  IEEE754 format data invalid, will try integer format next");
-        #endif
-        useIEEE754Format = false;
-        
-        // Reconfigure RS485 for integer sensor
-        rs485.end();
-        rs485.begin(4800, SERIAL_8N1, RS485_RX, RS485_TX);
-        windSensor.begin(1, rs485);
-        windSensor.preTransmission(preTransmission);
-        windSensor.postTransmission(postTransmission);
-        
-        return false; // Try again with integer format
-      }
-      
-    } else {
-      // Integer ultrasonic anemometer format:
-      // reg0 = speed (expanded by 100, e.g., 125 = 1.25 m/s)
-      // reg1 = direction (0-359°)
-      
-      uint16_t speedRaw = windSensor.getResponseBuffer(0);
-      windSpeed = speedRaw / 100.0f;
-      windAngle = windSensor.getResponseBuffer(1);
-      
-      #ifdef DEBUG_WIND_SENSOR
-      Serial.printf("SUCCESS - integer format: Speed raw=%d (%.2f m/s), Direction=%d°\n", 
-                    speedRaw, windSpeed, windAngle);
-      #endif
-      
-      // Validate data - if it looks wrong, try IEEE754 format
-      if (!sensorTypeDetected && (windAngle < 0 || windAngle > 359 || windSpeed < 0 || windSpeed > 50)) {
-        #ifdef DEBUG_WIND_SENSOR
-        Serial.println("  Integer format data invalid, will try IEEE754 format next");
-        #endif
-        useIEEE754Format = true;
-        
-        // Reconfigure RS485 for IEEE754 sensor
-        rs485.end(); 
-        rs485.begin(9600, SERIAL_8E1, RS485_RX, RS485_TX);
-        windSensor.begin(1, rs485);
-        windSensor.preTransmission(preTransmission);
-        windSensor.postTransmission(postTransmission);
-        
-        return false; // Try again with IEEE754 format
-      }
-    }
-    
-    // If we get here with valid data, lock in the sensor type
-    if (!sensorTypeDetected && windAngle >= 0 && windAngle <= 359 && 
-        windSpeed >= 0 && windSpeed <= 50 && !isnan(windSpeed)) {
-      sensorTypeDetected = true;
-      Serial.printf("\n[Wind Sensor] Detected %s format and locked it in\n", 
-                    useIEEE754Format ? "IEEE754 float" : "integer");
-    }
-    
-    return true;
-    
-  } else {
-    #ifdef DEBUG_WIND_SENSOR
-    Serial.printf("ERROR %d - ", result);
-    
-    // Decode common Modbus error codes
-    switch(result) {
-      case 0xE0: Serial.println("Invalid slave ID"); break;
-      case 0xE1: Serial.println("Invalid function"); break;
-      case 0xE2: Serial.println("Response timeout"); break;
-      case 0xE3: Serial.println("Invalid CRC"); break;
-      default:   
-        if (result == 226) {
-          Serial.println("Communication timeout/no response");
-        } else {
-          Serial.printf("Unknown error code\n");
-        }
-        break;
-    }
-    
-    // If we haven't detected sensor type yet, try the other format
-    if (!sensorTypeDetected) {
-      useIEEE754Format = !useIEEE754Format;
-      #ifdef DEBUG_WIND_SENSOR
-      Serial.printf("  Switching to %s format for next attempt\n", 
-                    useIEEE754Format ? "IEEE754 float" : "integer");
-      #endif
-      
-      // Reconfigure RS485 for the other sensor type
-      rs485.end();
-      if (useIEEE754Format) {
-        rs485.begin(9600, SERIAL_8E1, RS485_RX, RS485_TX);
-      } else {
-        rs485.begin(4800, SERIAL_8N1, RS485_RX, RS485_TX);
-      }
-      windSensor.begin(1, rs485);
-      windSensor.preTransmission(preTransmission);
-      windSensor.postTransmission(postTransmission);
+// Keep the system clock on GPS time, and put a countdown that was started
+// (or restored) without a clock onto UTC once there is one
+void updateRaceClock() {
+  uint32_t utc = gpsEpochSeconds();
+  if (utc == 0) return;
+  uint64_t gpsMs = (uint64_t)utc * 1000 + gps.fix().centisecond * 10 + (uint32_t)(millis() - gps.fix().timeAt);
+  uint64_t clockMs = utcNowMs();
+  if (clockMs == 0 || (clockMs > gpsMs ? clockMs - gpsMs : gpsMs - clockMs) > RACE_CLOCK_MAX_ERROR_MS) {
+    struct timeval now = {(time_t)(gpsMs / 1000), (suseconds_t)(gpsMs % 1000 * 1000)};
+    settimeofday(&now, nullptr);
+    LOGI("Regatta", "System clock set from GPS: %lu", (unsigned long)utc);
+    clockMs = gpsMs;
+  }
+  
+  if (regattaData.timerRunning && regattaData.startUtcMs == 0) {
+    regattaData.startUtcMs = clockMs + (long)(regattaData.startAt - millis());
+    saveRaceState();
+  } else if (!regattaData.timerRunning && regattaData.startUtcMs != 0) {
+    if (clockMs > regattaData.startUtcMs + RACE_START_MAX_AGE_MS) {
+      LOGI("Regatta", "Restored countdown has expired, dropping it");
+      regattaData.startUtcMs = 0;
+      saveRaceState();
+      return;
     }
-    #endif
-    
-    return false;
+    regattaData.timerRunning = true;
+    regattaData.startAt = millis() + (long)(regattaData.startUtcMs - clockMs);
+    LOGI("Regatta", "Countdown resumed on GPS time, %.0f s to the start", secondsToStart());
   }
 }
 
-// GPS Functions
-
-// Check if GPS has valid, recent data
-bool isGPSDataValid() {
-  // Require multiple conditions for valid GPS:
-  // 1. Must have processed characters (indicating actual serial data)
-  // 2. Must have valid sentences with fix data
-  // 3. Location must be valid
-  // 4. Data must be recent (less than 5 seconds old)
-  // 5. Must have reasonable satellite count (not just noise)
-  return gps.charsProcessed() > 10 &&        // Must have processed actual data
-         gps.sentencesWithFix() > 0 &&       // Must have valid NMEA sentences
-         gps.location.isValid() && 
-         gps.location.age() < 5000 && 
-         gps.satellites.isValid() &&
-         gps.satellites.value() >= 3;         // Minimum for any fix
+// Write the line ends and countdown to NVS; called on every change
+void saveRaceState() {
+  RaceStateRecord record = {};
+  record.version = RACE_STATE_VERSION;
+  if (regattaData.hasPin) {
+    record.flags |= RACE_HAS_PIN;
+    record.pin = regattaData.pin;
+  }
+  if (regattaData.hasBoat) {
+    record.flags |= RACE_HAS_BOAT;
+    record.boat = regattaData.boat;
+  }
+  if (regattaData.startUtcMs != 0) {
+    record.flags |= RACE_HAS_START;
+    record.startUtcMs = regattaData.startUtcMs;
+  }
+  if (record.flags == 0) {
+    preferences.remove("race");
+  } else {
+    preferences.putBytes("race", &record, sizeof(record));
+  }
 }
 
-// Read GPS data
-bool readGPS() {
-  bool newData = false;
-  int bytesRead = 0;
+// Restore the line ends and countdown at boot, before the first GPS fix
+void loadRaceState() {
+  RaceStateRecord record = {};
+  size_t length = preferences.getBytesLength("race");
+  if (length == 0) return;
+  if (length != sizeof(record) || preferences.getBytes("race", &record, sizeof(record)) != sizeof(record) ||
+      record.version != RACE_STATE_VERSION) {
+    LOGW("Boot", "Stored race state is invalid (%u bytes), ignoring it", (unsigned)length);
+    return;
+  }
   
-  // Read available GPS data (but limit to prevent infinite loops)
-  while (gpsSerial.available() > 0 && bytesRead < 256) {
-    if (gps.encode(gpsSerial.read())) {
-      newData = true;
-    }
-    bytesRead++;
+  if (record.flags & RACE_HAS_PIN) {
+    regattaData.hasPin = true;
+    regattaData.pin = record.pin;
+  }
+  if (record.flags & RACE_HAS_BOAT) {
+    regattaData.hasBoat = true;
+    regattaData.boat = record.boat;
+  }
+  if (regattaData.hasPin && regattaData.hasBoat &&
+      startLine.setLine(regattaData.pin, regattaData.boat)) {
+    LOGI("Boot", "Restored start line: %.0f m, bearing %.0f", startLine.length(), startLine.bearing());
+  } else if (regattaData.hasPin || regattaData.hasBoat) {
+    LOGI("Boot", "Restored start line end(s): pin %d, committee boat %d", regattaData.hasPin, regattaData.hasBoat);
   }
   
-  // Return true only if we have valid, recent location data
-  return newData && isGPSDataValid();
+  if (record.flags & RACE_HAS_START) {
+    uint64_t now = utcNowMs();
+    if (now != 0 && now > record.startUtcMs + RACE_START_MAX_AGE_MS) {
+      LOGI("Boot", "Stored countdown has expired, dropping it");
+      saveRaceState();
+    } else {
+      // Without a clock the countdown waits for GPS time (updateRaceClock())
+      regattaData.startUtcMs = record.startUtcMs;
+      if (now != 0) {
+        regattaData.timerRunning = true;
+        regattaData.startAt = millis() + (long)(record.startUtcMs - now);
+        LOGI("Boot", "Restored countdown: %.0f s to the start", secondsToStart());
+      } else {
+        LOGI("Boot", "Restored countdown, waiting for GPS time");
+      }
+    }
+  }
 }
 
-// Regatta Functions
-
-// Calculate distance between two GPS coordinates using Haversine formula
-float haversineDistance(double lat1, double lon1, double lat2, double lon2) {
-  const double R = 6371000; // Earth radius in meters
-  
-  double dLat = (lat2 - lat1) * PI / 180.0;
-  double dLon = (lon2 - lon1) * PI / 180.0;
-  
-  double a = sin(dLat/2) * sin(dLat/2) + 
-             cos(lat1 * PI / 180.0) * cos(lat2 * PI / 180.0) * 
-             sin(dLon/2) * sin(dLon/2);
-  
-  double c = 2 * atan2(sqrt(a), sqrt(1-a));
+// Set one end of the start line and rebuild the line once both are known;
+// false when the two ends are too close to form a line (the end is still kept)
+bool pingLineEnd(StartLineEnd end, const GeoPoint &position) {
+  if (end == START_LINE_PIN) {
+    regattaData.pin = position;
+    regattaData.hasPin = true;
+  } else {
+    regattaData.boat = position;
+    regattaData.hasBoat = true;
+  }
+  LOGI("Regatta", "%s end set: %ld, %ld (1e-7 deg)", end == START_LINE_PIN ? "Pin" : "Committee boat",
+       (long)position.lat, (long)position.lon);
+  saveRaceState();
   
-  return R * c; // Distance in meters
+  startLine.clear();
+  startState.valid = false;
+  if (!regattaData.hasPin || !regattaData.hasBoat) return true;
+  if (!startLine.setLine(regattaData.pin, regattaData.boat)) {
+    return false;
+  }
+  LOGI("Regatta", "Start line %.0f m, bearing %.0f", startLine.length(), startLine.bearing());
+  calculateRegattaData();
+  return true;
 }
 
-// Calculate perpendicular distance from point to line segment
-float distanceToLine(double px, double py, double x1, double y1, double x2, double y2) {
-  // Convert GPS coordinates to meters using simple projection for short distances
-  // This is accurate enough for regatta start lines (typically < 1km)
-  double dx = x2 - x1;
-  double dy = y2 - y1;
-  
-  if (dx == 0 && dy == 0) {
-    // Line endpoints are the same, return distance to point
-    return haversineDistance(px, py, x1, y1);
-  }
-  
-  // Calculate the t parameter for the closest point on the line
-  double t = ((px - x1) * dx + (py - y1) * dy) / (dx * dx + dy * dy);
-  
-  // Clamp t to [0,1] to stay within the line segment
-  t = max(0.0, min(1.0, t));
-  
-  // Calculate the closest point on the line segment
-  double closestX = x1 + t * dx;
-  double closestY = y1 + t * dy;
-  
-  // Return distance to closest point
-  return haversineDistance(px, py, closestX, closestY);
+// Start line state; every line and countdown command answers with this, plus "error" when it failed
+void sendStartLineInfo(const char* error) {
+  DynamicJsonDocument response(384);
+  response["type"] = "start_line";
+  response["pin"] = regattaData.hasPin;
+  response["boat"] = regattaData.hasBoat;
+  if (regattaData.hasPin) {
+    response["pinLat"] = regattaData.pin.lat / 1e7;
+    response["pinLon"] = regattaData.pin.lon / 1e7;
+  }
+  if (regattaData.hasBoat) {
+    response["boatLat"] = regattaData.boat.lat / 1e7;
+    response["boatLon"] = regattaData.boat.lon / 1e7;
+  }
+  response["line"] = startLine.isSet();
+  if (startLine.isSet()) {
+    response["length"] = round(startLine.length() * 10) / 10.0;
+    response["bearing"] = round(startLine.bearing());
+  }
+  if (regattaData.timerRunning) {
+    response["timeToStart"] = round(secondsToStart() * 10) / 10.0;
+  }
+  if (error) {
+    response["error"] = error;
+    LOGW("Regatta", "%s", error);
+  }
+  String responseStr;
+  serializeJson(response, responseStr);
+  safeBLESend(responseStr, true);
 }
 
-// Calculate current distance to regatta start line
+// Start line numbers for the newest fix. Runs on every GPS fix while a line
+// is set (see loop()), so time to burn follows the receiver's rate rather
+// than the refresh tick
 void calculateRegattaData() {
-  if (!regattaData.hasStartLine || !gps.location.isValid()) {
-    regattaData.distanceToLine = -1.0; // Invalid
+  const NmeaFix &fix = gps.fix();
+  startStateFixAt = fix.positionAt;
+  if (!startLine.isSet() || !fix.has(NMEA_POSITION)) {
+    startState.valid = false;
     return;
   }
-  
-  double currentLat = gps.location.lat();
-  double currentLon = gps.location.lng();
-  
-  regattaData.distanceToLine = distanceToLine(currentLat, currentLon,
-                                             regattaData.portLat, regattaData.portLon,
-                                             regattaData.starboardLat, regattaData.starboardLon);
-}
\ No newline at end of file
+  PROFILE_SCOPE(PROF_FUSION);
+  float sog = fix.has(NMEA_SPEED) ? fix.knots() : NAN;
+  float cog = fix.has(NMEA_COURSE) ? fix.courseDegrees() : NAN;
+  startLine.update(fix.position, sog, cog,
+                   currentData.trueWindDirection, secondsToStart(), startState);
+}
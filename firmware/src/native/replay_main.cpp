@@ -0,0 +1,618 @@
+// Replay harness for the sensor pipeline (PlatformIO `native` environment).
+//
+// Feeds recorded sensor data through the same SensorPipeline code the
+// firmware runs, on a virtual clock, and writes one CSV row per refresh tick
+// so filter changes can be diffed against a known-good run:
+//
+//   pio run -e native
+//   .pio/build/native/program --nmea session.nmea --wind wind.csv --imu imu.csv --out ticks.csv
+//
+// firmware/test/replay has a short session and its expected ticks.csv, which
+// firmware/test/host_checks.sh diffs against on every pull request.
+//
+// Inputs (all optional, missing inputs behave like an absent sensor):
+//   --nmea FILE   GPS UART capture. Lines are either raw sentences, paced at
+//                 --baud, or "<ms><TAB or comma><sentence>" with the arrival time.
+//   --wind FILE   Modbus replies: t_ms,result,reg0,reg1,reg2,reg3 (result 0 = success).
+//   --imu FILE    BNO080 reports: t_ms,quatI,quatJ,quatK,quatReal,magX,magY,magZ,accelX,accelY,accelZ
+// Options:
+//   --out FILE          Per-tick CSV (default stdout)
+//   --rate MS           Refresh interval (default 1000, as the firmware)
+//   --baud N            GPS UART baud rate for untimed lines (default 9600)
+//   --uart-buffer N     GPS RX buffer size, overflow is dropped (default 256)
+//   --duration S        Stop after S seconds of replayed time
+//   --trace FILE        Write the last PROF_TRACE_EVENTS profiler scopes as a Chrome trace
+//   --verbose           Print pipeline log output to stderr (up to VEETR_LOG_LEVEL)
+//   --power             Run the loop under PowerScheduler: refreshes follow the
+//                       power mode, passes between them while active publish
+//                       changes from updateFast() as loop() does, and stderr
+//                       gets the simulated duty cycle
+//   --clients N         Connected BLE clients for --power (default 0)
+//   --polar FILE        Polar blob (as uploaded, see lib/PolarTable/examples/polar_tool):
+//                       adds vmg, target_sog and polar_pct columns and a summary
+//   --stress N          Instead of replaying, push N command-sized messages
+//                       through the SpscRing used between the NimBLE callbacks
+//                       and loop(), from a second thread, and check order and
+//                       contents. Build env native_tsan to run it under
+//                       ThreadSanitizer.
+
+#include <ChangePublisher.h>
+#include <Hal.h>
+#include <Logger.h>
+#include <PolarTable.h>
+#include <PowerScheduler.h>
+#include <Profiler.h>
+#include <SensorPipeline.h>
+#include <SpscRing.h>
+#include <TelemetryCodec.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static bool verbose = false;
+
+// Duty cycle model for --power (ESP32 only, sensors excluded)
+#define POWER_SIM_REFRESH_AWAKE_MS 30   // Modbus round trip at 9600 baud, IMU read, JSON and notify
+#define POWER_SIM_WIND_AWAKE_MS 25      // Wind sensor read between refreshes (Modbus round trip)
+#define POWER_SIM_POLL_AWAKE_MS 1       // Button check, GPS UART drain and IMU report
+#define POWER_SIM_AWAKE_MA 50.0         // 240 MHz with the BLE controller on
+#define POWER_SIM_IDLE_MA 20.0          // Waiting at 80 MHz without light sleep (active)
+#define POWER_SIM_SLEEP_MA 2.0          // Automatic light sleep with BLE modem sleep (moored)
+#define POWER_SIM_BATTERY_MAH 10000.0
+
+// Simulated time per power mode
+struct PowerModeTime {
+  uint64_t awakeMs = 0;
+  uint64_t waitMs = 0;
+  size_t passes = 0;
+};
+
+// Virtual time, advanced by the replay loop
+class VirtualClock : public hal::Clock {
+public:
+  uint32_t millis() override { return now; }
+  uint32_t micros() override { return now * 1000; }
+  uint32_t now = 0;
+};
+
+static VirtualClock virtualClock;
+
+// The Arduino clock, for TinyGPSPlus (kept in lib_deps as the reference of
+// lib/NmeaParser/examples/nmea_benchmark)
+unsigned long millis() { return virtualClock.millis(); }
+unsigned long micros() { return virtualClock.micros(); }
+
+static void stderrLogSink(const char* text, size_t length) {
+  fwrite(text, 1, length, stderr);
+}
+
+static bool readLines(const char* path, std::vector<std::string> &lines) {
+  FILE* file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "Cannot open %s\n", path);
+    return false;
+  }
+  char line[512];
+  while (fgets(line, sizeof(line), file)) {
+    size_t length = strcspn(line, "\r\n");
+    line[length] = 0;
+    if (length > 0 && line[0] != '#') lines.push_back(line);
+  }
+  fclose(file);
+  return true;
+}
+
+// GPS UART: bytes become available at their arrival time and are dropped
+// when the RX buffer is full, like the ESP32 UART driver
+class ReplayUart : public hal::Uart {
+public:
+  bool load(const char* path, uint32_t baud) {
+    std::vector<std::string> lines;
+    if (!readLines(path, lines)) return false;
+    double byteMs = 10000.0 / baud;  // 8N1 = 10 bits per byte
+    double t = 0;
+    for (const std::string &line : lines) {
+      const char* sentence = line.c_str();
+      if (isdigit((unsigned char)sentence[0])) {
+        char* end;
+        t = strtoul(sentence, &end, 10);
+        sentence = end;
+        while (*sentence == '\t' || *sentence == ',' || *sentence == ' ') sentence++;
+      }
+      std::string text = std::string(sentence) + "\r\n";
+      for (char c : text) {
+        t += byteMs;
+        stream.push_back((uint8_t)c);
+        arrival.push_back((uint32_t)t);
+      }
+    }
+    return true;
+  }
+
+  // Move every byte that has arrived by `now` into the RX buffer
+  void advance(uint32_t now) {
+    while (next < stream.size() && arrival[next] <= now) {
+      if (rx.size() < capacity) {
+        rx.push_back(stream[next]);
+      } else {
+        overflowBytes++;
+      }
+      next++;
+    }
+  }
+
+  int available() override { return (int)rx.size(); }
+  int read() override {
+    if (rx.empty()) return -1;
+    int c = rx.front();
+    rx.pop_front();
+    return c;
+  }
+  size_t write(const uint8_t* data, size_t length) override { return length; }
+
+  uint32_t endTime() const { return arrival.empty() ? 0 : arrival.back(); }
+
+  size_t capacity = 256;
+  size_t overflowBytes = 0;
+
+private:
+  std::vector<uint8_t> stream;
+  std::vector<uint32_t> arrival;
+  std::deque<uint8_t> rx;
+  size_t next = 0;
+};
+
+// Wind sensor: the newest recorded reply at or before the current time
+class ReplayModbus : public hal::Modbus {
+public:
+  bool load(const char* path) {
+    std::vector<std::string> lines;
+    if (!readLines(path, lines)) return false;
+    for (const std::string &line : lines) {
+      Reply reply = {};
+      int result = 0;
+      unsigned r[4] = {0};
+      if (sscanf(line.c_str(), "%u,%i,%u,%u,%u,%u", &reply.time, &result, &r[0], &r[1], &r[2], &r[3]) >= 2) {
+        reply.result = (uint8_t)result;
+        for (int i = 0; i < 4; i++) reply.registers[i] = (uint16_t)r[i];
+        replies.push_back(reply);
+      }
+    }
+    return true;
+  }
+
+  uint8_t readHoldingRegisters(uint16_t address, uint16_t count, uint16_t* registers) override {
+    requests++;
+    while (next + 1 < replies.size() && replies[next + 1].time <= virtualClock.now) next++;
+    if (replies.empty() || replies[next].time > virtualClock.now) return TIMEOUT;
+    const Reply &reply = replies[next];
+    if (reply.result != SUCCESS) return reply.result;
+    for (uint16_t i = 0; i < count && i < 4; i++) registers[i] = reply.registers[i];
+    return SUCCESS;
+  }
+
+  void configure(uint32_t baud, bool evenParity) override {
+    reconfigurations++;
+    LOGD("Replay", "RS485 reconfigured to %u %s", (unsigned)baud, evenParity ? "8E1" : "8N1");
+  }
+
+  uint32_t endTime() const { return replies.empty() ? 0 : replies.back().time; }
+
+  size_t requests = 0;
+  size_t reconfigurations = 0;
+
+private:
+  struct Reply {
+    uint32_t time;
+    uint8_t result;
+    uint16_t registers[4];
+  };
+  std::vector<Reply> replies;
+  size_t next = 0;
+};
+
+// IMU: each recorded report is delivered once, after its timestamp
+class ReplayImu : public hal::Imu {
+public:
+  bool load(const char* path) {
+    std::vector<std::string> lines;
+    if (!readLines(path, lines)) return false;
+    for (const std::string &line : lines) {
+      Report report;
+      hal::ImuSample &s = report.sample;
+      if (sscanf(line.c_str(), "%u,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f", &report.time, &s.quatI, &s.quatJ, &s.quatK,
+                 &s.quatReal, &s.magX, &s.magY, &s.magZ, &s.accelX, &s.accelY, &s.accelZ) == 11) {
+        reports.push_back(report);
+      }
+    }
+    loaded = true;
+    return true;
+  }
+
+  bool isAvailable() override { return loaded; }
+
+  bool read(hal::ImuSample &sample) override {
+    // The sensor only holds its latest report, older ones are overwritten
+    bool fresh = false;
+    while (next < reports.size() && reports[next].time <= virtualClock.now) {
+      sample = reports[next++].sample;
+      fresh = true;
+    }
+    return fresh;
+  }
+
+  uint32_t endTime() const { return reports.empty() ? 0 : reports.back().time; }
+
+private:
+  struct Report {
+    uint32_t time;
+    hal::ImuSample sample;
+  };
+  std::vector<Report> reports;
+  size_t next = 0;
+  bool loaded = false;
+};
+
+// Counts what the firmware would notify on the telemetry characteristic
+class CaptureLink : public hal::BleLink {
+public:
+  size_t connectedCount() override { return 1; }
+  bool notify(const uint8_t* data, size_t length) override {
+    frames++;
+    bytes += length;
+    return true;
+  }
+  size_t frames = 0;
+  size_t bytes = 0;
+};
+
+// Same shape as the firmware's BLE command channel (BleCommand, depth 8)
+#define STRESS_PAYLOAD_MAX 512
+#define STRESS_QUEUE_DEPTH 8
+struct StressMessage {
+  uint32_t seq;
+  uint16_t length;
+  char text[STRESS_PAYLOAD_MAX];
+};
+
+static void fillStressMessage(uint32_t seq, StressMessage &message) {
+  message.seq = seq;
+  message.length = seq % (STRESS_PAYLOAD_MAX + 1);
+  for (uint16_t i = 0; i < message.length; i++) message.text[i] = (char)(seq * 31 + i);
+}
+
+static bool checkStressMessage(const StressMessage &message) {
+  if (message.length != message.seq % (STRESS_PAYLOAD_MAX + 1)) return false;
+  for (uint16_t i = 0; i < message.length; i++) {
+    if (message.text[i] != (char)(message.seq * 31 + i)) return false;
+  }
+  return true;
+}
+
+// One producer thread, the main thread consumes. With dropWhenFull the
+// producer behaves like the BLE callback (a full ring loses the message),
+// otherwise it retries until every message got through in order.
+static bool stressRing(uint32_t count, bool dropWhenFull) {
+  std::unique_ptr<SpscRing<StressMessage, STRESS_QUEUE_DEPTH>> ring(new SpscRing<StressMessage, STRESS_QUEUE_DEPTH>());
+  std::atomic<bool> done{false};
+
+  std::thread producer([&] {
+    StressMessage message;
+    for (uint32_t seq = 0; seq < count; seq++) {
+      fillStressMessage(seq, message);
+      while (!ring->push(message) && !dropWhenFull) std::this_thread::yield();
+    }
+    done.store(true, std::memory_order_release);
+  });
+
+  uint32_t received = 0;
+  uint32_t errors = 0;
+  int64_t lastSeq = -1;
+  StressMessage message;
+  for (;;) {
+    // Read the flag first: once it is set, an empty ring means everything arrived
+    bool finished = done.load(std::memory_order_acquire);
+    if (ring->pop(message)) {
+      bool inOrder = dropWhenFull ? (int64_t)message.seq > lastSeq : (int64_t)message.seq == lastSeq + 1;
+      if (!inOrder || !checkStressMessage(message)) errors++;
+      lastSeq = message.seq;
+      received++;
+    } else if (finished) {
+      break;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+
+  uint32_t full = ring->dropped();
+  bool ok = errors == 0 && (dropWhenFull ? received + full == count : received == count);
+  fprintf(stderr, "stress %-9s %u messages, %u received, %u ring full, %u errors: %s\n",
+          dropWhenFull ? "(drop)" : "(retry)", count, received, full, errors, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+// Polar blob as uploaded with POLAR_BEGIN/POLAR_CHUNK/POLAR_END
+static bool loadPolar(const char* path, PolarTable &polar) {
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "Cannot open %s\n", path);
+    return false;
+  }
+  uint8_t blob[POLAR_MAX_BLOB_SIZE + 1];
+  size_t length = fread(blob, 1, sizeof(blob), file);
+  fclose(file);
+  if (!polar.load(blob, length)) {
+    fprintf(stderr, "%s is not a valid polar blob\n", path);
+    return false;
+  }
+  return true;
+}
+
+static void usage() {
+  fprintf(stderr, "Usage: program [--nmea FILE] [--wind FILE] [--imu FILE] [--out FILE] [--rate MS]\n"
+                  "               [--baud N] [--uart-buffer N] [--duration S] [--trace FILE] [--verbose]\n"
+                  "               [--power] [--clients N] [--polar FILE]\n"
+                  "       program --stress N\n");
+}
+
+int main(int argc, char** argv) {
+  const char* nmeaPath = nullptr;
+  const char* windPath = nullptr;
+  const char* imuPath = nullptr;
+  const char* outPath = nullptr;
+  const char* tracePath = nullptr;
+  uint32_t rate = 1000;
+  uint32_t baud = 9600;
+  size_t uartBuffer = 256;
+  uint32_t duration = 0;
+  bool power = false;
+  size_t clients = 0;
+  uint32_t stress = 0;
+  const char* polarPath = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    if (!strcmp(argv[i], "--nmea") && hasValue) nmeaPath = argv[++i];
+    else if (!strcmp(argv[i], "--wind") && hasValue) windPath = argv[++i];
+    else if (!strcmp(argv[i], "--imu") && hasValue) imuPath = argv[++i];
+    else if (!strcmp(argv[i], "--out") && hasValue) outPath = argv[++i];
+    else if (!strcmp(argv[i], "--rate") && hasValue) rate = strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--baud") && hasValue) baud = strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--uart-buffer") && hasValue) uartBuffer = strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--duration") && hasValue) duration = strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--trace") && hasValue) tracePath = argv[++i];
+    else if (!strcmp(argv[i], "--verbose")) verbose = true;
+    else if (!strcmp(argv[i], "--power")) power = true;
+    else if (!strcmp(argv[i], "--clients") && hasValue) clients = strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--stress") && hasValue) stress = strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--polar") && hasValue) polarPath = argv[++i];
+    else {
+      usage();
+      return 2;
+    }
+  }
+  if (rate == 0 || baud == 0) {
+    usage();
+    return 2;
+  }
+  if (stress) {
+    bool ok = stressRing(stress, false);
+    ok = stressRing(stress, true) && ok;
+    return ok ? 0 : 1;
+  }
+  logger.begin(verbose ? stderrLogSink : nullptr, false);
+
+  ReplayUart gpsUart;
+  ReplayModbus windBus;
+  ReplayImu imu;
+  gpsUart.capacity = uartBuffer;
+  if (nmeaPath && !gpsUart.load(nmeaPath, baud)) return 1;
+  if (windPath && !windBus.load(windPath)) return 1;
+  if (imuPath && !imu.load(imuPath)) return 1;
+
+  uint32_t endTime = duration ? duration * 1000 : std::max(gpsUart.endTime(), std::max(windBus.endTime(), imu.endTime()));
+  if (endTime == 0) {
+    fprintf(stderr, "Nothing to replay\n");
+    usage();
+    return 1;
+  }
+
+  static PolarTable polar;
+  if (polarPath && !loadPolar(polarPath, polar)) return 1;
+
+  FILE* out = outPath ? fopen(outPath, "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "Cannot write %s\n", outPath);
+    return 1;
+  }
+
+  NmeaParser gps;
+  SensorPipeline pipeline(virtualClock, gpsUart, gps, windBus, imu);
+  TelemetryEncoder encoder(30);
+  ChangePublisher publisher;  // Same publish decisions as the firmware
+  TelemetryHistory history;
+  size_t publishReasons[PUBLISH_FORCED + 1] = {};
+  CaptureLink link;
+  SensorData &data = pipeline.data;
+
+  fprintf(out, "t_ms,sog,aws,awa,tws,twa,twd,heel,hdm,accel_x,accel_y,accel_z,lat,lon,gps_valid%s\n",
+          polarPath ? ",vmg,target_sog,polar_pct" : "");
+  PolarPerformance performance = {};
+  bool polarValid = false;
+  size_t polarTicks = 0;
+  double polarPercentSum = 0;
+  size_t polarPercentTicks = 0;
+
+  // Host profiler counts nanoseconds
+  profiler.begin(1000);
+  
+  PowerScheduler scheduler;
+  PowerModeTime modeTime[2];
+  uint32_t nextRefresh = rate;
+
+  // The snapshot through the publisher and, when it goes out, the codec
+  auto publish = [&]() {
+    uint8_t encoded[TF_MAX_FRAME_SIZE];
+    size_t length = 0;
+    {
+      PROFILE_SCOPE(PROF_SERIALIZE);
+      TelemetryFrame frame;
+      buildTelemetryFrame(data, gps.fix(), imu.isAvailable(), 0, data.sampleTime, frame);
+      PublishReason reason = publisher.update(data.sampleTime, frame);
+      publishReasons[reason]++;
+      if (reason == PUBLISH_NONE) return false;
+      history.push(frame);
+      length = encoder.encode(frame, encoded);
+    }
+    PROFILE_SCOPE(PROF_BLE_NOTIFY);
+    link.notify(encoded, length);
+    return true;
+  };
+
+  size_t ticks = 0;
+  size_t fastPublished = 0;
+  auto wallStart = std::chrono::steady_clock::now();
+  for (uint32_t now = rate; now <= endTime + rate;) {
+    virtualClock.now = now;
+    gpsUart.advance(now);
+
+    // Without --power every pass is a refresh tick at the fixed rate
+    bool refresh = !power || (int32_t)(now - nextRefresh) >= 0;
+    size_t windRequests = windBus.requests;
+    if (!refresh) {
+      if (scheduler.mode() == POWER_MOORED) {
+        pipeline.pollGPS();
+      } else if (pipeline.updateFast() && publish()) {
+        fastPublished++;
+      }
+    } else {
+      {
+        PROFILE_SCOPE(PROF_REFRESH);
+        pipeline.readSensors();
+
+        if (polarPath) {
+          PROFILE_SCOPE(PROF_FUSION);
+          polarValid = !std::isnan(data.trueWindSpeed) && !std::isnan(data.trueWindAngle);
+          if (polarValid) polar.evaluate(data.trueWindSpeed, data.trueWindAngle, data.speed, performance);
+        }
+
+        publish();
+      }
+
+      fprintf(out, "%u,%.3f,%.3f,%d,%.3f,%.2f,%.2f,%.2f,%d,%.2f,%.2f,%.2f,%.7f,%.7f,%d", now, data.speed, data.windSpeed,
+              data.windAngle, data.trueWindSpeed, data.trueWindAngle, data.trueWindDirection, data.tilt, data.HDM, data.accelX, data.accelY,
+              data.accelZ, gps.fix().has(NMEA_POSITION) ? gps.fix().position.lat / (double)GEO_E7 : 0.0,
+              gps.fix().has(NMEA_POSITION) ? gps.fix().position.lon / (double)GEO_E7 : 0.0,
+              pipeline.isGPSDataValid() ? 1 : 0);
+      if (polarPath && polarValid) {
+        fprintf(out, ",%.3f,%.3f,%.1f", performance.vmg, performance.targetSpeed, performance.percent);
+        polarTicks++;
+        if (!std::isnan(performance.percent)) {
+          polarPercentSum += performance.percent;
+          polarPercentTicks++;
+        }
+      } else if (polarPath) {
+        fprintf(out, ",,,");
+      }
+      fputc('\n', out);
+      ticks++;
+    }
+
+    if (!power) {
+      now += rate;
+      continue;
+    }
+
+    // Same sequence as loop(): mode update, then wait for the next deadline
+    if (refresh) nextRefresh = now + scheduler.refreshInterval(rate);
+    if (scheduler.update(now, pipeline.isMoving(), clients, false) && scheduler.mode() == POWER_ACTIVE) {
+      nextRefresh = now;
+    }
+    uint32_t awake = refresh ? POWER_SIM_REFRESH_AWAKE_MS
+                     : windBus.requests != windRequests ? POWER_SIM_WIND_AWAKE_MS : POWER_SIM_POLL_AWAKE_MS;
+    uint32_t wait = scheduler.waitBudget(now + awake, nextRefresh);
+    PowerModeTime &time = modeTime[scheduler.mode()];
+    time.awakeMs += awake;
+    time.waitMs += wait;
+    time.passes++;
+    scheduler.recordAwake(awake * 1000);
+    scheduler.recordWait(wait * 1000);
+    now += awake + wait;
+  }
+  double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+  if (outPath) fclose(out);
+
+  fprintf(stderr, "ticks:              %zu (%.1f s replayed in %.1f ms, %.0fx real time)\n", ticks, endTime / 1000.0,
+          wallMs, wallMs > 0 ? endTime / wallMs : 0.0);
+  fprintf(stderr, "gps sentences:      %u ok, %u bad checksum, %zu bytes dropped on RX overflow\n",
+          (unsigned)gps.passedChecksum(), (unsigned)gps.failedChecksum(), gpsUart.overflowBytes);
+  fprintf(stderr, "modbus:             %zu requests, %zu reconfigurations\n", windBus.requests, windBus.reconfigurations);
+  fprintf(stderr, "spikes rejected:    AWS %lu, AWA %lu, SOG %lu\n",
+          (unsigned long)pipeline.outlierFilter(OUTLIER_AWS).rejected(),
+          (unsigned long)pipeline.outlierFilter(OUTLIER_AWA).rejected(),
+          (unsigned long)pipeline.outlierFilter(OUTLIER_SOG).rejected());
+  fprintf(stderr, "telemetry:          %.1f bytes/frame\n", link.frames ? (double)link.bytes / link.frames : 0.0);
+  fprintf(stderr, "published:          %zu frames over %zu ticks (%zu first, %zu change, %zu heartbeat; "
+                  "%zu between ticks)\n", link.frames, ticks, publishReasons[PUBLISH_FIRST],
+          publishReasons[PUBLISH_CHANGE], publishReasons[PUBLISH_HEARTBEAT], fastPublished);
+  if (polarPath) {
+    fprintf(stderr, "polar:              %zu ticks with true wind, %.1f%% of target on average\n", polarTicks,
+            polarPercentTicks ? polarPercentSum / polarPercentTicks : 0.0);
+  }
+  if (power) {
+    double charge = 0;  // mA*ms
+    uint64_t totalMs = 0;
+    for (int mode = POWER_ACTIVE; mode <= POWER_MOORED; mode++) {
+      const PowerModeTime &time = modeTime[mode];
+      uint64_t spanMs = time.awakeMs + time.waitMs;
+      double waitMa = mode == POWER_MOORED ? POWER_SIM_SLEEP_MA : POWER_SIM_IDLE_MA;
+      charge += time.awakeMs * POWER_SIM_AWAKE_MA + time.waitMs * waitMa;
+      totalMs += spanMs;
+      fprintf(stderr, "power %-13s %.1f s, %zu wakeups, duty cycle %.1f%%\n", powerModeName((PowerMode)mode),
+              spanMs / 1000.0, time.passes, spanMs ? 100.0 * time.awakeMs / spanMs : 0.0);
+    }
+    double averageMa = totalMs ? charge / totalMs : 0.0;
+    fprintf(stderr, "power model:        %.1f mA average vs %.1f mA busy-looping, %.0f h on %.0f mAh "
+                    "(ESP32 only, sensors excluded), %u mode changes\n",
+            averageMa, POWER_SIM_AWAKE_MA, averageMa > 0 ? POWER_SIM_BATTERY_MAH / averageMa : 0.0,
+            POWER_SIM_BATTERY_MAH, (unsigned)scheduler.modeChanges());
+  }
+  fprintf(stderr, "%-12s %8s %10s %10s %10s %10s\n", "section", "count", "min us", "avg us", "max us", "p99 us");
+  for (int section = 0; section < PROF_SECTION_COUNT; section++) {
+    ProfileSummary summary;
+    profiler.summary(section, summary);
+    if (summary.count == 0) continue;
+    fprintf(stderr, "%-12s %8u %10.2f %10.2f %10.2f %10.2f\n", profileSectionName(section), (unsigned)summary.count,
+            summary.minUs, summary.avgUs, summary.maxUs, summary.p99Us);
+  }
+
+  if (tracePath) {
+    FILE* trace = fopen(tracePath, "w");
+    if (!trace) {
+      fprintf(stderr, "Cannot write %s\n", tracePath);
+      return 1;
+    }
+    fprintf(trace, "{\"traceEvents\":[\n");
+    char buffer[128];
+    for (size_t i = 0; i < profiler.traceCount(); i++) {
+      ProfileEvent event;
+      profiler.traceEvent(i, event);
+      profiler.formatTraceEvent(event, buffer, sizeof(buffer));
+      fprintf(trace, "%s%s\n", buffer, i + 1 < profiler.traceCount() ? "," : "");
+    }
+    fprintf(trace, "]}\n");
+    fclose(trace);
+  }
+  return 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+// Minimal Arduino.h for the native build. Only what TinyGPSPlus and the
+// portable libraries use; time comes from the replay harness clock.
+
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t byte;
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+
+#define radians(deg) ((deg)*DEG_TO_RAD)
+#define degrees(rad) ((rad)*RAD_TO_DEG)
+#define sq(x) ((x)*(x))
+
+unsigned long millis();
+unsigned long micros();
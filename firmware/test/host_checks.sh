@@ -0,0 +1,81 @@
+#!/bin/sh
+# Builds and runs the host checks in firmware/lib/*/examples: the private
+# libraries have no Arduino dependencies, so each check is one g++ command
+# (the same as in its header comment) and exits 1 on a failure.
+#
+#   sh firmware/test/host_checks.sh
+#
+# nmea_benchmark compares against TinyGPS++ from the native environment's
+# libraries (pio pkg install -e native); without them it is skipped.
+# The replay harness (src/native, as the native environment builds it) is
+# run on the capture in test/replay and its per-tick CSV diffed against
+# test/replay/ticks.csv.
+# Exits 1 when a check fails to build or fails.
+
+cd "$(dirname "$0")/../lib" || exit 1
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+CXX=${CXX:-g++}
+TINYGPS=../../.pio/libdeps/native/TinyGPSPlus/src
+REPLAY=../test/replay
+failed=""
+
+# check <name> <compiler arguments...>
+check() {
+  name=$1
+  shift
+  echo "=== $name"
+  if ! $CXX -std=gnu++17 -O2 "$@" -o "$OUT/$name"; then
+    failed="$failed $name(build)"
+    return
+  fi
+  "$OUT/$name" || failed="$failed $name"
+}
+
+check codec_benchmark -I TelemetryCodec TelemetryCodec/TelemetryCodec.cpp \
+  TelemetryCodec/examples/codec_benchmark/codec_benchmark.cpp
+echo "=== codec_benchmark $REPLAY/telemetry.csv"
+"$OUT/codec_benchmark" $REPLAY/telemetry.csv || failed="$failed codec_benchmark(telemetry.csv)"
+check polar_tool -I PolarTable PolarTable/PolarTable.cpp PolarTable/examples/polar_tool/polar_tool.cpp
+check geodesy_check -I Geodesy Geodesy/Geodesy.cpp Geodesy/examples/geodesy_check/geodesy_check.cpp
+check track_stats_check -I TrackStats -I Geodesy TrackStats/TrackStats.cpp Geodesy/Geodesy.cpp \
+  TrackStats/examples/track_stats_check/track_stats_check.cpp
+if [ -f "$TINYGPS/TinyGPS++.cpp" ]; then
+  check nmea_benchmark -DARDUINO=100 -I NmeaParser -I Geodesy -I ../src/native/shim -I "$TINYGPS" \
+    NmeaParser/NmeaParser.cpp "$TINYGPS/TinyGPS++.cpp" NmeaParser/examples/nmea_benchmark/nmea_benchmark.cpp
+else
+  echo "=== nmea_benchmark SKIPPED: no TinyGPS++ (pio pkg install -e native)"
+fi
+check nmea_validator -I NmeaOutput -I NmeaParser -I StartLine -I TelemetryCodec -I Geodesy \
+  NmeaOutput/NmeaOutput.cpp NmeaParser/NmeaParser.cpp NmeaOutput/examples/nmea_validator/nmea_validator.cpp
+check server_check -I TelemetryServer -I TelemetryCodec -I VeetrHal TelemetryServer/TelemetryServer.cpp \
+  TelemetryCodec/TelemetryCodec.cpp TelemetryServer/examples/server_check/server_check.cpp
+check trend_check -I TrendHistory -I TelemetryCodec TrendHistory/TrendHistory.cpp TelemetryCodec/TelemetryCodec.cpp \
+  TrendHistory/examples/trend_check/trend_check.cpp
+check spike_check -I HampelFilter HampelFilter/HampelFilter.cpp HampelFilter/examples/spike_check/spike_check.cpp
+check orientation_check -I Orientation Orientation/Orientation.cpp \
+  Orientation/examples/orientation_check/orientation_check.cpp
+check patch_tool -I DeltaPatch DeltaPatch/DeltaPatch.cpp DeltaPatch/Sha256.cpp \
+  DeltaPatch/examples/patch_tool/patch_tool.cpp
+check lzss_tool -I Lzss Lzss/Lzss.cpp Lzss/examples/lzss_tool/lzss_tool.cpp
+
+echo "=== replay"
+if ! $CXX -std=gnu++17 -O2 -DARDUINO=100 -DVEETR_LOG_LEVEL=4 -I ../src/native/shim \
+    $(for lib in */; do printf -- '-I %s ' "$lib"; done) ../src/native/replay_main.cpp \
+    SensorPipeline/SensorPipeline.cpp TelemetryCodec/TelemetryCodec.cpp Profiler/Profiler.cpp Logger/Logger.cpp \
+    PowerScheduler/PowerScheduler.cpp ChangePublisher/ChangePublisher.cpp PolarTable/PolarTable.cpp \
+    TrueWind/TrueWind.cpp Geodesy/Geodesy.cpp TrackStats/TrackStats.cpp HampelFilter/HampelFilter.cpp \
+    Orientation/Orientation.cpp NmeaParser/NmeaParser.cpp -o "$OUT/replay"; then
+  failed="$failed replay(build)"
+elif ! "$OUT/replay" --nmea $REPLAY/gps.nmea --wind $REPLAY/wind.csv --imu $REPLAY/imu.csv --out "$OUT/ticks.csv"; then
+  failed="$failed replay"
+elif ! cmp -s $REPLAY/ticks.csv "$OUT/ticks.csv"; then
+  diff $REPLAY/ticks.csv "$OUT/ticks.csv" | head -20
+  failed="$failed replay(ticks.csv differs)"
+fi
+
+if [ -n "$failed" ]; then
+  echo "FAILED:$failed"
+  exit 1
+fi
+echo "All host checks passed"